@@ -296,6 +296,7 @@
         }],
         ['OS=="win" and component!="shared_library"', {
           'dependencies': [
+            'allocator_extension_thunks',
             'libcmt',
           ],
           'sources': [
@@ -356,7 +357,8 @@
     {
       # This library is linked in to src/base.gypi:base and allocator_unittests
       # It can't depend on either and nothing else should depend on it - all
-      # other code should use the interfaced provided by base.
+      # other code should use the interfaced provided by base. The exception
+      # is the Windows allocator shim, which calls the allocation hooks.
       'target_name': 'allocator_extension_thunks',
       'type': 'static_library',
       'sources': [
@@ -32,6 +32,17 @@ void ReleaseFreeMemory() {
     release_free_memory_function();
 }
 
+bool AreAllocationHooksSupported() {
+  return thunks::AreAllocationHooksSupported();
+}
+
+void SetAllocationHooks(const thunks::AllocationHooks* hooks) {
+  DCHECK(!thunks::GetAllocationHooks());
+  DCHECK(hooks->allocation_hook);
+  DCHECK(hooks->free_hook);
+  thunks::SetAllocationHooks(hooks);
+}
+
 void SetGetAllocatorWasteSizeFunction(
     thunks::GetAllocatorWasteSizeFunction get_allocator_waste_size_function) {
   DCHECK_EQ(thunks::GetGetAllocatorWasteSizeFunction(),
@@ -35,6 +35,16 @@ BASE_EXPORT void GetStats(char* buffer, int buffer_length);
 // system.
 BASE_EXPORT void ReleaseFreeMemory();
 
+// Returns true if the allocator shim calls the hooks set with
+// SetAllocationHooks(). Only the Windows allocator shim does.
+BASE_EXPORT bool AreAllocationHooksSupported();
+
+// Sets the functions that the allocator shim calls after every allocation,
+// and before every free. Both must be non-NULL, and |hooks| must outlive the
+// process. They may only be set once. They are called on any thread, from
+// within the allocator, so they must not assume that allocating or freeing in
+// turn is possible without coming back to them.
+BASE_EXPORT void SetAllocationHooks(const thunks::AllocationHooks* hooks);
 
 // These settings allow specifying a callback used to implement the allocator
 // extension functions.  These are optional, but if set they must only be set
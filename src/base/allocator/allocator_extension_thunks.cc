@@ -21,6 +21,11 @@ static GetAllocatorWasteSizeFunction g_get_allocator_waste_size_function = NULL;
 static GetStatsFunction g_get_stats_function = NULL;
 static ReleaseFreeMemoryFunction g_release_free_memory_function = NULL;
 static GetNumericPropertyFunction g_get_numeric_property_function = NULL;
+// Read on every allocation by the allocator shim, without a lock. Volatile
+// pointer-sized accesses are atomic, with acquire and release semantics, with
+// the compiler the shim is built with (MSVC).
+static const AllocationHooks* volatile g_allocation_hooks = NULL;
+static bool g_allocation_hooks_supported = false;
 
 void SetGetAllocatorWasteSizeFunction(
     GetAllocatorWasteSizeFunction get_allocator_waste_size_function) {
@@ -57,6 +62,22 @@ GetNumericPropertyFunction GetGetNumericPropertyFunction() {
   return g_get_numeric_property_function;
 }
 
+void SetAllocationHooks(const AllocationHooks* hooks) {
+  g_allocation_hooks = hooks;
+}
+
+const AllocationHooks* GetAllocationHooks() {
+  return g_allocation_hooks;
+}
+
+void SetAllocationHooksSupported() {
+  g_allocation_hooks_supported = true;
+}
+
+bool AreAllocationHooksSupported() {
+  return g_allocation_hooks_supported;
+}
+
 }  // namespace thunks
 }  // namespace allocator
 }  // namespace base
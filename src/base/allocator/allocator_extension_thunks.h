@@ -34,6 +34,24 @@ void SetGetNumericPropertyFunction(
     GetNumericPropertyFunction get_numeric_property_function);
 GetNumericPropertyFunction GetGetNumericPropertyFunction();
 
+// Called by an allocator shim after every allocation, and before every free.
+typedef void (*AllocationHookFunction)(void* address, size_t size);
+typedef void (*FreeHookFunction)(void* address);
+struct AllocationHooks {
+  AllocationHookFunction allocation_hook;
+  FreeHookFunction free_hook;
+};
+// Both hooks are installed at once, with a single pointer store, so that a
+// shim never calls one hook without the other. |hooks| must be fully set up
+// before it is passed in, and must stay valid for the life of the process.
+void SetAllocationHooks(const AllocationHooks* hooks);
+const AllocationHooks* GetAllocationHooks();
+
+// Called by an allocator shim that calls the allocation hooks, when it is
+// initialized.
+void SetAllocationHooksSupported();
+bool AreAllocationHooksSupported();
+
 }  // namespace thunks
 }  // namespace allocator
 }  // namespace base
@@ -6,6 +6,7 @@
 #include <new.h>
 #include <windows.h>
 
+#include "base/allocator/allocator_extension_thunks.h"
 #include "base/basictypes.h"
 
 // This shim make it possible to perform additional checks on allocations
@@ -16,6 +17,7 @@
 // perform additional checks:
 // 1. Enforcing the maximum size that can be allocated to 2Gb.
 // 2. Calling new_handler if malloc fails.
+// 3. Calling the allocation hooks that base installs for heap profiling.
 
 extern "C" {
 // We set this to 1 because part of the CRT uses a check of _crtheap != 0
@@ -34,6 +36,30 @@ const size_t kWindowsPageSize = 4096;
 const size_t kMaxWindowsAllocation = INT_MAX - kWindowsPageSize;
 int new_mode = 0;
 
+// Tells the allocation hook, if base has installed one, about |ptr|. The
+// hooks may change the last error, e.g. through TlsGetValue(), which callers
+// of the allocator don't expect, so it is restored after them.
+inline void call_allocation_hook(void* ptr, size_t size) {
+  const base::allocator::thunks::AllocationHooks* hooks =
+      base::allocator::thunks::GetAllocationHooks();
+  if (hooks) {
+    DWORD last_error = GetLastError();
+    hooks->allocation_hook(ptr, size);
+    SetLastError(last_error);
+  }
+}
+
+// Tells the free hook, if base has installed one, that |ptr| is being freed.
+inline void call_free_hook(void* ptr) {
+  const base::allocator::thunks::AllocationHooks* hooks =
+      base::allocator::thunks::GetAllocationHooks();
+  if (hooks) {
+    DWORD last_error = GetLastError();
+    hooks->free_hook(ptr);
+    SetLastError(last_error);
+  }
+}
+
 // VS2013 crt uses the process heap as its heap, so we do the same here.
 // See heapinit.c in VS CRT sources.
 bool win_heap_init() {
@@ -50,14 +76,19 @@ bool win_heap_init() {
   HeapSetInformation(_crtheap, HeapCompatibilityInformation, &enable_lfh,
                      sizeof(enable_lfh));
 
+  // Every allocation and free goes through the functions below, which call
+  // the allocation hooks.
+  base::allocator::thunks::SetAllocationHooksSupported();
   return true;
 }
 
 void* win_heap_malloc(size_t size) {
   if (size < kMaxWindowsAllocation) {
     void* ptr = HeapAlloc(_crtheap, 0, size);
-    if (ptr)
+    if (ptr) {
         ::InterlockedAdd64(&allocator_shim_counter, size);
+        call_allocation_hook(ptr, size);
+    }
     return ptr;
   }
   return NULL;
@@ -65,6 +96,7 @@ void* win_heap_malloc(size_t size) {
 
 void win_heap_free(void* ptr) {
   if (ptr) {
+    call_free_hook(ptr);
     size_t size = HeapSize(_crtheap, 0, ptr);
     ::InterlockedAdd64(&allocator_shim_counter, -static_cast<LONG64>(size));
   }
@@ -79,9 +111,14 @@ void* win_heap_realloc(void* ptr, size_t size) {
     return NULL;
   }
   if (size < kMaxWindowsAllocation) {
+    // |ptr| is reported as freed before it is reallocated, so that another
+    // thread can't be handed its address first. If reallocating fails, the
+    // allocation goes on unreported.
+    call_free_hook(ptr);
     size_t old_size = HeapSize(_crtheap, 0, ptr);
     void* new_ptr = HeapReAlloc(_crtheap, 0, ptr, size);
     if (new_ptr) {
+      call_allocation_hook(new_ptr, size);
       if (size >= old_size)
         ::InterlockedAdd64(&allocator_shim_counter, size - old_size);
       else
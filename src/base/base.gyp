@@ -849,6 +849,17 @@
             'i18n/build_utf8_validator_tables.cc'
           ],
         },
+        {
+          # Converts traces in the binary format back to JSON.
+          'target_name': 'convert_binary_trace',
+          'type': 'executable',
+          'dependencies': [
+            'base',
+          ],
+          'sources': [
+            'trace_event/convert_binary_trace.cc',
+          ],
+        },
       ],
     }],
     ['OS == "win" and target_arch=="ia32"', {
@@ -19,6 +19,12 @@ const char kEnableCrashReporter[]           = "enable-crash-reporter";
 // the memory-infra category is enabled.
 const char kEnableHeapProfiling[]           = "enable-heap-profiling";
 
+// The mean number of bytes allocated between two allocations that are sampled
+// by the heap profiler, when heap profiling is enabled. Larger values make heap
+// profiling cheaper but less precise.
+const char kHeapProfilingSamplingInterval[] =
+    "heap-profiling-sampling-interval";
+
 // Generates full memory crash dump.
 const char kFullMemoryCrashReport[]         = "full-memory-crash-report";
 
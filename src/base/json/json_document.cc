@@ -0,0 +1,366 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_document.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/logging.h"
+
+namespace base {
+
+// JSONDocument::ValueRef ------------------------------------------------------
+
+JSONDocument::ValueRef::ValueRef() : document_(NULL), node_index_(0) {}
+
+JSONDocument::ValueRef::ValueRef(const JSONDocument* document,
+                                 uint32 node_index)
+    : document_(document), node_index_(node_index) {}
+
+Value::Type JSONDocument::ValueRef::GetType() const {
+  if (!document_)
+    return Value::TYPE_NULL;
+  return document_->nodes_[node_index_].type;
+}
+
+bool JSONDocument::ValueRef::IsType(Value::Type type) const {
+  return GetType() == type;
+}
+
+bool JSONDocument::ValueRef::GetAsBoolean(bool* out_value) const {
+  if (!IsType(Value::TYPE_BOOLEAN))
+    return false;
+  if (out_value)
+    *out_value = document_->nodes_[node_index_].bool_value;
+  return true;
+}
+
+bool JSONDocument::ValueRef::GetAsInteger(int* out_value) const {
+  if (!IsType(Value::TYPE_INTEGER))
+    return false;
+  if (out_value)
+    *out_value = document_->nodes_[node_index_].int_value;
+  return true;
+}
+
+bool JSONDocument::ValueRef::GetAsDouble(double* out_value) const {
+  if (IsType(Value::TYPE_INTEGER)) {
+    if (out_value)
+      *out_value = document_->nodes_[node_index_].int_value;
+    return true;
+  }
+  if (!IsType(Value::TYPE_DOUBLE))
+    return false;
+  if (out_value)
+    *out_value = document_->nodes_[node_index_].double_value;
+  return true;
+}
+
+bool JSONDocument::ValueRef::GetAsString(std::string* out_value) const {
+  StringPiece string;
+  if (!GetAsString(&string))
+    return false;
+  if (out_value)
+    string.CopyToString(out_value);
+  return true;
+}
+
+bool JSONDocument::ValueRef::GetAsString(StringPiece* out_value) const {
+  if (!IsType(Value::TYPE_STRING))
+    return false;
+  if (out_value)
+    *out_value = document_->GetString(document_->nodes_[node_index_]);
+  return true;
+}
+
+size_t JSONDocument::ValueRef::GetSize() const {
+  if (IsType(Value::TYPE_LIST))
+    return document_->nodes_[node_index_].size;
+  if (IsType(Value::TYPE_DICTIONARY))
+    return document_->nodes_[node_index_].size / 2;
+  return 0;
+}
+
+bool JSONDocument::ValueRef::Get(size_t index, ValueRef* out_value) const {
+  if (!IsType(Value::TYPE_LIST))
+    return false;
+  const Node& node = document_->nodes_[node_index_];
+  if (index >= node.size)
+    return false;
+  if (out_value)
+    *out_value = ValueRef(document_, document_->items_[node.offset + index]);
+  return true;
+}
+
+bool JSONDocument::ValueRef::HasKey(const StringPiece& key) const {
+  return GetWithoutPathExpansion(key, NULL);
+}
+
+bool JSONDocument::ValueRef::Get(const StringPiece& path,
+                                 ValueRef* out_value) const {
+  ValueRef current = *this;
+  StringPiece remaining = path;
+  for (size_t delimiter = remaining.find('.'); delimiter != StringPiece::npos;
+       delimiter = remaining.find('.')) {
+    if (!current.GetWithoutPathExpansion(remaining.substr(0, delimiter),
+                                         &current) ||
+        !current.IsType(Value::TYPE_DICTIONARY)) {
+      return false;
+    }
+    remaining = remaining.substr(delimiter + 1);
+  }
+  return current.GetWithoutPathExpansion(remaining, out_value);
+}
+
+bool JSONDocument::ValueRef::GetBoolean(const StringPiece& path,
+                                        bool* out_value) const {
+  ValueRef value;
+  return Get(path, &value) && value.GetAsBoolean(out_value);
+}
+
+bool JSONDocument::ValueRef::GetInteger(const StringPiece& path,
+                                        int* out_value) const {
+  ValueRef value;
+  return Get(path, &value) && value.GetAsInteger(out_value);
+}
+
+bool JSONDocument::ValueRef::GetDouble(const StringPiece& path,
+                                       double* out_value) const {
+  ValueRef value;
+  return Get(path, &value) && value.GetAsDouble(out_value);
+}
+
+bool JSONDocument::ValueRef::GetString(const StringPiece& path,
+                                       std::string* out_value) const {
+  ValueRef value;
+  return Get(path, &value) && value.GetAsString(out_value);
+}
+
+bool JSONDocument::ValueRef::GetDictionary(const StringPiece& path,
+                                           ValueRef* out_value) const {
+  return GetTyped(path, Value::TYPE_DICTIONARY, out_value);
+}
+
+bool JSONDocument::ValueRef::GetList(const StringPiece& path,
+                                     ValueRef* out_value) const {
+  return GetTyped(path, Value::TYPE_LIST, out_value);
+}
+
+bool JSONDocument::ValueRef::GetWithoutPathExpansion(
+    const StringPiece& key,
+    ValueRef* out_value) const {
+  if (!IsType(Value::TYPE_DICTIONARY))
+    return false;
+  int item_index = document_->FindKey(document_->nodes_[node_index_], key);
+  if (item_index < 0)
+    return false;
+  if (out_value)
+    *out_value = ValueRef(document_, document_->items_[item_index]);
+  return true;
+}
+
+bool JSONDocument::ValueRef::GetEntry(size_t index,
+                                      StringPiece* key,
+                                      ValueRef* out_value) const {
+  if (!IsType(Value::TYPE_DICTIONARY) || index >= GetSize())
+    return false;
+  size_t key_index = document_->nodes_[node_index_].offset + 2 * index;
+  if (key) {
+    *key =
+        document_->GetString(document_->nodes_[document_->items_[key_index]]);
+  }
+  if (out_value)
+    *out_value = ValueRef(document_, document_->items_[key_index + 1]);
+  return true;
+}
+
+scoped_ptr<Value> JSONDocument::ValueRef::CreateDeepCopy() const {
+  switch (GetType()) {
+    case Value::TYPE_BOOLEAN:
+      return make_scoped_ptr(
+          new FundamentalValue(document_->nodes_[node_index_].bool_value));
+    case Value::TYPE_INTEGER:
+      return make_scoped_ptr(
+          new FundamentalValue(document_->nodes_[node_index_].int_value));
+    case Value::TYPE_DOUBLE:
+      return make_scoped_ptr(
+          new FundamentalValue(document_->nodes_[node_index_].double_value));
+    case Value::TYPE_STRING: {
+      StringPiece string;
+      GetAsString(&string);
+      return make_scoped_ptr(new StringValue(string.as_string()));
+    }
+    case Value::TYPE_LIST: {
+      scoped_ptr<ListValue> list(new ListValue);
+      ValueRef item;
+      for (size_t i = 0; Get(i, &item); ++i)
+        list->Append(item.CreateDeepCopy());
+      return list.Pass();
+    }
+    case Value::TYPE_DICTIONARY: {
+      scoped_ptr<DictionaryValue> dictionary(new DictionaryValue);
+      StringPiece key;
+      ValueRef value;
+      for (size_t i = 0; GetEntry(i, &key, &value); ++i) {
+        dictionary->SetWithoutPathExpansion(key.as_string(),
+                                            value.CreateDeepCopy());
+      }
+      return dictionary.Pass();
+    }
+    default:
+      return Value::CreateNullValue();
+  }
+}
+
+bool JSONDocument::ValueRef::GetTyped(const StringPiece& path,
+                                      Value::Type type,
+                                      ValueRef* out_value) const {
+  ValueRef value;
+  if (!Get(path, &value) || !value.IsType(type))
+    return false;
+  if (out_value)
+    *out_value = value;
+  return true;
+}
+
+// JSONDocument ----------------------------------------------------------------
+
+JSONDocument::JSONDocument(const StringPiece& json)
+    : json_(json.as_string()), root_index_(0) {}
+
+JSONDocument::~JSONDocument() {}
+
+JSONDocument::ValueRef JSONDocument::root() const {
+  return ValueRef(this, root_index_);
+}
+
+void JSONDocument::AddNull() {
+  Node node = Node();
+  node.type = Value::TYPE_NULL;
+  AddNode(node);
+}
+
+void JSONDocument::AddBoolean(bool value) {
+  Node node = Node();
+  node.type = Value::TYPE_BOOLEAN;
+  node.bool_value = value;
+  AddNode(node);
+}
+
+void JSONDocument::AddInteger(int value) {
+  Node node = Node();
+  node.type = Value::TYPE_INTEGER;
+  node.int_value = value;
+  AddNode(node);
+}
+
+void JSONDocument::AddDouble(double value) {
+  Node node = Node();
+  node.type = Value::TYPE_DOUBLE;
+  node.double_value = value;
+  AddNode(node);
+}
+
+void JSONDocument::AddString(const StringPiece& string) {
+  DCHECK(string.data() >= json_.data() &&
+         string.data() + string.size() <= json_.data() + json_.size());
+  Node node = Node();
+  node.type = Value::TYPE_STRING;
+  node.size = static_cast<uint32>(string.size());
+  node.offset = static_cast<uint32>(string.data() - json_.data());
+  AddNode(node);
+}
+
+void JSONDocument::AddDecodedString(const std::string& string) {
+  Node node = Node();
+  node.type = Value::TYPE_STRING;
+  node.is_decoded = true;
+  node.size = static_cast<uint32>(string.size());
+  node.offset = static_cast<uint32>(decoded_strings_.size());
+  decoded_strings_.append(string);
+  AddNode(node);
+}
+
+size_t JSONDocument::BeginContainer() const {
+  return pending_items_.size();
+}
+
+void JSONDocument::EndList(size_t begin) {
+  DCHECK_LE(begin, pending_items_.size());
+  Node node = Node();
+  node.type = Value::TYPE_LIST;
+  node.offset = static_cast<uint32>(items_.size());
+  node.size = static_cast<uint32>(pending_items_.size() - begin);
+  items_.insert(items_.end(), pending_items_.begin() + begin,
+                pending_items_.end());
+  pending_items_.resize(begin);
+  AddNode(node);
+}
+
+void JSONDocument::EndDictionary(size_t begin) {
+  DCHECK_LE(begin, pending_items_.size());
+  DCHECK_EQ(0u, (pending_items_.size() - begin) % 2);
+
+  // Sort the entries by key. Entries with the same key stay in input order,
+  // since the position of the key breaks ties.
+  std::vector<std::pair<StringPiece, size_t>> entries;
+  entries.reserve((pending_items_.size() - begin) / 2);
+  for (size_t i = begin; i < pending_items_.size(); i += 2)
+    entries.push_back(std::make_pair(GetString(nodes_[pending_items_[i]]), i));
+  std::sort(entries.begin(), entries.end());
+
+  Node node = Node();
+  node.type = Value::TYPE_DICTIONARY;
+  node.offset = static_cast<uint32>(items_.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    // Like DictionaryValue::SetWithoutPathExpansion(), the last entry with a
+    // given key wins.
+    if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first)
+      continue;
+    items_.push_back(pending_items_[entries[i].second]);
+    items_.push_back(pending_items_[entries[i].second + 1]);
+  }
+  node.size = static_cast<uint32>(items_.size() - node.offset);
+  pending_items_.resize(begin);
+  AddNode(node);
+}
+
+void JSONDocument::Finish() {
+  DCHECK_EQ(1u, pending_items_.size());
+  root_index_ = pending_items_[0];
+  std::vector<uint32>().swap(pending_items_);
+}
+
+void JSONDocument::AddNode(const Node& node) {
+  pending_items_.push_back(static_cast<uint32>(nodes_.size()));
+  nodes_.push_back(node);
+}
+
+StringPiece JSONDocument::GetString(const Node& node) const {
+  DCHECK_EQ(Value::TYPE_STRING, node.type);
+  const std::string& strings = node.is_decoded ? decoded_strings_ : json_;
+  return StringPiece(strings.data() + node.offset, node.size);
+}
+
+int JSONDocument::FindKey(const Node& node, const StringPiece& key) const {
+  DCHECK_EQ(Value::TYPE_DICTIONARY, node.type);
+  // Binary search over the keys, which are every other item.
+  size_t low = 0;
+  size_t high = node.size / 2;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    size_t key_index = node.offset + 2 * middle;
+    int comparison = GetString(nodes_[items_[key_index]]).compare(key);
+    if (comparison == 0)
+      return static_cast<int>(key_index + 1);
+    if (comparison < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return -1;
+}
+
+}  // namespace base
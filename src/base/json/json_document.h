@@ -0,0 +1,180 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_JSON_JSON_DOCUMENT_H_
+#define BASE_JSON_JSON_DOCUMENT_H_
+
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/values.h"
+
+namespace base {
+
+namespace internal {
+class JSONParser;
+}
+
+// JSONDocument is a read-only alternative to the Value tree that JSONReader
+// produces, for large inputs that are only read from.
+//
+// Parsing a document allocates a handful of arrays rather than one object
+// per value: values live in a single array, the items of every list and
+// dictionary in another one, and strings are kept as ranges of a copy of the
+// input, unless they had to be unescaped. Dictionary keys are sorted, so
+// lookups are binary searches.
+//
+// Values are read through ValueRef, which mirrors the read-only parts of the
+// Value, ListValue and DictionaryValue interfaces. A ValueRef must not
+// outlive its document. CreateDeepCopy() converts any part of the document
+// to a regular Value.
+//
+// Use JSONReader::ReadDocument() to create one.
+class BASE_EXPORT JSONDocument {
+ public:
+  class BASE_EXPORT ValueRef {
+   public:
+    // Refers to a null value that belongs to no document.
+    ValueRef();
+
+    Value::Type GetType() const;
+    bool IsType(Value::Type type) const;
+
+    // As in Value. GetAsDouble() also accepts integers.
+    bool GetAsBoolean(bool* out_value) const;
+    bool GetAsInteger(int* out_value) const;
+    bool GetAsDouble(double* out_value) const;
+    bool GetAsString(std::string* out_value) const;
+    bool GetAsString(StringPiece* out_value) const;
+
+    // Returns the number of items of a list or a dictionary, and 0 for other
+    // values.
+    size_t GetSize() const;
+
+    // Lists. As in ListValue.
+    bool Get(size_t index, ValueRef* out_value) const;
+
+    // Dictionaries. As in DictionaryValue, |path| is split at periods, while
+    // |key| is used as is.
+    bool HasKey(const StringPiece& key) const;
+    bool Get(const StringPiece& path, ValueRef* out_value) const;
+    bool GetBoolean(const StringPiece& path, bool* out_value) const;
+    bool GetInteger(const StringPiece& path, int* out_value) const;
+    bool GetDouble(const StringPiece& path, double* out_value) const;
+    bool GetString(const StringPiece& path, std::string* out_value) const;
+    bool GetDictionary(const StringPiece& path, ValueRef* out_value) const;
+    bool GetList(const StringPiece& path, ValueRef* out_value) const;
+    bool GetWithoutPathExpansion(const StringPiece& key,
+                                 ValueRef* out_value) const;
+
+    // Returns the |index|th entry of a dictionary, in key order.
+    bool GetEntry(size_t index, StringPiece* key, ValueRef* out_value) const;
+
+    // Returns this value as a Value tree, owned by the caller.
+    scoped_ptr<Value> CreateDeepCopy() const;
+
+   private:
+    friend class JSONDocument;
+
+    ValueRef(const JSONDocument* document, uint32 node_index);
+
+    // Gets the item of a typed path, if it has |type|.
+    bool GetTyped(const StringPiece& path,
+                  Value::Type type,
+                  ValueRef* out_value) const;
+
+    // NULL for the default constructed null value.
+    const JSONDocument* document_;
+    uint32 node_index_;
+  };
+
+  ~JSONDocument();
+
+  // Returns the root of the document.
+  ValueRef root() const;
+
+ private:
+  friend class internal::JSONParser;
+
+  // A value of the document.
+  struct Node {
+    Value::Type type;
+
+    // For strings, whether |offset| is into |decoded_strings_| rather than
+    // into |json_|.
+    bool is_decoded;
+
+    // For strings, the length in bytes. For lists and dictionaries, the
+    // number of entries in |items_|: one per list item, and two per
+    // dictionary entry, the key first.
+    uint32 size;
+
+    union {
+      bool bool_value;
+      int int_value;
+      double double_value;
+      // For strings, the start of the string. For lists and dictionaries,
+      // the index of the first entry in |items_|.
+      uint32 offset;
+    };
+  };
+
+  // Only to be created by JSONParser, which fills it in with the methods
+  // below.
+  explicit JSONDocument(const StringPiece& json);
+
+  // The copy of the input that the parser runs over.
+  const std::string& json() const { return json_; }
+
+  // Each of these adds a value, which then becomes an item of the list or
+  // dictionary being parsed, or the root. |string| must be a range of
+  // json().
+  void AddNull();
+  void AddBoolean(bool value);
+  void AddInteger(int value);
+  void AddDouble(double value);
+  void AddString(const StringPiece& string);
+  void AddDecodedString(const std::string& string);
+
+  // Called before the items of a list or dictionary are added. Returns the
+  // value to pass to EndList() or EndDictionary() once they all have been,
+  // which adds the list or dictionary.
+  size_t BeginContainer() const;
+  void EndList(size_t begin);
+  void EndDictionary(size_t begin);
+
+  // Called once the whole input has been parsed.
+  void Finish();
+
+  void AddNode(const Node& node);
+
+  StringPiece GetString(const Node& node) const;
+
+  // Returns the index of the value of |key| in the dictionary |node|, or
+  // -1 if there is none.
+  int FindKey(const Node& node, const StringPiece& key) const;
+
+  std::string json_;
+
+  // Strings that are not as is in |json_|, because of escape sequences.
+  std::string decoded_strings_;
+
+  std::vector<Node> nodes_;
+  std::vector<uint32> items_;
+
+  // Values whose list or dictionary is still being parsed.
+  std::vector<uint32> pending_items_;
+
+  uint32 root_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONDocument);
+};
+
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_DOCUMENT_H_
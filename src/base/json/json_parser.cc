@@ -4,8 +4,12 @@
 
 #include "base/json/json_parser.h"
 
+#include <string.h>
+
 #include <cmath>
 
+#include "base/json/json_document.h"
+#include "base/json/string_scan_internal.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/string_number_conversions.h"
@@ -183,6 +187,31 @@ class StackMarker {
   DISALLOW_COPY_AND_ASSIGN(StackMarker);
 };
 
+// Returns the number of leading bytes of |str| that are in the basic ASCII
+// plane and neither a quote nor a backslash. These are the bulk of most
+// strings, and stand for themselves. Eight bytes are checked at a time.
+size_t CountPlainASCIIChars(const char* str, size_t length) {
+  const uint64 kQuotes = kLowBits * '"';
+  const uint64 kBackslashes = kLowBits * '\\';
+  size_t count = 0;
+  for (; count + sizeof(uint64) <= length; count += sizeof(uint64)) {
+    uint64 word;
+    memcpy(&word, str + count, sizeof(word));
+    if ((word & kHighBits) || HasZeroByte(word ^ kQuotes) ||
+        HasZeroByte(word ^ kBackslashes)) {
+      break;
+    }
+  }
+  for (; count < length; ++count) {
+    char c = str[count];
+    if (static_cast<uint8>(c) >= kExtendedASCIIStart || c == '"' ||
+        c == '\\') {
+      break;
+    }
+  }
+  return count;
+}
+
 }  // namespace
 
 JSONParser::JSONParser(int options)
@@ -196,7 +225,8 @@ JSONParser::JSONParser(int options)
       index_last_line_(0),
       error_code_(JSONReader::JSON_NO_ERROR),
       error_line_(0),
-      error_column_(0) {
+      error_column_(0),
+      document_(NULL) {
 }
 
 JSONParser::~JSONParser() {
@@ -213,39 +243,13 @@ Value* JSONParser::Parse(const StringPiece& input) {
   } else {
     start_pos_ = input.data();
   }
-  pos_ = start_pos_;
-  end_pos_ = start_pos_ + input.length();
-  index_ = 0;
-  line_number_ = 1;
-  index_last_line_ = 0;
-
-  error_code_ = JSONReader::JSON_NO_ERROR;
-  error_line_ = 0;
-  error_column_ = 0;
-
-  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
-  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // ParseNextToken function mis-treating a Unicode BOM as an invalid
-  // character and returning NULL.
-  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
-      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
-      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
-    NextNChars(3);
-  }
+  StartParsing(input.length());
 
   // Parse the first and any nested tokens.
   scoped_ptr<Value> root(ParseNextToken());
-  if (!root.get())
+  if (!root.get() || !ConsumeEndOfInput())
     return NULL;
 
-  // Make sure the input stream is at an end.
-  if (GetNextToken() != T_END_OF_INPUT) {
-    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
-      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
-      return NULL;
-    }
-  }
-
   // Dictionaries and lists can contain JSONStringValues, so wrap them in a
   // hidden root.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
@@ -265,6 +269,21 @@ Value* JSONParser::Parse(const StringPiece& input) {
   return root.release();
 }
 
+JSONDocument* JSONParser::ParseDocument(const StringPiece& input) {
+  scoped_ptr<JSONDocument> document(new JSONDocument(input));
+  start_pos_ = document->json().data();
+  StartParsing(input.length());
+
+  document_ = document.get();
+  bool parsed = ParseNextTokenIntoDocument() && ConsumeEndOfInput();
+  document_ = NULL;
+  if (!parsed)
+    return NULL;
+
+  document->Finish();
+  return document.release();
+}
+
 JSONReader::JsonParseError JSONParser::error_code() const {
   return error_code_;
 }
@@ -308,6 +327,13 @@ void JSONParser::StringBuilder::Append(const char& c) {
     ++length_;
 }
 
+void JSONParser::StringBuilder::AppendASCII(const char* str, size_t length) {
+  if (string_)
+    string_->append(str, length);
+  else
+    length_ += length;
+}
+
 void JSONParser::StringBuilder::AppendString(const std::string& str) {
   DCHECK(string_);
   string_->append(str);
@@ -337,6 +363,39 @@ const std::string& JSONParser::StringBuilder::AsString() {
 
 // JSONParser private //////////////////////////////////////////////////////////
 
+void JSONParser::StartParsing(size_t length) {
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + length;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+
+  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
+  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
+  // ParseNextToken function mis-treating a Unicode BOM as an invalid
+  // character and returning NULL.
+  if (CanConsume(3) && static_cast<uint8>(*pos_) == 0xEF &&
+      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+}
+
+bool JSONParser::ConsumeEndOfInput() {
+  // Make sure the input stream is at an end.
+  if (GetNextToken() != T_END_OF_INPUT) {
+    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
 inline bool JSONParser::CanConsume(int length) {
   return pos_ + length <= end_pos_;
 }
@@ -601,6 +660,158 @@ Value* JSONParser::ConsumeString() {
   }
 }
 
+bool JSONParser::ParseNextTokenIntoDocument() {
+  return ParseTokenIntoDocument(GetNextToken());
+}
+
+bool JSONParser::ParseTokenIntoDocument(Token token) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return ConsumeDictionaryIntoDocument();
+    case T_ARRAY_BEGIN:
+      return ConsumeListIntoDocument();
+    case T_STRING: {
+      StringBuilder string;
+      if (!ConsumeStringRaw(&string))
+        return false;
+      if (string.CanBeStringPiece())
+        document_->AddString(string.AsStringPiece());
+      else
+        document_->AddDecodedString(string.AsString());
+      return true;
+    }
+    case T_NUMBER: {
+      StringPiece num_string;
+      if (!ConsumeNumberRaw(&num_string))
+        return false;
+
+      int num_int;
+      if (StringToInt(num_string, &num_int)) {
+        document_->AddInteger(num_int);
+        return true;
+      }
+
+      double num_double;
+      if (StringToDouble(num_string.as_string(), &num_double) &&
+          std::isfinite(num_double)) {
+        document_->AddDouble(num_double);
+        return true;
+      }
+      return false;
+    }
+    case T_BOOL_TRUE:
+      if (!ConsumeLiteralRaw("true"))
+        return false;
+      document_->AddBoolean(true);
+      return true;
+    case T_BOOL_FALSE:
+      if (!ConsumeLiteralRaw("false"))
+        return false;
+      document_->AddBoolean(false);
+      return true;
+    case T_NULL:
+      if (!ConsumeLiteralRaw("null"))
+        return false;
+      document_->AddNull();
+      return true;
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::ConsumeDictionaryIntoDocument() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  size_t begin = document_->BeginContainer();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+
+    // First consume the key, which is added as a string just before its
+    // value.
+    if (!ParseTokenIntoDocument(token))
+      return false;
+
+    // Read the separator.
+    NextChar();
+    token = GetNextToken();
+    if (token != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    // The next token is the value.
+    NextChar();
+    if (!ParseNextTokenIntoDocument()) {
+      // ReportError from deeper level.
+      return false;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+
+  document_->EndDictionary(begin);
+  return true;
+}
+
+bool JSONParser::ConsumeListIntoDocument() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  size_t begin = document_->BeginContainer();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!ParseTokenIntoDocument(token)) {
+      // ReportError from deeper level.
+      return false;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+
+  document_->EndList(begin);
+  return true;
+}
+
 bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
   if (*pos_ != '"') {
     ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
@@ -616,6 +827,15 @@ bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
   int32 next_char = 0;
 
   while (CanConsume(1)) {
+    // Copy runs of plain characters in one go. The last byte of the input is
+    // left to the code below, which deals with strings that are not closed.
+    if (index_ + 1 < length) {
+      size_t plain_length = CountPlainASCIIChars(
+          start_pos_ + index_, static_cast<size_t>(length - 1 - index_));
+      string.AppendASCII(start_pos_ + index_, plain_length);
+      index_ += static_cast<int>(plain_length);
+    }
+
     pos_ = start_pos_ + index_;  // CBU8_NEXT is postcrement.
     CBU8_NEXT(start_pos_, index_, length, next_char);
     if (next_char < 0 || !IsValidCharacter(next_char)) {
@@ -813,6 +1033,24 @@ void JSONParser::DecodeUTF8(const int32& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return NULL;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return new FundamentalValue(num_int);
+
+  double num_double;
+  if (StringToDouble(num_string.as_string(), &num_double) &&
+      std::isfinite(num_double)) {
+    return new FundamentalValue(num_double);
+  }
+
+  return NULL;
+}
+
+bool JSONParser::ConsumeNumberRaw(StringPiece* out) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -822,7 +1060,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return NULL;
+    return false;
   }
   end_index = index_;
 
@@ -830,12 +1068,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -847,7 +1085,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -867,25 +1105,14 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
   }
 
   pos_ = exit_pos;
   index_ = exit_index;
 
-  StringPiece num_string(num_start, end_index - start_index);
-
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
-
-  double num_double;
-  if (StringToDouble(num_string.as_string(), &num_double) &&
-      std::isfinite(num_double)) {
-    return new FundamentalValue(num_double);
-  }
-
-  return NULL;
+  out->set(num_start, end_index - start_index);
+  return true;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -909,45 +1136,34 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 
 Value* JSONParser::ConsumeLiteral() {
   switch (*pos_) {
-    case 't': {
-      const char kTrueLiteral[] = "true";
-      const int kTrueLen = static_cast<int>(strlen(kTrueLiteral));
-      if (!CanConsume(kTrueLen - 1) ||
-          !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
-        ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+    case 't':
+      if (!ConsumeLiteralRaw("true"))
         return NULL;
-      }
-      NextNChars(kTrueLen - 1);
       return new FundamentalValue(true);
-    }
-    case 'f': {
-      const char kFalseLiteral[] = "false";
-      const int kFalseLen = static_cast<int>(strlen(kFalseLiteral));
-      if (!CanConsume(kFalseLen - 1) ||
-          !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
-        ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+    case 'f':
+      if (!ConsumeLiteralRaw("false"))
         return NULL;
-      }
-      NextNChars(kFalseLen - 1);
       return new FundamentalValue(false);
-    }
-    case 'n': {
-      const char kNullLiteral[] = "null";
-      const int kNullLen = static_cast<int>(strlen(kNullLiteral));
-      if (!CanConsume(kNullLen - 1) ||
-          !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
-        ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+    case 'n':
+      if (!ConsumeLiteralRaw("null"))
         return NULL;
-      }
-      NextNChars(kNullLen - 1);
       return Value::CreateNullValue().release();
-    }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
       return NULL;
   }
 }
 
+bool JSONParser::ConsumeLiteralRaw(const char* literal) {
+  const int length = static_cast<int>(strlen(literal));
+  if (!CanConsume(length - 1) || !StringsAreEqual(pos_, literal, length)) {
+    ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+    return false;
+  }
+  NextNChars(length - 1);
+  return true;
+}
+
 // static
 bool JSONParser::StringsAreEqual(const char* one, const char* two, size_t len) {
   return strncmp(one, two, len) == 0;
@@ -16,6 +16,7 @@
 
 namespace base {
 
+class JSONDocument;
 class Value;
 
 namespace internal {
@@ -49,6 +50,10 @@ class BASE_EXPORT JSONParser {
   // result as a Value owned by the caller.
   Value* Parse(const StringPiece& input);
 
+  // Parses the input string like Parse(), but returns the result as a
+  // JSONDocument owned by the caller.
+  JSONDocument* ParseDocument(const StringPiece& input);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
@@ -96,6 +101,11 @@ class BASE_EXPORT JSONParser {
     // AppendString below.
     void Append(const char& c);
 
+    // Like Append(), for the |length| characters at |str|, which must all be
+    // in the basic ASCII plane. Unless the builder has been converted, they
+    // must be the next characters of the input string.
+    void AppendASCII(const char* str, size_t length);
+
     // Appends a string to the std::string. Must be Convert()ed to use.
     void AppendString(const std::string& str);
 
@@ -126,6 +136,12 @@ class BASE_EXPORT JSONParser {
     std::string* string_;
   };
 
+  // Resets the parser to the beginning of the |length| bytes at |start_pos_|.
+  void StartParsing(size_t length);
+
+  // Checks that nothing but whitespace and comments is left after the root.
+  bool ConsumeEndOfInput();
+
   // Quick check that the stream has capacity to consume |length| more bytes.
   bool CanConsume(int length);
 
@@ -166,6 +182,14 @@ class BASE_EXPORT JSONParser {
   // Calls through ConsumeStringRaw and wraps it in a value.
   Value* ConsumeString();
 
+  // Like ParseNextToken(), ParseToken(), ConsumeDictionary() and
+  // ConsumeList(), but add the values to |document_| instead. Return false on
+  // error.
+  bool ParseNextTokenIntoDocument();
+  bool ParseTokenIntoDocument(Token token);
+  bool ConsumeDictionaryIntoDocument();
+  bool ConsumeListIntoDocument();
+
   // Assuming that the parser is wound to a double quote, this parses a string,
   // decoding any escape sequences and converts UTF-16 to UTF-8. Returns true on
   // success and Swap()s the result into |out|. Returns false on failure with
@@ -185,6 +209,9 @@ class BASE_EXPORT JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+  // Helper for ConsumeNumber() that validates the number and sets |out| to
+  // its characters.
+  bool ConsumeNumberRaw(StringPiece* out);
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -192,6 +219,9 @@ class BASE_EXPORT JSONParser {
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Helper for ConsumeLiteral() that consumes |literal|, which the input must
+  // match.
+  bool ConsumeLiteralRaw(const char* literal);
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
@@ -236,6 +266,9 @@ class BASE_EXPORT JSONParser {
   int error_line_;
   int error_column_;
 
+  // The document being built by ParseDocument(), NULL otherwise.
+  JSONDocument* document_;
+
   friend class JSONParserTest;
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, NextChar);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeDictionary);
@@ -4,6 +4,7 @@
 
 #include "base/json/json_reader.h"
 
+#include "base/json/json_document.h"
 #include "base/json/json_parser.h"
 #include "base/logging.h"
 #include "base/values.h"
@@ -72,6 +73,23 @@ scoped_ptr<Value> JSONReader::ReadAndReturnError(const StringPiece& json,
   return root;
 }
 
+// static
+scoped_ptr<JSONDocument> JSONReader::ReadDocument(const StringPiece& json,
+                                                  int options,
+                                                  int* error_code_out,
+                                                  std::string* error_msg_out) {
+  internal::JSONParser parser(options);
+  scoped_ptr<JSONDocument> document(parser.ParseDocument(json));
+  if (!document) {
+    if (error_code_out)
+      *error_code_out = parser.error_code();
+    if (error_msg_out)
+      *error_msg_out = parser.GetErrorMessage();
+  }
+
+  return document.Pass();
+}
+
 // static
 std::string JSONReader::ErrorCodeToString(JsonParseError error_code) {
   switch (error_code) {
@@ -4,8 +4,11 @@
 
 #include "base/json/string_escape.h"
 
+#include <string.h>
+
 #include <string>
 
+#include "base/json/string_scan_internal.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversion_utils.h"
@@ -14,6 +17,10 @@
 
 namespace base {
 
+using internal::HasZeroByte;
+using internal::kHighBits;
+using internal::kLowBits;
+
 namespace {
 
 // Format string for printing a \uXXXX escape sequence.
@@ -73,6 +80,45 @@ bool EscapeSpecialCodePoint(uint32 code_point, std::string* dest) {
   return true;
 }
 
+// Returns whether |c| is written out as is, without going through the code
+// point handling below.
+template <typename Char>
+inline bool IsUnescapedASCII(Char c) {
+  return c >= 0x20 && c < 0x80 && c != '"' && c != '\\' && c != '<';
+}
+
+// Returns the number of leading characters of |str| for which
+// IsUnescapedASCII() holds.
+template <typename Char>
+size_t CountUnescapedASCII(const Char* str, size_t length) {
+  size_t count = 0;
+  while (count < length && IsUnescapedASCII(str[count]))
+    ++count;
+  return count;
+}
+
+// Eight bytes are checked at a time. The bytes to stop at are the ones with
+// the high bit set, the ones below 0x20, and quotes, backslashes and '<'.
+template <>
+size_t CountUnescapedASCII(const char* str, size_t length) {
+  size_t count = 0;
+  for (; count + sizeof(uint64) <= length; count += sizeof(uint64)) {
+    uint64 word;
+    memcpy(&word, str + count, sizeof(word));
+    // The subtraction sets the high bit of the bytes below 0x20, as long as
+    // their own high bit is clear.
+    if ((word & kHighBits) || ((word - kLowBits * 0x20) & ~word & kHighBits) ||
+        HasZeroByte(word ^ (kLowBits * '"')) ||
+        HasZeroByte(word ^ (kLowBits * '\\')) ||
+        HasZeroByte(word ^ (kLowBits * '<'))) {
+      break;
+    }
+  }
+  while (count < length && IsUnescapedASCII(static_cast<uint8>(str[count])))
+    ++count;
+  return count;
+}
+
 template <typename S>
 bool EscapeJSONStringImpl(const S& str, bool put_in_quotes, std::string* dest) {
   bool did_replacement = false;
@@ -85,6 +131,16 @@ bool EscapeJSONStringImpl(const S& str, bool put_in_quotes, std::string* dest) {
   const int32 length = static_cast<int32>(str.length());
 
   for (int32 i = 0; i < length; ++i) {
+    // Most characters need no escaping; copy runs of them in one go.
+    size_t run_length =
+        CountUnescapedASCII(str.data() + i, static_cast<size_t>(length - i));
+    if (run_length) {
+      dest->append(str.data() + i, str.data() + i + run_length);
+      i += static_cast<int32>(run_length);
+      if (i == length)
+        break;
+    }
+
     uint32 code_point;
     if (!ReadUnicodeCharacter(str.data(), length, &i, &code_point)) {
       code_point = kReplacementCodePoint;
@@ -0,0 +1,29 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Helpers shared by the JSON parser and writer for scanning strings a word at
+// a time. Not to be used outside of base/json.
+
+#ifndef BASE_JSON_STRING_SCAN_INTERNAL_H_
+#define BASE_JSON_STRING_SCAN_INTERNAL_H_
+
+#include "base/basictypes.h"
+
+namespace base {
+namespace internal {
+
+// Every byte set to 0x01, and to 0x80, for checking the bytes of a word at
+// once.
+const uint64 kLowBits = 0x0101010101010101ULL;
+const uint64 kHighBits = 0x8080808080808080ULL;
+
+// Returns whether any byte of |word| is zero.
+inline bool HasZeroByte(uint64 word) {
+  return ((word - kLowBits) & ~word & kHighBits) != 0;
+}
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_JSON_STRING_SCAN_INTERNAL_H_
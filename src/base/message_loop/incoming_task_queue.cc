@@ -10,6 +10,7 @@
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram.h"
 #include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -39,13 +40,25 @@ bool AlwaysNotifyPump(MessageLoop::Type type) {
 
 }  // namespace
 
+struct IncomingTaskQueue::TaskNode : public IncomingTaskQueue::Node {
+  explicit TaskNode(const PendingTask& pending_task)
+      : pending_task(pending_task) {}
+
+  PendingTask pending_task;
+};
+
+IncomingTaskQueue::Node::Node() : next(0) {}
+
 IncomingTaskQueue::IncomingTaskQueue(MessageLoop* message_loop)
     : high_res_task_count_(0),
+      incoming_head_(reinterpret_cast<subtle::AtomicWord>(&stub_)),
+      incoming_tail_(reinterpret_cast<subtle::AtomicWord>(&stub_)),
       message_loop_(message_loop),
+      posting_state_(0),
       next_sequence_num_(0),
-      message_loop_scheduled_(false),
+      message_loop_scheduled_(1),
       always_schedule_work_(AlwaysNotifyPump(message_loop_->type())),
-      is_ready_for_scheduling_(false) {
+      is_ready_for_scheduling_(0) {
 }
 
 bool IncomingTaskQueue::AddToIncomingQueue(
@@ -58,7 +71,6 @@ bool IncomingTaskQueue::AddToIncomingQueue(
       << "Requesting super-long task delay period of " << delay.InSeconds()
       << " seconds from here: " << from_here.ToString();
 
-  AutoLock locked(incoming_queue_lock_);
   PendingTask pending_task(
       from_here, task, CalculateDelayedRuntime(delay), nestable);
 #if defined(OS_WIN)
@@ -68,7 +80,7 @@ bool IncomingTaskQueue::AddToIncomingQueue(
   // resolution on Windows is between 10 and 15ms.
   if (delay > TimeDelta() &&
       delay.InMilliseconds() < (2 * Time::kMinLowResolutionThresholdMs)) {
-    ++high_res_task_count_;
+    subtle::NoBarrier_AtomicIncrement(&high_res_task_count_, 1);
     pending_task.is_high_res = true;
   }
 #endif
@@ -76,52 +88,61 @@ bool IncomingTaskQueue::AddToIncomingQueue(
 }
 
 bool IncomingTaskQueue::HasHighResolutionTasks() {
-  AutoLock lock(incoming_queue_lock_);
-  return high_res_task_count_ > 0;
+  return subtle::Acquire_Load(&high_res_task_count_) > 0;
 }
 
 bool IncomingTaskQueue::IsIdleForTesting() {
-  AutoLock lock(incoming_queue_lock_);
-  return incoming_queue_.empty();
+  return IsIncomingQueueEmpty();
 }
 
 int IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  AutoLock lock(incoming_queue_lock_);
-  if (incoming_queue_.empty()) {
+  MoveIncomingTasks(work_queue);
+  if (work_queue->empty()) {
     // If the loop attempts to reload but there are no tasks in the incoming
     // queue, that means it will go to sleep waiting for more work. If the
     // incoming queue becomes nonempty we need to schedule it again.
-    message_loop_scheduled_ = false;
-  } else {
-    incoming_queue_.Swap(work_queue);
+    //
+    // A poster that still saw the flag set has linked its task before
+    // looking at it, so looking at the queue again after clearing the flag
+    // either finds that task, or the poster finds the flag cleared.
+    subtle::NoBarrier_Store(&message_loop_scheduled_, 0);
+    subtle::MemoryBarrier();
+    MoveIncomingTasks(work_queue);
   }
-  // Reset the count of high resolution tasks since our queue is now empty.
-  int high_res_tasks = high_res_task_count_;
-  high_res_task_count_ = 0;
-  return high_res_tasks;
+  // Reset the count of high resolution tasks, now that the tasks it counted
+  // have been moved over.
+  return subtle::NoBarrier_AtomicExchange(&high_res_task_count_, 0);
 }
 
 void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
-  AutoLock lock(incoming_queue_lock_);
+  DCHECK(message_loop_);
+  // Turn away new posts, and wait for the ones in progress to be done with
+  // |message_loop_|. They only hold on to it for a moment.
+  subtle::Barrier_AtomicIncrement(&posting_state_, 1);
+  while (subtle::Acquire_Load(&posting_state_) != 1)
+    PlatformThread::YieldCurrentThread();
   message_loop_ = NULL;
 }
 
 void IncomingTaskQueue::StartScheduling() {
-  AutoLock lock(incoming_queue_lock_);
-  DCHECK(!is_ready_for_scheduling_);
-  DCHECK(!message_loop_scheduled_);
-  is_ready_for_scheduling_ = true;
-  if (!incoming_queue_.empty())
-    ScheduleWork();
+  DCHECK(!subtle::NoBarrier_Load(&is_ready_for_scheduling_));
+  subtle::Release_Store(&is_ready_for_scheduling_, 1);
+  subtle::NoBarrier_Store(&message_loop_scheduled_, 0);
+  subtle::MemoryBarrier();
+  if (!IsIncomingQueueEmpty())
+    ScheduleWorkIfNeeded();
 }
 
 IncomingTaskQueue::~IncomingTaskQueue() {
   // Verify that WillDestroyCurrentMessageLoop() has been called.
   DCHECK(!message_loop_);
+
+  // Nothing posts anymore, so every task left can be taken out.
+  while (TaskNode* node = PopNode())
+    delete node;
 }
 
 TimeTicks IncomingTaskQueue::CalculateDelayedRuntime(TimeDelta delay) {
@@ -138,10 +159,7 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  // This should only be called while the lock is taken.
-  incoming_queue_lock_.AssertAcquired();
-
-  if (!message_loop_) {
+  if (!EnterPosting()) {
     pending_task->task.Reset();
     return false;
   }
@@ -149,33 +167,128 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   // Initialize the sequence number. The sequence number is used for delayed
   // tasks (to facilitate FIFO sorting when two tasks have the same
   // delayed_run_time value) and for identifying the task in about:tracing.
-  pending_task->sequence_num = next_sequence_num_++;
+  pending_task->sequence_num =
+      subtle::NoBarrier_AtomicIncrement(&next_sequence_num_, 1) - 1;
 
   message_loop_->task_annotator()->DidQueueTask("MessageLoop::PostTask",
                                                 *pending_task);
 
-  bool was_empty = incoming_queue_.empty();
-  incoming_queue_.push(*pending_task);
+  PushNode(new TaskNode(*pending_task));
   pending_task->task.Reset();
 
-  if (is_ready_for_scheduling_ &&
-      (always_schedule_work_ || (!message_loop_scheduled_ && was_empty))) {
-    ScheduleWork();
+  ScheduleWorkIfNeeded();
+  LeavePosting();
+  return true;
+}
+
+void IncomingTaskQueue::MoveIncomingTasks(TaskQueue* work_queue) {
+  // Stop at the node that is the head now, so that a steady stream of posts
+  // cannot keep the loop here. The head being the stub does not mean that the
+  // queue is empty: PopNode() queues the stub again behind the last node, and
+  // a poster may have swapped in its node just before, still to be linked
+  // ahead of the stub. PopNode() never returns the stub, so in that case this
+  // drains the queue until PopNode() returns NULL.
+  Node* last = reinterpret_cast<Node*>(subtle::Acquire_Load(&incoming_head_));
+  while (TaskNode* node = PopNode()) {
+    bool is_last = node == last;
+    work_queue->push(node->pending_task);
+    delete node;
+    if (is_last)
+      break;
+  }
+}
+
+void IncomingTaskQueue::PushNode(Node* node) {
+  // Once |node| is the head, later posters link their nodes behind it, but
+  // it stays unreachable from |incoming_tail_| until it is linked itself. The
+  // release store publishes |node|'s contents along with the link.
+  Node* previous = reinterpret_cast<Node*>(subtle::NoBarrier_AtomicExchange(
+      &incoming_head_, reinterpret_cast<subtle::AtomicWord>(node)));
+  subtle::Release_Store(&previous->next,
+                        reinterpret_cast<subtle::AtomicWord>(node));
+}
+
+IncomingTaskQueue::TaskNode* IncomingTaskQueue::PopNode() {
+  Node* tail = reinterpret_cast<Node*>(subtle::NoBarrier_Load(&incoming_tail_));
+  Node* next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (tail == &stub_) {
+    if (!next)
+      return NULL;
+    tail = next;
+    SetIncomingTail(tail);
+    next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  }
+  if (next) {
+    SetIncomingTail(next);
+    return static_cast<TaskNode*>(tail);
   }
 
+  // |tail| is the last node linked so far. Unless it is also the head, a
+  // poster has swapped in its node but not linked it yet, and |tail| can only
+  // be taken out once it has.
+  if (tail != reinterpret_cast<Node*>(subtle::Acquire_Load(&incoming_head_)))
+    return NULL;
+
+  // Queue the stub behind |tail|, so that |tail| can be taken out. If a
+  // poster swaps in its node first, the stub ends up behind that node
+  // instead, and |tail| can only be taken out once the poster links it. The
+  // stub is then the head while tasks are still queued ahead of it.
+  subtle::NoBarrier_Store(&stub_.next, 0);
+  PushNode(&stub_);
+  next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (next) {
+    SetIncomingTail(next);
+    return static_cast<TaskNode*>(tail);
+  }
+  return NULL;
+}
+
+void IncomingTaskQueue::SetIncomingTail(Node* node) {
+  subtle::NoBarrier_Store(&incoming_tail_,
+                          reinterpret_cast<subtle::AtomicWord>(node));
+}
+
+bool IncomingTaskQueue::IsIncomingQueueEmpty() const {
+  // The queue is empty only when the stub is the only node left to take out,
+  // and no poster has swapped in a node behind it. The head alone is not
+  // enough, as the stub may be the head with tasks still ahead of it.
+  return reinterpret_cast<Node*>(subtle::NoBarrier_Load(&incoming_tail_)) ==
+             &stub_ &&
+         !subtle::Acquire_Load(&stub_.next) &&
+         reinterpret_cast<Node*>(subtle::Acquire_Load(&incoming_head_)) ==
+             &stub_;
+}
+
+bool IncomingTaskQueue::EnterPosting() {
+  // The low bit is set by WillDestroyCurrentMessageLoop().
+  if (subtle::Barrier_AtomicIncrement(&posting_state_, 2) & 1) {
+    LeavePosting();
+    return false;
+  }
   return true;
 }
 
-void IncomingTaskQueue::ScheduleWork() {
-  DCHECK(is_ready_for_scheduling_);
-  // Wake up the message loop.
-  message_loop_->ScheduleWork();
+void IncomingTaskQueue::LeavePosting() {
+  subtle::Barrier_AtomicIncrement(&posting_state_, -2);
+}
+
+void IncomingTaskQueue::ScheduleWorkIfNeeded() {
+  // Pairs with the barriers in ReloadWorkQueue() and StartScheduling(): the
+  // task that was just linked is either seen by the loop, or this sees the
+  // flag cleared.
+  subtle::MemoryBarrier();
+  if (always_schedule_work_) {
+    if (subtle::Acquire_Load(&is_ready_for_scheduling_))
+      message_loop_->ScheduleWork();
+    return;
+  }
   // After we've scheduled the message loop, we do not need to do so again
   // until we know it has processed all of the work in our queue and is
   // waiting for more work again. The message loop will always attempt to
-  // reload from the incoming queue before waiting again so we clear this flag
-  // in ReloadWorkQueue().
-  message_loop_scheduled_ = true;
+  // reload from the incoming queue before waiting again so the flag is
+  // cleared in ReloadWorkQueue().
+  if (subtle::NoBarrier_CompareAndSwap(&message_loop_scheduled_, 0, 1) == 0)
+    message_loop_->ScheduleWork();
 }
 
 }  // namespace internal
@@ -5,10 +5,10 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/memory/ref_counted.h"
 #include "base/pending_task.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -21,6 +21,12 @@ namespace internal {
 // Implements a queue of tasks posted to the message loop running on the current
 // thread. This class takes care of synchronizing posting tasks from different
 // threads and together with MessageLoop ensures clean shutdown.
+//
+// Posting does not take a lock. Tasks are linked into an intrusive
+// multi-producer, single-consumer queue: a poster swaps its node into
+// |incoming_head_| and then links it behind the previous head, and the thread
+// running the loop is the only one that takes nodes out, from
+// |incoming_tail_|.
 class BASE_EXPORT IncomingTaskQueue
     : public RefCountedThreadSafe<IncomingTaskQueue> {
  public:
@@ -45,7 +51,7 @@ class BASE_EXPORT IncomingTaskQueue
   // Returns true if the message loop is "idle". Provided for testing.
   bool IsIdleForTesting();
 
-  // Loads tasks from the |incoming_queue_| into |*work_queue|. Must be called
+  // Loads tasks from the incoming queue into |*work_queue|. Must be called
   // from the thread that is running the loop. Returns the number of tasks that
   // require high resolution timers.
   int ReloadWorkQueue(TaskQueue* work_queue);
@@ -64,43 +70,88 @@ class BASE_EXPORT IncomingTaskQueue
   // Calculates the time at which a PendingTask should run.
   TimeTicks CalculateDelayedRuntime(TimeDelta delay);
 
-  // Adds a task to |incoming_queue_|. The caller retains ownership of
+  // Adds a task to the incoming queue. The caller retains ownership of
   // |pending_task|, but this function will reset the value of
   // |pending_task->task|. This is needed to ensure that the posting call stack
   // does not retain |pending_task->task| beyond this function call.
   bool PostPendingTask(PendingTask* pending_task);
 
-  // Wakes up the message loop and schedules work.
-  void ScheduleWork();
+  // A link in the incoming queue. |next| points to the node queued after
+  // this one, once its poster has linked it.
+  struct Node {
+    Node();
+
+    subtle::AtomicWord next;
+  };
+  struct TaskNode;
+
+  // Moves the tasks that are in the incoming queue when it is called into
+  // |work_queue|. Tasks posted meanwhile are generally left for the next call.
+  void MoveIncomingTasks(TaskQueue* work_queue);
+
+  // Appends |node| to the incoming queue. May be called on any thread.
+  void PushNode(Node* node);
+
+  // Takes the oldest task out of the incoming queue, or returns NULL if there
+  // is none that can be taken yet. Only called on the thread that runs the
+  // loop.
+  TaskNode* PopNode();
+
+  // Sets |incoming_tail_|. Only called on the thread that runs the loop.
+  void SetIncomingTail(Node* node);
+
+  // Returns true if no task is queued, or being queued, in the incoming
+  // queue. May be called on any thread.
+  bool IsIncomingQueueEmpty() const;
+
+  // Called around every use of |message_loop_| by a posting thread.
+  // EnterPosting() returns false, and the task must be dropped, once
+  // WillDestroyCurrentMessageLoop() has been called.
+  bool EnterPosting();
+  void LeavePosting();
+
+  // Wakes up the message loop, unless it has already been, or is not ready
+  // for scheduling yet.
+  void ScheduleWorkIfNeeded();
 
   // Number of tasks that require high resolution timing. This value is kept
   // so that ReloadWorkQueue() completes in constant time.
-  int high_res_task_count_;
+  subtle::Atomic32 high_res_task_count_;
 
-  // The lock that protects access to the members of this class.
-  base::Lock incoming_queue_lock_;
+  // The most recently queued node. Posting threads swap their node in here.
+  subtle::AtomicWord incoming_head_;
 
-  // An incoming queue of tasks that are acquired under a mutex for processing
-  // on this instance's thread. These tasks have not yet been been pushed to
-  // |message_loop_|.
-  TaskQueue incoming_queue_;
+  // The oldest node in the queue. Only changed by the thread running the
+  // loop. Other threads only compare it with |stub_|, in
+  // IsIncomingQueueEmpty().
+  subtle::AtomicWord incoming_tail_;
 
-  // Points to the message loop that owns |this|.
+  // Sits in the queue whenever it would otherwise be empty, so that
+  // |incoming_head_| and |incoming_tail_| never need to be NULL.
+  Node stub_;
+
+  // Points to the message loop that owns |this|. Posting threads only use it
+  // between EnterPosting() and LeavePosting().
   MessageLoop* message_loop_;
 
+  // Twice the number of threads using |message_loop_|, plus one once
+  // WillDestroyCurrentMessageLoop() has been called.
+  subtle::Atomic32 posting_state_;
+
   // The next sequence number to use for delayed tasks.
-  int next_sequence_num_;
+  subtle::Atomic32 next_sequence_num_;
 
-  // True if our message loop has already been scheduled and does not need to be
-  // scheduled again until an empty reload occurs.
-  bool message_loop_scheduled_;
+  // Non-zero if our message loop has already been scheduled and does not need
+  // to be scheduled again until an empty reload occurs. Also set until
+  // StartScheduling() is called, so that no thread schedules the loop before.
+  subtle::Atomic32 message_loop_scheduled_;
 
   // True if we always need to call ScheduleWork when receiving a new task, even
   // if the incoming queue was not empty.
   const bool always_schedule_work_;
 
-  // False until StartScheduling() is called.
-  bool is_ready_for_scheduling_;
+  // Zero until StartScheduling() is called.
+  subtle::Atomic32 is_ready_for_scheduling_;
 
   DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
 };
@@ -540,7 +540,7 @@ bool MessageLoop::DeletePendingTasks() {
 void MessageLoop::ReloadWorkQueue() {
   // We can improve performance of our loading tasks from the incoming queue to
   // |*work_queue| by waiting until the last minute (|*work_queue| is empty) to
-  // load. That reduces the number of locks-per-task significantly when our
+  // load. That reduces the synchronization per task significantly when our
   // queues get large.
   if (work_queue_.empty()) {
 #if defined(OS_WIN)
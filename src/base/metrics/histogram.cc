@@ -16,14 +16,18 @@
 
 #include "base/compiler_specific.h"
 #include "base/debug/alias.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/histogram_macros.h"
+#include "base/metrics/histogram_persistence.h"
 #include "base/metrics/sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/values.h"
 
 namespace base {
@@ -63,6 +67,9 @@ bool ReadHistogramArguments(PickleIterator* iter,
   DCHECK(*flags & HistogramBase::kIPCSerializationSourceFlag);
   *flags &= ~HistogramBase::kIPCSerializationSourceFlag;
 
+  // Whether the local version is persistent is up to this process.
+  *flags &= ~HistogramBase::kIsPersistent;
+
   return true;
 }
 
@@ -79,6 +86,135 @@ bool ValidateRangeChecksum(const HistogramBase& histogram,
 typedef HistogramBase::Count Count;
 typedef HistogramBase::Sample Sample;
 
+// The samples that threads record in a histogram with
+// kThreadLocalAccumulationFlag. Every thread gets a SampleVector of its own,
+// so that recording a sample writes to no memory that other threads write
+// to. They are only added up when the histogram is snapshotted.
+//
+// The shards belong to the histogram. A thread that exits hands its shards
+// back, and the next new thread reuses them, samples included.
+class HistogramShards {
+ public:
+  explicit HistogramShards(const BucketRanges* ranges);
+  ~HistogramShards();
+
+  // Returns the samples of the current thread.
+  SampleVector* GetForCurrentThread();
+
+  // Adds the samples of all threads to |samples|.
+  void AddTo(SampleVector* samples);
+
+ private:
+  struct Shard {
+    Shard(HistogramShards* owner, const BucketRanges* ranges)
+        : owner(owner), samples(ranges) {}
+
+    HistogramShards* const owner;
+    SampleVector samples;
+  };
+
+  // The shards of a thread, indexed by |index_|.
+  typedef std::vector<Shard*> ThreadShards;
+
+  // Holds the ThreadShards of every thread.
+  struct ThreadShardsSlot {
+    ThreadShardsSlot() : slot(&OnThreadExit) {}
+
+    ThreadLocalStorage::Slot slot;
+  };
+
+  static void OnThreadExit(void* thread_shards);
+
+  // Gives the current thread a shard.
+  SampleVector* AcquireShard(ThreadShards* thread_shards);
+
+  void ReleaseShard(Shard* shard);
+
+  static LazyInstance<ThreadShardsSlot>::Leaky thread_shards_slot_;
+  static subtle::Atomic32 next_index_;
+
+  const BucketRanges* const ranges_;
+
+  // The index of the shards of this histogram in ThreadShards.
+  const size_t index_;
+
+  Lock lock_;
+
+  // All the shards, and those of them that no thread has.
+  ScopedVector<Shard> shards_;
+  std::vector<Shard*> free_shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramShards);
+};
+
+// static
+LazyInstance<HistogramShards::ThreadShardsSlot>::Leaky
+    HistogramShards::thread_shards_slot_ = LAZY_INSTANCE_INITIALIZER;
+
+// static
+subtle::Atomic32 HistogramShards::next_index_ = 0;
+
+HistogramShards::HistogramShards(const BucketRanges* ranges)
+    : ranges_(ranges),
+      index_(subtle::NoBarrier_AtomicIncrement(&next_index_, 1) - 1) {}
+
+HistogramShards::~HistogramShards() {}
+
+SampleVector* HistogramShards::GetForCurrentThread() {
+  ThreadShards* thread_shards =
+      static_cast<ThreadShards*>(thread_shards_slot_.Get().slot.Get());
+  if (thread_shards && index_ < thread_shards->size()) {
+    Shard* shard = (*thread_shards)[index_];
+    if (shard)
+      return &shard->samples;
+  }
+  return AcquireShard(thread_shards);
+}
+
+void HistogramShards::AddTo(SampleVector* samples) {
+  AutoLock lock(lock_);
+  for (const Shard* shard : shards_)
+    samples->Add(shard->samples);
+}
+
+// static
+void HistogramShards::OnThreadExit(void* thread_shards) {
+  ThreadShards* shards = static_cast<ThreadShards*>(thread_shards);
+  for (Shard* shard : *shards) {
+    if (shard)
+      shard->owner->ReleaseShard(shard);
+  }
+  delete shards;
+}
+
+SampleVector* HistogramShards::AcquireShard(ThreadShards* thread_shards) {
+  if (!thread_shards) {
+    thread_shards = new ThreadShards;
+    thread_shards_slot_.Get().slot.Set(thread_shards);
+  }
+  if (thread_shards->size() <= index_)
+    thread_shards->resize(index_ + 1);
+
+  Shard* shard;
+  {
+    AutoLock lock(lock_);
+    if (free_shards_.empty()) {
+      shard = new Shard(this, ranges_);
+      shards_.push_back(shard);
+    } else {
+      shard = free_shards_.back();
+      free_shards_.pop_back();
+    }
+  }
+  (*thread_shards)[index_] = shard;
+  return &shard->samples;
+}
+
+void HistogramShards::ReleaseShard(Shard* shard) {
+  AutoLock lock(lock_);
+  free_shards_.push_back(shard);
+}
+
 // static
 const size_t Histogram::kBucketCount_MAX = 16384u;
 
@@ -99,12 +235,23 @@ HistogramBase* Histogram::FactoryGet(const std::string& name,
     const BucketRanges* registered_ranges =
         StatisticsRecorder::RegisterOrDeleteDuplicateRanges(ranges);
 
-    Histogram* tentative_histogram =
-        new Histogram(name, minimum, maximum, registered_ranges);
+    // Use persistent memory if there is some left, the heap otherwise.
+    PersistentMemoryAllocator* allocator =
+        GetPersistentHistogramMemoryAllocator();
+    PersistentMemoryAllocator::Reference histogram_ref = 0;
+    HistogramBase* tentative_histogram = AllocatePersistentHistogram(
+        allocator, HISTOGRAM, name, minimum, maximum, registered_ranges, flags,
+        &histogram_ref);
+    if (!tentative_histogram) {
+      tentative_histogram =
+          new Histogram(name, minimum, maximum, registered_ranges);
+      tentative_histogram->SetFlags(flags);
+    }
 
-    tentative_histogram->SetFlags(flags);
     histogram =
         StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    FinalizePersistentHistogram(allocator, histogram_ref,
+                                histogram == tentative_histogram);
   }
 
   DCHECK_EQ(HISTOGRAM, histogram->GetHistogramType());
@@ -148,6 +295,18 @@ HistogramBase* Histogram::FactoryTimeGet(const char* name,
                         flags);
 }
 
+// static
+HistogramBase* Histogram::PersistentCreate(const std::string& name,
+                                           Sample minimum,
+                                           Sample maximum,
+                                           const BucketRanges* ranges,
+                                           HistogramBase::AtomicCount* counts,
+                                           size_t counts_size,
+                                           HistogramSamples::Metadata* meta) {
+  return new Histogram(name, minimum, maximum, ranges, counts, counts_size,
+                       meta);
+}
+
 // Calculate what range of values are held in each bucket.
 // We have to be careful that we don't pick a ratio between starting points in
 // consecutive buckets that is sooo small, that the integer bounds are the same
@@ -287,7 +446,10 @@ void Histogram::AddCount(int value, int count) {
     NOTREACHED();
     return;
   }
-  samples_->Accumulate(value, count);
+  if (flags() & kThreadLocalAccumulationFlag)
+    GetThreadSamples()->Accumulate(value, count);
+  else
+    samples_->Accumulate(value, count);
 
   FindAndRunCallback(value);
 }
@@ -333,12 +495,29 @@ Histogram::Histogram(const std::string& name,
   : HistogramBase(name),
     bucket_ranges_(ranges),
     declared_min_(minimum),
-    declared_max_(maximum) {
+    declared_max_(maximum),
+    shards_(0) {
   if (ranges)
     samples_.reset(new SampleVector(ranges));
 }
 
+Histogram::Histogram(const std::string& name,
+                     Sample minimum,
+                     Sample maximum,
+                     const BucketRanges* ranges,
+                     HistogramBase::AtomicCount* counts,
+                     size_t counts_size,
+                     HistogramSamples::Metadata* meta)
+    : HistogramBase(name),
+      bucket_ranges_(ranges),
+      declared_min_(minimum),
+      declared_max_(maximum),
+      shards_(0) {
+  samples_.reset(new SampleVector(counts, counts_size, meta, ranges));
+}
+
 Histogram::~Histogram() {
+  delete reinterpret_cast<HistogramShards*>(subtle::NoBarrier_Load(&shards_));
 }
 
 bool Histogram::PrintEmptyBucket(size_t index) const {
@@ -394,9 +573,29 @@ HistogramBase* Histogram::DeserializeInfoImpl(PickleIterator* iter) {
 scoped_ptr<SampleVector> Histogram::SnapshotSampleVector() const {
   scoped_ptr<SampleVector> samples(new SampleVector(bucket_ranges()));
   samples->Add(*samples_);
+  HistogramShards* shards =
+      reinterpret_cast<HistogramShards*>(subtle::Acquire_Load(&shards_));
+  if (shards)
+    shards->AddTo(samples.get());
   return samples.Pass();
 }
 
+SampleVector* Histogram::GetThreadSamples() {
+  HistogramShards* shards =
+      reinterpret_cast<HistogramShards*>(subtle::Acquire_Load(&shards_));
+  if (!shards) {
+    // Several threads may get here at once. Only one set of shards wins.
+    scoped_ptr<HistogramShards> new_shards(new HistogramShards(bucket_ranges_));
+    subtle::AtomicWord old_shards = subtle::Release_CompareAndSwap(
+        &shards_, 0, reinterpret_cast<subtle::AtomicWord>(new_shards.get()));
+    if (old_shards)
+      shards = reinterpret_cast<HistogramShards*>(old_shards);
+    else
+      shards = new_shards.release();
+  }
+  return shards->GetForCurrentThread();
+}
+
 void Histogram::WriteAsciiImpl(bool graph_it,
                                const std::string& newline,
                                std::string* output) const {
@@ -595,8 +794,18 @@ HistogramBase* LinearHistogram::FactoryGetWithRangeDescription(
     const BucketRanges* registered_ranges =
         StatisticsRecorder::RegisterOrDeleteDuplicateRanges(ranges);
 
+    PersistentMemoryAllocator* allocator =
+        GetPersistentHistogramMemoryAllocator();
+    PersistentMemoryAllocator::Reference histogram_ref = 0;
     LinearHistogram* tentative_histogram =
-        new LinearHistogram(name, minimum, maximum, registered_ranges);
+        static_cast<LinearHistogram*>(AllocatePersistentHistogram(
+            allocator, LINEAR_HISTOGRAM, name, minimum, maximum,
+            registered_ranges, flags, &histogram_ref));
+    if (!tentative_histogram) {
+      tentative_histogram =
+          new LinearHistogram(name, minimum, maximum, registered_ranges);
+      tentative_histogram->SetFlags(flags);
+    }
 
     // Set range descriptions.
     if (descriptions) {
@@ -606,9 +815,10 @@ HistogramBase* LinearHistogram::FactoryGetWithRangeDescription(
       }
     }
 
-    tentative_histogram->SetFlags(flags);
     histogram =
         StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    FinalizePersistentHistogram(allocator, histogram_ref,
+                                histogram == tentative_histogram);
   }
 
   DCHECK_EQ(LINEAR_HISTOGRAM, histogram->GetHistogramType());
@@ -625,6 +835,19 @@ HistogramBase* LinearHistogram::FactoryGetWithRangeDescription(
   return histogram;
 }
 
+// static
+HistogramBase* LinearHistogram::PersistentCreate(
+    const std::string& name,
+    Sample minimum,
+    Sample maximum,
+    const BucketRanges* ranges,
+    HistogramBase::AtomicCount* counts,
+    size_t counts_size,
+    HistogramSamples::Metadata* meta) {
+  return new LinearHistogram(name, minimum, maximum, ranges, counts,
+                             counts_size, meta);
+}
+
 HistogramType LinearHistogram::GetHistogramType() const {
   return LINEAR_HISTOGRAM;
 }
@@ -636,6 +859,15 @@ LinearHistogram::LinearHistogram(const std::string& name,
     : Histogram(name, minimum, maximum, ranges) {
 }
 
+LinearHistogram::LinearHistogram(const std::string& name,
+                                 Sample minimum,
+                                 Sample maximum,
+                                 const BucketRanges* ranges,
+                                 HistogramBase::AtomicCount* counts,
+                                 size_t counts_size,
+                                 HistogramSamples::Metadata* meta)
+    : Histogram(name, minimum, maximum, ranges, counts, counts_size, meta) {}
+
 double LinearHistogram::GetBucketSize(Count current, size_t i) const {
   DCHECK_GT(ranges(i + 1), ranges(i));
   // Adjacent buckets with different widths would have "surprisingly" many (few)
@@ -709,12 +941,21 @@ HistogramBase* BooleanHistogram::FactoryGet(const std::string& name,
     const BucketRanges* registered_ranges =
         StatisticsRecorder::RegisterOrDeleteDuplicateRanges(ranges);
 
-    BooleanHistogram* tentative_histogram =
-        new BooleanHistogram(name, registered_ranges);
+    PersistentMemoryAllocator* allocator =
+        GetPersistentHistogramMemoryAllocator();
+    PersistentMemoryAllocator::Reference histogram_ref = 0;
+    HistogramBase* tentative_histogram = AllocatePersistentHistogram(
+        allocator, BOOLEAN_HISTOGRAM, name, 1, 2, registered_ranges, flags,
+        &histogram_ref);
+    if (!tentative_histogram) {
+      tentative_histogram = new BooleanHistogram(name, registered_ranges);
+      tentative_histogram->SetFlags(flags);
+    }
 
-    tentative_histogram->SetFlags(flags);
     histogram =
         StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    FinalizePersistentHistogram(allocator, histogram_ref,
+                                histogram == tentative_histogram);
   }
 
   DCHECK_EQ(BOOLEAN_HISTOGRAM, histogram->GetHistogramType());
@@ -725,6 +966,16 @@ HistogramBase* BooleanHistogram::FactoryGet(const char* name, int32 flags) {
   return FactoryGet(std::string(name), flags);
 }
 
+// static
+HistogramBase* BooleanHistogram::PersistentCreate(
+    const std::string& name,
+    const BucketRanges* ranges,
+    HistogramBase::AtomicCount* counts,
+    size_t counts_size,
+    HistogramSamples::Metadata* meta) {
+  return new BooleanHistogram(name, ranges, counts, counts_size, meta);
+}
+
 HistogramType BooleanHistogram::GetHistogramType() const {
   return BOOLEAN_HISTOGRAM;
 }
@@ -733,6 +984,13 @@ BooleanHistogram::BooleanHistogram(const std::string& name,
                                    const BucketRanges* ranges)
     : LinearHistogram(name, 1, 2, ranges) {}
 
+BooleanHistogram::BooleanHistogram(const std::string& name,
+                                   const BucketRanges* ranges,
+                                   HistogramBase::AtomicCount* counts,
+                                   size_t counts_size,
+                                   HistogramSamples::Metadata* meta)
+    : LinearHistogram(name, 1, 2, ranges, counts, counts_size, meta) {}
+
 HistogramBase* BooleanHistogram::DeserializeInfoImpl(PickleIterator* iter) {
   std::string histogram_name;
   int flags;
@@ -772,13 +1030,22 @@ HistogramBase* CustomHistogram::FactoryGet(
         StatisticsRecorder::RegisterOrDeleteDuplicateRanges(ranges);
 
     // To avoid racy destruction at shutdown, the following will be leaked.
-    CustomHistogram* tentative_histogram =
-        new CustomHistogram(name, registered_ranges);
-
-    tentative_histogram->SetFlags(flags);
+    PersistentMemoryAllocator* allocator =
+        GetPersistentHistogramMemoryAllocator();
+    PersistentMemoryAllocator::Reference histogram_ref = 0;
+    HistogramBase* tentative_histogram = AllocatePersistentHistogram(
+        allocator, CUSTOM_HISTOGRAM, name, registered_ranges->range(1),
+        registered_ranges->range(registered_ranges->bucket_count() - 1),
+        registered_ranges, flags, &histogram_ref);
+    if (!tentative_histogram) {
+      tentative_histogram = new CustomHistogram(name, registered_ranges);
+      tentative_histogram->SetFlags(flags);
+    }
 
     histogram =
         StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    FinalizePersistentHistogram(allocator, histogram_ref,
+                                histogram == tentative_histogram);
   }
 
   DCHECK_EQ(histogram->GetHistogramType(), CUSTOM_HISTOGRAM);
@@ -792,6 +1059,16 @@ HistogramBase* CustomHistogram::FactoryGet(
   return FactoryGet(std::string(name), custom_ranges, flags);
 }
 
+// static
+HistogramBase* CustomHistogram::PersistentCreate(
+    const std::string& name,
+    const BucketRanges* ranges,
+    HistogramBase::AtomicCount* counts,
+    size_t counts_size,
+    HistogramSamples::Metadata* meta) {
+  return new CustomHistogram(name, ranges, counts, counts_size, meta);
+}
+
 HistogramType CustomHistogram::GetHistogramType() const {
   return CUSTOM_HISTOGRAM;
 }
@@ -818,6 +1095,19 @@ CustomHistogram::CustomHistogram(const std::string& name,
                 ranges->range(ranges->bucket_count() - 1),
                 ranges) {}
 
+CustomHistogram::CustomHistogram(const std::string& name,
+                                 const BucketRanges* ranges,
+                                 HistogramBase::AtomicCount* counts,
+                                 size_t counts_size,
+                                 HistogramSamples::Metadata* meta)
+    : Histogram(name,
+                ranges->range(1),
+                ranges->range(ranges->bucket_count() - 1),
+                ranges,
+                counts,
+                counts_size,
+                meta) {}
+
 bool CustomHistogram::SerializeInfoImpl(Pickle* pickle) const {
   if (!Histogram::SerializeInfoImpl(pickle))
     return false;
@@ -88,6 +88,7 @@ namespace base {
 class BooleanHistogram;
 class CustomHistogram;
 class Histogram;
+class HistogramShards;
 class LinearHistogram;
 class Pickle;
 class PickleIterator;
@@ -139,6 +140,17 @@ class BASE_EXPORT Histogram : public HistogramBase {
                                      Sample maximum,
                                      BucketRanges* ranges);
 
+  // Creates a histogram that keeps its |counts_size| counts at |counts| and
+  // the rest of its samples in |meta|, for histograms in persistent memory.
+  // The histogram is not registered. See histogram_persistence.h.
+  static HistogramBase* PersistentCreate(const std::string& name,
+                                         Sample minimum,
+                                         Sample maximum,
+                                         const BucketRanges* ranges,
+                                         HistogramBase::AtomicCount* counts,
+                                         size_t counts_size,
+                                         HistogramSamples::Metadata* meta);
+
   // This constant if for FindCorruption. Since snapshots of histograms are
   // taken asynchronously relative to sampling, and our counting code currently
   // does not prevent race conditions, it is pretty likely that we'll catch a
@@ -196,6 +208,15 @@ class BASE_EXPORT Histogram : public HistogramBase {
             Sample maximum,
             const BucketRanges* ranges);
 
+  // Keeps the samples in |counts| and |meta|. See PersistentCreate().
+  Histogram(const std::string& name,
+            Sample minimum,
+            Sample maximum,
+            const BucketRanges* ranges,
+            HistogramBase::AtomicCount* counts,
+            size_t counts_size,
+            HistogramSamples::Metadata* meta);
+
   ~Histogram() override;
 
   // HistogramBase implementation:
@@ -231,6 +252,10 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // Implementation of SnapshotSamples function.
   scoped_ptr<SampleVector> SnapshotSampleVector() const;
 
+  // Returns the samples of the current thread, for histograms with
+  // kThreadLocalAccumulationFlag.
+  SampleVector* GetThreadSamples();
+
   //----------------------------------------------------------------------------
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
 
@@ -269,6 +294,12 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // sample.
   scoped_ptr<SampleVector> samples_;
 
+  // The per-thread samples, a HistogramShards* created the first time a
+  // sample is recorded with kThreadLocalAccumulationFlag. Owned. Threads
+  // refer to it until they exit, so a histogram that has some must outlive
+  // the threads that recorded in it, as leaked histograms do.
+  subtle::AtomicWord shards_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -329,6 +360,15 @@ class BASE_EXPORT LinearHistogram : public Histogram {
                                      Sample maximum,
                                      BucketRanges* ranges);
 
+  // As in Histogram.
+  static HistogramBase* PersistentCreate(const std::string& name,
+                                         Sample minimum,
+                                         Sample maximum,
+                                         const BucketRanges* ranges,
+                                         HistogramBase::AtomicCount* counts,
+                                         size_t counts_size,
+                                         HistogramSamples::Metadata* meta);
+
   // Overridden from Histogram:
   HistogramType GetHistogramType() const override;
 
@@ -338,6 +378,14 @@ class BASE_EXPORT LinearHistogram : public Histogram {
                   Sample maximum,
                   const BucketRanges* ranges);
 
+  LinearHistogram(const std::string& name,
+                  Sample minimum,
+                  Sample maximum,
+                  const BucketRanges* ranges,
+                  HistogramBase::AtomicCount* counts,
+                  size_t counts_size,
+                  HistogramSamples::Metadata* meta);
+
   double GetBucketSize(Count current, size_t i) const override;
 
   // If we have a description for a bucket, then return that.  Otherwise
@@ -374,10 +422,22 @@ class BASE_EXPORT BooleanHistogram : public LinearHistogram {
   // call sites.
   static HistogramBase* FactoryGet(const char* name, int32 flags);
 
+  // As in Histogram.
+  static HistogramBase* PersistentCreate(const std::string& name,
+                                         const BucketRanges* ranges,
+                                         HistogramBase::AtomicCount* counts,
+                                         size_t counts_size,
+                                         HistogramSamples::Metadata* meta);
+
   HistogramType GetHistogramType() const override;
 
  private:
   BooleanHistogram(const std::string& name, const BucketRanges* ranges);
+  BooleanHistogram(const std::string& name,
+                   const BucketRanges* ranges,
+                   HistogramBase::AtomicCount* counts,
+                   size_t counts_size,
+                   HistogramSamples::Metadata* meta);
 
   friend BASE_EXPORT HistogramBase* DeserializeHistogramInfo(
       base::PickleIterator* iter);
@@ -406,6 +466,13 @@ class BASE_EXPORT CustomHistogram : public Histogram {
                                    const std::vector<Sample>& custom_ranges,
                                    int32 flags);
 
+  // As in Histogram.
+  static HistogramBase* PersistentCreate(const std::string& name,
+                                         const BucketRanges* ranges,
+                                         HistogramBase::AtomicCount* counts,
+                                         size_t counts_size,
+                                         HistogramSamples::Metadata* meta);
+
   // Overridden from Histogram:
   HistogramType GetHistogramType() const override;
 
@@ -421,6 +488,12 @@ class BASE_EXPORT CustomHistogram : public Histogram {
   CustomHistogram(const std::string& name,
                   const BucketRanges* ranges);
 
+  CustomHistogram(const std::string& name,
+                  const BucketRanges* ranges,
+                  HistogramBase::AtomicCount* counts,
+                  size_t counts_size,
+                  HistogramSamples::Metadata* meta);
+
   // HistogramBase implementation:
   bool SerializeInfoImpl(base::Pickle* pickle) const override;
 
@@ -79,6 +79,18 @@ class BASE_EXPORT HistogramBase {
     // to shortcut looking up the callback if it doesn't exist.
     kCallbackExists = 0x20,
 
+    // Indicates that the samples of the histogram are kept in persistent
+    // memory, where another process may read them. See
+    // histogram_persistence.h.
+    kIsPersistent = 0x40,
+
+    // Only for Histogram and its sub classes: every thread records into
+    // samples of its own, which are only added up when the histogram is
+    // snapshotted. For histograms recorded at a high rate from many threads.
+    // The per-thread samples are kept on the heap, where other processes
+    // can't see them, so such histograms are never persistent.
+    kThreadLocalAccumulationFlag = 0x80,
+
     // Only for Histogram and its sub classes: fancy bucket-naming support.
     kHexRangePrintingFlag = 0x8000,
   };
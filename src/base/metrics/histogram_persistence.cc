@@ -0,0 +1,256 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/histogram_persistence.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/statistics_recorder.h"
+
+namespace base {
+
+namespace {
+
+// Type ids of the blocks of a histogram. The low digit is bumped whenever
+// the layout of a block changes.
+const uint32 kTypeIdHistogram = 0xF1645910 + 2;
+const uint32 kTypeIdRangesArray = 0xBCEA225A + 1;
+const uint32 kTypeIdCountsArray = 0x53215530 + 1;
+
+// What a histogram needs to be recreated by another process. Only types of
+// a fixed size are used, so that 32 and 64-bit processes agree on the
+// layout.
+struct PersistentHistogramData {
+  int32 histogram_type;
+  int32 flags;
+  int32 minimum;
+  int32 maximum;
+  uint32 bucket_count;
+  PersistentMemoryAllocator::Reference ranges_ref;
+  uint32 ranges_checksum;
+  PersistentMemoryAllocator::Reference counts_ref;
+  HistogramSamples::Metadata samples_metadata;
+
+  // Space for the full name is allocated along with the structure.
+  char name[1];
+};
+
+// The structure may still end in padding of a different size, but blocks
+// are a multiple of 8 bytes long, which covers it.
+COMPILE_ASSERT(sizeof(HistogramSamples::Metadata) == 16,
+               histogram_metadata_size_differs_between_platforms);
+COMPILE_ASSERT(offsetof(PersistentHistogramData, name) == 48,
+               persistent_histogram_name_offset_differs_between_platforms);
+
+PersistentMemoryAllocator* g_allocator = NULL;
+
+// Creates a histogram of |histogram_type| over |counts| and |meta|, which
+// are in persistent memory.
+HistogramBase* CreateHistogram(HistogramType histogram_type,
+                               const std::string& name,
+                               int minimum,
+                               int maximum,
+                               const BucketRanges* ranges,
+                               HistogramBase::AtomicCount* counts,
+                               HistogramSamples::Metadata* meta) {
+  size_t counts_size = ranges->bucket_count();
+  switch (histogram_type) {
+    case HISTOGRAM:
+      return Histogram::PersistentCreate(name, minimum, maximum, ranges,
+                                         counts, counts_size, meta);
+    case LINEAR_HISTOGRAM:
+      return LinearHistogram::PersistentCreate(name, minimum, maximum, ranges,
+                                               counts, counts_size, meta);
+    case BOOLEAN_HISTOGRAM:
+      return BooleanHistogram::PersistentCreate(name, ranges, counts,
+                                                counts_size, meta);
+    case CUSTOM_HISTOGRAM:
+      return CustomHistogram::PersistentCreate(name, ranges, counts,
+                                               counts_size, meta);
+    default:
+      return NULL;
+  }
+}
+
+// Gives up on the histogram at |ref|, which is corrupt.
+scoped_ptr<HistogramBase> RejectHistogram(
+    PersistentMemoryAllocator::Reference ref) {
+  DLOG(ERROR) << "Corrupt persistent histogram at " << ref;
+  return scoped_ptr<HistogramBase>();
+}
+
+// Creates the histogram at |ref|. Since the memory may have been written by
+// another process, which can also change it at any time, every field is read
+// once into a local that is then checked.
+scoped_ptr<HistogramBase> CreatePersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    PersistentMemoryAllocator::Reference ref) {
+  PersistentHistogramData* histogram_data =
+      allocator->GetAsObject<PersistentHistogramData>(ref, kTypeIdHistogram);
+  if (!histogram_data)
+    return scoped_ptr<HistogramBase>();
+
+  // The name must end within the block. Its length is taken from this one
+  // scan, since the terminator may be gone by the time it is scanned again.
+  size_t name_size =
+      allocator->GetAllocSize(ref) - offsetof(PersistentHistogramData, name);
+  const char* name_end = static_cast<const char*>(
+      memchr(histogram_data->name, '\0', name_size));
+  if (!name_end)
+    return RejectHistogram(ref);
+  const std::string name(histogram_data->name, name_end - histogram_data->name);
+
+  const int32 histogram_type = histogram_data->histogram_type;
+  const int32 flags = histogram_data->flags;
+  const int32 minimum = histogram_data->minimum;
+  const int32 maximum = histogram_data->maximum;
+  const uint32 bucket_count = histogram_data->bucket_count;
+  const PersistentMemoryAllocator::Reference ranges_ref =
+      histogram_data->ranges_ref;
+  const uint32 ranges_checksum = histogram_data->ranges_checksum;
+  const PersistentMemoryAllocator::Reference counts_ref =
+      histogram_data->counts_ref;
+  if (bucket_count < 2 || bucket_count >= Histogram::kBucketCount_MAX)
+    return RejectHistogram(ref);
+
+  HistogramBase::Sample* ranges_data =
+      allocator->GetAsArray<HistogramBase::Sample>(
+          ranges_ref, kTypeIdRangesArray, bucket_count + 1);
+  HistogramBase::AtomicCount* counts_data =
+      allocator->GetAsArray<HistogramBase::AtomicCount>(
+          counts_ref, kTypeIdCountsArray, bucket_count);
+  if (!ranges_data || !counts_data)
+    return RejectHistogram(ref);
+
+  // Samples are CHECKed against the ranges, so they must be sound. They are
+  // checked on the copy.
+  scoped_ptr<BucketRanges> ranges(new BucketRanges(bucket_count + 1));
+  for (size_t i = 0; i < bucket_count + 1; ++i) {
+    ranges->set_range(i, ranges_data[i]);
+    if (i > 0 && ranges->range(i) <= ranges->range(i - 1))
+      return RejectHistogram(ref);
+  }
+  ranges->set_checksum(ranges_checksum);
+  if (ranges->range(0) != 0 ||
+      ranges->range(bucket_count) != HistogramBase::kSampleType_MAX ||
+      !ranges->HasValidChecksum()) {
+    return RejectHistogram(ref);
+  }
+  const BucketRanges* registered_ranges =
+      StatisticsRecorder::RegisterOrDeleteDuplicateRanges(ranges.release());
+
+  scoped_ptr<HistogramBase> histogram(CreateHistogram(
+      static_cast<HistogramType>(histogram_type), name, minimum, maximum,
+      registered_ranges, counts_data, &histogram_data->samples_metadata));
+  if (!histogram)
+    return RejectHistogram(ref);
+  // The histogram is owned by the caller, so it must not hand its threads
+  // per-thread samples that would outlive it.
+  histogram->SetFlags(flags & ~HistogramBase::kThreadLocalAccumulationFlag);
+  return histogram.Pass();
+}
+
+}  // namespace
+
+void SetPersistentHistogramMemoryAllocator(
+    PersistentMemoryAllocator* allocator) {
+  // Histograms already in the old allocator refer to its memory, so it is
+  // never deleted.
+  DCHECK(!g_allocator || !allocator);
+  g_allocator = allocator;
+}
+
+PersistentMemoryAllocator* GetPersistentHistogramMemoryAllocator() {
+  return g_allocator;
+}
+
+HistogramBase* AllocatePersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    HistogramType histogram_type,
+    const std::string& name,
+    int minimum,
+    int maximum,
+    const BucketRanges* bucket_ranges,
+    int32 flags,
+    PersistentMemoryAllocator::Reference* ref_ptr) {
+  if (!allocator || allocator->IsReadonly())
+    return NULL;
+
+  // Samples recorded per thread would never reach the persistent counts.
+  if (flags & HistogramBase::kThreadLocalAccumulationFlag)
+    return NULL;
+
+  size_t bucket_count = bucket_ranges->bucket_count();
+  PersistentMemoryAllocator::Reference counts_ref = allocator->Allocate(
+      bucket_count * sizeof(HistogramBase::AtomicCount), kTypeIdCountsArray);
+  PersistentMemoryAllocator::Reference ranges_ref = allocator->Allocate(
+      (bucket_count + 1) * sizeof(HistogramBase::Sample), kTypeIdRangesArray);
+  PersistentMemoryAllocator::Reference histogram_ref = allocator->Allocate(
+      sizeof(PersistentHistogramData) + name.length(), kTypeIdHistogram);
+
+  HistogramBase::AtomicCount* counts_data =
+      allocator->GetAsArray<HistogramBase::AtomicCount>(
+          counts_ref, kTypeIdCountsArray, bucket_count);
+  HistogramBase::Sample* ranges_data =
+      allocator->GetAsArray<HistogramBase::Sample>(
+          ranges_ref, kTypeIdRangesArray, bucket_count + 1);
+  PersistentHistogramData* histogram_data =
+      allocator->GetAsObject<PersistentHistogramData>(histogram_ref,
+                                                      kTypeIdHistogram);
+
+  // Whatever was allocated is left unused if the rest did not fit.
+  if (!counts_data || !ranges_data || !histogram_data)
+    return NULL;
+
+  for (size_t i = 0; i < bucket_count + 1; ++i)
+    ranges_data[i] = bucket_ranges->range(i);
+
+  histogram_data->histogram_type = histogram_type;
+  histogram_data->flags = flags | HistogramBase::kIsPersistent;
+  histogram_data->minimum = minimum;
+  histogram_data->maximum = maximum;
+  histogram_data->bucket_count = static_cast<uint32>(bucket_count);
+  histogram_data->ranges_ref = ranges_ref;
+  histogram_data->ranges_checksum = bucket_ranges->checksum();
+  histogram_data->counts_ref = counts_ref;
+  memcpy(histogram_data->name, name.c_str(), name.length() + 1);
+
+  HistogramBase* histogram = CreateHistogram(
+      histogram_type, name, minimum, maximum, bucket_ranges, counts_data,
+      &histogram_data->samples_metadata);
+  DCHECK(histogram);
+  histogram->SetFlags(histogram_data->flags);
+  *ref_ptr = histogram_ref;
+  return histogram;
+}
+
+void FinalizePersistentHistogram(PersistentMemoryAllocator* allocator,
+                                 PersistentMemoryAllocator::Reference ref,
+                                 bool registered) {
+  if (ref && registered)
+    allocator->MakeIterable(ref);
+}
+
+scoped_ptr<HistogramBase> GetNextPersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    PersistentMemoryAllocator::Iterator* iter) {
+  PersistentMemoryAllocator::Reference ref;
+  uint32 type_id;
+  while ((ref = allocator->GetNextIterable(iter, &type_id)) != 0) {
+    if (type_id != kTypeIdHistogram)
+      continue;
+    scoped_ptr<HistogramBase> histogram =
+        CreatePersistentHistogram(allocator, ref);
+    if (histogram)
+      return histogram.Pass();
+  }
+  return scoped_ptr<HistogramBase>();
+}
+
+}  // namespace base
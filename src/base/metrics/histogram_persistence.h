@@ -0,0 +1,80 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Histograms can keep their counts in persistent memory, such as a segment
+// shared with the browser, rather than on the heap. The browser then reads
+// the counts of a child process directly instead of receiving them in
+// pickles, and still can once the child is gone.
+//
+// A process opts in by setting the allocator that histograms are allocated
+// from, before any histogram is created:
+//
+//   SetPersistentHistogramMemoryAllocator(
+//       new SharedPersistentMemoryAllocator(shared_memory.Pass(), "Child",
+//                                           false));
+//
+// From then on Histogram::FactoryGet() and friends put every new histogram
+// in the segment, along with everything needed to recreate it, and fall back
+// to the heap once the segment is full. Another process then gets them with
+// GetNextPersistentHistogram(), over an allocator of its own on the same
+// memory. Sparse histograms are always kept on the heap.
+
+#ifndef BASE_METRICS_HISTOGRAM_PERSISTENCE_H_
+#define BASE_METRICS_HISTOGRAM_PERSISTENCE_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram_base.h"
+#include "base/metrics/persistent_memory_allocator.h"
+
+namespace base {
+
+class BucketRanges;
+
+// Sets the allocator that new histograms are allocated from, or NULL for the
+// heap. Takes ownership of |allocator|, which is leaked at exit like the
+// histograms that live in it.
+BASE_EXPORT void SetPersistentHistogramMemoryAllocator(
+    PersistentMemoryAllocator* allocator);
+
+// Returns the allocator that new histograms are allocated from, or NULL.
+BASE_EXPORT PersistentMemoryAllocator* GetPersistentHistogramMemoryAllocator();
+
+// Creates a histogram of |histogram_type| with its counts in |allocator|.
+// Returns NULL if it does not fit, or if |flags| has
+// kThreadLocalAccumulationFlag, in which case it belongs on the heap. Otherwise sets |ref_ptr| to where it is;
+// the histogram becomes visible to readers once it is passed to
+// FinalizePersistentHistogram(). For use by the histogram factories.
+BASE_EXPORT HistogramBase* AllocatePersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    HistogramType histogram_type,
+    const std::string& name,
+    int minimum,
+    int maximum,
+    const BucketRanges* bucket_ranges,
+    int32 flags,
+    PersistentMemoryAllocator::Reference* ref_ptr);
+
+// Makes the histogram at |ref| in |allocator| visible to readers if it was
+// |registered| with the StatisticsRecorder. A histogram that lost the race to
+// register leaves its memory unused.
+BASE_EXPORT void FinalizePersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    PersistentMemoryAllocator::Reference ref,
+    bool registered);
+
+// Returns the next histogram of |allocator| that |iter| has not been through,
+// or NULL if there is none. The histogram reads and writes the counts in
+// |allocator|, so it must not outlive it. It is not registered with the
+// StatisticsRecorder. Histograms that fail the checks against corrupt
+// memory are skipped.
+BASE_EXPORT scoped_ptr<HistogramBase> GetNextPersistentHistogram(
+    PersistentMemoryAllocator* allocator,
+    PersistentMemoryAllocator::Iterator* iter);
+
+}  // namespace base
+
+#endif  // BASE_METRICS_HISTOGRAM_PERSISTENCE_H_
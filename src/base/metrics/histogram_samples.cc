@@ -59,16 +59,23 @@ void SampleCountPickleIterator::Get(HistogramBase::Sample* min,
 
 }  // namespace
 
-HistogramSamples::HistogramSamples() : sum_(0), redundant_count_(0) {}
+HistogramSamples::HistogramSamples() : meta_(&local_meta_) {
+  local_meta_.sum = 0;
+  local_meta_.redundant_count = 0;
+  local_meta_.padding = 0;
+}
+
+HistogramSamples::HistogramSamples(Metadata* meta) : meta_(meta) {
+  local_meta_.sum = 0;
+  local_meta_.redundant_count = 0;
+  local_meta_.padding = 0;
+}
 
 HistogramSamples::~HistogramSamples() {}
 
 void HistogramSamples::Add(const HistogramSamples& other) {
-  sum_ += other.sum();
-  HistogramBase::Count old_redundant_count =
-      subtle::NoBarrier_Load(&redundant_count_);
-  subtle::NoBarrier_Store(&redundant_count_,
-      old_redundant_count + other.redundant_count());
+  IncreaseSum(other.sum());
+  IncreaseRedundantCount(other.redundant_count());
   bool success = AddSubtractImpl(other.Iterator().get(), ADD);
   DCHECK(success);
 }
@@ -79,29 +86,22 @@ bool HistogramSamples::AddFromPickle(PickleIterator* iter) {
 
   if (!iter->ReadInt64(&sum) || !iter->ReadInt(&redundant_count))
     return false;
-  sum_ += sum;
-  HistogramBase::Count old_redundant_count =
-      subtle::NoBarrier_Load(&redundant_count_);
-  subtle::NoBarrier_Store(&redundant_count_,
-                          old_redundant_count + redundant_count);
+  IncreaseSum(sum);
+  IncreaseRedundantCount(redundant_count);
 
   SampleCountPickleIterator pickle_iter(iter);
   return AddSubtractImpl(&pickle_iter, ADD);
 }
 
 void HistogramSamples::Subtract(const HistogramSamples& other) {
-  sum_ -= other.sum();
-  HistogramBase::Count old_redundant_count =
-      subtle::NoBarrier_Load(&redundant_count_);
-  subtle::NoBarrier_Store(&redundant_count_,
-                          old_redundant_count - other.redundant_count());
+  IncreaseSum(-other.sum());
+  IncreaseRedundantCount(-other.redundant_count());
   bool success = AddSubtractImpl(other.Iterator().get(), SUBTRACT);
   DCHECK(success);
 }
 
 bool HistogramSamples::Serialize(Pickle* pickle) const {
-  if (!pickle->WriteInt64(sum_) ||
-      !pickle->WriteInt(subtle::NoBarrier_Load(&redundant_count_)))
+  if (!pickle->WriteInt64(sum()) || !pickle->WriteInt(redundant_count()))
     return false;
 
   HistogramBase::Sample min;
@@ -120,12 +120,12 @@ bool HistogramSamples::Serialize(Pickle* pickle) const {
 }
 
 void HistogramSamples::IncreaseSum(int64 diff) {
-  sum_ += diff;
+  meta_->sum += diff;
 }
 
 void HistogramSamples::IncreaseRedundantCount(HistogramBase::Count diff) {
-  subtle::NoBarrier_Store(&redundant_count_,
-      subtle::NoBarrier_Load(&redundant_count_) + diff);
+  subtle::NoBarrier_Store(&meta_->redundant_count,
+      subtle::NoBarrier_Load(&meta_->redundant_count) + diff);
 }
 
 SampleCountIterator::~SampleCountIterator() {}
@@ -18,7 +18,35 @@ class SampleCountIterator;
 // HistogramSamples is a container storing all samples of a histogram.
 class BASE_EXPORT HistogramSamples {
  public:
+  // The sum and the redundant count of the samples. They are kept in a
+  // separate structure so that they can live in persistent memory, next to
+  // the counts. See histogram_persistence.h.
+  struct Metadata {
+    int64 sum;
+
+    // |redundant_count| helps identify memory corruption. It redundantly
+    // stores the total number of samples accumulated in the histogram. We can
+    // compare this count to the sum of the counts (TotalCount() function), and
+    // detect problems. Note, depending on the implementation of different
+    // histogram types, there might be races during histogram accumulation and
+    // snapshotting that we choose to accept. In this case, the tallies might
+    // mismatch even when no memory corruption has happened.
+    HistogramBase::AtomicCount redundant_count;
+
+    // Pads the structure to a multiple of 8 bytes explicitly. |sum| only
+    // needs 4-byte alignment on some 32-bit platforms, which would otherwise
+    // leave the structure 4 bytes shorter there than on 64-bit ones, and
+    // persistent memory is shared between both.
+    int32 padding;
+  };
+
   HistogramSamples();
+
+  // Uses |meta|, which must outlive this object, rather than a metadata of
+  // its own. |meta| is used as is, so it must be zeroed for an empty set of
+  // samples.
+  explicit HistogramSamples(Metadata* meta);
+
   virtual ~HistogramSamples();
 
   virtual void Accumulate(HistogramBase::Sample value,
@@ -37,9 +65,9 @@ class BASE_EXPORT HistogramSamples {
   virtual bool Serialize(Pickle* pickle) const;
 
   // Accessor fuctions.
-  int64 sum() const { return sum_; }
+  int64 sum() const { return meta_->sum; }
   HistogramBase::Count redundant_count() const {
-    return subtle::NoBarrier_Load(&redundant_count_);
+    return subtle::NoBarrier_Load(&meta_->redundant_count);
   }
 
  protected:
@@ -51,16 +79,13 @@ class BASE_EXPORT HistogramSamples {
   void IncreaseRedundantCount(HistogramBase::Count diff);
 
  private:
-  int64 sum_;
-
-  // |redundant_count_| helps identify memory corruption. It redundantly stores
-  // the total number of samples accumulated in the histogram. We can compare
-  // this count to the sum of the counts (TotalCount() function), and detect
-  // problems. Note, depending on the implementation of different histogram
-  // types, there might be races during histogram accumulation and snapshotting
-  // that we choose to accept. In this case, the tallies might mismatch even
-  // when no memory corruption has happened.
-  HistogramBase::AtomicCount redundant_count_;
+  // Used unless the metadata is given to the constructor.
+  Metadata local_meta_;
+
+  // Either |local_meta_| or the metadata given to the constructor.
+  Metadata* meta_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramSamples);
 };
 
 class BASE_EXPORT SampleCountIterator {
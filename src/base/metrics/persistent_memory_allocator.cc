@@ -0,0 +1,476 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/persistent_memory_allocator.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/memory/shared_memory.h"
+
+namespace base {
+
+namespace {
+
+// Marks a region that has been set up, and the blocks that are in use. The
+// version is bumped whenever the layout of the region changes.
+const int32 kGlobalCookie = 0x408305DC;
+const int32 kGlobalVersion = 1;
+const int32 kBlockCookieQueue = 1;
+const int32 kBlockCookieAllocated = 0x5EC3C9D1;
+
+// Flags of the region, in SharedMetadata::flags.
+const int32 kFlagCorrupt = 1 << 0;
+const int32 kFlagFull = 1 << 1;
+
+// The largest region that references can address, with room to spare so
+// that sums of references and sizes do not overflow.
+const size_t kSegmentMaxSize = 1 << 30;
+
+// Allocates the zeroed memory of a LocalPersistentMemoryAllocator. There is
+// no allocator to hand out without it.
+void* AllocateLocalMemory(size_t size) {
+  void* memory = calloc(size, 1);
+  CHECK(memory);
+  return memory;
+}
+
+}  // namespace
+
+// The header of every block, including the head of the iterable list.
+struct PersistentMemoryAllocator::BlockHeader {
+  // The size of the block, header included.
+  uint32 size;
+  int32 cookie;
+  uint32 type_id;
+
+  // The next iterable block, or kReferenceQueue for the last one. 0 until
+  // the block is made iterable.
+  subtle::Atomic32 next;
+};
+
+// The start of the region, set up by the first allocator over it.
+struct PersistentMemoryAllocator::SharedMetadata {
+  int32 cookie;
+  uint32 size;
+  uint32 page_size;
+  int32 version;
+
+  // The block that holds the name, if any.
+  Reference name;
+
+  int32 reserved;
+
+  // The start of the memory that has not been handed out yet.
+  subtle::Atomic32 freeptr;
+
+  // kFlag* bits.
+  subtle::Atomic32 flags;
+
+  // The last iterable block.
+  subtle::Atomic32 tailptr;
+
+  int32 padding;
+
+  // The head of the list of iterable blocks.
+  BlockHeader queue;
+};
+
+const uint32 PersistentMemoryAllocator::kAllocAlignment = 8;
+const PersistentMemoryAllocator::Reference
+    PersistentMemoryAllocator::kReferenceQueue =
+        offsetof(SharedMetadata, queue);
+
+PersistentMemoryAllocator::PersistentMemoryAllocator(void* base,
+                                                     size_t size,
+                                                     size_t page_size,
+                                                     const std::string& name,
+                                                     bool readonly)
+    : mem_base_(static_cast<char*>(base)),
+      mem_size_(static_cast<uint32>(size)),
+      mem_page_(static_cast<uint32>(page_size ? page_size : size)),
+      readonly_(readonly),
+      corrupt_(false) {
+  COMPILE_ASSERT(sizeof(BlockHeader) % 8 == 0, block_header_not_aligned);
+  COMPILE_ASSERT(sizeof(SharedMetadata) % 8 == 0, shared_metadata_not_aligned);
+  DCHECK(IsMemoryAcceptable(base, size, page_size, readonly));
+
+  volatile SharedMetadata* shared = shared_meta();
+  if (shared->cookie != kGlobalCookie) {
+    // The region has not been set up. Unless it is all zeros, it is not one
+    // that can be used.
+    if (readonly || shared->cookie != 0 || shared->size != 0 ||
+        subtle::NoBarrier_Load(&shared->freeptr) != 0 ||
+        shared->queue.cookie != 0 ||
+        subtle::NoBarrier_Load(&shared->queue.next) != 0) {
+      SetCorrupt();
+      return;
+    }
+
+    shared->size = mem_size_;
+    shared->page_size = mem_page_;
+    shared->version = kGlobalVersion;
+    subtle::NoBarrier_Store(&shared->freeptr, sizeof(SharedMetadata));
+    subtle::NoBarrier_Store(&shared->tailptr, kReferenceQueue);
+    shared->queue.size = sizeof(BlockHeader);
+    shared->queue.cookie = kBlockCookieQueue;
+    subtle::NoBarrier_Store(&shared->queue.next, kReferenceQueue);
+
+    if (!name.empty()) {
+      Reference name_ref = Allocate(name.length() + 1, 0);
+      char* name_cstr = GetAsArray<char>(name_ref, 0, name.length() + 1);
+      if (name_cstr) {
+        memcpy(name_cstr, name.data(), name.length());
+        shared->name = name_ref;
+      }
+    }
+
+    // Others may only see the region as set up once everything is in place.
+    subtle::MemoryBarrier();
+    shared->cookie = kGlobalCookie;
+    return;
+  }
+
+  // The region was set up by another allocator. Check that it was set up for
+  // what this one is given.
+  if (shared->size != mem_size_ || shared->page_size != mem_page_ ||
+      shared->version != kGlobalVersion ||
+      static_cast<uint32>(subtle::NoBarrier_Load(&shared->freeptr)) >
+          mem_size_ ||
+      shared->queue.cookie != kBlockCookieQueue) {
+    SetCorrupt();
+  }
+}
+
+PersistentMemoryAllocator::~PersistentMemoryAllocator() {}
+
+// static
+bool PersistentMemoryAllocator::IsMemoryAcceptable(const void* base,
+                                                   size_t size,
+                                                   size_t page_size,
+                                                   bool readonly) {
+  if (!base || reinterpret_cast<uintptr_t>(base) % kAllocAlignment != 0)
+    return false;
+  if (size < sizeof(SharedMetadata) || size > kSegmentMaxSize ||
+      size % kAllocAlignment != 0) {
+    return false;
+  }
+  if (page_size == 0)
+    return true;
+  return page_size >= sizeof(SharedMetadata) && page_size <= size &&
+         page_size % kAllocAlignment == 0 && size % page_size == 0;
+}
+
+const char* PersistentMemoryAllocator::Name() const {
+  Reference name_ref = shared_meta()->name;
+  const char* name_cstr = GetAsArray<char>(name_ref, 0, 1);
+  if (!name_cstr)
+    return "";
+
+  // The name may have been overwritten by another process, so it is only
+  // trusted if it ends within its block.
+  size_t name_length = GetAllocSize(name_ref);
+  if (name_cstr[name_length - 1] != '\0') {
+    SetCorrupt();
+    return "";
+  }
+  return name_cstr;
+}
+
+bool PersistentMemoryAllocator::IsCorrupt() const {
+  return corrupt_ || CheckFlag(kFlagCorrupt);
+}
+
+bool PersistentMemoryAllocator::IsFull() const {
+  return CheckFlag(kFlagFull);
+}
+
+size_t PersistentMemoryAllocator::used() const {
+  uint32 freeptr = static_cast<uint32>(
+      subtle::Acquire_Load(&shared_meta()->freeptr));
+  return std::min(freeptr, mem_size_);
+}
+
+size_t PersistentMemoryAllocator::GetAllocSize(Reference ref) const {
+  volatile BlockHeader* block = GetBlock(ref, 0, 0, false, false);
+  if (!block)
+    return 0;
+  return block->size - sizeof(BlockHeader);
+}
+
+uint32 PersistentMemoryAllocator::GetType(Reference ref) const {
+  volatile BlockHeader* block = GetBlock(ref, 0, 0, false, false);
+  if (!block)
+    return 0;
+  return block->type_id;
+}
+
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::Allocate(
+    size_t size,
+    uint32 type_id) {
+  DCHECK(!readonly_);
+
+  // Blocks are never larger than a page, which also keeps the sums below
+  // from overflowing.
+  if (size == 0 || size > mem_page_)
+    return 0;
+  uint32 block_size = static_cast<uint32>(size + sizeof(BlockHeader));
+  block_size = (block_size + kAllocAlignment - 1) & ~(kAllocAlignment - 1);
+  if (block_size > mem_page_)
+    return 0;
+
+  volatile SharedMetadata* shared = shared_meta();
+  uint32 freeptr = static_cast<uint32>(subtle::Acquire_Load(&shared->freeptr));
+  while (true) {
+    if (IsCorrupt())
+      return 0;
+
+    if (freeptr > mem_size_ || mem_size_ - freeptr < block_size) {
+      SetFlag(kFlagFull);
+      return 0;
+    }
+
+    // A block that does not fit in what is left of the page goes at the
+    // start of the next one. The rest of the page is left unused.
+    uint32 page_free = mem_page_ - freeptr % mem_page_;
+    uint32 new_freeptr =
+        block_size > page_free ? freeptr + page_free : freeptr + block_size;
+    uint32 old_freeptr = static_cast<uint32>(subtle::Acquire_CompareAndSwap(
+        &shared->freeptr, freeptr, new_freeptr));
+    if (old_freeptr != freeptr) {
+      // Another thread allocated first.
+      freeptr = old_freeptr;
+      continue;
+    }
+    if (block_size > page_free) {
+      freeptr = new_freeptr;
+      continue;
+    }
+
+    // The block is ours. Its header is still zero unless something wrote
+    // past the memory it was given.
+    volatile BlockHeader* block = GetBlock(freeptr, 0, 0, false, true);
+    if (!block || block->size != 0 || block->cookie != 0 ||
+        block->type_id != 0 || subtle::NoBarrier_Load(&block->next) != 0) {
+      SetCorrupt();
+      return 0;
+    }
+    block->size = block_size;
+    block->cookie = kBlockCookieAllocated;
+    block->type_id = type_id;
+    return freeptr;
+  }
+}
+
+void PersistentMemoryAllocator::MakeIterable(Reference ref) {
+  DCHECK(!readonly_);
+  if (IsCorrupt())
+    return;
+  volatile BlockHeader* block = GetBlock(ref, 0, 0, false, false);
+  if (!block)
+    return;
+
+  // Mark the block as the end of the list. If it already had a |next|, it
+  // already is iterable.
+  if (subtle::NoBarrier_CompareAndSwap(&block->next, 0, kReferenceQueue) != 0)
+    return;
+
+  // Link the block after the last one. If another thread appended a block
+  // first, move the tail on its behalf and try again.
+  volatile SharedMetadata* shared = shared_meta();
+  Reference tail =
+      static_cast<Reference>(subtle::Acquire_Load(&shared->tailptr));
+  while (true) {
+    block = GetBlock(tail, 0, 0, true, false);
+    if (!block) {
+      SetCorrupt();
+      return;
+    }
+
+    // The release makes the contents of the block visible to whoever finds
+    // it through the list.
+    Reference next = static_cast<Reference>(subtle::Release_CompareAndSwap(
+        &block->next, kReferenceQueue, ref));
+    if (next == kReferenceQueue) {
+      subtle::Release_CompareAndSwap(&shared->tailptr, tail, ref);
+      return;
+    }
+    Reference old_tail = static_cast<Reference>(
+        subtle::Release_CompareAndSwap(&shared->tailptr, tail, next));
+    tail = old_tail == tail ? next : old_tail;
+  }
+}
+
+void PersistentMemoryAllocator::CreateIterator(Iterator* state) const {
+  state->last = kReferenceQueue;
+  state->count = 0;
+}
+
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::GetNextIterable(
+    Iterator* state,
+    uint32* type_id_return) const {
+  volatile BlockHeader* block = GetBlock(state->last, 0, 0, true, false);
+  if (!block)
+    return 0;
+  Reference next =
+      static_cast<Reference>(subtle::Acquire_Load(&block->next));
+
+  // The end of the list, for now.
+  if (next == kReferenceQueue)
+    return 0;
+
+  block = GetBlock(next, 0, 0, false, false);
+  if (!block) {
+    SetCorrupt();
+    return 0;
+  }
+
+  // There can't be more blocks than fit in the region, so more than that
+  // means the list loops.
+  if (++state->count > mem_size_ / sizeof(BlockHeader)) {
+    SetCorrupt();
+    return 0;
+  }
+
+  state->last = next;
+  *type_id_return = block->type_id;
+  return next;
+}
+
+volatile PersistentMemoryAllocator::SharedMetadata*
+PersistentMemoryAllocator::shared_meta() const {
+  return reinterpret_cast<volatile SharedMetadata*>(mem_base_);
+}
+
+volatile PersistentMemoryAllocator::BlockHeader*
+PersistentMemoryAllocator::GetBlock(Reference ref,
+                                    uint32 type_id,
+                                    uint32 size,
+                                    bool queue_ok,
+                                    bool free_ok) const {
+  if (ref % kAllocAlignment != 0)
+    return NULL;
+  if (ref < (queue_ok ? kReferenceQueue : sizeof(SharedMetadata)))
+    return NULL;
+  if (size > mem_size_ - sizeof(BlockHeader))
+    return NULL;
+  size += sizeof(BlockHeader);
+  if (ref > mem_size_ - size)
+    return NULL;
+
+  volatile BlockHeader* block =
+      reinterpret_cast<volatile BlockHeader*>(mem_base_ + ref);
+  if (free_ok)
+    return block;
+
+  // The block must have been handed out, and be large enough.
+  uint32 freeptr =
+      static_cast<uint32>(subtle::Acquire_Load(&shared_meta()->freeptr));
+  if (ref > freeptr || block->size < size || block->size > freeptr - ref)
+    return NULL;
+  if (block->cookie !=
+      (ref == kReferenceQueue ? kBlockCookieQueue : kBlockCookieAllocated)) {
+    return NULL;
+  }
+  if (type_id != 0 && block->type_id != type_id)
+    return NULL;
+  return block;
+}
+
+void* PersistentMemoryAllocator::GetBlockData(Reference ref,
+                                              uint32 type_id,
+                                              uint32 size) const {
+  DCHECK(size > 0);
+  volatile BlockHeader* block = GetBlock(ref, type_id, size, false, false);
+  if (!block)
+    return NULL;
+  return const_cast<char*>(reinterpret_cast<volatile char*>(block) +
+                           sizeof(BlockHeader));
+}
+
+void PersistentMemoryAllocator::SetCorrupt() const {
+  LOG(ERROR) << "Corruption detected in persistent memory.";
+  corrupt_ = true;
+  if (!readonly_)
+    SetFlag(kFlagCorrupt);
+}
+
+void PersistentMemoryAllocator::SetFlag(int32 flag) const {
+  DCHECK(!readonly_);
+  volatile subtle::Atomic32* flags = &shared_meta()->flags;
+  subtle::Atomic32 old_flags = subtle::NoBarrier_Load(flags);
+  while (!(old_flags & flag)) {
+    subtle::Atomic32 seen_flags = subtle::NoBarrier_CompareAndSwap(
+        flags, old_flags, old_flags | flag);
+    if (seen_flags == old_flags)
+      break;
+    old_flags = seen_flags;
+  }
+}
+
+bool PersistentMemoryAllocator::CheckFlag(int32 flag) const {
+  return (subtle::NoBarrier_Load(&shared_meta()->flags) & flag) != 0;
+}
+
+// LocalPersistentMemoryAllocator ---------------------------------------------
+
+LocalPersistentMemoryAllocator::LocalPersistentMemoryAllocator(
+    size_t size,
+    const std::string& name)
+    : PersistentMemoryAllocator(AllocateLocalMemory(size),
+                                size,
+                                0,
+                                name,
+                                false) {}
+
+LocalPersistentMemoryAllocator::~LocalPersistentMemoryAllocator() {
+  free(const_cast<char*>(mem_base_));
+}
+
+// SharedPersistentMemoryAllocator --------------------------------------------
+
+SharedPersistentMemoryAllocator::SharedPersistentMemoryAllocator(
+    scoped_ptr<SharedMemory> memory,
+    const std::string& name,
+    bool readonly)
+    : PersistentMemoryAllocator(memory->memory(),
+                                memory->mapped_size(),
+                                0,
+                                name,
+                                readonly),
+      shared_memory_(memory.Pass()) {}
+
+SharedPersistentMemoryAllocator::~SharedPersistentMemoryAllocator() {}
+
+// static
+bool SharedPersistentMemoryAllocator::IsSharedMemoryAcceptable(
+    const SharedMemory& memory) {
+  return IsMemoryAcceptable(memory.memory(), memory.mapped_size(), 0, false);
+}
+
+// FilePersistentMemoryAllocator ----------------------------------------------
+
+FilePersistentMemoryAllocator::FilePersistentMemoryAllocator(
+    scoped_ptr<MemoryMappedFile> file)
+    : PersistentMemoryAllocator(const_cast<uint8*>(file->data()),
+                                file->length(),
+                                0,
+                                std::string(),
+                                true),
+      mapped_file_(file.Pass()) {}
+
+FilePersistentMemoryAllocator::~FilePersistentMemoryAllocator() {}
+
+// static
+bool FilePersistentMemoryAllocator::IsFileAcceptable(
+    const MemoryMappedFile& file) {
+  return IsMemoryAcceptable(file.data(), file.length(), 0, true);
+}
+
+}  // namespace base
@@ -0,0 +1,226 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
+#define BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
+
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+
+namespace base {
+
+class MemoryMappedFile;
+class SharedMemory;
+
+// PersistentMemoryAllocator hands out blocks of a fixed region of memory,
+// such as a shared memory segment or a memory-mapped file, so that what is
+// stored in them can be read by another process, or after the process that
+// wrote it is gone. Since the region may be mapped at a different address in
+// every process, blocks are identified by a Reference, their offset from the
+// start of the region, rather than by pointers.
+//
+// Allocation is lock-free, and blocks are never freed. Every block is tagged
+// with a type id, which is checked before handing it out. Blocks can also be
+// made "iterable", which appends them to a list that other processes can walk
+// to find them.
+//
+// Everything the allocator needs is kept in the region itself, so that an
+// allocator created over a region that is already in use picks up where the
+// other ones left it. Since the region may be written by another process, it
+// is not trusted: references are checked before use, and an allocator that
+// finds the region inconsistent marks it corrupt, after which no more blocks
+// are allocated or iterated over.
+class BASE_EXPORT PersistentMemoryAllocator {
+ public:
+  typedef uint32 Reference;
+
+  // The state of a walk over the iterable blocks. Each reader keeps its own.
+  struct Iterator {
+    // The last block returned, or the start of the list.
+    Reference last;
+
+    // The number of blocks returned, to detect loops in corrupt memory.
+    uint32 count;
+  };
+
+  // Creates an allocator over the |size| bytes at |base|, which are either
+  // all zero or were set up by an earlier allocator. |page_size| is the size
+  // of the pages of the region, which no block straddles; 0 stands for
+  // |size|. |name| is stored in the region when it is set up, and ignored
+  // otherwise. A |readonly| allocator does not write to the region.
+  //
+  // The region must pass IsMemoryAcceptable().
+  PersistentMemoryAllocator(void* base,
+                            size_t size,
+                            size_t page_size,
+                            const std::string& name,
+                            bool readonly);
+  virtual ~PersistentMemoryAllocator();
+
+  // Returns whether an allocator can be created over the given region.
+  static bool IsMemoryAcceptable(const void* base,
+                                 size_t size,
+                                 size_t page_size,
+                                 bool readonly);
+
+  // Returns the name that was given when the region was set up.
+  const char* Name() const;
+
+  bool IsReadonly() const { return readonly_; }
+
+  // Returns whether the region was found to be inconsistent, by this or by
+  // another allocator.
+  bool IsCorrupt() const;
+
+  // Returns whether an allocation failed for lack of space.
+  bool IsFull() const;
+
+  // Returns the size of the region, and the number of bytes handed out or
+  // used by the allocator itself.
+  size_t size() const { return mem_size_; }
+  size_t used() const;
+
+  // Returns the block at |ref| as a T, or NULL if |ref| is not a block of
+  // |type_id| that is large enough for one. A |type_id| of 0 matches blocks
+  // of any type. Since the memory may be shared, T must be a plain structure
+  // that does not depend on where it is mapped.
+  template <typename T>
+  T* GetAsObject(Reference ref, uint32 type_id) const {
+    return static_cast<T*>(GetBlockData(ref, type_id, sizeof(T)));
+  }
+
+  // Like GetAsObject(), for a block that holds |count| T's.
+  template <typename T>
+  T* GetAsArray(Reference ref, uint32 type_id, size_t count) const {
+    if (count > mem_size_ / sizeof(T))
+      return NULL;
+    return static_cast<T*>(GetBlockData(ref, type_id, count * sizeof(T)));
+  }
+
+  // Returns the usable size of the block at |ref|, which may be more than
+  // was asked for, or 0 if |ref| is not a block.
+  size_t GetAllocSize(Reference ref) const;
+
+  // Returns the type id of the block at |ref|, or 0 if |ref| is not a block.
+  uint32 GetType(Reference ref) const;
+
+  // Allocates a block of |size| bytes, tagged with |type_id|, and returns a
+  // reference to it. The block is zeroed. Returns 0 if there is not enough
+  // room left, or if the block would not fit in a page.
+  Reference Allocate(size_t size, uint32 type_id);
+
+  // Appends the block at |ref| to the list of iterable blocks. This should
+  // be done once the block has been filled in, since other processes may
+  // read it from then on. Does nothing if the block already is iterable.
+  void MakeIterable(Reference ref);
+
+  // Starts a walk over the iterable blocks, in the order in which they were
+  // made iterable.
+  void CreateIterator(Iterator* state) const;
+
+  // Returns the next iterable block and sets |type_id_return| to its type
+  // id, or returns 0 if there is none. Blocks made iterable later on are
+  // returned by later calls, so a walk can be resumed.
+  Reference GetNextIterable(Iterator* state, uint32* type_id_return) const;
+
+ protected:
+  volatile char* const mem_base_;
+  const uint32 mem_size_;
+  const uint32 mem_page_;
+
+ private:
+  struct BlockHeader;
+  struct SharedMetadata;
+
+  // Blocks are aligned to this, so that any plain structure can be stored.
+  static const uint32 kAllocAlignment;
+
+  // The reference of the head of the list of iterable blocks, which is kept
+  // in the SharedMetadata.
+  static const Reference kReferenceQueue;
+
+  volatile SharedMetadata* shared_meta() const;
+
+  // Returns the header of the block at |ref|, if it is one that holds at
+  // least |size| bytes and has |type_id| (unless 0). |queue_ok| allows the
+  // head of the iterable list. |free_ok| allows a block that is just being
+  // allocated, whose header is not written yet.
+  volatile BlockHeader* GetBlock(Reference ref,
+                                 uint32 type_id,
+                                 uint32 size,
+                                 bool queue_ok,
+                                 bool free_ok) const;
+
+  // Returns the data of the block at |ref|, as GetBlock() checks it.
+  void* GetBlockData(Reference ref, uint32 type_id, uint32 size) const;
+
+  void SetCorrupt() const;
+  void SetFlag(int32 flag) const;
+  bool CheckFlag(int32 flag) const;
+
+  const bool readonly_;
+
+  // Whether this allocator found the region to be corrupt. Also recorded in
+  // the region, unless it is read-only.
+  mutable bool corrupt_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentMemoryAllocator);
+};
+
+// An allocator over memory of the heap, for when there is no memory to share
+// but the data should still be laid out the same way.
+class BASE_EXPORT LocalPersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  LocalPersistentMemoryAllocator(size_t size, const std::string& name);
+  ~LocalPersistentMemoryAllocator() override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LocalPersistentMemoryAllocator);
+};
+
+// An allocator over a shared memory segment, which it owns. The segment must
+// be mapped, and pass IsSharedMemoryAcceptable().
+class BASE_EXPORT SharedPersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  SharedPersistentMemoryAllocator(scoped_ptr<SharedMemory> memory,
+                                  const std::string& name,
+                                  bool readonly);
+  ~SharedPersistentMemoryAllocator() override;
+
+  static bool IsSharedMemoryAcceptable(const SharedMemory& memory);
+
+  SharedMemory* shared_memory() { return shared_memory_.get(); }
+
+ private:
+  scoped_ptr<SharedMemory> shared_memory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedPersistentMemoryAllocator);
+};
+
+// A read-only allocator over a memory-mapped file, which it owns, such as
+// the contents of a region that was saved after the process that wrote it
+// was gone. The file must pass IsFileAcceptable().
+class BASE_EXPORT FilePersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  explicit FilePersistentMemoryAllocator(scoped_ptr<MemoryMappedFile> file);
+  ~FilePersistentMemoryAllocator() override;
+
+  static bool IsFileAcceptable(const MemoryMappedFile& file);
+
+ private:
+  scoped_ptr<MemoryMappedFile> mapped_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePersistentMemoryAllocator);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
@@ -23,6 +23,16 @@ class BucketRanges;
 class BASE_EXPORT SampleVector : public HistogramSamples {
  public:
   explicit SampleVector(const BucketRanges* bucket_ranges);
+
+  // Keeps the counts in the |counts_size| entries at |counts|, one per
+  // bucket, and the sum and redundant count in |meta|, rather than in memory
+  // of its own. Both must outlive this object, and be zeroed for an empty
+  // vector. This is for histograms in persistent memory.
+  SampleVector(HistogramBase::AtomicCount* counts,
+               size_t counts_size,
+               Metadata* meta,
+               const BucketRanges* bucket_ranges);
+
   ~SampleVector() override;
 
   // HistogramSamples implementation:
@@ -45,7 +55,13 @@ class BASE_EXPORT SampleVector : public HistogramSamples {
  private:
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptSampleCounts);
 
-  std::vector<HistogramBase::AtomicCount> counts_;
+  // Used unless the counts are given to the constructor.
+  std::vector<HistogramBase::AtomicCount> local_counts_;
+
+  // Either the data of |local_counts_| or the counts given to the
+  // constructor.
+  HistogramBase::AtomicCount* counts_;
+  size_t counts_size_;
 
   // Shares the same BucketRanges with Histogram object.
   const BucketRanges* const bucket_ranges_;
@@ -55,7 +71,8 @@ class BASE_EXPORT SampleVector : public HistogramSamples {
 
 class BASE_EXPORT SampleVectorIterator : public SampleCountIterator {
  public:
-  SampleVectorIterator(const std::vector<HistogramBase::AtomicCount>* counts,
+  SampleVectorIterator(const HistogramBase::AtomicCount* counts,
+                       size_t counts_size,
                        const BucketRanges* bucket_ranges);
   ~SampleVectorIterator() override;
 
@@ -72,7 +89,8 @@ class BASE_EXPORT SampleVectorIterator : public SampleCountIterator {
  private:
   void SkipEmptyBuckets();
 
-  const std::vector<HistogramBase::AtomicCount>* counts_;
+  const HistogramBase::AtomicCount* counts_;
+  size_t counts_size_;
   const BucketRanges* bucket_ranges_;
 
   size_t index_;
@@ -328,6 +328,8 @@ class SequencedWorkerPool::Inner {
   void ThreadLoop(Worker* this_worker);
 
  private:
+  typedef std::set<SequencedTask, SequencedTaskLessThan> PendingTaskSet;
+
   enum GetWorkStatus {
     GET_WORK_FOUND,
     GET_WORK_NOT_FOUND,
@@ -349,6 +351,19 @@ class SequencedWorkerPool::Inner {
   // Called from within the lock, this returns the next sequence task number.
   int64 LockedGetNextSequenceTaskNumber();
 
+  // Called from within the lock, this adds |task| to the pending tasks. It
+  // goes to |pending_tasks_| if it can run once its time comes, and behind
+  // the other tasks of its sequence otherwise.
+  void LockedAddPendingTask(const SequencedTask& task);
+
+  // Called from within the lock, this removes |i| from |pending_tasks_|.
+  void LockedErasePendingTask(PendingTaskSet::iterator i);
+
+  // Called from within the lock, this moves the first task queued in the
+  // given sequence, if any, to |pending_tasks_|. The sequence must not be
+  // running, nor have a task in |pending_tasks_|.
+  void LockedMakeNextSequencedTaskPending(int sequence_token_id);
+
   // Gets new task. There are 3 cases depending on the return value:
   //
   // 1) If the return value is |GET_WORK_FOUND|, |task| is filled in and should
@@ -454,18 +469,29 @@ class SequencedWorkerPool::Inner {
   // or SKIP_ON_SHUTDOWN flag set.
   size_t blocking_shutdown_thread_count_;
 
-  // A set of all pending tasks in time-to-run order. These are tasks that are
-  // either waiting for a thread to run on, waiting for their time to run,
-  // or blocked on a previous task in their sequence. We have to iterate over
+  // A set of the pending tasks that can run as soon as a thread is available
+  // and their time has come, in time-to-run order. We have to iterate over
   // the tasks by time-to-run order, so we use the set instead of the
   // traditional priority_queue.
-  typedef std::set<SequencedTask, SequencedTaskLessThan> PendingTaskSet;
+  //
+  // A sequence has at most one task in here, its first one, and none while
+  // it is running. So the first task of the set is always the next one to
+  // run, however many tasks are queued behind running sequences.
   PendingTaskSet pending_tasks_;
 
+  // The other pending tasks of every sequence, by sequence token ID. These
+  // are blocked on a previous task in their sequence.
+  typedef std::map<int, PendingTaskSet> SequencedTaskMap;
+  SequencedTaskMap blocked_sequenced_tasks_;
+
+  // The task that each sequence with a task in |pending_tasks_| has there.
+  typedef std::map<int, PendingTaskSet::iterator> SequenceFrontTaskMap;
+  SequenceFrontTaskMap sequence_front_tasks_;
+
   // The next sequence number for a new sequenced task.
   int64 next_sequence_task_number_;
 
-  // Number of tasks in the pending_tasks_ list that are marked as blocking
+  // Number of pending tasks, blocked or not, that are marked as blocking
   // shutdown.
   size_t blocking_shutdown_pending_task_count_;
 
@@ -651,7 +677,7 @@ bool SequencedWorkerPool::Inner::PostTask(
     if (optional_token_name)
       sequenced.sequence_token_id = LockedGetNamedTokenID(*optional_token_name);
 
-    pending_tasks_.insert(sequenced);
+    LockedAddPendingTask(sequenced);
     if (shutdown_behavior == BLOCK_SHUTDOWN)
       blocking_shutdown_pending_task_count_++;
 
@@ -947,56 +973,99 @@ int64 SequencedWorkerPool::Inner::LockedGetNextSequenceTaskNumber() {
   return next_sequence_task_number_++;
 }
 
+void SequencedWorkerPool::Inner::LockedAddPendingTask(
+    const SequencedTask& task) {
+  lock_.AssertAcquired();
+  const int sequence_token_id = task.sequence_token_id;
+  if (!sequence_token_id) {
+    pending_tasks_.insert(task);
+    return;
+  }
+
+  if (!IsSequenceTokenRunnable(sequence_token_id)) {
+    blocked_sequenced_tasks_[sequence_token_id].insert(task);
+    return;
+  }
+
+  SequenceFrontTaskMap::iterator front =
+      sequence_front_tasks_.find(sequence_token_id);
+  if (front == sequence_front_tasks_.end()) {
+    sequence_front_tasks_[sequence_token_id] =
+        pending_tasks_.insert(task).first;
+    return;
+  }
+
+  if (SequencedTaskLessThan()(*front->second, task)) {
+    blocked_sequenced_tasks_[sequence_token_id].insert(task);
+    return;
+  }
+
+  // |task| is due before the task the sequence has pending, which must be a
+  // delayed one. It takes its place.
+  blocked_sequenced_tasks_[sequence_token_id].insert(*front->second);
+  pending_tasks_.erase(front->second);
+  front->second = pending_tasks_.insert(task).first;
+}
+
+void SequencedWorkerPool::Inner::LockedErasePendingTask(
+    PendingTaskSet::iterator i) {
+  lock_.AssertAcquired();
+  if (i->sequence_token_id)
+    sequence_front_tasks_.erase(i->sequence_token_id);
+  pending_tasks_.erase(i);
+}
+
+void SequencedWorkerPool::Inner::LockedMakeNextSequencedTaskPending(
+    int sequence_token_id) {
+  lock_.AssertAcquired();
+  DCHECK(IsSequenceTokenRunnable(sequence_token_id));
+  DCHECK(!ContainsKey(sequence_front_tasks_, sequence_token_id));
+  if (!sequence_token_id)
+    return;
+
+  SequencedTaskMap::iterator found =
+      blocked_sequenced_tasks_.find(sequence_token_id);
+  if (found == blocked_sequenced_tasks_.end())
+    return;
+
+  PendingTaskSet& tasks = found->second;
+  sequence_front_tasks_[sequence_token_id] =
+      pending_tasks_.insert(*tasks.begin()).first;
+  tasks.erase(tasks.begin());
+  if (tasks.empty())
+    blocked_sequenced_tasks_.erase(found);
+}
+
 SequencedWorkerPool::Inner::GetWorkStatus SequencedWorkerPool::Inner::GetWork(
     SequencedTask* task,
     TimeDelta* wait_time,
     std::vector<Closure>* delete_these_outside_lock) {
   lock_.AssertAcquired();
 
-  // Find the next task with a sequence token that's not currently in use.
-  // If the token is in use, that means another thread is running something
-  // in that sequence, and we can't run it without going out-of-order.
-  //
-  // This algorithm is simple and fair, but inefficient in some cases. For
-  // example, say somebody schedules 1000 slow tasks with the same sequence
-  // number. We'll have to go through all those tasks each time we feel like
-  // there might be work to schedule. If this proves to be a problem, we
-  // should make this more efficient.
-  //
-  // One possible enhancement would be to keep a map from sequence ID to a
-  // list of pending but currently blocked SequencedTasks for that ID.
-  // When a worker finishes a task of one sequence token, it can pick up the
-  // next one from that token right away.
-  //
-  // This may lead to starvation if there are sufficient numbers of sequences
-  // in use. To alleviate this, we could add an incrementing priority counter
-  // to each SequencedTask. Then maintain a priority_queue of all runnable
-  // tasks, sorted by priority counter. When a sequenced task is completed
-  // we would pop the head element off of that tasks pending list and add it
-  // to the priority queue. Then we would run the first item in the priority
-  // queue.
+  // Tasks whose sequence token is in use are kept out of |pending_tasks_|,
+  // since running them while another thread is running something in that
+  // sequence would go out-of-order. So only the first pending task ever needs
+  // looking at: it either runs, is deleted on shutdown, or tells how long to
+  // wait. When a worker finishes a task of a sequence, the next task of that
+  // sequence takes its place in |pending_tasks_|.
 
   GetWorkStatus status = GET_WORK_NOT_FOUND;
-  int unrunnable_tasks = 0;
-  PendingTaskSet::iterator i = pending_tasks_.begin();
   // We assume that the loop below doesn't take too long and so we can just do
   // a single call to TimeTicks::Now().
   const TimeTicks current_time = TimeTicks::Now();
-  while (i != pending_tasks_.end()) {
-    if (!IsSequenceTokenRunnable(i->sequence_token_id)) {
-      unrunnable_tasks++;
-      ++i;
-      continue;
-    }
+  while (!pending_tasks_.empty()) {
+    PendingTaskSet::iterator i = pending_tasks_.begin();
+    DCHECK(IsSequenceTokenRunnable(i->sequence_token_id));
 
     if (shutdown_called_ && i->shutdown_behavior != BLOCK_SHUTDOWN) {
       // We're shutting down and the task we just found isn't blocking
       // shutdown. Delete it and get more work.
       //
-      // Note that we do not want to delete unrunnable tasks. Deleting a task
+      // Note that we do not want to delete blocked tasks. Deleting a task
       // can have side effects (like freeing some objects) and deleting a
       // task that's supposed to run after one that's currently running could
-      // cause an obscure crash.
+      // cause an obscure crash. The next task of the sequence is only looked
+      // at once this one is gone.
       //
       // We really want to delete these tasks outside the lock in case the
       // closures are holding refs to objects that want to post work from
@@ -1006,7 +1075,9 @@ SequencedWorkerPool::Inner::GetWorkStatus SequencedWorkerPool::Inner::GetWork(
       // vector they passed to us once the lock is exited to make this
       // happen.
       delete_these_outside_lock->push_back(i->task);
-      pending_tasks_.erase(i++);
+      const int sequence_token_id = i->sequence_token_id;
+      LockedErasePendingTask(i);
+      LockedMakeNextSequencedTaskPending(sequence_token_id);
       continue;
     }
 
@@ -1017,14 +1088,16 @@ SequencedWorkerPool::Inner::GetWorkStatus SequencedWorkerPool::Inner::GetWork(
       if (cleanup_state_ == CLEANUP_RUNNING) {
         // Deferred tasks are deleted when cleaning up, see Inner::ThreadLoop.
         delete_these_outside_lock->push_back(i->task);
-        pending_tasks_.erase(i);
+        const int sequence_token_id = i->sequence_token_id;
+        LockedErasePendingTask(i);
+        LockedMakeNextSequencedTaskPending(sequence_token_id);
       }
       break;
     }
 
     // Found a runnable task.
     *task = *i;
-    pending_tasks_.erase(i);
+    LockedErasePendingTask(i);
     if (task->shutdown_behavior == BLOCK_SHUTDOWN) {
       blocking_shutdown_pending_task_count_--;
     }
@@ -1075,8 +1148,10 @@ void SequencedWorkerPool::Inner::DidRunWorkerTask(const SequencedTask& task) {
     blocking_shutdown_thread_count_--;
   }
 
-  if (task.sequence_token_id)
+  if (task.sequence_token_id) {
     current_sequences_.erase(task.sequence_token_id);
+    LockedMakeNextSequencedTaskPending(task.sequence_token_id);
+  }
 }
 
 bool SequencedWorkerPool::Inner::IsSequenceTokenRunnable(
@@ -1123,14 +1198,12 @@ int SequencedWorkerPool::Inner::PrepareToStartAdditionalThreadIfHelpful() {
       cleanup_state_ == CLEANUP_DONE &&
       threads_.size() < max_threads_ &&
       waiting_thread_count_ == 0) {
-    // We could use an additional thread if there's work to be done.
-    for (PendingTaskSet::const_iterator i = pending_tasks_.begin();
-         i != pending_tasks_.end(); ++i) {
-      if (IsSequenceTokenRunnable(i->sequence_token_id)) {
-        // Found a runnable task, mark the thread as being started.
-        thread_being_created_ = true;
-        return static_cast<int>(threads_.size() + 1);
-      }
+    // We could use an additional thread if there's work to be done. Every
+    // task in |pending_tasks_| is runnable.
+    if (!pending_tasks_.empty()) {
+      // Mark the thread as being started.
+      thread_being_created_ = true;
+      return static_cast<int>(threads_.size() + 1);
     }
   }
   return 0;
@@ -0,0 +1,61 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Converts a trace in the binary format of TraceLog::FlushAsBinary() to the
+// JSON trace format, for the viewers that only read JSON.
+//
+// Usage: convert_binary_trace <binary trace> <JSON trace>
+
+#include <stdio.h>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/strings/string_piece.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event_binary_format.h"
+
+using base::trace_event::TraceResultBuffer;
+
+int main(int argc, char* argv[]) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+
+  const base::CommandLine::StringVector& args =
+      base::CommandLine::ForCurrentProcess()->GetArgs();
+  if (args.size() != 2) {
+    fprintf(stderr, "Usage: %s <binary trace> <JSON trace>\n", argv[0]);
+    return 1;
+  }
+
+  base::FilePath binary_trace_path(args[0]);
+  base::FilePath json_trace_path(args[1]);
+
+  base::MemoryMappedFile binary_trace;
+  if (!binary_trace.Initialize(binary_trace_path)) {
+    fprintf(stderr, "Could not read the binary trace.\n");
+    return 1;
+  }
+
+  // The JSON is written out as the events are converted, so that it is never
+  // held in memory as a whole.
+  TraceResultBuffer::FileOutput output(json_trace_path);
+  TraceResultBuffer result_buffer;
+  result_buffer.SetOutputCallback(output.GetCallback());
+  result_buffer.Start();
+  bool converted = base::trace_event::ConvertBinaryTraceToJSON(
+      base::StringPiece(reinterpret_cast<const char*>(binary_trace.data()),
+                        binary_trace.length()),
+      base::Bind(&TraceResultBuffer::AddFragment,
+                 base::Unretained(&result_buffer)));
+  result_buffer.Finish();
+
+  if (!converted)
+    fprintf(stderr, "The binary trace is corrupt or truncated.\n");
+  if (!output.succeeded())
+    fprintf(stderr, "Could not write the JSON trace.\n");
+  return converted && output.succeeded() ? 0 : 1;
+}
@@ -16,6 +16,7 @@
 #include "base/trace_event/memory_dump_provider.h"
 #include "base/trace_event/memory_dump_session_state.h"
 #include "base/trace_event/memory_profiler_allocation_context.h"
+#include "base/trace_event/memory_profiler_sampling_heap_dump_provider.h"
 #include "base/trace_event/process_memory_dump.h"
 #include "base/trace_event/trace_event_argument.h"
 #include "build/build_config.h"
@@ -173,6 +174,13 @@ void MemoryDumpManager::Initialize(MemoryDumpManagerDelegate* delegate,
   RegisterDumpProvider(WinHeapDumpProvider::GetInstance(), "WinHeap", nullptr);
 #endif
 
+  // Without an allocator shim that calls its hooks, the sampling profiler
+  // would only ever write empty heap dumps.
+  if (SamplingHeapDumpProvider::InstallAllocationHooks()) {
+    RegisterDumpProvider(SamplingHeapDumpProvider::GetInstance(),
+                         "SamplingHeapProfiler", nullptr);
+  }
+
   // If tracing was enabled before initializing MemoryDumpManager, we missed the
   // OnTraceLogEnabled() event. Synthetize it so we can late-join the party.
   bool is_tracing_already_enabled = TraceLog::GetInstance()->IsEnabled();
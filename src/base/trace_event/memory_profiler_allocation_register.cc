@@ -47,7 +47,7 @@ void AllocationRegister::Insert(void* address,
   cells_[*idx_ptr].allocation.context = context;
 }
 
-void AllocationRegister::Remove(void* address) {
+bool AllocationRegister::Remove(void* address) {
   // Get a pointer to the index of the cell that stores |address|. The index can
   // be an element of |buckets_| or the |next| member of a cell.
   CellIndex* idx_ptr = Lookup(address);
@@ -55,7 +55,7 @@ void AllocationRegister::Remove(void* address) {
 
   // If the index is 0, the address was not there in the first place.
   if (freed_idx == 0)
-    return;
+    return false;
 
   // The cell at the index is now free, remove it from the linked list for
   // |Hash(address)|.
@@ -68,6 +68,7 @@ void AllocationRegister::Remove(void* address) {
 
   // Reset the address, so that on iteration the free cell is ignored.
   freed_cell->allocation.address = nullptr;
+  return true;
 }
 
 AllocationRegister::ConstIterator AllocationRegister::begin() const {
@@ -68,8 +68,8 @@ class BASE_EXPORT AllocationRegister {
   void Insert(void* address, size_t size, AllocationContext context);
 
   // Removes the address from the table if it is present. It is ok to call this
-  // with a null pointer.
-  void Remove(void* address);
+  // with a null pointer. Returns whether the address was present.
+  bool Remove(void* address);
 
   ConstIterator begin() const;
   ConstIterator end() const;
@@ -0,0 +1,266 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/memory_profiler_sampling_heap_dump_provider.h"
+
+#include <math.h>
+
+#include <limits>
+
+#include "base/allocator/allocator_extension.h"
+#include "base/atomicops.h"
+#include "base/base_switches.h"
+#include "base/command_line.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/thread_local.h"
+#include "base/trace_event/memory_profiler_allocation_context.h"
+#include "base/trace_event/memory_profiler_allocation_register.h"
+#include "base/trace_event/memory_profiler_heap_dump_writer.h"
+#include "base/trace_event/process_memory_dump.h"
+#include "base/trace_event/trace_event_argument.h"
+#include "base/trace_event/trace_event_memory_overhead.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// Non-zero while sampling. This is the only thing that |RecordAlloc| reads
+// when the profiler is off.
+subtle::Atomic32 g_sampling_enabled = 0;
+
+// The number of bytes that the current thread can allocate before its next
+// sample. It is stored in the pointer itself, so that the countdown never
+// allocates. Null if the countdown has not been drawn yet on this thread.
+LazyInstance<ThreadLocalPointer<void>>::Leaky g_bytes_until_sample =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Set while the current thread is in the profiler, so that the allocations and
+// frees that the profiler makes itself are not recorded.
+LazyInstance<ThreadLocalBoolean>::Leaky g_in_profiler =
+    LAZY_INSTANCE_INITIALIZER;
+
+// The number of sampled allocations in the register, by hash of the address.
+// This lets frees skip the lock for the addresses that were never sampled,
+// which are nearly all of them.
+const int kSampledAddressCountBits = 12;
+subtle::Atomic32 g_sampled_address_counts[1 << kSampledAddressCountBits];
+
+subtle::Atomic32* GetSampledAddressCount(void* address) {
+  // Multiplicative hashing. The low bits of an address are mostly zero
+  // because of alignment, so they are shifted out first.
+  uint32_t key = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(address) >>
+                                       4);
+  uint32_t hash = (key * 2654435761u) >> (32 - kSampledAddressCountBits);
+  return &g_sampled_address_counts[hash];
+}
+
+class ScopedInProfiler {
+ public:
+  ScopedInProfiler() { g_in_profiler.Get().Set(true); }
+  ~ScopedInProfiler() { g_in_profiler.Get().Set(false); }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedInProfiler);
+};
+
+}  // namespace
+
+// static
+SamplingHeapDumpProvider* SamplingHeapDumpProvider::GetInstance() {
+  return Singleton<SamplingHeapDumpProvider,
+                   LeakySingletonTraits<SamplingHeapDumpProvider>>::get();
+}
+
+// static
+bool SamplingHeapDumpProvider::InstallAllocationHooks() {
+  if (!allocator::AreAllocationHooksSupported())
+    return false;
+  // Constant-initialized, so that it is set up before any thread can see it.
+  static const allocator::thunks::AllocationHooks kHooks = {
+      &SamplingHeapDumpProvider::RecordAlloc,
+      &SamplingHeapDumpProvider::RecordFree};
+  allocator::SetAllocationHooks(&kHooks);
+  return true;
+}
+
+SamplingHeapDumpProvider::SamplingHeapDumpProvider()
+    : sampling_interval_(0),
+      // The xorshift state must not be zero.
+      random_state_(RandUint64() | 1) {}
+
+SamplingHeapDumpProvider::~SamplingHeapDumpProvider() {}
+
+// static
+void SamplingHeapDumpProvider::RecordAlloc(void* address, size_t size) {
+  if (subtle::NoBarrier_Load(&g_sampling_enabled) == 0 || !address)
+    return;
+
+  ThreadLocalPointer<void>* countdown = g_bytes_until_sample.Pointer();
+  uintptr_t bytes_until_sample = reinterpret_cast<uintptr_t>(countdown->Get());
+  if (size < bytes_until_sample) {
+    countdown->Set(reinterpret_cast<void*>(bytes_until_sample - size));
+    return;
+  }
+
+  if (g_in_profiler.Get().Get())
+    return;
+
+  GetInstance()->SampleAllocation(address, size, bytes_until_sample);
+}
+
+// static
+void SamplingHeapDumpProvider::RecordFree(void* address) {
+  if (!address || subtle::NoBarrier_Load(GetSampledAddressCount(address)) == 0)
+    return;
+
+  if (g_in_profiler.Get().Get())
+    return;
+
+  GetInstance()->RemoveSample(address);
+}
+
+void SamplingHeapDumpProvider::SetSamplingInterval(size_t sampling_interval) {
+  if (sampling_interval != 0)
+    AllocationContextTracker::SetCaptureEnabled(true);
+
+  ScopedInProfiler in_profiler;
+  AutoLock lock(lock_);
+  if (sampling_interval != 0 && !allocation_register_)
+    allocation_register_.reset(new AllocationRegister);
+
+  // Threads keep the countdown that they have drawn with the old interval
+  // until their next sample.
+  sampling_interval_ = sampling_interval;
+  subtle::NoBarrier_Store(&g_sampling_enabled, sampling_interval != 0);
+}
+
+bool SamplingHeapDumpProvider::OnMemoryDump(const MemoryDumpArgs& args,
+                                            ProcessMemoryDump* pmd) {
+  // The stack frame deduplicator is only there when heap profiling is enabled
+  // for the session.
+  if (!pmd->session_state() ||
+      !pmd->session_state()->stack_frame_deduplicator())
+    return true;
+
+  ScopedInProfiler in_profiler;
+  HeapDumpWriter writer(pmd->session_state()->stack_frame_deduplicator());
+  TraceEventMemoryOverhead overhead;
+  overhead.Add("SamplingHeapDumpProvider", sizeof(*this));
+  {
+    AutoLock lock(lock_);
+    if (!allocation_register_)
+      return true;
+
+    for (const AllocationRegister::Allocation& allocation :
+         *allocation_register_)
+      writer.InsertAllocation(allocation.context, allocation.size);
+    allocation_register_->EstimateTraceMemoryOverhead(&overhead);
+  }
+
+  pmd->AddHeapDump("malloc", writer.WriteHeapDump());
+  overhead.AddSelf();
+  overhead.DumpInto("tracing/heap_profiler", pmd);
+  return true;
+}
+
+void SamplingHeapDumpProvider::OnHeapProfilingEnabled(bool enabled) {
+  if (!enabled) {
+    SetSamplingInterval(0);
+    return;
+  }
+
+  size_t sampling_interval = kDefaultSamplingInterval;
+  if (CommandLine::InitializedForCurrentProcess()) {
+    const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+    if (command_line.HasSwitch(switches::kHeapProfilingSamplingInterval)) {
+      std::string value = command_line.GetSwitchValueASCII(
+          switches::kHeapProfilingSamplingInterval);
+      if (!StringToSizeT(value, &sampling_interval) || sampling_interval == 0) {
+        LOG(ERROR) << "Invalid heap profiling sampling interval: " << value;
+        sampling_interval = kDefaultSamplingInterval;
+      }
+    }
+  }
+  SetSamplingInterval(sampling_interval);
+}
+
+void SamplingHeapDumpProvider::SampleAllocation(void* address,
+                                                size_t size,
+                                                uintptr_t bytes_until_sample) {
+  ScopedInProfiler in_profiler;
+  ThreadLocalPointer<void>* countdown = g_bytes_until_sample.Pointer();
+
+  AutoLock lock(lock_);
+  if (sampling_interval_ == 0)
+    return;
+
+  if (bytes_until_sample == 0) {
+    // This is the first allocation of the thread since sampling started, so
+    // there was no countdown yet.
+    bytes_until_sample = NextSampleIntervalWhileLocked();
+    if (size < bytes_until_sample) {
+      countdown->Set(reinterpret_cast<void*>(bytes_until_sample - size));
+      return;
+    }
+  }
+
+  // Whether bytes are sampled is independent of the bytes before them, so
+  // the countdown to the next sample starts afresh after this allocation.
+  countdown->Set(reinterpret_cast<void*>(NextSampleIntervalWhileLocked()));
+
+  // The context tracker may have been disabled since sampling started.
+  if (!AllocationContextTracker::capture_enabled())
+    return;
+
+  // An allocation of |size| bytes is sampled with probability
+  // 1 - exp(-size / sampling_interval), so it stands for 1 / probability
+  // allocations of its size. For small allocations this is about
+  // |sampling_interval| bytes, and for large ones about |size| bytes.
+  double probability =
+      -expm1(-static_cast<double>(size) / sampling_interval_);
+  size_t estimated_size = static_cast<size_t>(size / probability);
+
+  // An address can only be in the register again if its free was missed.
+  if (!allocation_register_->Remove(address))
+    subtle::NoBarrier_AtomicIncrement(GetSampledAddressCount(address), 1);
+  allocation_register_->Insert(address, estimated_size,
+                               AllocationContextTracker::GetContextSnapshot());
+}
+
+void SamplingHeapDumpProvider::RemoveSample(void* address) {
+  AutoLock lock(lock_);
+  if (allocation_register_ && allocation_register_->Remove(address))
+    subtle::NoBarrier_AtomicIncrement(GetSampledAddressCount(address), -1);
+}
+
+uintptr_t SamplingHeapDumpProvider::NextSampleIntervalWhileLocked() {
+  lock_.AssertAcquired();
+
+  // xorshift64*, which is plenty for spacing samples, and cheap enough to
+  // draw under the lock.
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  uint64_t bits = random_state_ * UINT64_C(2685821657736338717);
+
+  // A uniform value in (0, 1] from the top 53 bits, turned into an
+  // exponentially distributed one.
+  double uniform =
+      static_cast<double>((bits >> 11) + 1) / (UINT64_C(1) << 53);
+  double interval = -log(uniform) * sampling_interval_;
+
+  const uintptr_t kMaxInterval = std::numeric_limits<uintptr_t>::max() / 2;
+  if (interval >= static_cast<double>(kMaxInterval))
+    return kMaxInterval;
+  if (interval < 1)
+    return 1;
+  return static_cast<uintptr_t>(interval);
+}
+
+}  // namespace trace_event
+}  // namespace base
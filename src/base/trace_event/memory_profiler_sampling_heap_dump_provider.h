@@ -0,0 +1,104 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_MEMORY_PROFILER_SAMPLING_HEAP_DUMP_PROVIDER_H_
+#define BASE_TRACE_EVENT_MEMORY_PROFILER_SAMPLING_HEAP_DUMP_PROVIDER_H_
+
+#include <stdint.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/singleton.h"
+#include "base/synchronization/lock.h"
+#include "base/trace_event/memory_dump_provider.h"
+
+namespace base {
+namespace trace_event {
+
+class AllocationRegister;
+
+// Heap profiler that records only a sample of the allocations, so that it is
+// cheap enough to leave enabled in production. Allocations are sampled as a
+// Poisson process over the allocated bytes: on average one byte in every
+// |sampling_interval| bytes is picked, and an allocation is recorded, with its
+// |AllocationContext|, if any of its bytes is picked. Each recorded allocation
+// is weighted by the inverse of the probability that it was sampled, so that
+// the sizes in the heap dumps estimate the sizes of all live allocations.
+//
+// The allocator shim feeds the profiler through |RecordAlloc| and
+// |RecordFree|, once |InstallAllocationHooks| has installed them. Between two
+// samples, an allocation costs a thread-local countdown, and a free a lookup
+// in a small table of counters; only sampled allocations take a lock.
+class BASE_EXPORT SamplingHeapDumpProvider : public MemoryDumpProvider {
+ public:
+  // The sampling interval used when heap profiling is enabled without the
+  // --heap-profiling-sampling-interval switch.
+  static const size_t kDefaultSamplingInterval = 128 * 1024;
+
+  static SamplingHeapDumpProvider* GetInstance();
+
+  // Installs |RecordAlloc| and |RecordFree| as the allocator shim's hooks.
+  // Returns false if no allocator shim calls the hooks, in which case the
+  // profiler would never see an allocation, and should not be registered.
+  static bool InstallAllocationHooks();
+
+  // Called by the allocator shim after |address| has been allocated with
+  // |size| bytes, and before |address| is freed. Allocations and frees made
+  // by the profiler itself are ignored. These are safe to call before the
+  // profiler is enabled, and from any thread.
+  static void RecordAlloc(void* address, size_t size);
+  static void RecordFree(void* address);
+
+  // Sets the mean number of bytes allocated between two samples. Setting it
+  // to 0 stops sampling; the allocations sampled so far are still dumped
+  // until they are freed. Sampling requires the allocation context tracker,
+  // which is enabled when sampling starts.
+  void SetSamplingInterval(size_t sampling_interval);
+
+  // MemoryDumpProvider implementation.
+  bool OnMemoryDump(const MemoryDumpArgs& args,
+                    ProcessMemoryDump* pmd) override;
+  void OnHeapProfilingEnabled(bool enabled) override;
+
+ private:
+  friend struct DefaultSingletonTraits<SamplingHeapDumpProvider>;
+
+  SamplingHeapDumpProvider();
+  ~SamplingHeapDumpProvider() override;
+
+  // Slow path of |RecordAlloc|, for the allocations that exhaust the
+  // countdown of the current thread. |bytes_until_sample| is the countdown,
+  // or 0 if it has not been drawn yet on this thread.
+  void SampleAllocation(void* address,
+                        size_t size,
+                        uintptr_t bytes_until_sample);
+
+  // Slow path of |RecordFree|, for addresses that may have been sampled.
+  void RemoveSample(void* address);
+
+  // Draws the number of bytes until the next sample from the exponential
+  // distribution with mean |sampling_interval_|. Must be called with |lock_|
+  // held. Never returns 0.
+  uintptr_t NextSampleIntervalWhileLocked();
+
+  // Protects everything below.
+  Lock lock_;
+
+  size_t sampling_interval_;
+
+  // State of the xorshift generator for |NextSampleIntervalWhileLocked|.
+  uint64_t random_state_;
+
+  // The sampled allocations, by address. Created when sampling first starts,
+  // because it reserves a lot of address space.
+  scoped_ptr<AllocationRegister> allocation_register_;
+
+  DISALLOW_COPY_AND_ASSIGN(SamplingHeapDumpProvider);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_MEMORY_PROFILER_SAMPLING_HEAP_DUMP_PROVIDER_H_
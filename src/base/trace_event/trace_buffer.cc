@@ -359,6 +359,23 @@ void TraceResultBuffer::SimpleOutput::Append(
   json_output += json_trace_output;
 }
 
+TraceResultBuffer::FileOutput::FileOutput(const FilePath& path)
+    : file_(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+      write_failed_(false) {}
+
+TraceResultBuffer::FileOutput::~FileOutput() {}
+
+TraceResultBuffer::OutputCallback TraceResultBuffer::FileOutput::GetCallback() {
+  return Bind(&FileOutput::Append, Unretained(this));
+}
+
+void TraceResultBuffer::FileOutput::Append(const std::string& json_string) {
+  if (!file_.IsValid() || write_failed_)
+    return;
+  int size = static_cast<int>(json_string.size());
+  write_failed_ = file_.WriteAtCurrentPos(json_string.data(), size) != size;
+}
+
 TraceResultBuffer::TraceResultBuffer() : append_comma_(false) {}
 
 TraceResultBuffer::~TraceResultBuffer() {}
@@ -6,6 +6,7 @@
 #define BASE_TRACE_EVENT_TRACE_BUFFER_H_
 
 #include "base/base_export.h"
+#include "base/files/file.h"
 #include "base/trace_event/trace_event.h"
 #include "base/trace_event/trace_event_impl.h"
 
@@ -99,6 +100,30 @@ class BASE_EXPORT TraceResultBuffer {
     std::string json_output;
   };
 
+  // Writes the JSON output to a file as it comes instead of collecting it, so
+  // that a trace never has to be held in memory as a whole. Flushing with
+  // TraceLog::Flush(..., true) converts and writes the events on a worker
+  // thread; the output callback must run on a thread that allows IO.
+  class BASE_EXPORT FileOutput {
+   public:
+    // Creates the file at |path|, or overwrites it.
+    explicit FileOutput(const FilePath& path);
+    ~FileOutput();
+
+    OutputCallback GetCallback();
+
+    // Returns whether all of the output so far was written.
+    bool succeeded() const { return file_.IsValid() && !write_failed_; }
+
+   private:
+    void Append(const std::string& json_string);
+
+    File file_;
+    bool write_failed_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileOutput);
+  };
+
   TraceResultBuffer();
   ~TraceResultBuffer();
 
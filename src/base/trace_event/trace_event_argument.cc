@@ -6,6 +6,7 @@
 
 #include "base/bits.h"
 #include "base/json/json_writer.h"
+#include "base/trace_event/trace_event_binary_format.h"
 #include "base/trace_event/trace_event_memory_overhead.h"
 #include "base/values.h"
 
@@ -454,6 +455,83 @@ void TracedValue::AppendAsTraceFormat(std::string* out) const {
   *out += tmp;
 }
 
+void TracedValue::AppendAsBinary(BinaryTraceWriter* writer) const {
+  DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
+  DCHECK_CONTAINER_STACK_DEPTH_EQ(1u);
+
+  // The entries are written out as they are read, rather than going through a
+  // base::Value as ToBaseValue() does. Each is followed by its key, if in a
+  // dictionary, which the writer wants first.
+  writer->BeginDictionary();
+  std::vector<bool> outer_containers_are_arrays;
+  bool in_array = false;
+  PickleIterator it(pickle_);
+  const char* type;
+
+  while (it.ReadBytes(&type, 1)) {
+    switch (*type) {
+      case kTypeStartDict:
+      case kTypeStartArray:
+        if (!in_array)
+          writer->WriteKey(ReadKeyName(it));
+        outer_containers_are_arrays.push_back(in_array);
+        in_array = *type == kTypeStartArray;
+        if (in_array)
+          writer->BeginArray();
+        else
+          writer->BeginDictionary();
+        break;
+
+      case kTypeEndDict:
+      case kTypeEndArray:
+        if (in_array)
+          writer->EndArray();
+        else
+          writer->EndDictionary();
+        in_array = outer_containers_are_arrays.back();
+        outer_containers_are_arrays.pop_back();
+        break;
+
+      case kTypeBool: {
+        bool value;
+        CHECK(it.ReadBool(&value));
+        if (!in_array)
+          writer->WriteKey(ReadKeyName(it));
+        writer->WriteBoolean(value);
+      } break;
+
+      case kTypeInt: {
+        int value;
+        CHECK(it.ReadInt(&value));
+        if (!in_array)
+          writer->WriteKey(ReadKeyName(it));
+        writer->WriteInteger(value);
+      } break;
+
+      case kTypeDouble: {
+        double value;
+        CHECK(it.ReadDouble(&value));
+        if (!in_array)
+          writer->WriteKey(ReadKeyName(it));
+        writer->WriteDouble(value);
+      } break;
+
+      case kTypeString: {
+        std::string value;
+        CHECK(it.ReadString(&value));
+        if (!in_array)
+          writer->WriteKey(ReadKeyName(it));
+        writer->WriteString(value);
+      } break;
+
+      default:
+        NOTREACHED();
+    }
+  }
+  DCHECK(outer_containers_are_arrays.empty());
+  writer->EndDictionary();
+}
+
 void TracedValue::EstimateTraceMemoryOverhead(
     TraceEventMemoryOverhead* overhead) {
   const size_t kPickleHeapAlign = 4096;  // Must be == Pickle::kPickleHeapAlign.
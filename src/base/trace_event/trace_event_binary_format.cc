@@ -0,0 +1,735 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_binary_format.h"
+
+#include <string.h>
+
+#include <deque>
+
+#include "base/format_macros.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+#include "base/strings/stringprintf.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_log.h"
+#include "base/values.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+const char kMagic[] = {'\x89', 'T', 'R', 'B'};
+const char kVersion = 1;
+
+const char kRecordEvent = 'e';
+
+// Which of the fields of an event are present.
+const char kFieldHasProcessId = 1 << 0;
+const char kFieldHasThreadTimestamp = 1 << 1;
+const char kFieldArgsStripped = 1 << 2;
+
+// The types of values.
+const char kTypeFalse = 'f';
+const char kTypeTrue = 't';
+const char kTypeUint = 'u';
+const char kTypeInt = 'i';
+const char kTypeDouble = 'd';
+const char kTypePointer = 'p';
+const char kTypeString = 's';
+const char kTypeJSON = 'j';
+const char kTypeStripped = 'x';
+const char kTypeStartDict = '{';
+const char kTypeEndDict = '}';
+const char kTypeStartArray = '[';
+const char kTypeEndArray = ']';
+
+// Limits the nesting of dictionaries and arrays, so that a corrupt trace
+// can't exhaust the stack of the reader.
+const int kMaxDepth = 100;
+
+const char kStrippedJSON[] = "\"__stripped__\"";
+
+class BinaryTraceReader {
+ public:
+  explicit BinaryTraceReader(const StringPiece& data)
+      : pos_(data.data()),
+        end_(data.data() + data.size()),
+        process_id_(0),
+        last_timestamp_(0) {}
+
+  bool ReadHeader();
+
+  bool AtEnd() const { return pos_ == end_; }
+
+  // Reads the next event and appends it to |out| as JSON.
+  bool ReadEventAsJSON(std::string* out);
+
+ private:
+  bool ReadByte(char* value);
+  bool ReadVarint(uint64* value);
+  bool ReadSignedVarint(int64* value);
+  bool ReadDouble(double* value);
+  bool ReadBytes(StringPiece* bytes);
+  bool ReadInternedString(const std::string** str);
+
+  // Reads a value and appends it to |out| as JSON.
+  bool ReadValueAsJSON(std::string* out);
+
+  // Reads the rest of a value of |type| within a dictionary or an array.
+  bool ReadValue(char type, int depth, scoped_ptr<Value>* value);
+
+  const char* pos_;
+  const char* const end_;
+  int process_id_;
+  int64 last_timestamp_;
+
+  // A deque, so that the strings stay put as more are read.
+  std::deque<std::string> strings_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceReader);
+};
+
+bool BinaryTraceReader::ReadHeader() {
+  if (static_cast<size_t>(end_ - pos_) < sizeof(kMagic) ||
+      memcmp(pos_, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  pos_ += sizeof(kMagic);
+
+  char version;
+  int64 process_id;
+  if (!ReadByte(&version) || version != kVersion ||
+      !ReadSignedVarint(&process_id)) {
+    return false;
+  }
+  process_id_ = static_cast<int>(process_id);
+  return true;
+}
+
+bool BinaryTraceReader::ReadEventAsJSON(std::string* out) {
+  char record;
+  char phase;
+  const std::string* category;
+  const std::string* name;
+  uint64 flags;
+  char fields;
+  int64 timestamp_delta;
+  int64 thread_or_process_id;
+  if (!ReadByte(&record) || record != kRecordEvent || !ReadByte(&phase) ||
+      !ReadInternedString(&category) || !ReadInternedString(&name) ||
+      !ReadVarint(&flags) || !ReadByte(&fields) ||
+      !ReadSignedVarint(&timestamp_delta) ||
+      !ReadSignedVarint(&thread_or_process_id)) {
+    return false;
+  }
+  last_timestamp_ += timestamp_delta;
+
+  bool has_thread_timestamp = (fields & kFieldHasThreadTimestamp) != 0;
+  int64 duration = -1;
+  int64 thread_duration = -1;
+  int64 thread_timestamp = 0;
+  uint64 id = 0;
+  uint64 bind_id = 0;
+  uint64 context_id = 0;
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    if (!ReadSignedVarint(&duration))
+      return false;
+    if (has_thread_timestamp && !ReadSignedVarint(&thread_duration))
+      return false;
+  }
+  if (has_thread_timestamp && !ReadSignedVarint(&thread_timestamp))
+    return false;
+  if ((flags & TRACE_EVENT_FLAG_HAS_ID) && !ReadVarint(&id))
+    return false;
+  if ((flags & (TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT)) &&
+      !ReadVarint(&bind_id)) {
+    return false;
+  }
+  if ((flags & TRACE_EVENT_FLAG_HAS_CONTEXT_ID) && !ReadVarint(&context_id))
+    return false;
+
+  int process_id = process_id_;
+  int thread_id = static_cast<int>(thread_or_process_id);
+  if (fields & kFieldHasProcessId) {
+    process_id = static_cast<int>(thread_or_process_id);
+    thread_id = -1;
+  }
+
+  // The rest mirrors TraceEvent::AppendAsJSON().
+  StringAppendF(out, "{\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64
+                     ","
+                     "\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",\"args\":",
+                process_id, thread_id, last_timestamp_, phase,
+                category->c_str(), name->c_str());
+
+  char num_args;
+  if (!ReadByte(&num_args))
+    return false;
+  if (fields & kFieldArgsStripped) {
+    *out += kStrippedJSON;
+  } else {
+    *out += "{";
+    for (int i = 0; i < num_args; ++i) {
+      const std::string* arg_name;
+      if (!ReadInternedString(&arg_name))
+        return false;
+      if (i > 0)
+        *out += ",";
+      *out += "\"";
+      *out += *arg_name;
+      *out += "\":";
+      if (!ReadValueAsJSON(out))
+        return false;
+    }
+    *out += "}";
+  }
+
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    if (duration != -1)
+      StringAppendF(out, ",\"dur\":%" PRId64, duration);
+    if (has_thread_timestamp && thread_duration != -1)
+      StringAppendF(out, ",\"tdur\":%" PRId64, thread_duration);
+  }
+
+  if (has_thread_timestamp)
+    StringAppendF(out, ",\"tts\":%" PRId64, thread_timestamp);
+
+  if (flags & TRACE_EVENT_FLAG_ASYNC_TTS)
+    StringAppendF(out, ", \"use_async_tts\":1");
+
+  if (flags & TRACE_EVENT_FLAG_HAS_ID)
+    StringAppendF(out, ",\"id\":\"0x%" PRIx64 "\"", id);
+
+  if (flags & TRACE_EVENT_FLAG_BIND_TO_ENCLOSING)
+    StringAppendF(out, ",\"bp\":\"e\"");
+
+  if (flags & (TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT))
+    StringAppendF(out, ",\"bind_id\":\"0x%" PRIx64 "\"", bind_id);
+  if (flags & TRACE_EVENT_FLAG_FLOW_IN)
+    StringAppendF(out, ",\"flow_in\":true");
+  if (flags & TRACE_EVENT_FLAG_FLOW_OUT)
+    StringAppendF(out, ",\"flow_out\":true");
+
+  if (flags & TRACE_EVENT_FLAG_HAS_CONTEXT_ID)
+    StringAppendF(out, ",\"cid\":\"0x%" PRIx64 "\"", context_id);
+
+  if (phase == TRACE_EVENT_PHASE_INSTANT) {
+    char scope = '?';
+    switch (flags & TRACE_EVENT_FLAG_SCOPE_MASK) {
+      case TRACE_EVENT_SCOPE_GLOBAL:
+        scope = TRACE_EVENT_SCOPE_NAME_GLOBAL;
+        break;
+
+      case TRACE_EVENT_SCOPE_PROCESS:
+        scope = TRACE_EVENT_SCOPE_NAME_PROCESS;
+        break;
+
+      case TRACE_EVENT_SCOPE_THREAD:
+        scope = TRACE_EVENT_SCOPE_NAME_THREAD;
+        break;
+    }
+    StringAppendF(out, ",\"s\":\"%c\"", scope);
+  }
+
+  *out += "}";
+  return true;
+}
+
+bool BinaryTraceReader::ReadByte(char* value) {
+  if (pos_ == end_)
+    return false;
+  *value = *pos_++;
+  return true;
+}
+
+bool BinaryTraceReader::ReadVarint(uint64* value) {
+  uint64 result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos_ == end_)
+      return false;
+    uint8 byte = static_cast<uint8>(*pos_++);
+    result |= static_cast<uint64>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BinaryTraceReader::ReadSignedVarint(int64* value) {
+  uint64 zigzag;
+  if (!ReadVarint(&zigzag))
+    return false;
+  *value = static_cast<int64>(zigzag >> 1) ^ -static_cast<int64>(zigzag & 1);
+  return true;
+}
+
+bool BinaryTraceReader::ReadDouble(double* value) {
+  if (end_ - pos_ < 8)
+    return false;
+  uint64 bits = 0;
+  for (int i = 0; i < 8; ++i)
+    bits |= static_cast<uint64>(static_cast<uint8>(*pos_++)) << (8 * i);
+  memcpy(value, &bits, sizeof(*value));
+  return true;
+}
+
+bool BinaryTraceReader::ReadBytes(StringPiece* bytes) {
+  uint64 size;
+  if (!ReadVarint(&size) || size > static_cast<uint64>(end_ - pos_))
+    return false;
+  bytes->set(pos_, static_cast<size_t>(size));
+  pos_ += size;
+  return true;
+}
+
+bool BinaryTraceReader::ReadInternedString(const std::string** str) {
+  uint64 index;
+  if (!ReadVarint(&index))
+    return false;
+  if (index == 0) {
+    StringPiece bytes;
+    if (!ReadBytes(&bytes))
+      return false;
+    strings_.push_back(bytes.as_string());
+    *str = &strings_.back();
+    return true;
+  }
+  if (index > strings_.size())
+    return false;
+  *str = &strings_[index - 1];
+  return true;
+}
+
+bool BinaryTraceReader::ReadValueAsJSON(std::string* out) {
+  char type;
+  if (!ReadByte(&type))
+    return false;
+
+  TraceEvent::TraceValue value;
+  switch (type) {
+    case kTypeFalse:
+    case kTypeTrue:
+      value.as_bool = type == kTypeTrue;
+      TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_BOOL, value, out);
+      return true;
+
+    case kTypeUint: {
+      uint64 uint_value;
+      if (!ReadVarint(&uint_value))
+        return false;
+      value.as_uint = uint_value;
+      TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_UINT, value, out);
+      return true;
+    }
+
+    case kTypeInt: {
+      int64 int_value;
+      if (!ReadSignedVarint(&int_value))
+        return false;
+      value.as_int = int_value;
+      TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_INT, value, out);
+      return true;
+    }
+
+    case kTypeDouble:
+      if (!ReadDouble(&value.as_double))
+        return false;
+      TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_DOUBLE, value, out);
+      return true;
+
+    case kTypePointer: {
+      // The pointer may not fit in a pointer of this process.
+      uint64 pointer_value;
+      if (!ReadVarint(&pointer_value))
+        return false;
+      StringAppendF(out, "\"0x%" PRIx64 "\"", pointer_value);
+      return true;
+    }
+
+    case kTypeString: {
+      StringPiece bytes;
+      if (!ReadBytes(&bytes))
+        return false;
+      std::string string_value = bytes.as_string();
+      value.as_string = string_value.c_str();
+      TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_STRING, value, out);
+      return true;
+    }
+
+    case kTypeJSON: {
+      StringPiece bytes;
+      if (!ReadBytes(&bytes))
+        return false;
+      bytes.AppendToString(out);
+      return true;
+    }
+
+    case kTypeStripped:
+      *out += kStrippedJSON;
+      return true;
+
+    case kTypeStartDict:
+    case kTypeStartArray: {
+      scoped_ptr<Value> container;
+      if (!ReadValue(type, 0, &container))
+        return false;
+      std::string json;
+      JSONWriter::Write(*container, &json);
+      *out += json;
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool BinaryTraceReader::ReadValue(char type,
+                                  int depth,
+                                  scoped_ptr<Value>* value) {
+  switch (type) {
+    case kTypeFalse:
+    case kTypeTrue:
+      value->reset(new FundamentalValue(type == kTypeTrue));
+      return true;
+
+    case kTypeInt: {
+      // Values of a TracedValue are ints, but anything larger is kept as a
+      // double rather than truncated.
+      int64 int_value;
+      if (!ReadSignedVarint(&int_value))
+        return false;
+      if (int_value == static_cast<int>(int_value)) {
+        value->reset(new FundamentalValue(static_cast<int>(int_value)));
+      } else {
+        value->reset(new FundamentalValue(static_cast<double>(int_value)));
+      }
+      return true;
+    }
+
+    case kTypeDouble: {
+      double double_value;
+      if (!ReadDouble(&double_value))
+        return false;
+      value->reset(new FundamentalValue(double_value));
+      return true;
+    }
+
+    case kTypeString: {
+      StringPiece bytes;
+      if (!ReadBytes(&bytes))
+        return false;
+      value->reset(new StringValue(bytes.as_string()));
+      return true;
+    }
+
+    case kTypeStartDict: {
+      if (depth >= kMaxDepth)
+        return false;
+      scoped_ptr<DictionaryValue> dict(new DictionaryValue);
+      char entry_type;
+      while (ReadByte(&entry_type)) {
+        if (entry_type == kTypeEndDict) {
+          *value = dict.Pass();
+          return true;
+        }
+        const std::string* key;
+        scoped_ptr<Value> entry;
+        if (!ReadInternedString(&key) ||
+            !ReadValue(entry_type, depth + 1, &entry)) {
+          return false;
+        }
+        dict->SetWithoutPathExpansion(*key, entry.Pass());
+      }
+      return false;
+    }
+
+    case kTypeStartArray: {
+      if (depth >= kMaxDepth)
+        return false;
+      scoped_ptr<ListValue> list(new ListValue);
+      char entry_type;
+      while (ReadByte(&entry_type)) {
+        if (entry_type == kTypeEndArray) {
+          *value = list.Pass();
+          return true;
+        }
+        scoped_ptr<Value> entry;
+        if (!ReadValue(entry_type, depth + 1, &entry))
+          return false;
+        list->Append(entry.Pass());
+      }
+      return false;
+    }
+
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+BinaryTraceWriter::BinaryTraceWriter(int process_id)
+    : process_id_(process_id),
+      wrote_header_(false),
+      last_timestamp_(0),
+      has_pending_key_(false),
+      string_count_(0) {}
+
+BinaryTraceWriter::~BinaryTraceWriter() {}
+
+void BinaryTraceWriter::AppendEvent(
+    const TraceEvent& event,
+    const ArgumentFilterPredicate& argument_filter_predicate) {
+  if (!wrote_header_) {
+    WriteBytes(StringPiece(kMagic, sizeof(kMagic)));
+    WriteByte(kVersion);
+    WriteSignedVarint(process_id_);
+    wrote_header_ = true;
+  }
+
+  unsigned int flags = event.flags();
+  // The names of an event that is copied live in the event.
+  bool static_names = !(flags & TRACE_EVENT_FLAG_COPY);
+  const char* category_group_name =
+      TraceLog::GetCategoryGroupName(event.category_group_enabled());
+
+  ArgumentNameFilterPredicate argument_name_filter_predicate;
+  bool strip_args =
+      event.arg_name(0) && !argument_filter_predicate.is_null() &&
+      !argument_filter_predicate.Run(category_group_name, event.name(),
+                                     &argument_name_filter_predicate);
+
+  char fields = 0;
+  int thread_or_process_id = event.thread_id();
+  if ((flags & TRACE_EVENT_FLAG_HAS_PROCESS_ID) &&
+      thread_or_process_id != kNullProcessId) {
+    fields |= kFieldHasProcessId;
+  }
+  bool has_thread_timestamp = !event.thread_timestamp().is_null();
+  if (has_thread_timestamp)
+    fields |= kFieldHasThreadTimestamp;
+  if (strip_args)
+    fields |= kFieldArgsStripped;
+
+  WriteByte(kRecordEvent);
+  WriteByte(event.phase());
+  WriteInternedString(category_group_name, true);
+  WriteInternedString(event.name(), static_names);
+  WriteVarint(flags);
+  WriteByte(fields);
+  int64 timestamp = event.timestamp().ToInternalValue();
+  WriteSignedVarint(timestamp - last_timestamp_);
+  last_timestamp_ = timestamp;
+  WriteSignedVarint(thread_or_process_id);
+
+  if (event.phase() == TRACE_EVENT_PHASE_COMPLETE) {
+    WriteSignedVarint(event.duration().ToInternalValue());
+    if (has_thread_timestamp)
+      WriteSignedVarint(event.thread_duration().ToInternalValue());
+  }
+  if (has_thread_timestamp)
+    WriteSignedVarint(event.thread_timestamp().ToInternalValue());
+  if (flags & TRACE_EVENT_FLAG_HAS_ID)
+    WriteVarint(event.id());
+  if (flags & (TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT))
+    WriteVarint(event.bind_id());
+  if (flags & TRACE_EVENT_FLAG_HAS_CONTEXT_ID)
+    WriteVarint(event.context_id());
+
+  size_t num_args = 0;
+  while (!strip_args && num_args < kTraceMaxNumArgs &&
+         event.arg_name(num_args)) {
+    ++num_args;
+  }
+  WriteByte(static_cast<char>(num_args));
+  for (size_t i = 0; i < num_args; ++i) {
+    WriteInternedString(event.arg_name(i), static_names);
+    WriteArgument(event, i, argument_name_filter_predicate);
+  }
+}
+
+void BinaryTraceWriter::TakeData(std::string* out) {
+  out->clear();
+  out->swap(data_);
+}
+
+void BinaryTraceWriter::BeginDictionary() {
+  BeginValue(kTypeStartDict);
+}
+
+void BinaryTraceWriter::EndDictionary() {
+  DCHECK(!has_pending_key_);
+  WriteByte(kTypeEndDict);
+}
+
+void BinaryTraceWriter::BeginArray() {
+  BeginValue(kTypeStartArray);
+}
+
+void BinaryTraceWriter::EndArray() {
+  DCHECK(!has_pending_key_);
+  WriteByte(kTypeEndArray);
+}
+
+void BinaryTraceWriter::WriteKey(const StringPiece& name) {
+  DCHECK(!has_pending_key_);
+  name.CopyToString(&pending_key_);
+  has_pending_key_ = true;
+}
+
+void BinaryTraceWriter::WriteBoolean(bool value) {
+  BeginValue(value ? kTypeTrue : kTypeFalse);
+}
+
+void BinaryTraceWriter::WriteInteger(int64 value) {
+  BeginValue(kTypeInt);
+  WriteSignedVarint(value);
+}
+
+void BinaryTraceWriter::WriteDouble(double value) {
+  BeginValue(kTypeDouble);
+  uint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i)
+    WriteByte(static_cast<char>(bits >> (8 * i)));
+}
+
+void BinaryTraceWriter::WriteString(const StringPiece& value) {
+  BeginValue(kTypeString);
+  WriteBytes(value);
+}
+
+void BinaryTraceWriter::WriteJSON(const StringPiece& json) {
+  BeginValue(kTypeJSON);
+  WriteBytes(json);
+}
+
+void BinaryTraceWriter::WriteVarint(uint64 value) {
+  while (value >= 0x80) {
+    WriteByte(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  WriteByte(static_cast<char>(value));
+}
+
+void BinaryTraceWriter::WriteSignedVarint(int64 value) {
+  // Zigzag encoding, so that small negative numbers stay short.
+  WriteVarint((static_cast<uint64>(value) << 1) ^
+              static_cast<uint64>(value >> 63));
+}
+
+void BinaryTraceWriter::WriteBytes(const StringPiece& bytes) {
+  WriteVarint(bytes.size());
+  bytes.AppendToString(&data_);
+}
+
+void BinaryTraceWriter::BeginValue(char type) {
+  WriteByte(type);
+  if (has_pending_key_) {
+    WriteInternedString(pending_key_);
+    has_pending_key_ = false;
+  }
+}
+
+void BinaryTraceWriter::WriteInternedString(const char* str,
+                                            bool static_string) {
+  if (!static_string) {
+    WriteInternedString(StringPiece(str));
+    return;
+  }
+
+  hash_map<const char*, uint32>::const_iterator it =
+      static_string_indices_.find(str);
+  if (it != static_string_indices_.end()) {
+    WriteVarint(it->second + 1);
+    return;
+  }
+  static_string_indices_[str] = WriteInternedString(StringPiece(str));
+}
+
+uint32 BinaryTraceWriter::WriteInternedString(const StringPiece& str) {
+  std::pair<hash_map<std::string, uint32>::iterator, bool> result =
+      string_indices_.insert(std::make_pair(str.as_string(), string_count_));
+  if (!result.second) {
+    WriteVarint(result.first->second + 1);
+    return result.first->second;
+  }
+  WriteVarint(0);
+  WriteBytes(str);
+  return string_count_++;
+}
+
+void BinaryTraceWriter::WriteArgument(
+    const TraceEvent& event,
+    size_t index,
+    const ArgumentNameFilterPredicate& name_filter_predicate) {
+  if (!name_filter_predicate.is_null() &&
+      !name_filter_predicate.Run(event.arg_name(index))) {
+    WriteByte(kTypeStripped);
+    return;
+  }
+
+  TraceEvent::TraceValue value = event.arg_value(index);
+  switch (event.arg_type(index)) {
+    case TRACE_VALUE_TYPE_BOOL:
+      WriteBoolean(value.as_bool);
+      break;
+    case TRACE_VALUE_TYPE_UINT:
+      WriteByte(kTypeUint);
+      WriteVarint(value.as_uint);
+      break;
+    case TRACE_VALUE_TYPE_INT:
+      WriteInteger(value.as_int);
+      break;
+    case TRACE_VALUE_TYPE_DOUBLE:
+      WriteDouble(value.as_double);
+      break;
+    case TRACE_VALUE_TYPE_POINTER:
+      WriteByte(kTypePointer);
+      WriteVarint(static_cast<uint64>(
+          reinterpret_cast<intptr_t>(value.as_pointer)));
+      break;
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      WriteString(value.as_string ? value.as_string : "NULL");
+      break;
+    case TRACE_VALUE_TYPE_CONVERTABLE:
+      event.convertable_value(index)->AppendAsBinary(this);
+      break;
+    default:
+      NOTREACHED() << "Don't know how to write this value";
+      WriteJSON("null");
+      break;
+  }
+}
+
+bool ConvertBinaryTraceToJSON(
+    const StringPiece& data,
+    const TraceResultBuffer::OutputCallback& event_callback) {
+  // A trace without events has no header either.
+  if (data.empty())
+    return true;
+
+  BinaryTraceReader reader(data);
+  if (!reader.ReadHeader())
+    return false;
+
+  std::string json;
+  while (!reader.AtEnd()) {
+    json.clear();
+    if (!reader.ReadEventAsJSON(&json))
+      return false;
+    event_callback.Run(json);
+  }
+  return true;
+}
+
+}  // namespace trace_event
+}  // namespace base
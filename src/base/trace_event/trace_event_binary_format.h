@@ -0,0 +1,128 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact binary encoding of trace events, as an alternative to the JSON
+// trace format. It is several times smaller, and much cheaper to produce,
+// since numbers are written as varints rather than printed, and the names of
+// categories, events and arguments are written only once.
+//
+// A binary trace is a header followed by event records:
+//
+//   header:  "\x89TRB", a version byte, the process id as a signed varint.
+//   event:   'e', the phase byte, the category and the name as strings, the
+//            flags as a varint, a byte telling which fields are present, the
+//            timestamp as a signed varint relative to the previous event, the
+//            thread id (or the process id, if the event has its own) as a
+//            signed varint, then the optional fields in the order that
+//            AppendAsJSON() writes them, then the number of arguments as a
+//            byte, and each argument as a string and a value.
+//   string:  a varint, 0 for a string that follows as a varint length and its
+//            bytes, or 1 + the index of an earlier string in the trace.
+//   value:   a type byte, then the value: varints for integers, 8 bytes for
+//            doubles, a length and bytes for strings, and entries up to the
+//            matching end byte for dictionaries and arrays.
+//
+// All numbers are little-endian. The trace is written incrementally, so that
+// the output of TraceLog::FlushAsBinary() can be written out as it comes, and
+// ConvertBinaryTraceToJSON() turns it back into the JSON format for existing
+// viewers.
+
+#ifndef BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
+#define BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/strings/string_piece.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event_impl.h"
+
+namespace base {
+namespace trace_event {
+
+class BASE_EXPORT BinaryTraceWriter {
+ public:
+  // |process_id| is the process of the events that don't have their own.
+  explicit BinaryTraceWriter(int process_id);
+  ~BinaryTraceWriter();
+
+  // Appends |event|, with its arguments filtered as AppendAsJSON() does.
+  void AppendEvent(const TraceEvent& event,
+                   const ArgumentFilterPredicate& argument_filter_predicate);
+
+  // Returns the size of the data written since the last TakeData().
+  size_t size() const { return data_.size(); }
+
+  // Moves the data written since the last call to |out|. The trace is the
+  // concatenation of all the data taken.
+  void TakeData(std::string* out);
+
+  // For ConvertableToTraceFormat::AppendAsBinary(), which writes a single
+  // value. Every value within a dictionary is preceded by WriteKey(). Within
+  // a dictionary, a value is written as its type, its key and the value
+  // itself, and within an array as its type and the value.
+  void BeginDictionary();
+  void EndDictionary();
+  void BeginArray();
+  void EndArray();
+  void WriteKey(const StringPiece& name);
+  void WriteBoolean(bool value);
+  void WriteInteger(int64 value);
+  void WriteDouble(double value);
+  void WriteString(const StringPiece& value);
+
+  // Writes a value that is already in the JSON format, to be copied as is.
+  void WriteJSON(const StringPiece& json);
+
+ private:
+  void WriteByte(char value) { data_.push_back(value); }
+  void WriteVarint(uint64 value);
+  void WriteSignedVarint(int64 value);
+  void WriteBytes(const StringPiece& bytes);
+
+  // Starts a value of |type|, with the pending key if in a dictionary.
+  void BeginValue(char type);
+
+  // Writes |str| as a reference to an earlier occurrence if there is one.
+  // Strings that are |static_string| are looked up by address, which is
+  // cheaper, and must never be freed or change.
+  void WriteInternedString(const char* str, bool static_string);
+
+  // Returns the index of |str| in the trace.
+  uint32 WriteInternedString(const StringPiece& str);
+
+  void WriteArgument(const TraceEvent& event,
+                     size_t index,
+                     const ArgumentNameFilterPredicate& name_filter_predicate);
+
+  const int process_id_;
+  std::string data_;
+  bool wrote_header_;
+  int64 last_timestamp_;
+
+  // The key of the next value, set by WriteKey().
+  std::string pending_key_;
+  bool has_pending_key_;
+
+  hash_map<const char*, uint32> static_string_indices_;
+  hash_map<std::string, uint32> string_indices_;
+  uint32 string_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceWriter);
+};
+
+// Converts the binary trace |data| to JSON. Calls |event_callback| with each
+// event in the format of TraceEvent::AppendAsJSON(), ready for
+// TraceResultBuffer::AddFragment(). Returns false if |data| is not a complete
+// binary trace, after converting the events before the error.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(
+    const StringPiece& data,
+    const TraceResultBuffer::OutputCallback& event_callback);
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
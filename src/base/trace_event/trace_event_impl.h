@@ -31,6 +31,8 @@ class MessageLoop;
 
 namespace trace_event {
 
+class BinaryTraceWriter;
+
 typedef base::Callback<bool(const char* arg_name)> ArgumentNameFilterPredicate;
 
 typedef base::Callback<bool(const char* category_group_name,
@@ -49,6 +51,10 @@ class BASE_EXPORT ConvertableToTraceFormat
   // appended.
   virtual void AppendAsTraceFormat(std::string* out) const = 0;
 
+  // Append the class info to |writer| as a single value. By default the
+  // output of AppendAsTraceFormat() is written as is.
+  virtual void AppendAsBinary(BinaryTraceWriter* writer) const;
+
   virtual void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead);
 
   std::string ToString() const {
@@ -135,6 +141,15 @@ class BASE_EXPORT TraceEvent {
   unsigned long long id() const { return id_; }
   unsigned long long context_id() const { return context_id_; }
   unsigned int flags() const { return flags_; }
+  unsigned long long bind_id() const { return bind_id_; }
+
+  // The arguments, up to the first one without a name.
+  const char* arg_name(size_t index) const { return arg_names_[index]; }
+  unsigned char arg_type(size_t index) const { return arg_types_[index]; }
+  TraceValue arg_value(size_t index) const { return arg_values_[index]; }
+  ConvertableToTraceFormat* convertable_value(size_t index) const {
+    return convertable_values_[index].get();
+  }
 
   // Exposed for unittesting:
 
@@ -32,6 +32,7 @@
 #include "base/trace_event/process_memory_dump.h"
 #include "base/trace_event/trace_buffer.h"
 #include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_binary_format.h"
 #include "base/trace_event/trace_event_synthetic_delay.h"
 #include "base/trace_event/trace_log.h"
 #include "base/trace_event/trace_sampling_thread.h"
@@ -334,6 +335,113 @@ void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
   // find the generation mismatch and delete this buffer soon.
 }
 
+// The events of a thread without a message loop, or whose message loop may be
+// blocked. Such a thread can't be asked to flush, so its chunk is taken over by
+// the flushing thread instead. The thread claims the buffer with an atomic flag
+// for as long as it writes to an event in the chunk, and the flushing thread
+// waits for the claim to take the chunk. Since the flag is only contended by a
+// flush, adding an event to the current chunk doesn't take a lock. The chunk
+// hand-off isn't lock-free, though: returning a full chunk and getting a new
+// one from |logged_events_| takes |lock_|, once per chunk.
+class TraceLog::WorkerThreadEventBuffer {
+ public:
+  explicit WorkerThreadEventBuffer(TraceLog* trace_log)
+      : trace_log_(trace_log), claimed_(0), chunk_index_(0), generation_(0) {}
+  ~WorkerThreadEventBuffer() {}
+
+  // Holds the claim on a buffer, which may be NULL, for the scope.
+  class AutoClaim {
+   public:
+    explicit AutoClaim(WorkerThreadEventBuffer* buffer) : buffer_(buffer) {
+      if (buffer_)
+        buffer_->Claim();
+    }
+    ~AutoClaim() {
+      if (buffer_)
+        buffer_->Unclaim();
+    }
+
+   private:
+    WorkerThreadEventBuffer* buffer_;
+    DISALLOW_COPY_AND_ASSIGN(AutoClaim);
+  };
+
+  // The buffer must be claimed, and the event written to before the claim is
+  // released.
+  TraceEvent* AddTraceEvent(TraceEventHandle* handle);
+
+  TraceEvent* GetEventByHandle(TraceEventHandle handle) {
+    if (!chunk_ || handle.chunk_seq != chunk_->seq() ||
+        handle.chunk_index != chunk_index_)
+      return NULL;
+
+    return chunk_->GetEventAt(handle.event_index);
+  }
+
+  // Returns the chunk to the main buffer. Must be called without the lock of
+  // the TraceLog.
+  void Flush();
+
+ private:
+  void Claim() {
+    while (subtle::Acquire_CompareAndSwap(&claimed_, 0, 1) != 0)
+      PlatformThread::YieldCurrentThread();
+  }
+  void Unclaim() { subtle::Release_Store(&claimed_, 0); }
+
+  void ReturnChunkWhileLocked();
+
+  // Since TraceLog is a leaky singleton, trace_log_ will always be valid.
+  TraceLog* trace_log_;
+  subtle::Atomic32 claimed_;
+  scoped_ptr<TraceBufferChunk> chunk_;
+  size_t chunk_index_;
+  int generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerThreadEventBuffer);
+};
+
+TraceEvent* TraceLog::WorkerThreadEventBuffer::AddTraceEvent(
+    TraceEventHandle* handle) {
+  if (chunk_ &&
+      (chunk_->IsFull() || !trace_log_->CheckGeneration(generation_))) {
+    AutoLock lock(trace_log_->lock_);
+    ReturnChunkWhileLocked();
+  }
+  if (!chunk_) {
+    AutoLock lock(trace_log_->lock_);
+    chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
+    generation_ = trace_log_->generation();
+    trace_log_->CheckIfBufferIsFullWhileLocked();
+  }
+  if (!chunk_)
+    return NULL;
+
+  size_t event_index;
+  TraceEvent* trace_event = chunk_->AddTraceEvent(&event_index);
+  if (trace_event && handle)
+    MakeHandle(chunk_->seq(), chunk_index_, event_index, handle);
+
+  return trace_event;
+}
+
+void TraceLog::WorkerThreadEventBuffer::Flush() {
+  AutoClaim claim(this);
+  if (!chunk_)
+    return;
+
+  AutoLock lock(trace_log_->lock_);
+  ReturnChunkWhileLocked();
+}
+
+void TraceLog::WorkerThreadEventBuffer::ReturnChunkWhileLocked() {
+  trace_log_->lock_.AssertAcquired();
+  // The chunk of an earlier buffer is dropped.
+  if (trace_log_->CheckGeneration(generation_))
+    trace_log_->logged_events_->ReturnChunk(chunk_index_, chunk_.Pass());
+  chunk_.reset();
+}
+
 TraceLogStatus::TraceLogStatus() : event_capacity(0), event_count(0) {}
 
 TraceLogStatus::~TraceLogStatus() {}
@@ -356,9 +464,11 @@ TraceLog::TraceLog()
       sampling_thread_handle_(0),
       trace_config_(TraceConfig()),
       event_callback_trace_config_(TraceConfig()),
+      worker_event_buffer_slot_(&TraceLog::OnWorkerThreadExit),
       thread_shared_chunk_index_(0),
       generation_(0),
-      use_worker_thread_(false) {
+      use_worker_thread_(false),
+      flush_as_binary_(false) {
   // Trace is enabled or disabled on one thread while other threads are
   // accessing the enabled flag. We don't care whether edge-case events are
   // traced or not, so we allow races on the enabled flag to keep the trace
@@ -406,10 +516,13 @@ void TraceLog::InitializeThreadLocalEventBufferIfSupported() {
   // A ThreadLocalEventBuffer needs the message loop
   // - to know when the thread exits;
   // - to handle the final flush.
-  // For a thread without a message loop or the message loop may be blocked, the
-  // trace events will be added into the main buffer directly.
-  if (thread_blocks_message_loop_.Get() || !MessageLoop::current())
+  // A thread without a message loop or whose message loop may be blocked gets
+  // a WorkerThreadEventBuffer instead.
+  if (thread_blocks_message_loop_.Get() || !MessageLoop::current()) {
+    if (!current_worker_event_buffer())
+      worker_event_buffer_slot_.Set(AcquireWorkerThreadEventBuffer());
     return;
+  }
   auto thread_local_event_buffer = thread_local_event_buffer_.Get();
   if (thread_local_event_buffer &&
       !CheckGeneration(thread_local_event_buffer->generation())) {
@@ -422,6 +535,48 @@ void TraceLog::InitializeThreadLocalEventBufferIfSupported() {
   }
 }
 
+TraceLog::WorkerThreadEventBuffer* TraceLog::AcquireWorkerThreadEventBuffer() {
+  AutoLock lock(lock_);
+  if (free_worker_event_buffers_.empty()) {
+    worker_event_buffers_.push_back(new WorkerThreadEventBuffer(this));
+    return worker_event_buffers_.back();
+  }
+  WorkerThreadEventBuffer* buffer = free_worker_event_buffers_.back();
+  free_worker_event_buffers_.pop_back();
+  return buffer;
+}
+
+void TraceLog::ReleaseWorkerThreadEventBuffer(
+    WorkerThreadEventBuffer* buffer) {
+  buffer->Flush();
+
+  AutoLock lock(lock_);
+  free_worker_event_buffers_.push_back(buffer);
+}
+
+// static
+void TraceLog::OnWorkerThreadExit(void* buffer) {
+  GetInstance()->ReleaseWorkerThreadEventBuffer(
+      static_cast<WorkerThreadEventBuffer*>(buffer));
+}
+
+void TraceLog::FlushWorkerThreadEventBuffers() {
+  // Buffers are never deleted, so they can be flushed without the lock.
+  std::vector<WorkerThreadEventBuffer*> buffers;
+  {
+    AutoLock lock(lock_);
+    buffers.assign(worker_event_buffers_.begin(), worker_event_buffers_.end());
+  }
+  for (WorkerThreadEventBuffer* buffer : buffers) {
+    // This thread may hold the claim on its own buffer if it flushes from
+    // within a trace event, e.g. from an observer of the buffer getting full.
+    if (buffer == current_worker_event_buffer() &&
+        thread_is_in_trace_event_.Get())
+      continue;
+    buffer->Flush();
+  }
+}
+
 bool TraceLog::OnMemoryDump(const MemoryDumpArgs& args,
                             ProcessMemoryDump* pmd) {
   // TODO(ssid): Use MemoryDumpArgs to create light dumps when requested
@@ -844,27 +999,36 @@ void TraceLog::SetEventCallbackDisabled() {
 // Flush() works as the following:
 // 1. Flush() is called in thread A whose task runner is saved in
 //    flush_task_runner_;
-// 2. If thread_message_loops_ is not empty, thread A posts task to each message
+// 2. Thread A returns the chunks of the WorkerThreadEventBuffers, which belong
+//    to threads that can't run a task, to the main buffer;
+// 3. If thread_message_loops_ is not empty, thread A posts task to each message
 //    loop to flush the thread local buffers; otherwise finish the flush;
-// 3. FlushCurrentThread() deletes the thread local event buffer:
+// 4. FlushCurrentThread() deletes the thread local event buffer:
 //    - The last batch of events of the thread are flushed into the main buffer;
 //    - The message loop will be removed from thread_message_loops_;
 //    If this is the last message loop, finish the flush;
-// 4. If any thread hasn't finish its flush in time, finish the flush.
+// 5. If any thread hasn't finish its flush in time, finish the flush.
 void TraceLog::Flush(const TraceLog::OutputCallback& cb,
                      bool use_worker_thread) {
-  FlushInternal(cb, use_worker_thread, false);
+  FlushInternal(cb, use_worker_thread, false, false);
+}
+
+void TraceLog::FlushAsBinary(const TraceLog::OutputCallback& cb,
+                             bool use_worker_thread) {
+  FlushInternal(cb, use_worker_thread, true, false);
 }
 
 void TraceLog::CancelTracing(const OutputCallback& cb) {
   SetDisabled();
-  FlushInternal(cb, false, true);
+  FlushInternal(cb, false, false, true);
 }
 
 void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
                              bool use_worker_thread,
+                             bool as_binary,
                              bool discard_events) {
   use_worker_thread_ = use_worker_thread;
+  flush_as_binary_ = as_binary;
   if (IsEnabled()) {
     // Can't flush when tracing is enabled because otherwise PostTask would
     // - generate more trace events;
@@ -877,6 +1041,8 @@ void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
     return;
   }
 
+  FlushWorkerThreadEventBuffers();
+
   int generation = this->generation();
   // Copy of thread_message_loops_ to be used without locking.
   std::vector<scoped_refptr<SingleThreadTaskRunner>>
@@ -947,6 +1113,33 @@ void TraceLog::ConvertTraceEventsToTraceFormat(
   flush_output_callback.Run(json_events_str_ptr, false);
 }
 
+// Usually it runs on a different thread.
+void TraceLog::ConvertTraceEventsToBinaryFormat(
+    scoped_ptr<TraceBuffer> logged_events,
+    const OutputCallback& flush_output_callback,
+    const ArgumentFilterPredicate& argument_filter_predicate) {
+  if (flush_output_callback.is_null())
+    return;
+
+  BinaryTraceWriter writer(TraceLog::GetInstance()->process_id());
+  while (const TraceBufferChunk* chunk = logged_events->NextChunk()) {
+    for (size_t j = 0; j < chunk->size(); ++j) {
+      if (writer.size() > kTraceEventBufferSizeInBytes) {
+        scoped_refptr<RefCountedString> binary_events_str_ptr =
+            new RefCountedString();
+        writer.TakeData(&binary_events_str_ptr->data());
+        flush_output_callback.Run(binary_events_str_ptr, true);
+      }
+      writer.AppendEvent(*chunk->GetEventAt(j), argument_filter_predicate);
+    }
+  }
+  // As for JSON, the callback is called at least once.
+  scoped_refptr<RefCountedString> binary_events_str_ptr =
+      new RefCountedString();
+  writer.TakeData(&binary_events_str_ptr->data());
+  flush_output_callback.Run(binary_events_str_ptr, false);
+}
+
 void TraceLog::FinishFlush(int generation, bool discard_events) {
   scoped_ptr<TraceBuffer> previous_logged_events;
   OutputCallback flush_output_callback;
@@ -980,18 +1173,20 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
     return;
   }
 
+  auto convert_trace_events = flush_as_binary_
+                                  ? &TraceLog::ConvertTraceEventsToBinaryFormat
+                                  : &TraceLog::ConvertTraceEventsToTraceFormat;
   if (use_worker_thread_ &&
       WorkerPool::PostTask(
-          FROM_HERE, Bind(&TraceLog::ConvertTraceEventsToTraceFormat,
+          FROM_HERE, Bind(convert_trace_events,
                           Passed(&previous_logged_events),
                           flush_output_callback, argument_filter_predicate),
           true)) {
     return;
   }
 
-  ConvertTraceEventsToTraceFormat(previous_logged_events.Pass(),
-                                  flush_output_callback,
-                                  argument_filter_predicate);
+  convert_trace_events(previous_logged_events.Pass(), flush_output_callback,
+                       argument_filter_predicate);
 }
 
 // Run in each thread holding a local event buffer.
@@ -1043,6 +1238,7 @@ void TraceLog::FlushButLeaveBufferIntact(
     const TraceLog::OutputCallback& flush_output_callback) {
   scoped_ptr<TraceBuffer> previous_logged_events;
   ArgumentFilterPredicate argument_filter_predicate;
+  FlushWorkerThreadEventBuffers();
   {
     AutoLock lock(lock_);
     AddMetadataEventsWhileLocked();
@@ -1236,9 +1432,12 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
   ThreadTicks thread_now = ThreadNow();
 
   // |thread_local_event_buffer_| can be null if the current thread doesn't have
-  // a message loop or the message loop is blocked.
+  // a message loop or the message loop is blocked, in which case it has a
+  // WorkerThreadEventBuffer.
   InitializeThreadLocalEventBufferIfSupported();
   auto thread_local_event_buffer = thread_local_event_buffer_.Get();
+  auto worker_event_buffer =
+      thread_local_event_buffer ? NULL : current_worker_event_buffer();
 
   // Check and update the current thread name only if the event is for the
   // current thread to avoid locks in most cases.
@@ -1290,10 +1489,13 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
   if (*category_group_enabled &
       (ENABLED_FOR_RECORDING | ENABLED_FOR_MONITORING)) {
     OptionalAutoLock lock(&lock_);
+    WorkerThreadEventBuffer::AutoClaim claim(worker_event_buffer);
 
     TraceEvent* trace_event = NULL;
     if (thread_local_event_buffer) {
       trace_event = thread_local_event_buffer->AddTraceEvent(&handle);
+    } else if (worker_event_buffer) {
+      trace_event = worker_event_buffer->AddTraceEvent(&handle);
     } else {
       lock.EnsureAcquired();
       trace_event = AddEventToThreadSharedChunkWhileLocked(&handle, true);
@@ -1467,6 +1669,7 @@ void TraceLog::UpdateTraceEventDuration(
   std::string console_message;
   if (category_group_enabled_local & ENABLED_FOR_RECORDING) {
     OptionalAutoLock lock(&lock_);
+    WorkerThreadEventBuffer::AutoClaim claim(current_worker_event_buffer());
 
     TraceEvent* trace_event = GetEventByHandleInternal(handle, &lock);
     if (trace_event) {
@@ -1618,6 +1821,15 @@ TraceEvent* TraceLog::GetEventByHandleInternal(TraceEventHandle handle,
       return trace_event;
   }
 
+  // The caller holds the claim on the buffer if it is going to write to the
+  // event.
+  if (current_worker_event_buffer()) {
+    TraceEvent* trace_event =
+        current_worker_event_buffer()->GetEventByHandle(handle);
+    if (trace_event)
+      return trace_event;
+  }
+
   // The event has been out-of-control of the thread local buffer.
   // Try to get the event from the main buffer with a lock.
   if (lock)
@@ -1730,6 +1942,13 @@ void TraceLog::UpdateETWCategoryGroupEnabledFlags() {
 }
 #endif  // defined(OS_WIN)
 
+void ConvertableToTraceFormat::AppendAsBinary(
+    BinaryTraceWriter* writer) const {
+  std::string json;
+  AppendAsTraceFormat(&json);
+  writer->WriteJSON(json);
+}
+
 void ConvertableToTraceFormat::EstimateTraceMemoryOverhead(
     TraceEventMemoryOverhead* overhead) {
   overhead->Add("ConvertableToTraceFormat(Unknown)", sizeof(*this));
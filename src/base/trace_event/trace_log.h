@@ -13,6 +13,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/trace_event/memory_dump_provider.h"
 #include "base/trace_event/trace_config.h"
 #include "base/trace_event/trace_event_impl.h"
@@ -166,6 +167,11 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   void Flush(const OutputCallback& cb, bool use_worker_thread = false);
   void FlushButLeaveBufferIntact(const OutputCallback& flush_output_callback);
 
+  // Like Flush(), but the strings are pieces of a trace in the binary format
+  // of trace_event_binary_format.h, to be concatenated. It is much smaller,
+  // and cheaper to produce, than JSON.
+  void FlushAsBinary(const OutputCallback& cb, bool use_worker_thread = false);
+
   // Cancels tracing and discards collected data.
   void CancelTracing(const OutputCallback& cb);
 
@@ -358,6 +364,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
       const TraceConfig& config);
 
   class ThreadLocalEventBuffer;
+  class WorkerThreadEventBuffer;
   class OptionalAutoLock;
 
   TraceLog();
@@ -379,6 +386,19 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
 
   TraceEvent* AddEventToThreadSharedChunkWhileLocked(TraceEventHandle* handle,
                                                      bool check_buffer_is_full);
+
+  // Returns the WorkerThreadEventBuffer of the current thread, or NULL.
+  WorkerThreadEventBuffer* current_worker_event_buffer() const {
+    return static_cast<WorkerThreadEventBuffer*>(
+        worker_event_buffer_slot_.Get());
+  }
+  WorkerThreadEventBuffer* AcquireWorkerThreadEventBuffer();
+  void ReleaseWorkerThreadEventBuffer(WorkerThreadEventBuffer* buffer);
+  static void OnWorkerThreadExit(void* buffer);
+
+  // Returns the chunks of all the WorkerThreadEventBuffers to the main
+  // buffer. Must be called without |lock_|.
+  void FlushWorkerThreadEventBuffers();
   void CheckIfBufferIsFullWhileLocked();
   void SetDisabledWhileLocked();
 
@@ -387,6 +407,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
 
   void FlushInternal(const OutputCallback& cb,
                      bool use_worker_thread,
+                     bool as_binary,
                      bool discard_events);
 
   // |generation| is used in the following callbacks to check if the callback
@@ -397,6 +418,10 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
       scoped_ptr<TraceBuffer> logged_events,
       const TraceLog::OutputCallback& flush_output_callback,
       const ArgumentFilterPredicate& argument_filter_predicate);
+  static void ConvertTraceEventsToBinaryFormat(
+      scoped_ptr<TraceBuffer> logged_events,
+      const TraceLog::OutputCallback& flush_output_callback,
+      const ArgumentFilterPredicate& argument_filter_predicate);
   void FinishFlush(int generation, bool discard_events);
   void OnFlushTimeout(int generation, bool discard_events);
 
@@ -474,13 +499,23 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   ThreadLocalBoolean thread_blocks_message_loop_;
   ThreadLocalBoolean thread_is_in_trace_event_;
 
+  // The WorkerThreadEventBuffer of threads without a message loop, or whose
+  // message loop may be blocked.
+  ThreadLocalStorage::Slot worker_event_buffer_slot_;
+
+  // All the WorkerThreadEventBuffers, and those of them that no thread has.
+  // They are handed to new threads rather than deleted, so that they can be
+  // flushed without knowing whether their thread still runs.
+  ScopedVector<WorkerThreadEventBuffer> worker_event_buffers_;
+  std::vector<WorkerThreadEventBuffer*> free_worker_event_buffers_;
+
   // Contains the message loops of threads that have had at least one event
   // added into the local event buffer. Not using SingleThreadTaskRunner
   // because we need to know the life time of the message loops.
   hash_set<MessageLoop*> thread_message_loops_;
 
-  // For events which can't be added into the thread local buffer, e.g. events
-  // from threads without a message loop.
+  // For events which can't be added into a thread local buffer, e.g. events
+  // added while a thread is exiting.
   scoped_ptr<TraceBufferChunk> thread_shared_chunk_;
   size_t thread_shared_chunk_index_;
 
@@ -490,6 +525,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   ArgumentFilterPredicate argument_filter_predicate_;
   subtle::AtomicWord generation_;
   bool use_worker_thread_;
+  bool flush_as_binary_;
 
   DISALLOW_COPY_AND_ASSIGN(TraceLog);
 };
@@ -13,6 +13,7 @@
 #include "base/containers/linked_list.h"
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/histogram_macros.h"
+#include "base/pickle.h"
 #include "base/profiler/scoped_tracker.h"
 #include "base/sha1.h"
 #include "base/stl_util.h"
@@ -81,6 +82,75 @@ const unsigned kMaxCacheEntries = 256;
 // The number of seconds to cache entries.
 const unsigned kTTLSecs = 1800;  // 30 minutes.
 
+// Version of the format written by PersistCache(). Caches written in another
+// format are not restored.
+const int kCachePickleVersion = 1;
+
+// Outcome of looking a request up, before verifying it. These values are
+// used in UMA, do not reorder or remove them.
+enum CacheLookupResult {
+  CACHE_LOOKUP_HIT,
+  CACHE_LOOKUP_INFLIGHT_JOIN,
+  CACHE_LOOKUP_MISS,
+  CACHE_LOOKUP_RESULT_MAX
+};
+
+void RecordCacheLookupResult(CacheLookupResult result) {
+  UMA_HISTOGRAM_ENUMERATION("Net.CertVerifier.CacheLookupResult", result,
+                            CACHE_LOOKUP_RESULT_MAX);
+}
+
+void PersistCertVerifyResult(const CertVerifyResult& result,
+                             base::Pickle* pickle) {
+  pickle->WriteBool(result.verified_cert.get() != NULL);
+  if (result.verified_cert.get())
+    result.verified_cert->Persist(pickle);
+  pickle->WriteUInt32(result.cert_status);
+  pickle->WriteBool(result.has_md2);
+  pickle->WriteBool(result.has_md4);
+  pickle->WriteBool(result.has_md5);
+  pickle->WriteBool(result.has_sha1);
+  pickle->WriteBool(result.has_sha1_leaf);
+  pickle->WriteSizeT(result.public_key_hashes.size());
+  for (const HashValue& hash : result.public_key_hashes)
+    pickle->WriteString(hash.ToString());
+  pickle->WriteBool(result.is_issued_by_known_root);
+  pickle->WriteBool(result.is_issued_by_additional_trust_anchor);
+  pickle->WriteBool(result.common_name_fallback_used);
+}
+
+bool ReadCertVerifyResult(base::PickleIterator* iter,
+                          CertVerifyResult* result) {
+  bool has_verified_cert;
+  if (!iter->ReadBool(&has_verified_cert))
+    return false;
+  if (has_verified_cert) {
+    result->verified_cert = X509Certificate::CreateFromPickle(
+        iter, X509Certificate::PICKLETYPE_CERTIFICATE_CHAIN_V3);
+    if (!result->verified_cert.get())
+      return false;
+  }
+  size_t num_public_key_hashes;
+  if (!iter->ReadUInt32(&result->cert_status) ||
+      !iter->ReadBool(&result->has_md2) || !iter->ReadBool(&result->has_md4) ||
+      !iter->ReadBool(&result->has_md5) ||
+      !iter->ReadBool(&result->has_sha1) ||
+      !iter->ReadBool(&result->has_sha1_leaf) ||
+      !iter->ReadSizeT(&num_public_key_hashes)) {
+    return false;
+  }
+  for (size_t i = 0; i < num_public_key_hashes; ++i) {
+    std::string hash_string;
+    HashValue hash;
+    if (!iter->ReadString(&hash_string) || !hash.FromString(hash_string))
+      return false;
+    result->public_key_hashes.push_back(hash);
+  }
+  return iter->ReadBool(&result->is_issued_by_known_root) &&
+         iter->ReadBool(&result->is_issued_by_additional_trust_anchor) &&
+         iter->ReadBool(&result->common_name_fallback_used);
+}
+
 scoped_ptr<base::Value> CertVerifyResultCallback(
     const CertVerifyResult& verify_result,
     NetLogCaptureMode capture_mode) {
@@ -113,7 +183,8 @@ scoped_ptr<base::Value> CertVerifyResultCallback(
 
 }  // namespace
 
-MultiThreadedCertVerifier::CachedResult::CachedResult() : error(ERR_FAILED) {}
+MultiThreadedCertVerifier::CachedResult::CachedResult()
+    : error(ERR_FAILED), crl_set_sequence(0) {}
 
 MultiThreadedCertVerifier::CachedResult::~CachedResult() {}
 
@@ -389,6 +460,7 @@ class CertVerifierJob {
 MultiThreadedCertVerifier::MultiThreadedCertVerifier(
     CertVerifyProc* verify_proc)
     : cache_(kMaxCacheEntries),
+      restored_cache_(kMaxCacheEntries),
       requests_(0),
       cache_hits_(0),
       inflight_joins_(0),
@@ -432,11 +504,25 @@ int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
           trust_anchor_provider_->GetAdditionalTrustAnchors() : empty_cert_list;
 
   const RequestParams key(cert->fingerprint(), cert->ca_fingerprint(), hostname,
-                          ocsp_response, flags, additional_trust_anchors);
-  const CertVerifierCache::value_type* cached_entry =
-      cache_.Get(key, CacheValidityPeriod(base::Time::Now()));
+                          ocsp_response, flags,
+                          crl_set ? crl_set->sequence() : 0,
+                          additional_trust_anchors);
+  const CacheValidityPeriod now(base::Time::Now());
+  const CertVerifierCache::value_type* cached_entry = cache_.Get(key, now);
+  if (!cached_entry && !restored_cache_.empty()) {
+    RequestParams restored_key(key);
+    restored_key.crl_set_sequence = 0;
+    const CertVerifierCache::value_type* restored_entry =
+        restored_cache_.Get(restored_key, now);
+    // Once a newer CRLSet is loaded, the certificate is verified again.
+    if (restored_entry &&
+        restored_entry->crl_set_sequence >= key.crl_set_sequence) {
+      cached_entry = restored_entry;
+    }
+  }
   if (cached_entry) {
     ++cache_hits_;
+    RecordCacheLookupResult(CACHE_LOOKUP_HIT);
     *verify_result = cached_entry->result;
     return cached_entry->error;
   }
@@ -447,7 +533,9 @@ int MultiThreadedCertVerifier::Verify(X509Certificate* cert,
     // An identical request is in flight already. We'll just attach our
     // callback.
     inflight_joins_++;
+    RecordCacheLookupResult(CACHE_LOOKUP_INFLIGHT_JOIN);
   } else {
+    RecordCacheLookupResult(CACHE_LOOKUP_MISS);
     // Need to make a new job.
     scoped_ptr<CertVerifierJob> new_job(
         new CertVerifierJob(key, net_log.net_log(), cert, this));
@@ -476,14 +564,83 @@ bool MultiThreadedCertVerifier::SupportsOCSPStapling() {
   return verify_proc_->SupportsOCSPStapling();
 }
 
+void MultiThreadedCertVerifier::PersistCache(base::Pickle* pickle) const {
+  DCHECK(CalledOnValidThread());
+
+  const CacheValidityPeriod now(base::Time::Now());
+  pickle->WriteInt(kCachePickleVersion);
+  pickle->WriteSizeT(CountValidEntries(cache_, now) +
+                     CountValidEntries(restored_cache_, now));
+  PersistEntries(cache_, false, now, pickle);
+  PersistEntries(restored_cache_, true, now, pickle);
+}
+
+bool MultiThreadedCertVerifier::RestoreCache(const base::Pickle& pickle) {
+  DCHECK(CalledOnValidThread());
+
+  base::PickleIterator iter(pickle);
+  int version;
+  size_t num_entries;
+  if (!iter.ReadInt(&version) || version != kCachePickleVersion ||
+      !iter.ReadSizeT(&num_entries)) {
+    return false;
+  }
+
+  const CacheValidityPeriod now(base::Time::Now());
+  for (size_t i = 0; i < num_entries; ++i) {
+    std::string hostname;
+    int flags;
+    uint32_t crl_set_sequence;
+    size_t num_hash_values;
+    if (!iter.ReadString(&hostname) || !iter.ReadInt(&flags) ||
+        !iter.ReadUInt32(&crl_set_sequence) ||
+        !iter.ReadSizeT(&num_hash_values) ||
+        num_hash_values > pickle.payload_size() / sizeof(SHA1HashValue)) {
+      return false;
+    }
+    std::vector<SHA1HashValue> hash_values(num_hash_values);
+    for (SHA1HashValue& hash : hash_values) {
+      const char* data;
+      if (!iter.ReadBytes(&data, sizeof(hash.data)))
+        return false;
+      memcpy(hash.data, data, sizeof(hash.data));
+    }
+    int64_t verification_time;
+    int64_t expiration_time;
+    CachedResult result;
+    if (!iter.ReadInt64(&verification_time) ||
+        !iter.ReadInt64(&expiration_time) || !iter.ReadInt(&result.error) ||
+        !ReadCertVerifyResult(&iter, &result.result)) {
+      return false;
+    }
+
+    // Entries that are no longer valid at this point, for instance because
+    // the clock has been moved backwards since, are dropped.
+    const CacheValidityPeriod validity(
+        base::Time::FromInternalValue(verification_time),
+        base::Time::FromInternalValue(expiration_time));
+    if (!CacheExpirationFunctor()(now, validity))
+      continue;
+    result.crl_set_sequence = crl_set_sequence;
+    const RequestParams key(hostname, flags, 0, hash_values,
+                            validity.verification_time);
+    restored_cache_.Put(key, result, now, validity);
+  }
+  return true;
+}
+
 MultiThreadedCertVerifier::RequestParams::RequestParams(
     const SHA1HashValue& cert_fingerprint_arg,
     const SHA1HashValue& ca_fingerprint_arg,
     const std::string& hostname_arg,
     const std::string& ocsp_response_arg,
     int flags_arg,
+    uint32_t crl_set_sequence_arg,
     const CertificateList& additional_trust_anchors)
-    : hostname(hostname_arg), flags(flags_arg), start_time(base::Time::Now()) {
+    : hostname(hostname_arg),
+      flags(flags_arg),
+      crl_set_sequence(crl_set_sequence_arg),
+      start_time(base::Time::Now()) {
   hash_values.reserve(3 + additional_trust_anchors.size());
   SHA1HashValue ocsp_hash;
   base::SHA1HashBytes(
@@ -496,6 +653,18 @@ MultiThreadedCertVerifier::RequestParams::RequestParams(
     hash_values.push_back(additional_trust_anchors[i]->fingerprint());
 }
 
+MultiThreadedCertVerifier::RequestParams::RequestParams(
+    const std::string& hostname_arg,
+    int flags_arg,
+    uint32_t crl_set_sequence_arg,
+    const std::vector<SHA1HashValue>& hash_values_arg,
+    const base::Time& start_time_arg)
+    : hostname(hostname_arg),
+      flags(flags_arg),
+      crl_set_sequence(crl_set_sequence_arg),
+      hash_values(hash_values_arg),
+      start_time(start_time_arg) {}
+
 MultiThreadedCertVerifier::RequestParams::~RequestParams() {}
 
 bool MultiThreadedCertVerifier::RequestParams::operator<(
@@ -505,6 +674,8 @@ bool MultiThreadedCertVerifier::RequestParams::operator<(
   // are faster than memory and string comparisons.
   if (flags != other.flags)
     return flags < other.flags;
+  if (crl_set_sequence != other.crl_set_sequence)
+    return crl_set_sequence < other.crl_set_sequence;
   if (hostname != other.hostname)
     return hostname < other.hostname;
   return std::lexicographical_compare(
@@ -518,6 +689,42 @@ bool MultiThreadedCertVerifier::JobComparator::operator()(
   return job1->key() < job2->key();
 }
 
+// static
+size_t MultiThreadedCertVerifier::CountValidEntries(
+    const CertVerifierCache& cache,
+    const CacheValidityPeriod& now) {
+  size_t num_entries = 0;
+  for (CertVerifierCache::Iterator it(cache); it.HasNext(); it.Advance()) {
+    if (CacheExpirationFunctor()(now, it.expiration()))
+      ++num_entries;
+  }
+  return num_entries;
+}
+
+// static
+void MultiThreadedCertVerifier::PersistEntries(const CertVerifierCache& cache,
+                                               bool restored,
+                                               const CacheValidityPeriod& now,
+                                               base::Pickle* pickle) {
+  for (CertVerifierCache::Iterator entry(cache); entry.HasNext();
+       entry.Advance()) {
+    if (!CacheExpirationFunctor()(now, entry.expiration()))
+      continue;
+    const RequestParams& key = entry.key();
+    pickle->WriteString(key.hostname);
+    pickle->WriteInt(key.flags);
+    pickle->WriteUInt32(restored ? entry.value().crl_set_sequence
+                                 : key.crl_set_sequence);
+    pickle->WriteSizeT(key.hash_values.size());
+    for (const SHA1HashValue& hash : key.hash_values)
+      pickle->WriteBytes(hash.data, sizeof(hash.data));
+    pickle->WriteInt64(entry.expiration().verification_time.ToInternalValue());
+    pickle->WriteInt64(entry.expiration().expiration_time.ToInternalValue());
+    pickle->WriteInt(entry.value().error);
+    PersistCertVerifyResult(entry.value().result, pickle);
+  }
+}
+
 void MultiThreadedCertVerifier::SaveResultToCache(const RequestParams& key,
                                                   const CachedResult& result) {
   DCHECK(CalledOnValidThread());
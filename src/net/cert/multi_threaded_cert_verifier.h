@@ -23,6 +23,10 @@
 #include "net/cert/cert_verify_result.h"
 #include "net/cert/x509_cert_types.h"
 
+namespace base {
+class Pickle;
+}
+
 namespace net {
 
 class CertTrustAnchorProvider;
@@ -67,6 +71,18 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
 
   bool SupportsOCSPStapling() override;
 
+  // Serializes the unexpired entries of the verification cache into
+  // |pickle|, so that a later instance, such as the one of the next run, can
+  // start with them. Entries are restored with the validity period they were
+  // given when verified, so a restored result is never older than one kept
+  // in memory all along.
+  void PersistCache(base::Pickle* pickle) const;
+
+  // Adds the entries serialized by PersistCache() into |pickle| to the
+  // cache. Returns false if |pickle| can't be read, in which case some
+  // entries may have been added.
+  bool RestoreCache(const base::Pickle& pickle);
+
  private:
   struct JobToRequestParamsComparator;
   friend class CertVerifierRequest;
@@ -89,13 +105,23 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
                   const std::string& hostname_arg,
                   const std::string& ocsp_response_arg,
                   int flags_arg,
+                  uint32_t crl_set_sequence_arg,
                   const CertificateList& additional_trust_anchors);
+    // Used for the entries restored by RestoreCache().
+    RequestParams(const std::string& hostname_arg,
+                  int flags_arg,
+                  uint32_t crl_set_sequence_arg,
+                  const std::vector<SHA1HashValue>& hash_values_arg,
+                  const base::Time& start_time_arg);
     ~RequestParams();
 
     bool operator<(const RequestParams& other) const;
 
     std::string hostname;
     int flags;
+    // Sequence number of the CRLSet the verification is done with, or 0 if
+    // there is none.
+    uint32_t crl_set_sequence;
     std::vector<SHA1HashValue> hash_values;
     // The time when verification started.
     // Note: This uses base::Time, rather than base::TimeTicks, to
@@ -110,6 +136,9 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
 
     int error;  // The return value of CertVerifier::Verify.
     CertVerifyResult result;  // The output of CertVerifier::Verify.
+    // Sequence number of the CRLSet the result was verified with. Only set
+    // for the entries of |restored_cache_|, whose keys don't carry it.
+    uint32_t crl_set_sequence;
   };
 
   // Rather than having a single validity point along a monotonically increasing
@@ -144,6 +173,17 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   typedef ExpiringCache<RequestParams, CachedResult, CacheValidityPeriod,
                         CacheExpirationFunctor> CertVerifierCache;
 
+  // Returns the number of entries of |cache| that are valid at |now|.
+  static size_t CountValidEntries(const CertVerifierCache& cache,
+                                  const CacheValidityPeriod& now);
+
+  // Serializes the entries of |cache| that are valid at |now| into |pickle|.
+  // |restored| is true if |cache| is |restored_cache_|.
+  static void PersistEntries(const CertVerifierCache& cache,
+                             bool restored,
+                             const CacheValidityPeriod& now,
+                             base::Pickle* pickle);
+
   // Saves |result| into the cache, keyed by |key|.
   void SaveResultToCache(const RequestParams& key, const CachedResult& result);
 
@@ -159,7 +199,10 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   scoped_ptr<CertVerifierJob> RemoveJob(CertVerifierJob* job);
 
   // For unit testing.
-  void ClearCache() { cache_.Clear(); }
+  void ClearCache() {
+    cache_.Clear();
+    restored_cache_.Clear();
+  }
   size_t GetCacheSize() const { return cache_.size(); }
   uint64_t cache_hits() const { return cache_hits_; }
   uint64_t requests() const { return requests_; }
@@ -168,6 +211,12 @@ class NET_EXPORT_PRIVATE MultiThreadedCertVerifier
   // cache_ maps from a request to a cached result.
   CertVerifierCache cache_;
 
+  // restored_cache_ holds the entries added by RestoreCache(), keyed with a
+  // |crl_set_sequence| of 0. The CRLSet is usually not loaded yet when they
+  // are restored, so they match a request whatever its CRLSet, as long as it
+  // is not newer than the one they were verified with.
+  CertVerifierCache restored_cache_;
+
   // inflight_ holds the jobs for which an active verification is taking place.
   JobSet inflight_;
 
@@ -376,6 +376,13 @@ CookieMonster::CookieMonster(PersistentCookieStore* store,
   SetDefaultCookieableSchemes();
 }
 
+CookieMonster::CachedCookieLine::CachedCookieLine()
+    : valid(false), path_sensitive(false) {
+}
+
+CookieMonster::CachedCookieLine::~CachedCookieLine() {
+}
+
 // Task classes for queueing the coming request.
 
 class CookieMonster::CookieMonsterTask
@@ -1353,11 +1360,25 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
   if (!HasCookieableScheme(url))
     return std::string();
 
+  // Most requests for a host are sent the same cookies as the previous one,
+  // so the line is served from |cookie_line_cache_| when it can be.
+  const Time current_time(CurrentTime());
+  const std::string key(GetKey(url.host()));
+  const int line_flags = GetCookieLineFlags(url, options);
+  const std::string* cached_line =
+      FindCachedCookieLine(key, url, line_flags, current_time);
+  if (cached_line) {
+    RecordPeriodicStats(current_time);
+    VLOG(kVlogGetCookies) << "GetCookies() cached result: " << *cached_line;
+    return *cached_line;
+  }
+
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, true, &cookies);
   std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line = BuildCookieLine(cookies);
+  CacheCookieLine(key, url, line_flags, current_time, cookie_line);
 
   VLOG(kVlogGetCookies) << "GetCookies() result: " << cookie_line;
 
@@ -1780,6 +1801,90 @@ void CookieMonster::FindCookiesForKey(const std::string& key,
   }
 }
 
+// static
+int CookieMonster::GetCookieLineFlags(const GURL& url,
+                                      const CookieOptions& options) {
+  int line_flags = 0;
+  if (url.SchemeIsCryptographic())
+    line_flags |= COOKIE_LINE_SECURE_SCHEME;
+  if (!options.exclude_httponly())
+    line_flags |= COOKIE_LINE_INCLUDE_HTTPONLY;
+  if (options.include_first_party_only() ||
+      options.first_party().IsSameOriginWith(url::Origin(url))) {
+    line_flags |= COOKIE_LINE_INCLUDE_FIRST_PARTY_ONLY;
+  }
+  return line_flags;
+}
+
+const std::string* CookieMonster::FindCachedCookieLine(
+    const std::string& key,
+    const GURL& url,
+    int line_flags,
+    const Time& current) {
+  lock_.AssertAcquired();
+
+  CookieLineCache::const_iterator key_it = cookie_line_cache_.find(key);
+  if (key_it == cookie_line_cache_.end())
+    return NULL;
+  std::map<std::string, CachedCookieLines>::const_iterator host_it =
+      key_it->second.find(url.host());
+  if (host_it == key_it->second.end())
+    return NULL;
+
+  const CachedCookieLine& cached = host_it->second.lines[line_flags];
+  if (!cached.valid || current < cached.creation_time ||
+      current >= cached.expiry_time) {
+    return NULL;
+  }
+  if (cached.path_sensitive && cached.path != url.path())
+    return NULL;
+  return &cached.line;
+}
+
+void CookieMonster::CacheCookieLine(const std::string& key,
+                                    const GURL& url,
+                                    int line_flags,
+                                    const Time& current,
+                                    const std::string& cookie_line) {
+  lock_.AssertAcquired();
+
+  // Cached lines skip the access time updates of FindCookiesForKey(), so they
+  // are not kept for longer than |last_access_threshold_|, which bounds how
+  // stale those become. They also have to go when one of the cookies that
+  // could be sent to the host expires.
+  Time expiry_time = current + last_access_threshold_;
+  bool path_sensitive = false;
+  for (CookieMapItPair its = cookies_.equal_range(key); its.first != its.second;
+       ++its.first) {
+    const CanonicalCookie* cc = its.first->second;
+    if (!cc->IsDomainMatch(url.host()))
+      continue;
+    if (cc->Path() != "/")
+      path_sensitive = true;
+    if (cc->IsPersistent() && !keep_expired_cookies_)
+      expiry_time = std::min(expiry_time, cc->ExpiryDate());
+  }
+  if (expiry_time <= current)
+    return;
+
+  if (cookie_line_cache_.size() >= kMaxCookieLineCacheKeys &&
+      cookie_line_cache_.find(key) == cookie_line_cache_.end()) {
+    cookie_line_cache_.clear();
+  }
+
+  CachedCookieLine& cached =
+      cookie_line_cache_[key][url.host()].lines[line_flags];
+  cached.valid = true;
+  cached.path_sensitive = path_sensitive;
+  if (path_sensitive)
+    cached.path = url.path();
+  else
+    cached.path.clear();
+  cached.line = cookie_line;
+  cached.creation_time = current;
+  cached.expiry_time = expiry_time;
+}
+
 bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
                                               const CanonicalCookie& ecc,
                                               bool skip_httponly,
@@ -1827,6 +1932,7 @@ CookieMonster::CookieMap::iterator CookieMonster::InternalInsertCookie(
     store_->AddCookie(*cc);
   CookieMap::iterator inserted =
       cookies_.insert(CookieMap::value_type(key, cc));
+  cookie_line_cache_.erase(key);
   if (delegate_.get()) {
     delegate_->OnCookieChanged(*cc, false,
                                CookieMonsterDelegate::CHANGE_COOKIE_EXPLICIT);
@@ -2000,6 +2106,7 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
       delegate_->OnCookieChanged(*cc, true, mapping.cause);
   }
   RunCallbacks(*cc, true);
+  cookie_line_cache_.erase(it->first);
   cookies_.erase(it);
   delete cc;
 }
@@ -451,6 +451,47 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // Record statistics every kRecordStatisticsIntervalSeconds of uptime.
   static const int kRecordStatisticsIntervalSeconds = 10 * 60;
 
+  // Once cookie lines are cached for more than this many CookieMap keys, the
+  // cache is dropped and starts over.
+  static const size_t kMaxCookieLineCacheKeys = 1000;
+
+  // The properties of a request, beyond its host and path, that decide which
+  // cookies are sent with it. GetCookiesWithOptions() caches one cookie line
+  // per host for each combination of them.
+  enum CookieLineFlags {
+    COOKIE_LINE_SECURE_SCHEME = 1 << 0,
+    COOKIE_LINE_INCLUDE_HTTPONLY = 1 << 1,
+    COOKIE_LINE_INCLUDE_FIRST_PARTY_ONLY = 1 << 2,
+    COOKIE_LINE_FLAG_COMBINATIONS = 1 << 3,
+  };
+
+  // A sorted cookie line, as returned by GetCookiesWithOptions().
+  struct CachedCookieLine {
+    CachedCookieLine();
+    ~CachedCookieLine();
+
+    bool valid;
+    // True if some cookie for the host has a path other than "/", in which
+    // case |line| is only good for requests to |path|.
+    bool path_sensitive;
+    std::string path;
+    std::string line;
+    // |line| was built at |creation_time|, and may be returned until
+    // |expiry_time|, when one of the host's cookies expires or the access
+    // times of its cookies are due for an update.
+    base::Time creation_time;
+    base::Time expiry_time;
+  };
+
+  struct CachedCookieLines {
+    CachedCookieLine lines[COOKIE_LINE_FLAG_COMBINATIONS];
+  };
+
+  // Cached cookie lines, by CookieMap key and then by host, so that all the
+  // lines a cookie may appear in are dropped together when it changes.
+  typedef std::map<std::string, std::map<std::string, CachedCookieLines>>
+      CookieLineCache;
+
   ~CookieMonster() override;
 
   // The following are synchronous calls to which the asynchronous methods
@@ -561,6 +602,26 @@ class NET_EXPORT CookieMonster : public CookieStore {
                          bool update_access_time,
                          std::vector<CanonicalCookie*>* cookies);
 
+  // Returns the CookieLineFlags that apply to a request for |url| with
+  // |options|.
+  static int GetCookieLineFlags(const GURL& url, const CookieOptions& options);
+
+  // Returns the cookie line cached for |url| and |line_flags|, or NULL if
+  // there is none that is still valid at |current|. |key| is the CookieMap key
+  // of the host of |url|.
+  const std::string* FindCachedCookieLine(const std::string& key,
+                                          const GURL& url,
+                                          int line_flags,
+                                          const base::Time& current);
+
+  // Caches |cookie_line|, built at |current| from the cookies in |cookies_|
+  // for |url| and |line_flags|.
+  void CacheCookieLine(const std::string& key,
+                       const GURL& url,
+                       int line_flags,
+                       const base::Time& current,
+                       const std::string& cookie_line);
+
   // Delete any cookies that are equivalent to |ecc| (same path, domain, etc).
   // If |skip_httponly| is true, httponly cookies will not be deleted.  The
   // return value with be true if |skip_httponly| skipped an httponly cookie.
@@ -685,6 +746,11 @@ class NET_EXPORT CookieMonster : public CookieStore {
 
   CookieMap cookies_;
 
+  // Cookie lines returned by GetCookiesWithOptions(). The entries for a
+  // CookieMap key are dropped whenever a cookie is added to or removed from
+  // |cookies_| under that key.
+  CookieLineCache cookie_line_cache_;
+
   // Indicates whether the cookie store has been initialized.
   bool initialized_;
 
@@ -10,6 +10,7 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
@@ -183,4 +184,8 @@ int CreateCacheBackend(
   return creator->Run();
 }
 
+scoped_ptr<Backend> CreateCompressedBackend(scoped_ptr<Backend> backend) {
+  return make_scoped_ptr(new CompressedBackendImpl(backend.Pass()));
+}
+
 }  // namespace disk_cache
@@ -0,0 +1,285 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/task_runner.h"
+#include "base/threading/worker_pool.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/compressed/compressed_entry_impl.h"
+
+namespace disk_cache {
+
+class CompressedBackendImpl::CompressedIterator : public Iterator {
+ public:
+  CompressedIterator(const base::WeakPtr<CompressedBackendImpl>& backend,
+                     scoped_ptr<Iterator> inner_iterator)
+      : backend_(backend),
+        inner_iterator_(inner_iterator.Pass()),
+        weak_factory_(this) {}
+
+  // Iterator interface.
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    Entry** inner_entry = new Entry*(NULL);
+    CompletionCallback inner_callback =
+        base::Bind(&CompressedIterator::OnInnerEntryReady,
+                   weak_factory_.GetWeakPtr(), base::Owned(inner_entry),
+                   next_entry, callback);
+    int rv = inner_iterator_->OpenNextEntry(inner_entry, inner_callback);
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    return WrapNextEntry(*inner_entry, next_entry, callback, rv);
+  }
+
+ private:
+  int WrapNextEntry(Entry* inner_entry,
+                    Entry** next_entry,
+                    const CompletionCallback& callback,
+                    int result) {
+    if (result != net::OK)
+      return result;
+    int rv = WrapEntry(backend_, false, inner_entry->GetKey(), inner_entry,
+                       next_entry,
+                       base::Bind(&CompressedIterator::OnEntryWrapped,
+                                  weak_factory_.GetWeakPtr(), next_entry,
+                                  callback),
+                       result);
+    // Skip corrupt entries, rather than ending the enumeration early.
+    if (rv == net::ERR_CACHE_READ_FAILURE)
+      return OpenNextEntry(next_entry, callback);
+    return rv;
+  }
+
+  void OnInnerEntryReady(Entry** inner_entry,
+                         Entry** next_entry,
+                         const CompletionCallback& callback,
+                         int result) {
+    int rv = WrapNextEntry(*inner_entry, next_entry, callback, result);
+    if (rv != net::ERR_IO_PENDING)
+      callback.Run(rv);
+  }
+
+  void OnEntryWrapped(Entry** next_entry,
+                      const CompletionCallback& callback,
+                      int result) {
+    if (result == net::ERR_CACHE_READ_FAILURE) {
+      result = OpenNextEntry(next_entry, callback);
+      if (result == net::ERR_IO_PENDING)
+        return;
+    }
+    callback.Run(result);
+  }
+
+  base::WeakPtr<CompressedBackendImpl> backend_;
+  scoped_ptr<Iterator> inner_iterator_;
+  base::WeakPtrFactory<CompressedIterator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedIterator);
+};
+
+WrappedBackendHolder::WrappedBackendHolder(scoped_ptr<Backend> backend)
+    : backend_(backend.Pass()) {
+  DCHECK(backend_);
+}
+
+WrappedBackendHolder::~WrappedBackendHolder() {
+}
+
+CompressedBackendImpl::CompressedBackendImpl(scoped_ptr<Backend> backend)
+    : backend_holder_(new WrappedBackendHolder(backend.Pass())),
+      backend_(backend_holder_->backend()),
+      worker_pool_(base::WorkerPool::GetTaskRunner(false)),
+      logical_bytes_written_(0),
+      physical_bytes_written_(0) {
+}
+
+CompressedBackendImpl::~CompressedBackendImpl() {
+  // Entries that are still writing their footer hold on to |backend_holder_|,
+  // and the wrapped backend goes away once they are done.
+}
+
+void CompressedBackendImpl::OnEntryOpened(CompressedEntryImpl* entry) {
+  active_entries_[entry->GetKey()] = entry;
+}
+
+void CompressedBackendImpl::OnEntryDoomedOrClosed(CompressedEntryImpl* entry) {
+  EntryMap::iterator it = active_entries_.find(entry->GetKey());
+  if (it != active_entries_.end() && it->second == entry)
+    active_entries_.erase(it);
+}
+
+void CompressedBackendImpl::OnChunkWritten(int logical_size,
+                                           int physical_size) {
+  logical_bytes_written_ += logical_size;
+  physical_bytes_written_ += physical_size;
+}
+
+net::CacheType CompressedBackendImpl::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32 CompressedBackendImpl::GetEntryCount() const {
+  return backend_->GetEntryCount();
+}
+
+int CompressedBackendImpl::OpenEntry(const std::string& key,
+                                     Entry** entry,
+                                     const CompletionCallback& callback) {
+  return OpenOrCreateEntry(false, key, entry, callback);
+}
+
+int CompressedBackendImpl::CreateEntry(const std::string& key,
+                                       Entry** entry,
+                                       const CompletionCallback& callback) {
+  return OpenOrCreateEntry(true, key, entry, callback);
+}
+
+int CompressedBackendImpl::DoomEntry(const std::string& key,
+                                     const CompletionCallback& callback) {
+  EntryMap::iterator it = active_entries_.find(key);
+  if (it != active_entries_.end()) {
+    it->second->OnDoomedByBackend();
+    active_entries_.erase(it);
+  }
+  return backend_->DoomEntry(key, callback);
+}
+
+int CompressedBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  for (EntryMap::iterator it = active_entries_.begin();
+       it != active_entries_.end(); ++it) {
+    it->second->OnDoomedByBackend();
+  }
+  active_entries_.clear();
+  return backend_->DoomAllEntries(callback);
+}
+
+int CompressedBackendImpl::DoomEntriesBetween(
+    base::Time initial_time,
+    base::Time end_time,
+    const CompletionCallback& callback) {
+  DropActiveEntriesBetween(initial_time, end_time);
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int CompressedBackendImpl::DoomEntriesSince(
+    base::Time initial_time,
+    const CompletionCallback& callback) {
+  DropActiveEntriesBetween(initial_time, base::Time::Max());
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+int CompressedBackendImpl::CalculateSizeOfAllEntries(
+    const CompletionCallback& callback) {
+  return backend_->CalculateSizeOfAllEntries(callback);
+}
+
+scoped_ptr<Backend::Iterator> CompressedBackendImpl::CreateIterator() {
+  return scoped_ptr<Iterator>(
+      new CompressedIterator(AsWeakPtr(), backend_->CreateIterator()));
+}
+
+void CompressedBackendImpl::GetStats(base::StringPairs* stats) {
+  backend_->GetStats(stats);
+  stats->push_back(std::make_pair("Compressed data written",
+                                  base::Int64ToString(logical_bytes_written_)));
+  stats->push_back(std::make_pair(
+      "Compressed data stored", base::Int64ToString(physical_bytes_written_)));
+}
+
+void CompressedBackendImpl::OnExternalCacheHit(const std::string& key) {
+  backend_->OnExternalCacheHit(key);
+}
+
+// static
+int CompressedBackendImpl::WrapEntry(
+    const base::WeakPtr<CompressedBackendImpl>& backend,
+    bool is_new,
+    const std::string& key,
+    Entry* inner_entry,
+    Entry** entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (result != net::OK)
+    return result;
+  if (!backend.get()) {
+    inner_entry->Close();
+    return net::ERR_ABORTED;
+  }
+
+  // Another open of the same key may have completed in the meantime.
+  EntryMap::iterator it = backend->active_entries_.find(key);
+  if (it != backend->active_entries_.end()) {
+    inner_entry->Close();
+    it->second->Reopen(entry);
+    return net::OK;
+  }
+
+  scoped_refptr<CompressedEntryImpl> compressed_entry(
+      new CompressedEntryImpl(backend, backend->backend_holder_,
+                              backend->worker_pool_, key, inner_entry));
+  return compressed_entry->Init(is_new, entry, callback);
+}
+
+// static
+void CompressedBackendImpl::OnInnerEntryReady(
+    const base::WeakPtr<CompressedBackendImpl>& backend,
+    bool is_new,
+    const std::string& key,
+    Entry** inner_entry,
+    Entry** entry,
+    const CompletionCallback& callback,
+    int result) {
+  int rv =
+      WrapEntry(backend, is_new, key, *inner_entry, entry, callback, result);
+  // The caller is gone with the backend.
+  if (rv != net::ERR_IO_PENDING && backend.get())
+    callback.Run(rv);
+}
+
+void CompressedBackendImpl::DropActiveEntriesBetween(base::Time initial_time,
+                                                     base::Time end_time) {
+  EntryMap::iterator it = active_entries_.begin();
+  while (it != active_entries_.end()) {
+    const base::Time last_used = it->second->GetLastUsed();
+    if (last_used >= initial_time && last_used < end_time) {
+      it->second->OnDoomedByBackend();
+      active_entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+int CompressedBackendImpl::OpenOrCreateEntry(
+    bool create,
+    const std::string& key,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  EntryMap::iterator it = active_entries_.find(key);
+  if (it != active_entries_.end()) {
+    if (create)
+      return net::ERR_FAILED;
+    it->second->Reopen(entry);
+    return net::OK;
+  }
+
+  Entry** inner_entry = new Entry*(NULL);
+  CompletionCallback inner_callback =
+      base::Bind(&CompressedBackendImpl::OnInnerEntryReady, AsWeakPtr(),
+                 create, key, base::Owned(inner_entry), entry, callback);
+  int rv = create ? backend_->CreateEntry(key, inner_entry, inner_callback)
+                  : backend_->OpenEntry(key, inner_entry, inner_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return WrapEntry(AsWeakPtr(), create, key, *inner_entry, entry, callback,
+                   rv);
+}
+
+}  // namespace disk_cache
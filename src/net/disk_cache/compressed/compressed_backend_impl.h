@@ -0,0 +1,137 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
+
+#include <string>
+
+#include "base/containers/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace base {
+class TaskRunner;
+}
+
+namespace disk_cache {
+
+class CompressedEntryImpl;
+
+// Owns the Backend wrapped by a CompressedBackendImpl. Entries hold a reference
+// to it, so that the wrapped backend outlives the entries that are still
+// writing their footer when the CompressedBackendImpl goes away.
+class NET_EXPORT_PRIVATE WrappedBackendHolder
+    : public base::RefCounted<WrappedBackendHolder> {
+ public:
+  explicit WrappedBackendHolder(scoped_ptr<Backend> backend);
+
+  Backend* backend() const { return backend_.get(); }
+
+ private:
+  friend class base::RefCounted<WrappedBackendHolder>;
+
+  ~WrappedBackendHolder();
+
+  scoped_ptr<Backend> backend_;
+
+  DISALLOW_COPY_AND_ASSIGN(WrappedBackendHolder);
+};
+
+// CompressedBackendImpl is a Backend that stores its entries in another
+// Backend, compressing their data stream on the way. See CompressedEntryImpl
+// for the details of the format.
+//
+// There is at most one CompressedEntryImpl open for a given key, so that
+// every caller sees the data that has yet to be written out. An entry stays
+// registered until its last chunk and footer are written, so that opening it
+// again while it is being closed reuses it.
+class NET_EXPORT_PRIVATE CompressedBackendImpl
+    : public Backend,
+      public base::SupportsWeakPtr<CompressedBackendImpl> {
+ public:
+  explicit CompressedBackendImpl(scoped_ptr<Backend> backend);
+  ~CompressedBackendImpl() override;
+
+  // Called by the entries, as they come and go and as they write data.
+  void OnEntryOpened(CompressedEntryImpl* entry);
+  void OnEntryDoomedOrClosed(CompressedEntryImpl* entry);
+  void OnChunkWritten(int logical_size, int physical_size);
+
+  // Backend interface.
+  net::CacheType GetCacheType() const override;
+  int32 GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  int CalculateSizeOfAllEntries(const CompletionCallback& callback) override;
+  scoped_ptr<Iterator> CreateIterator() override;
+  void GetStats(base::StringPairs* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+
+ private:
+  class CompressedIterator;
+
+  typedef base::hash_map<std::string, CompressedEntryImpl*> EntryMap;
+
+  // Wraps |inner_entry|, the result of opening or creating an entry in the
+  // wrapped backend, into a CompressedEntryImpl returned in |*entry|.
+  static int WrapEntry(const base::WeakPtr<CompressedBackendImpl>& backend,
+                       bool is_new,
+                       const std::string& key,
+                       Entry* inner_entry,
+                       Entry** entry,
+                       const CompletionCallback& callback,
+                       int result);
+  static void OnInnerEntryReady(
+      const base::WeakPtr<CompressedBackendImpl>& backend,
+      bool is_new,
+      const std::string& key,
+      Entry** inner_entry,
+      Entry** entry,
+      const CompletionCallback& callback,
+      int result);
+
+  // Forgets the open entries last used in [initial_time, end_time), which the
+  // wrapped backend is about to doom, as DoomEntry() does for a single key.
+  // The entries are told, so that they don't write their footer when closed.
+  void DropActiveEntriesBetween(base::Time initial_time, base::Time end_time);
+
+  int OpenOrCreateEntry(bool create,
+                        const std::string& key,
+                        Entry** entry,
+                        const CompletionCallback& callback);
+
+  const scoped_refptr<WrappedBackendHolder> backend_holder_;
+  Backend* const backend_;  // Owned by |backend_holder_|.
+  EntryMap active_entries_;
+
+  // Compresses and inflates the chunks of the entries.
+  const scoped_refptr<base::TaskRunner> worker_pool_;
+
+  // Bytes of stream data handed to the entries, and bytes actually written
+  // for them, since this backend was created.
+  int64 logical_bytes_written_;
+  int64 physical_bytes_written_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
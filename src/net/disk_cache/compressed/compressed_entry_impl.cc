@@ -0,0 +1,922 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed/compressed_entry_impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/task_runner_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+// A compressed data stream starts with this magic number. It is written with
+// the first chunk, and never truncated away, so that the stream is known to be
+// chunked even if the entry was not closed and its footer is missing.
+const uint64 kStreamHeaderMagic = UINT64_C(0x31726468706d6f63);
+
+// The footer of a compressed data stream is an array of ChunkRecord, one per
+// chunk, followed by a FooterTrailer.
+struct ChunkRecord {
+  uint32 physical_size;
+  uint32 logical_size;
+};
+
+struct FooterTrailer {
+  uint32 chunk_count;
+  uint32 crc;  // Covers the chunk records.
+  uint64 magic;
+};
+
+const uint64 kFooterMagic = UINT64_C(0x31727a706d6f6363);
+
+const int kStreamHeaderSize = static_cast<int>(sizeof(kStreamHeaderMagic));
+const int kChunkRecordSize = static_cast<int>(sizeof(ChunkRecord));
+const int kFooterTrailerSize = static_cast<int>(sizeof(FooterTrailer));
+
+// Cache entries are limited to 2 GB.
+const uint32 kMaxChunkCount =
+    kint32max / disk_cache::CompressedEntryImpl::kChunkSize + 1;
+
+uint32 CalculateCRC(const char* data, size_t length) {
+  return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(data),
+               length);
+}
+
+// Inflates the first |physical_size| bytes of |physical_data| into
+// |logical_data|, which is already sized for the result. Runs on the worker
+// pool.
+bool InflateChunkData(scoped_refptr<net::IOBuffer> physical_data,
+                      int physical_size,
+                      std::vector<char>* logical_data) {
+  uLongf inflated_size = logical_data->size();
+  return uncompress(reinterpret_cast<Bytef*>(&(*logical_data)[0]),
+                    &inflated_size,
+                    reinterpret_cast<const Bytef*>(physical_data->data()),
+                    physical_size) == Z_OK &&
+         inflated_size == logical_data->size();
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+CompressedEntryImpl::CompressJob::CompressJob() {}
+
+CompressedEntryImpl::CompressJob::~CompressJob() {}
+
+CompressedEntryImpl::CompressedEntryImpl(
+    const base::WeakPtr<CompressedBackendImpl>& backend,
+    const scoped_refptr<WrappedBackendHolder>& backend_holder,
+    const scoped_refptr<base::TaskRunner>& worker_pool,
+    const std::string& key,
+    Entry* entry)
+    : backend_(backend),
+      backend_holder_(backend_holder),
+      worker_pool_(worker_pool),
+      key_(key),
+      entry_(entry),
+      open_count_(0),
+      doomed_(false),
+      compressed_(false),
+      physical_end_(0),
+      tail_loaded_(true),
+      chunk_data_index_(-1),
+      dirty_(false),
+      failed_(false),
+      write_in_progress_(false) {
+  DCHECK(entry_);
+}
+
+int CompressedEntryImpl::Init(bool is_new,
+                              Entry** out_entry,
+                              const CompletionCallback& callback) {
+  const int physical_size = entry_->GetDataSize(kCompressedStream);
+  if (is_new || physical_size == 0) {
+    compressed_ = true;
+    return InitDone(net::OK, out_entry);
+  }
+  // Too short to have a header, so this is a stream stored as is.
+  if (physical_size < kStreamHeaderSize)
+    return InitDone(net::OK, out_entry);
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kStreamHeaderSize));
+  CompletionCallback io_callback =
+      base::Bind(&CompressedEntryImpl::OnStreamHeaderRead, this, buffer,
+                 out_entry, callback);
+  int rv = entry_->ReadData(kCompressedStream, 0, buffer.get(),
+                            kStreamHeaderSize, io_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return DidReadStreamHeader(buffer.get(), out_entry, callback, rv);
+}
+
+void CompressedEntryImpl::Reopen(Entry** out_entry) {
+  DCHECK(entry_);
+  ++open_count_;
+  AddRef();  // Balanced in Close().
+  *out_entry = this;
+}
+
+void CompressedEntryImpl::OnDoomedByBackend() {
+  doomed_ = true;
+}
+
+void CompressedEntryImpl::Doom() {
+  if (doomed_)
+    return;
+  doomed_ = true;
+  if (backend_.get())
+    backend_->OnEntryDoomedOrClosed(this);
+  entry_->Doom();
+}
+
+void CompressedEntryImpl::Close() {
+  DCHECK_LT(0, open_count_);
+  if (--open_count_ > 0) {
+    DCHECK(!HasOneRef());
+    Release();  // Balanced in InitDone() or Reopen().
+    return;
+  }
+
+  // The last chunk and the footer are written once the pending writes are
+  // done. Until then, the entry stays registered with the backend: opening it
+  // from the wrapped backend would find its data stream without a footer.
+  pending_writes_.push(base::Bind(&CompressedEntryImpl::Flush, this));
+  Release();  // Balanced in InitDone() or Reopen().
+  RunNextWriteIfNeeded();
+}
+
+std::string CompressedEntryImpl::GetKey() const {
+  return key_;
+}
+
+base::Time CompressedEntryImpl::GetLastUsed() const {
+  return entry_->GetLastUsed();
+}
+
+base::Time CompressedEntryImpl::GetLastModified() const {
+  return entry_->GetLastModified();
+}
+
+int32 CompressedEntryImpl::GetDataSize(int index) const {
+  if (index != kCompressedStream || !compressed_)
+    return entry_->GetDataSize(index);
+  return GetCompressedStreamSize();
+}
+
+int CompressedEntryImpl::ReadData(int index,
+                                  int offset,
+                                  IOBuffer* buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  if (index != kCompressedStream || !compressed_)
+    return entry_->ReadData(index, offset, buf, buf_len, callback);
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  const int size = GetCompressedStreamSize();
+  if (offset >= size || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, size - offset);
+  return ReadCompressed(offset, buf, buf_len, 0, callback);
+}
+
+int CompressedEntryImpl::WriteData(int index,
+                                   int offset,
+                                   IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback,
+                                   bool truncate) {
+  if (index != kCompressedStream || !compressed_)
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+
+  if (offset < 0 || buf_len < 0 || (buf_len && !buf) ||
+      offset > kint32max - buf_len) {
+    return net::ERR_INVALID_ARGUMENT;
+  }
+  if (failed_)
+    return net::ERR_CACHE_WRITE_FAILURE;
+
+  if (write_in_progress_) {
+    pending_writes_.push(base::Bind(&CompressedEntryImpl::RunQueuedWrite, this,
+                                    offset, make_scoped_refptr(buf), buf_len,
+                                    callback, truncate));
+    return net::ERR_IO_PENDING;
+  }
+
+  write_in_progress_ = true;
+  int rv = StartWrite(offset, buf, buf_len, callback, truncate);
+  if (rv != net::ERR_IO_PENDING)
+    WriteDone();
+  return rv;
+}
+
+int CompressedEntryImpl::ReadSparseData(int64 offset,
+                                        IOBuffer* buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  return entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntryImpl::WriteSparseData(int64 offset,
+                                         IOBuffer* buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback) {
+  return entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntryImpl::GetAvailableRange(int64 offset,
+                                           int len,
+                                           int64* start,
+                                           const CompletionCallback& callback) {
+  return entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool CompressedEntryImpl::CouldBeSparse() const {
+  return entry_->CouldBeSparse();
+}
+
+void CompressedEntryImpl::CancelSparseIO() {
+  entry_->CancelSparseIO();
+}
+
+int CompressedEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return entry_->ReadyForSparseIO(callback);
+}
+
+CompressedEntryImpl::~CompressedEntryImpl() {
+  DCHECK_EQ(0, open_count_);
+  if (entry_)
+    entry_->Close();
+}
+
+void CompressedEntryImpl::OnStreamHeaderRead(
+    scoped_refptr<net::IOBuffer> buffer,
+    Entry** out_entry,
+    const CompletionCallback& callback,
+    int result) {
+  // If the backend is gone, so is the caller waiting for this entry.
+  if (!backend_.get())
+    return;
+  int rv = DidReadStreamHeader(buffer.get(), out_entry, callback, result);
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+int CompressedEntryImpl::DidReadStreamHeader(
+    net::IOBuffer* buffer,
+    Entry** out_entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (result != kStreamHeaderSize)
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+
+  uint64 magic;
+  memcpy(&magic, buffer->data(), sizeof(magic));
+  // Without a header, this is a stream stored as is.
+  if (magic != kStreamHeaderMagic)
+    return InitDone(net::OK, out_entry);
+
+  compressed_ = true;
+  // The footer is only written when the entry is closed. A chunked stream
+  // without one was left behind by a crash, and its chunks can't be found.
+  const int physical_size = entry_->GetDataSize(kCompressedStream);
+  if (physical_size < kStreamHeaderSize + kFooterTrailerSize) {
+    LOG(WARNING) << "Missing footer in compressed cache entry.";
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+  }
+
+  scoped_refptr<net::IOBuffer> trailer(new net::IOBuffer(kFooterTrailerSize));
+  CompletionCallback io_callback =
+      base::Bind(&CompressedEntryImpl::OnFooterTrailerRead, this, trailer,
+                 out_entry, callback);
+  int rv = entry_->ReadData(kCompressedStream,
+                            physical_size - kFooterTrailerSize, trailer.get(),
+                            kFooterTrailerSize, io_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return DidReadFooterTrailer(trailer.get(), out_entry, callback, rv);
+}
+
+void CompressedEntryImpl::OnFooterTrailerRead(
+    scoped_refptr<net::IOBuffer> buffer,
+    Entry** out_entry,
+    const CompletionCallback& callback,
+    int result) {
+  // If the backend is gone, so is the caller waiting for this entry.
+  if (!backend_.get())
+    return;
+  int rv = DidReadFooterTrailer(buffer.get(), out_entry, callback, result);
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+int CompressedEntryImpl::DidReadFooterTrailer(
+    net::IOBuffer* buffer,
+    Entry** out_entry,
+    const CompletionCallback& callback,
+    int result) {
+  if (result != kFooterTrailerSize)
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+
+  FooterTrailer trailer;
+  memcpy(&trailer, buffer->data(), sizeof(trailer));
+  if (trailer.magic != kFooterMagic) {
+    LOG(WARNING) << "Missing footer in compressed cache entry.";
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+  }
+
+  const int footer_size = kFooterTrailerSize +
+                          static_cast<int>(trailer.chunk_count) *
+                              kChunkRecordSize;
+  if (trailer.chunk_count > kMaxChunkCount ||
+      footer_size >
+          entry_->GetDataSize(kCompressedStream) - kStreamHeaderSize) {
+    LOG(WARNING) << "Invalid footer in compressed cache entry.";
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+  }
+  if (!trailer.chunk_count)
+    return InitDone(ParseChunkTable(NULL, 0, trailer.crc), out_entry);
+
+  const int table_size = footer_size - kFooterTrailerSize;
+  scoped_refptr<net::IOBuffer> table(new net::IOBuffer(table_size));
+  CompletionCallback io_callback =
+      base::Bind(&CompressedEntryImpl::OnChunkTableRead, this, table,
+                 static_cast<int>(trailer.chunk_count), trailer.crc,
+                 out_entry, callback);
+  int rv = entry_->ReadData(
+      kCompressedStream, entry_->GetDataSize(kCompressedStream) - footer_size,
+      table.get(), table_size, io_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  if (rv != table_size)
+    return InitDone(net::ERR_CACHE_READ_FAILURE, out_entry);
+  return InitDone(ParseChunkTable(table->data(),
+                                  static_cast<int>(trailer.chunk_count),
+                                  trailer.crc),
+                  out_entry);
+}
+
+void CompressedEntryImpl::OnChunkTableRead(scoped_refptr<net::IOBuffer> table,
+                                           int chunk_count,
+                                           uint32 crc,
+                                           Entry** out_entry,
+                                           const CompletionCallback& callback,
+                                           int result) {
+  if (!backend_.get())
+    return;
+  if (result != chunk_count * kChunkRecordSize)
+    result = net::ERR_CACHE_READ_FAILURE;
+  else
+    result = ParseChunkTable(table->data(), chunk_count, crc);
+  callback.Run(InitDone(result, out_entry));
+}
+
+int CompressedEntryImpl::ParseChunkTable(const char* data,
+                                         int chunk_count,
+                                         uint32 crc) {
+  const int table_size = chunk_count * kChunkRecordSize;
+  if (CalculateCRC(data, table_size) != crc) {
+    LOG(WARNING) << "Invalid CRC in compressed cache entry footer.";
+    return net::ERR_CACHE_READ_FAILURE;
+  }
+
+  const int footer_offset = entry_->GetDataSize(kCompressedStream) -
+                            table_size - kFooterTrailerSize;
+  int physical_offset = kStreamHeaderSize;
+  chunks_.reserve(chunk_count);
+  for (int i = 0; i < chunk_count; ++i) {
+    ChunkRecord record;
+    memcpy(&record, data + i * kChunkRecordSize, sizeof(record));
+    // Only the last chunk can be partial, and chunks that did not compress
+    // are stored as is.
+    const bool is_last = i + 1 == chunk_count;
+    if (record.logical_size == 0 || record.logical_size > kChunkSize ||
+        (!is_last && record.logical_size != kChunkSize) ||
+        record.physical_size == 0 ||
+        record.physical_size > record.logical_size ||
+        static_cast<int>(record.physical_size) >
+            footer_offset - physical_offset) {
+      LOG(WARNING) << "Invalid chunk in compressed cache entry.";
+      chunks_.clear();
+      return net::ERR_CACHE_READ_FAILURE;
+    }
+    Chunk chunk;
+    chunk.physical_offset = physical_offset;
+    chunk.physical_size = static_cast<int>(record.physical_size);
+    chunk.logical_size = static_cast<int>(record.logical_size);
+    chunks_.push_back(chunk);
+    physical_offset += chunk.physical_size;
+  }
+  if (physical_offset != footer_offset) {
+    chunks_.clear();
+    return net::ERR_CACHE_READ_FAILURE;
+  }
+
+  physical_end_ = physical_offset;
+  tail_loaded_ = chunks_.empty() || chunks_.back().logical_size == kChunkSize;
+  return net::OK;
+}
+
+int CompressedEntryImpl::InitDone(int result, Entry** out_entry) {
+  if (result != net::OK) {
+    // The entry is corrupt, or can't be read. Either way, it is of no use.
+    Doom();
+    return result;
+  }
+  open_count_ = 1;
+  AddRef();  // Balanced in Close().
+  if (backend_.get())
+    backend_->OnEntryOpened(this);
+  *out_entry = this;
+  return net::OK;
+}
+
+int CompressedEntryImpl::ReadChunk(size_t index,
+                                   const CompletionCallback& callback) {
+  DCHECK_LT(index, chunks_.size());
+  if (static_cast<int>(index) == chunk_data_index_)
+    return net::OK;
+
+  const Chunk& chunk = chunks_[index];
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(chunk.physical_size));
+  CompletionCallback io_callback =
+      base::Bind(&CompressedEntryImpl::OnChunkRead, this, index, chunk, buffer,
+                 callback);
+  int rv = entry_->ReadData(kCompressedStream, chunk.physical_offset,
+                            buffer.get(), chunk.physical_size, io_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return InflateChunk(index, chunk, buffer, callback, rv);
+}
+
+void CompressedEntryImpl::OnChunkRead(size_t index,
+                                      const Chunk& chunk,
+                                      scoped_refptr<net::IOBuffer> buffer,
+                                      const CompletionCallback& callback,
+                                      int result) {
+  int rv = InflateChunk(index, chunk, buffer, callback, result);
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+int CompressedEntryImpl::InflateChunk(size_t index,
+                                      const Chunk& chunk,
+                                      scoped_refptr<net::IOBuffer> buffer,
+                                      const CompletionCallback& callback,
+                                      int result) {
+  if (result != chunk.physical_size)
+    return result < 0 ? result : net::ERR_CACHE_READ_FAILURE;
+  if (!IsChunkCurrent(index, chunk))
+    return net::ERR_CACHE_READ_FAILURE;
+
+  // A chunk that did not compress is stored as is.
+  if (chunk.physical_size == chunk.logical_size) {
+    chunk_data_.assign(buffer->data(), buffer->data() + chunk.logical_size);
+    chunk_data_index_ = static_cast<int>(index);
+    return net::OK;
+  }
+
+  std::vector<char>* logical_data = new std::vector<char>(chunk.logical_size);
+  base::PostTaskAndReplyWithResult(
+      worker_pool_.get(), FROM_HERE,
+      base::Bind(&InflateChunkData, buffer, chunk.physical_size,
+                 base::Unretained(logical_data)),
+      base::Bind(&CompressedEntryImpl::OnChunkInflated, this, index, chunk,
+                 base::Owned(logical_data), callback));
+  return net::ERR_IO_PENDING;
+}
+
+void CompressedEntryImpl::OnChunkInflated(size_t index,
+                                          const Chunk& chunk,
+                                          std::vector<char>* logical_data,
+                                          const CompletionCallback& callback,
+                                          bool success) {
+  if (!success) {
+    LOG(WARNING) << "Corrupt chunk in compressed cache entry.";
+    callback.Run(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+  if (!IsChunkCurrent(index, chunk)) {
+    callback.Run(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+  chunk_data_.swap(*logical_data);
+  chunk_data_index_ = static_cast<int>(index);
+  callback.Run(net::OK);
+}
+
+bool CompressedEntryImpl::IsChunkCurrent(size_t index,
+                                         const Chunk& chunk) const {
+  return index < chunks_.size() &&
+         chunks_[index].physical_offset == chunk.physical_offset;
+}
+
+int CompressedEntryImpl::ReadCompressed(int offset,
+                                        scoped_refptr<net::IOBuffer> buf,
+                                        int buf_len,
+                                        int bytes_done,
+                                        const CompletionCallback& callback) {
+  while (bytes_done < buf_len) {
+    const int position = offset + bytes_done;
+    const size_t index = position / kChunkSize;
+    const char* source = NULL;
+    int available = 0;
+    if (index >= chunks_.size()) {
+      DCHECK(tail_loaded_);
+      const int tail_offset =
+          position - static_cast<int>(chunks_.size()) * kChunkSize;
+      available = static_cast<int>(tail_.size()) - tail_offset;
+      if (available > 0)
+        source = &tail_[tail_offset];
+    } else {
+      if (static_cast<int>(index) != chunk_data_index_) {
+        int rv = ReadChunk(
+            index, base::Bind(&CompressedEntryImpl::OnChunkReadForRead, this,
+                              offset, buf, buf_len, bytes_done, callback));
+        if (rv != net::OK)
+          return rv;
+      }
+      const int chunk_offset = position % kChunkSize;
+      available = static_cast<int>(chunk_data_.size()) - chunk_offset;
+      if (available > 0)
+        source = &chunk_data_[chunk_offset];
+    }
+    // The stream was truncated while it was being read.
+    if (available <= 0)
+      break;
+
+    const int bytes = std::min(available, buf_len - bytes_done);
+    memcpy(buf->data() + bytes_done, source, bytes);
+    bytes_done += bytes;
+  }
+  return bytes_done;
+}
+
+void CompressedEntryImpl::OnChunkReadForRead(
+    int offset,
+    scoped_refptr<net::IOBuffer> buf,
+    int buf_len,
+    int bytes_done,
+    const CompletionCallback& callback,
+    int result) {
+  if (result == net::OK)
+    result = ReadCompressed(offset, buf, buf_len, bytes_done, callback);
+  if (result != net::ERR_IO_PENDING)
+    callback.Run(result);
+}
+
+void CompressedEntryImpl::RunNextWriteIfNeeded() {
+  if (write_in_progress_ || pending_writes_.empty())
+    return;
+  base::Closure next_write = pending_writes_.front();
+  pending_writes_.pop();
+  next_write.Run();
+}
+
+void CompressedEntryImpl::RunQueuedWrite(int offset,
+                                         scoped_refptr<net::IOBuffer> buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback,
+                                         bool truncate) {
+  write_in_progress_ = true;
+  int rv = failed_ ? net::ERR_CACHE_WRITE_FAILURE
+                   : StartWrite(offset, buf, buf_len, callback, truncate);
+  if (rv == net::ERR_IO_PENDING)
+    return;
+  callback.Run(rv);
+  WriteDone();
+}
+
+int CompressedEntryImpl::StartWrite(int offset,
+                                    scoped_refptr<net::IOBuffer> buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback,
+                                    bool truncate) {
+  // Data that has been compressed can only be replaced by truncating the
+  // stream. The chunk the write starts in, unless it starts right on a chunk
+  // boundary, is read back to be compressed again with the new data.
+  int reload_chunk = -1;
+  size_t keep_chunks = chunks_.size();
+  const size_t first_chunk = offset / kChunkSize;
+  if (first_chunk < chunks_.size()) {
+    if (!truncate && first_chunk + 1 < chunks_.size())
+      return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+    if (truncate && offset % kChunkSize == 0)
+      keep_chunks = first_chunk;
+    else
+      reload_chunk = static_cast<int>(first_chunk);
+  } else if (!tail_loaded_) {
+    reload_chunk = static_cast<int>(chunks_.size()) - 1;
+  }
+
+  if (reload_chunk >= 0 && reload_chunk != chunk_data_index_) {
+    int rv = ReadChunk(
+        reload_chunk,
+        base::Bind(&CompressedEntryImpl::OnChunkReadForWrite, this, offset, buf,
+                   buf_len, callback, truncate, reload_chunk));
+    if (rv != net::OK)
+      return rv;
+  }
+  return ContinueWrite(offset, buf.get(), buf_len, callback, truncate,
+                       reload_chunk, keep_chunks);
+}
+
+void CompressedEntryImpl::OnChunkReadForWrite(
+    int offset,
+    scoped_refptr<net::IOBuffer> buf,
+    int buf_len,
+    const CompletionCallback& callback,
+    bool truncate,
+    int reload_chunk,
+    int result) {
+  if (result == net::OK) {
+    result = ContinueWrite(offset, buf.get(), buf_len, callback, truncate,
+                           reload_chunk, chunks_.size());
+  }
+  if (result == net::ERR_IO_PENDING)
+    return;
+  callback.Run(result);
+  WriteDone();
+}
+
+int CompressedEntryImpl::ContinueWrite(int offset,
+                                       net::IOBuffer* buf,
+                                       int buf_len,
+                                       const CompletionCallback& callback,
+                                       bool truncate,
+                                       int reload_chunk,
+                                       size_t keep_chunks) {
+  if (reload_chunk >= 0) {
+    DCHECK_EQ(reload_chunk, chunk_data_index_);
+    std::vector<char> new_tail(chunk_data_);
+    if (tail_loaded_ && static_cast<size_t>(reload_chunk) + 1 == chunks_.size())
+      new_tail.insert(new_tail.end(), tail_.begin(), tail_.end());
+    tail_.swap(new_tail);
+    keep_chunks = reload_chunk;
+  } else if (keep_chunks < chunks_.size()) {
+    tail_.clear();
+  }
+
+  // Chunks that are dropped are cut from the wrapped stream right away, so
+  // that the footer left there by a previous writer goes away with them.
+  bool truncate_physical = false;
+  if (keep_chunks < chunks_.size()) {
+    physical_end_ = chunks_[keep_chunks].physical_offset;
+    chunks_.resize(keep_chunks);
+    if (chunk_data_index_ >= static_cast<int>(keep_chunks))
+      chunk_data_index_ = -1;
+    truncate_physical = true;
+  }
+  tail_loaded_ = true;
+
+  const int tail_start = static_cast<int>(chunks_.size()) * kChunkSize;
+  DCHECK_GE(offset, tail_start);
+  const size_t tail_offset = offset - tail_start;
+  const size_t tail_end = tail_offset + buf_len;
+  // Growing the tail fills any gap before |offset| with zeros.
+  if (truncate || tail_.size() < tail_end)
+    tail_.resize(tail_end);
+  if (buf_len)
+    memcpy(&tail_[tail_offset], buf->data(), buf_len);
+  dirty_ = true;
+
+  // Full chunks are compressed on the worker pool. Until that is done, they
+  // stay in |tail_|, where readers find them.
+  const size_t full_size = tail_.size() - tail_.size() % kChunkSize;
+  if (full_size) {
+    CompressJob* job = new CompressJob;
+    AppendStreamHeaderIfNeeded(&job->physical_data);
+    job->data.assign(tail_.begin(), tail_.begin() + full_size);
+    worker_pool_->PostTaskAndReply(
+        FROM_HERE,
+        base::Bind(&CompressedEntryImpl::CompressChunks, base::Unretained(job)),
+        base::Bind(&CompressedEntryImpl::OnChunksCompressed, this, buf_len,
+                   callback, base::Owned(job)));
+    return net::ERR_IO_PENDING;
+  }
+
+  if (!truncate_physical)
+    return buf_len;
+  return WritePhysicalData(buf_len, std::vector<char>(), callback);
+}
+
+void CompressedEntryImpl::OnChunksCompressed(
+    int buf_len,
+    const CompletionCallback& callback,
+    CompressJob* job) {
+  for (size_t i = 0; i < job->chunks.size(); ++i) {
+    Chunk chunk = job->chunks[i];
+    chunk.physical_offset += physical_end_;
+    chunks_.push_back(chunk);
+    if (backend_.get())
+      backend_->OnChunkWritten(chunk.logical_size, chunk.physical_size);
+  }
+  // Readers following the writer are likely to want the last chunk next.
+  const size_t consumed = job->data.size();
+  chunk_data_.assign(job->data.end() - kChunkSize, job->data.end());
+  chunk_data_index_ = static_cast<int>(chunks_.size()) - 1;
+  tail_.erase(tail_.begin(), tail_.begin() + consumed);
+
+  int rv = WritePhysicalData(buf_len, job->physical_data, callback);
+  if (rv == net::ERR_IO_PENDING)
+    return;
+  callback.Run(rv);
+  WriteDone();
+}
+
+int CompressedEntryImpl::WritePhysicalData(
+    int buf_len,
+    const std::vector<char>& physical_data,
+    const CompletionCallback& callback) {
+  const int physical_len = static_cast<int>(physical_data.size());
+  scoped_refptr<net::IOBuffer> physical_buffer;
+  if (physical_len) {
+    physical_buffer = new net::IOBuffer(physical_len);
+    memcpy(physical_buffer->data(), &physical_data[0], physical_len);
+  }
+  const int physical_offset = physical_end_;
+  physical_end_ += physical_len;
+  int rv = entry_->WriteData(
+      kCompressedStream, physical_offset, physical_buffer.get(), physical_len,
+      base::Bind(&CompressedEntryImpl::OnPhysicalWriteDone, this, buf_len,
+                 physical_len, callback),
+      true);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return PhysicalWriteDone(buf_len, physical_len, rv);
+}
+
+void CompressedEntryImpl::OnPhysicalWriteDone(
+    int buf_len,
+    int physical_len,
+    const CompletionCallback& callback,
+    int result) {
+  callback.Run(PhysicalWriteDone(buf_len, physical_len, result));
+  WriteDone();
+}
+
+int CompressedEntryImpl::PhysicalWriteDone(int buf_len,
+                                           int physical_len,
+                                           int result) {
+  if (result == physical_len)
+    return buf_len;
+  // The stream no longer matches |chunks_|.
+  failed_ = true;
+  Doom();
+  return net::ERR_CACHE_WRITE_FAILURE;
+}
+
+void CompressedEntryImpl::WriteDone() {
+  DCHECK(write_in_progress_);
+  write_in_progress_ = false;
+  RunNextWriteIfNeeded();
+}
+
+void CompressedEntryImpl::AppendStreamHeaderIfNeeded(
+    std::vector<char>* physical_data) {
+  // Chunks are only ever truncated down to the end of the header, so the
+  // stream is empty until the first chunk is written.
+  if (physical_end_ != 0)
+    return;
+  const char* magic_data = reinterpret_cast<const char*>(&kStreamHeaderMagic);
+  physical_data->insert(physical_data->end(), magic_data,
+                        magic_data + kStreamHeaderSize);
+}
+
+// static
+void CompressedEntryImpl::CompressChunks(CompressJob* job) {
+  std::vector<char>& physical_data = job->physical_data;
+  for (size_t offset = 0; offset < job->data.size(); offset += kChunkSize) {
+    const char* data = &job->data[offset];
+    const int size = static_cast<int>(
+        std::min(job->data.size() - offset, static_cast<size_t>(kChunkSize)));
+    const size_t start = physical_data.size();
+    Chunk chunk;
+    chunk.physical_offset = static_cast<int>(start);
+    chunk.logical_size = size;
+
+    uLongf compressed_size = compressBound(size);
+    physical_data.resize(start + compressed_size);
+    int rv = compress2(reinterpret_cast<Bytef*>(&physical_data[start]),
+                       &compressed_size, reinterpret_cast<const Bytef*>(data),
+                       size, Z_BEST_SPEED);
+    if (rv == Z_OK && compressed_size < static_cast<uLongf>(size)) {
+      physical_data.resize(start + compressed_size);
+      chunk.physical_size = static_cast<int>(compressed_size);
+    } else {
+      // Data that does not compress, such as images, is stored as is.
+      physical_data.resize(start + size);
+      memcpy(&physical_data[start], data, size);
+      chunk.physical_size = size;
+    }
+    job->chunks.push_back(chunk);
+  }
+}
+
+void CompressedEntryImpl::Flush() {
+  write_in_progress_ = true;
+  // The entry was opened again since it was closed. It is flushed when it is
+  // closed again instead.
+  if (open_count_ > 0 || !pending_writes_.empty()) {
+    WriteDone();
+    return;
+  }
+  // A doomed entry is never opened again.
+  if (!compressed_ || !dirty_ || failed_ || doomed_) {
+    OnFlushDone(0, 0);
+    return;
+  }
+
+  DCHECK(tail_loaded_);
+  CompressJob* job = new CompressJob;
+  AppendStreamHeaderIfNeeded(&job->physical_data);
+  job->data = tail_;
+  worker_pool_->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&CompressedEntryImpl::CompressChunks, base::Unretained(job)),
+      base::Bind(&CompressedEntryImpl::WriteFooter, this, base::Owned(job)));
+}
+
+void CompressedEntryImpl::WriteFooter(CompressJob* job) {
+  // The last chunk is only added to the footer, so that |chunks_| and |tail_|
+  // stay valid if the entry is opened again.
+  std::vector<Chunk> chunks(chunks_);
+  for (size_t i = 0; i < job->chunks.size(); ++i) {
+    chunks.push_back(job->chunks[i]);
+    if (backend_.get()) {
+      backend_->OnChunkWritten(job->chunks[i].logical_size,
+                               job->chunks[i].physical_size);
+    }
+  }
+
+  std::vector<char>& physical_data = job->physical_data;
+  const size_t table_start = physical_data.size();
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    ChunkRecord record;
+    record.physical_size = static_cast<uint32>(chunks[i].physical_size);
+    record.logical_size = static_cast<uint32>(chunks[i].logical_size);
+    const char* record_data = reinterpret_cast<const char*>(&record);
+    physical_data.insert(physical_data.end(), record_data,
+                         record_data + sizeof(record));
+  }
+  FooterTrailer trailer;
+  trailer.chunk_count = static_cast<uint32>(chunks.size());
+  trailer.crc = CalculateCRC(
+      physical_data.empty() ? NULL : &physical_data[table_start],
+      physical_data.size() - table_start);
+  trailer.magic = kFooterMagic;
+  const char* trailer_data = reinterpret_cast<const char*>(&trailer);
+  physical_data.insert(physical_data.end(), trailer_data,
+                       trailer_data + sizeof(trailer));
+
+  const int physical_len = static_cast<int>(physical_data.size());
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(physical_len));
+  memcpy(buffer->data(), &physical_data[0], physical_len);
+  int rv = entry_->WriteData(
+      kCompressedStream, physical_end_, buffer.get(), physical_len,
+      base::Bind(&CompressedEntryImpl::OnFlushDone, this, physical_len), true);
+  if (rv != net::ERR_IO_PENDING)
+    OnFlushDone(physical_len, rv);
+}
+
+void CompressedEntryImpl::OnFlushDone(int physical_len, int result) {
+  if (result != physical_len) {
+    LOG(WARNING) << "Could not write compressed cache entry footer.";
+    failed_ = true;
+    Doom();
+  } else {
+    dirty_ = false;
+  }
+
+  // The entry was opened again while it was being flushed.
+  if (open_count_ > 0 || !pending_writes_.empty()) {
+    WriteDone();
+    return;
+  }
+  if (backend_.get())
+    backend_->OnEntryDoomedOrClosed(this);
+  entry_->Close();
+  entry_ = NULL;
+}
+
+int CompressedEntryImpl::GetCompressedStreamSize() const {
+  const int chunk_count = static_cast<int>(chunks_.size());
+  if (!tail_loaded_)
+    return (chunk_count - 1) * kChunkSize + chunks_.back().logical_size;
+  return chunk_count * kChunkSize + static_cast<int>(tail_.size());
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,306 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace base {
+class TaskRunner;
+}
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+class CompressedBackendImpl;
+class WrappedBackendHolder;
+
+// CompressedEntryImpl wraps an Entry of another backend, and stores the data
+// stream of the entry (stream 1, where the HttpCache keeps response bodies)
+// compressed with zlib.
+//
+// The stream is compressed in independent chunks of kChunkSize bytes, so that
+// a read at any offset only has to inflate the chunk holding it. Chunks are
+// stored back to back in the wrapped stream, after a header that marks the
+// stream as chunked, and followed by a footer that lists their sizes and is
+// rewritten when the entry is closed. A chunked stream without a valid footer,
+// such as one left behind by a crash, is corrupt. Every chunk but the last one
+// holds exactly kChunkSize bytes of data; while the entry is being appended
+// to, that last chunk is kept in memory and only written out once it is full,
+// or when the entry is closed. Chunks are compressed and inflated on a worker
+// pool, as that takes too long for the IO thread.
+//
+// Writes to the data stream must append to it or truncate it, which is what
+// the HttpCache does. Overwriting data that has already been compressed fails
+// with ERR_CACHE_OPERATION_NOT_SUPPORTED. The other streams, sparse data and
+// entries written before compression was enabled are passed through as is.
+class NET_EXPORT_PRIVATE CompressedEntryImpl
+    : public Entry,
+      public base::RefCounted<CompressedEntryImpl> {
+ public:
+  static const int kCompressedStream = 1;
+  static const int kChunkSize = 64 * 1024;
+
+  // |entry| is owned by the new object, which closes it when done, and keeps
+  // |backend_holder| alive until then. Chunks are compressed and inflated on
+  // |worker_pool|.
+  CompressedEntryImpl(const base::WeakPtr<CompressedBackendImpl>& backend,
+                      const scoped_refptr<WrappedBackendHolder>& backend_holder,
+                      const scoped_refptr<base::TaskRunner>& worker_pool,
+                      const std::string& key,
+                      Entry* entry);
+
+  // Reads the list of chunks of an entry that has just been opened. On
+  // success, |*out_entry| is set to this entry. Returns a net error code; if
+  // it is ERR_IO_PENDING, |callback| will be run with the result. A corrupt
+  // entry is doomed, and fails with ERR_CACHE_READ_FAILURE.
+  int Init(bool is_new, Entry** out_entry, const CompletionCallback& callback);
+
+  // Returns this entry to one more caller, which has to Close() it. This
+  // includes an entry that has been closed but not flushed yet.
+  void Reopen(Entry** out_entry);
+
+  // Called when the backend dooms the wrapped entry, which is then no longer
+  // worth a footer.
+  void OnDoomedByBackend();
+
+  // Entry interface.
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32 GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64 offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64 offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64 offset,
+                        int len,
+                        int64* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  friend class base::RefCounted<CompressedEntryImpl>;
+
+  struct Chunk {
+    int physical_offset;
+    int physical_size;
+    int logical_size;
+  };
+
+  // Data handed to the worker pool to be compressed, and the result.
+  struct CompressJob {
+    CompressJob();
+    ~CompressJob();
+
+    // Whole chunks, but for the last one when flushing.
+    std::vector<char> data;
+    // The compressed chunks are appended to what is already there, which is
+    // the stream header if it has yet to be written.
+    std::vector<char> physical_data;
+    // The chunks appended to |physical_data|, at offsets relative to it.
+    std::vector<Chunk> chunks;
+  };
+
+  ~CompressedEntryImpl() override;
+
+  // Init() steps.
+  void OnStreamHeaderRead(scoped_refptr<net::IOBuffer> buffer,
+                          Entry** out_entry,
+                          const CompletionCallback& callback,
+                          int result);
+  int DidReadStreamHeader(net::IOBuffer* buffer,
+                          Entry** out_entry,
+                          const CompletionCallback& callback,
+                          int result);
+  void OnFooterTrailerRead(scoped_refptr<net::IOBuffer> buffer,
+                           Entry** out_entry,
+                           const CompletionCallback& callback,
+                           int result);
+  int DidReadFooterTrailer(net::IOBuffer* buffer,
+                           Entry** out_entry,
+                           const CompletionCallback& callback,
+                           int result);
+  void OnChunkTableRead(scoped_refptr<net::IOBuffer> table,
+                        int chunk_count,
+                        uint32 crc,
+                        Entry** out_entry,
+                        const CompletionCallback& callback,
+                        int result);
+  int ParseChunkTable(const char* data, int chunk_count, uint32 crc);
+  int InitDone(int result, Entry** out_entry);
+
+  // Reads chunk |index| into |chunk_data_|, unless it is already there.
+  // Returns OK, ERR_IO_PENDING, or an error.
+  int ReadChunk(size_t index, const CompletionCallback& callback);
+  void OnChunkRead(size_t index,
+                   const Chunk& chunk,
+                   scoped_refptr<net::IOBuffer> buffer,
+                   const CompletionCallback& callback,
+                   int result);
+  int InflateChunk(size_t index,
+                   const Chunk& chunk,
+                   scoped_refptr<net::IOBuffer> buffer,
+                   const CompletionCallback& callback,
+                   int result);
+  void OnChunkInflated(size_t index,
+                       const Chunk& chunk,
+                       std::vector<char>* logical_data,
+                       const CompletionCallback& callback,
+                       bool success);
+
+  // Returns true if |chunk| is still chunk |index| of the stream, which may
+  // have been truncated while it was being read.
+  bool IsChunkCurrent(size_t index, const Chunk& chunk) const;
+
+  // Copies the data stream into |buf| from |offset| + |bytes_done|, reading
+  // chunks as needed. Returns the number of bytes read, or ERR_IO_PENDING.
+  int ReadCompressed(int offset,
+                     scoped_refptr<net::IOBuffer> buf,
+                     int buf_len,
+                     int bytes_done,
+                     const CompletionCallback& callback);
+  void OnChunkReadForRead(int offset,
+                          scoped_refptr<net::IOBuffer> buf,
+                          int buf_len,
+                          int bytes_done,
+                          const CompletionCallback& callback,
+                          int result);
+
+  // Writes to the data stream. Writes are run one at a time, in order, and
+  // the final flush of the entry is queued behind them.
+  void RunNextWriteIfNeeded();
+  void RunQueuedWrite(int offset,
+                      scoped_refptr<net::IOBuffer> buf,
+                      int buf_len,
+                      const CompletionCallback& callback,
+                      bool truncate);
+  int StartWrite(int offset,
+                 scoped_refptr<net::IOBuffer> buf,
+                 int buf_len,
+                 const CompletionCallback& callback,
+                 bool truncate);
+  void OnChunkReadForWrite(int offset,
+                           scoped_refptr<net::IOBuffer> buf,
+                           int buf_len,
+                           const CompletionCallback& callback,
+                           bool truncate,
+                           int reload_chunk,
+                           int result);
+  int ContinueWrite(int offset,
+                    net::IOBuffer* buf,
+                    int buf_len,
+                    const CompletionCallback& callback,
+                    bool truncate,
+                    int reload_chunk,
+                    size_t keep_chunks);
+  void OnChunksCompressed(int buf_len,
+                          const CompletionCallback& callback,
+                          CompressJob* job);
+  // Writes |physical_data| at the end of the wrapped data stream, truncating
+  // it there. Returns |buf_len|, ERR_IO_PENDING, or an error.
+  int WritePhysicalData(int buf_len,
+                        const std::vector<char>& physical_data,
+                        const CompletionCallback& callback);
+  void OnPhysicalWriteDone(int buf_len,
+                           int physical_len,
+                           const CompletionCallback& callback,
+                           int result);
+  int PhysicalWriteDone(int buf_len, int physical_len, int result);
+  void WriteDone();
+
+  // Appends the stream header to |physical_data| if nothing has been written
+  // to the wrapped data stream yet.
+  void AppendStreamHeaderIfNeeded(std::vector<char>* physical_data);
+
+  // Compresses |job->data| in chunks of kChunkSize bytes. Runs on the worker
+  // pool.
+  static void CompressChunks(CompressJob* job);
+
+  // Writes the last chunk and the footer, and closes the wrapped entry unless
+  // the entry has been opened again in the meantime.
+  void Flush();
+  void WriteFooter(CompressJob* job);
+  void OnFlushDone(int physical_len, int result);
+
+  int GetCompressedStreamSize() const;
+
+  base::WeakPtr<CompressedBackendImpl> backend_;
+  // Keeps the wrapped backend alive for as long as |entry_| is open, which
+  // may be after |backend_| is gone.
+  const scoped_refptr<WrappedBackendHolder> backend_holder_;
+  const scoped_refptr<base::TaskRunner> worker_pool_;
+  const std::string key_;
+  Entry* entry_;
+
+  // Number of callers that have this entry open.
+  int open_count_;
+  bool doomed_;
+
+  // True once the data stream is known to use the chunked format. Entries
+  // written before compression was enabled keep their data stream as is.
+  bool compressed_;
+
+  // The chunks stored in the wrapped data stream, and the offset where the
+  // next one goes. That offset is 0 until the stream header is written.
+  std::vector<Chunk> chunks_;
+  int physical_end_;
+
+  // When true, every chunk in |chunks_| is full, and |tail_| holds the data
+  // that follows them. That can be more than a chunk while it is being
+  // compressed. When false, the last chunk in |chunks_| is partial and
+  // has to be read back into |tail_| before it can be appended to.
+  bool tail_loaded_;
+  std::vector<char> tail_;
+
+  // The last chunk that was inflated, kept for sequential reads.
+  int chunk_data_index_;
+  std::vector<char> chunk_data_;
+
+  // Set when the data stream has been modified, so that the footer has to be
+  // rewritten.
+  bool dirty_;
+  // Set when writing to the wrapped entry failed, leaving it unusable.
+  bool failed_;
+
+  bool write_in_progress_;
+  std::queue<base::Closure> pending_writes_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
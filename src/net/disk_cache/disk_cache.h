@@ -61,6 +61,13 @@ NET_EXPORT int CreateCacheBackend(
     scoped_ptr<Backend>* backend,
     const net::CompletionCallback& callback);
 
+// Returns a Backend that stores its entries in |backend|, compressing the data
+// stream of each entry (stream 1) with zlib. The data stream keeps supporting
+// reads at any offset, but can only be appended to or truncated. Entries
+// already in |backend| that were stored uncompressed remain readable.
+NET_EXPORT scoped_ptr<Backend> CreateCompressedBackend(
+    scoped_ptr<Backend> backend);
+
 // The root interface for a disk cache instance.
 class NET_EXPORT Backend {
  public:
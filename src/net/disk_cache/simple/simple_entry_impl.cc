@@ -229,7 +229,10 @@ int SimpleEntryImpl::OpenEntry(Entry** out_entry,
                    open_entry_index_enum, INDEX_MAX);
 
   // If entry is not known to the index, initiate fast failover to the network.
-  if (open_entry_index_enum == INDEX_MISS) {
+  // Before the index is initialized, Has() may still know from the index table
+  // on disk that the entry does not exist.
+  if (open_entry_index_enum == INDEX_MISS ||
+      (!have_index && !backend_->index()->Has(entry_hash_))) {
     net_log_.AddEventWithNetErrorCode(
         net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_END,
         net::ERR_FAILED);
@@ -28,6 +28,7 @@
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 
@@ -151,6 +152,7 @@ SimpleIndex::SimpleIndex(
       low_watermark_(0),
       eviction_in_progress_(false),
       initialized_(false),
+      full_write_required_(true),
       index_file_(index_file.Pass()),
       io_thread_(io_thread),
       // Creating the callback once so it is reused every time
@@ -179,6 +181,10 @@ void SimpleIndex::Initialize(base::Time cache_mtime) {
   }
 #endif
 
+  index_file_->MapIndexTable(
+      cache_mtime,
+      base::Bind(&SimpleIndex::OnIndexTableMapped, AsWeakPtr()));
+
   SimpleIndexLoadResult* load_result = new SimpleIndexLoadResult();
   scoped_ptr<SimpleIndexLoadResult> load_result_scoped(load_result);
   base::Closure reply = base::Bind(
@@ -235,7 +241,8 @@ scoped_ptr<SimpleIndex::HashList> SimpleIndex::GetAllHashes() {
 }
 
 int32 SimpleIndex::GetEntryCount() const {
-  // TODO(pasko): return a meaningful initial estimate before initialized.
+  if (!initialized_ && mapped_table_)
+    return base::saturated_cast<int32>(mapped_table_->GetEntryCount());
   return entries_set_.size();
 }
 
@@ -253,6 +260,7 @@ void SimpleIndex::Insert(uint64 entry_hash) {
       entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
 }
 
@@ -266,13 +274,25 @@ void SimpleIndex::Remove(uint64 entry_hash) {
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
 }
 
 bool SimpleIndex::Has(uint64 hash) const {
   DCHECK(io_thread_checker_.CalledOnValidThread());
-  // If not initialized, always return true, forcing it to go to the disk.
-  return !initialized_ || entries_set_.count(hash) > 0;
+  if (entries_set_.count(hash) > 0)
+    return true;
+  if (initialized_ || removed_entries_.count(hash) > 0)
+    return false;
+  // If not initialized and there is no index table to tell, always return
+  // true, forcing it to go to the disk. Every page of the table was read and
+  // checked on the worker pool before it was handed over, so looking it up
+  // here doesn't block on disk IO.
+  if (!mapped_table_)
+    return true;
+  EntryMetadata metadata;
+  return mapped_table_->Find(hash, &metadata) !=
+         SimpleIndexTable::LOOKUP_NOT_FOUND;
 }
 
 bool SimpleIndex::UseIfExists(uint64 entry_hash) {
@@ -281,9 +301,11 @@ bool SimpleIndex::UseIfExists(uint64 entry_hash) {
   // It will be merged later.
   EntrySet::iterator it = entries_set_.find(entry_hash);
   if (it == entries_set_.end())
-    // If not initialized, always return true, forcing it to go to the disk.
-    return !initialized_;
+    // If not initialized, defer to Has(), forcing it to go to the disk unless
+    // the index table knows better.
+    return !initialized_ && Has(entry_hash);
   it->second.SetLastUsedTime(base::Time::Now());
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
@@ -344,6 +366,7 @@ bool SimpleIndex::UpdateEntrySize(uint64 entry_hash, int64 entry_size) {
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  changed_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -392,11 +415,23 @@ void SimpleIndex::UpdateEntryIteratorSize(EntrySet::iterator* it,
   (*it)->second.SetEntrySize(entry_size);
 }
 
+void SimpleIndex::OnIndexTableMapped(scoped_ptr<SimpleIndexTable> table) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  // The table is of no use once the index has its entries.
+  if (!initialized_)
+    mapped_table_ = table.Pass();
+}
+
 void SimpleIndex::MergeInitializingSet(
     scoped_ptr<SimpleIndexLoadResult> load_result) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   DCHECK(load_result->did_load);
 
+  mapped_table_.reset();
+  // The entries changed during initialization are in |changed_entries_|, so
+  // a table that the entries were loaded from only needs to be updated.
+  full_write_required_ = !load_result->loaded_from_table;
+
   EntrySet* index_file_entries = &load_result->entries;
 
   for (base::hash_set<uint64>::const_iterator it = removed_entries_.begin();
@@ -478,8 +513,38 @@ void SimpleIndex::WriteToDisk() {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(entries_set_, cache_size_,
-                           start, app_on_background_, base::Closure());
+  if (full_write_required_) {
+    full_write_required_ = false;
+    changed_entries_.clear();
+    index_file_->WriteToDisk(entries_set_, cache_size_,
+                             start, app_on_background_, base::Closure());
+    return;
+  }
+
+  // Even with nothing changed, the update refreshes the age of the index.
+  EntrySet updated_entries;
+  std::vector<uint64> removed_hashes;
+  for (base::hash_set<uint64>::const_iterator it = changed_entries_.begin();
+       it != changed_entries_.end(); ++it) {
+    EntrySet::const_iterator found = entries_set_.find(*it);
+    if (found != entries_set_.end())
+      InsertInEntrySet(found->first, found->second, &updated_entries);
+    else
+      removed_hashes.push_back(*it);
+  }
+  changed_entries_.clear();
+  index_file_->UpdateOnDisk(
+      updated_entries, removed_hashes, cache_size_, start, app_on_background_,
+      base::Bind(&SimpleIndex::UpdateOnDiskDone, AsWeakPtr()));
+}
+
+void SimpleIndex::UpdateOnDiskDone(bool did_update) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (did_update)
+    return;
+  // The table is missing, corrupt or too full. Start over with a new one.
+  full_write_required_ = true;
+  WriteToDisk();
 }
 
 }  // namespace disk_cache
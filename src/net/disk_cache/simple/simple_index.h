@@ -37,6 +37,7 @@ namespace disk_cache {
 
 class SimpleIndexDelegate;
 class SimpleIndexFile;
+class SimpleIndexTable;
 struct SimpleIndexLoadResult;
 
 class NET_EXPORT_PRIVATE EntryMetadata {
@@ -94,7 +95,9 @@ class NET_EXPORT_PRIVATE SimpleIndex
   void Insert(uint64 entry_hash);
   void Remove(uint64 entry_hash);
 
-  // Check whether the index has the entry given the hash of its key.
+  // Check whether the index has the entry given the hash of its key. Before
+  // the index is initialized, the answer comes from the index table on disk
+  // if there is an up to date one, and is true otherwise.
   bool Has(uint64 entry_hash) const;
 
   // Update the last used time of the entry with the given key and return true
@@ -151,9 +154,14 @@ class NET_EXPORT_PRIVATE SimpleIndex
 
   void UpdateEntryIteratorSize(EntrySet::iterator* it, int64 entry_size);
 
+  // Must run on IO Thread.
+  void OnIndexTableMapped(scoped_ptr<SimpleIndexTable> table);
+
   // Must run on IO Thread.
   void MergeInitializingSet(scoped_ptr<SimpleIndexLoadResult> load_result);
 
+  void UpdateOnDiskDone(bool did_update);
+
 #if defined(OS_ANDROID)
   void OnApplicationStateChange(base::android::ApplicationState state);
 
@@ -178,6 +186,18 @@ class NET_EXPORT_PRIVATE SimpleIndex
   base::hash_set<uint64> removed_entries_;
   bool initialized_;
 
+  // The index table mapped from disk, which answers lookups until the index
+  // is initialized.
+  scoped_ptr<SimpleIndexTable> mapped_table_;
+
+  // Hashes of the entries inserted, updated or removed since the index was
+  // last written to disk.
+  base::hash_set<uint64> changed_entries_;
+
+  // Set when the index on disk can't be updated in place, and has to be
+  // written as a whole on the next WriteToDisk().
+  bool full_write_required_;
+
   scoped_ptr<SimpleIndexFile> index_file_;
 
   scoped_refptr<base::SingleThreadTaskRunner> io_thread_;
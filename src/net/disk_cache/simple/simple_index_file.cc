@@ -20,6 +20,7 @@
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -135,7 +136,8 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
 }  // namespace
 
 SimpleIndexLoadResult::SimpleIndexLoadResult() : did_load(false),
-                                                 flush_required(false) {
+                                                 flush_required(false),
+                                                 loaded_from_table(false) {
 }
 
 SimpleIndexLoadResult::~SimpleIndexLoadResult() {
@@ -144,6 +146,7 @@ SimpleIndexLoadResult::~SimpleIndexLoadResult() {
 void SimpleIndexLoadResult::Reset() {
   did_load = false;
   flush_required = false;
+  loaded_from_table = false;
   entries.clear();
 }
 
@@ -152,6 +155,8 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 // static
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
+const char SimpleIndexFile::kIndexTableFileName[] = "the-real-index-table";
+// static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
@@ -193,16 +198,16 @@ bool SimpleIndexFile::IndexMetadata::Deserialize(base::PickleIterator* it) {
       it->ReadUInt64(&cache_size_);
 }
 
-void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
-                                      const base::FilePath& cache_directory,
-                                      const base::FilePath& index_filename,
-                                      const base::FilePath& temp_index_filename,
-                                      scoped_ptr<base::Pickle> pickle,
-                                      const base::TimeTicks& start_time,
-                                      bool app_on_background) {
-  DCHECK_EQ(index_filename.DirName().value(),
-            temp_index_filename.DirName().value());
-  base::FilePath index_file_directory = temp_index_filename.DirName();
+void SimpleIndexFile::SyncWriteToDisk(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& index_filename,
+    const base::FilePath& index_table_filename,
+    scoped_ptr<SimpleIndex::EntrySet> entries,
+    uint64 cache_size,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  base::FilePath index_file_directory = index_table_filename.DirName();
   if (!base::DirectoryExists(index_file_directory) &&
       !base::CreateDirectory(index_file_directory)) {
     LOG(ERROR) << "Could not create a directory to hold the index file";
@@ -219,18 +224,25 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
     LOG(ERROR) << "Could obtain information about cache age";
     return;
   }
-  SerializeFinalData(cache_dir_mtime, pickle.get());
-  if (!WritePickleFile(pickle.get(), temp_index_filename)) {
-    LOG(ERROR) << "Failed to write the temporary index file";
-    return;
-  }
 
-  // Atomically rename the temporary index file to become the real one.
+  // The table is written to a temporary file and atomically renamed over the
+  // real one.
   // TODO(gavinp): DCHECK when not shutting down, since that is very strange.
   // The rename failing during shutdown is legal because it's legal to begin
   // erasing a cache as soon as the destructor has been called.
-  if (!base::ReplaceFile(temp_index_filename, index_filename, NULL))
+  if (!SimpleIndexTable::SyncWrite(index_table_filename, *entries, cache_size,
+                                   cache_dir_mtime)) {
+    LOG(ERROR) << "Failed to write the index table";
+    // Never leave an outdated table behind: incremental updates would apply
+    // on top of it.
+    simple_util::SimpleCacheDeleteFile(index_table_filename);
     return;
+  }
+  // The table replaces the legacy index file, and the temporary file it was
+  // written through, which a crash may have left behind.
+  simple_util::SimpleCacheDeleteFile(index_filename);
+  simple_util::SimpleCacheDeleteFile(
+      index_file_directory.AppendASCII(kTempIndexFileName));
 
   if (app_on_background) {
     SIMPLE_CACHE_UMA(TIMES,
@@ -243,6 +255,40 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   }
 }
 
+// static
+bool SimpleIndexFile::SyncUpdateOnDisk(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& index_table_filename,
+    scoped_ptr<SimpleIndex::EntrySet> updated_entries,
+    scoped_ptr<std::vector<uint64> > removed_hashes,
+    uint64 cache_size,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return false;
+  }
+  const bool did_update = SimpleIndexTable::SyncUpdate(
+      index_table_filename, *updated_entries, *removed_hashes, cache_size,
+      cache_dir_mtime);
+  SIMPLE_CACHE_UMA(BOOLEAN, "IndexUpdateOnDiskResult", cache_type, did_update);
+  if (!did_update)
+    return false;
+
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexUpdateOnDiskTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexUpdateOnDiskTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+  return true;
+}
+
 bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
   return number_of_entries_ <= kMaxEntiresInIndex &&
       magic_number_ == kSimpleIndexMagicNumber &&
@@ -260,19 +306,28 @@ SimpleIndexFile::SimpleIndexFile(
       cache_directory_(cache_directory),
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
                       .AppendASCII(kIndexFileName)),
-      temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+      index_table_file_(cache_directory_.AppendASCII(kIndexDirectory)
+                            .AppendASCII(kIndexTableFileName)) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
 
+void SimpleIndexFile::MapIndexTable(base::Time cache_last_modified,
+                                    const IndexTableCallback& callback) {
+  base::PostTaskAndReplyWithResult(
+      worker_pool_.get(), FROM_HERE,
+      base::Bind(&SimpleIndexFile::SyncMapIndexTable, cache_last_modified,
+                 index_table_file_),
+      callback);
+}
+
 void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
                                        const base::Closure& callback,
                                        SimpleIndexLoadResult* out_result) {
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
                                   cache_type_,
                                   cache_last_modified, cache_directory_,
-                                  index_file_, out_result);
+                                  index_file_, index_table_file_, out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
@@ -281,31 +336,72 @@ void SimpleIndexFile::WriteToDisk(const SimpleIndex::EntrySet& entry_set,
                                   const base::TimeTicks& start,
                                   bool app_on_background,
                                   const base::Closure& callback) {
-  IndexMetadata index_metadata(entry_set.size(), cache_size);
-  scoped_ptr<base::Pickle> pickle = Serialize(index_metadata, entry_set);
+  scoped_ptr<SimpleIndex::EntrySet> entries(
+      new SimpleIndex::EntrySet(entry_set));
   base::Closure task =
       base::Bind(&SimpleIndexFile::SyncWriteToDisk,
-                 cache_type_, cache_directory_, index_file_, temp_index_file_,
-                 base::Passed(&pickle), start, app_on_background);
+                 cache_type_, cache_directory_, index_file_, index_table_file_,
+                 base::Passed(&entries), cache_size, start, app_on_background);
   if (callback.is_null())
     cache_thread_->PostTask(FROM_HERE, task);
   else
     cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
+void SimpleIndexFile::UpdateOnDisk(
+    const SimpleIndex::EntrySet& updated_entries,
+    const std::vector<uint64>& removed_hashes,
+    uint64 cache_size,
+    const base::TimeTicks& start,
+    bool app_on_background,
+    const base::Callback<void(bool)>& callback) {
+  scoped_ptr<SimpleIndex::EntrySet> updated(
+      new SimpleIndex::EntrySet(updated_entries));
+  scoped_ptr<std::vector<uint64> > removed(
+      new std::vector<uint64>(removed_hashes));
+  base::PostTaskAndReplyWithResult(
+      cache_thread_.get(), FROM_HERE,
+      base::Bind(&SimpleIndexFile::SyncUpdateOnDisk, cache_type_,
+                 cache_directory_, index_table_file_, base::Passed(&updated),
+                 base::Passed(&removed), cache_size, start, app_on_background),
+      callback);
+}
+
+// static
+scoped_ptr<SimpleIndexTable> SimpleIndexFile::SyncMapIndexTable(
+    base::Time cache_last_modified,
+    const base::FilePath& index_table_path) {
+  scoped_ptr<SimpleIndexTable> table(new SimpleIndexTable());
+  if (!table->Open(index_table_path) ||
+      cache_last_modified > table->GetCacheLastModified()) {
+    return scoped_ptr<SimpleIndexTable>();
+  }
+  // The table is looked up on the IO thread, which must not block on disk.
+  table->CheckAllPages();
+  return table.Pass();
+}
+
 // static
 void SimpleIndexFile::SyncLoadIndexEntries(
     net::CacheType cache_type,
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    const base::FilePath& index_table_path,
     SimpleIndexLoadResult* out_result) {
-  // Load the index and find its age.
+  // Load the index and find its age. The index table is preferred, the legacy
+  // index file is only there if the table has not been written yet.
   base::Time last_cache_seen_by_index;
-  SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  base::FilePath loaded_file_path = index_table_path;
+  if (!SyncLoadFromTable(index_table_path, &last_cache_seen_by_index,
+                         out_result)) {
+    loaded_file_path = index_file_path;
+    SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  }
 
   // Consider the index loaded if it is fresh.
-  const bool index_file_existed = base::PathExists(index_file_path);
+  const bool index_file_existed = base::PathExists(index_file_path) ||
+                                  base::PathExists(index_table_path);
   if (!out_result->did_load) {
     if (index_file_existed)
       UmaRecordIndexFileState(INDEX_STATE_CORRUPT, cache_type);
@@ -313,13 +409,16 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     if (cache_last_modified <= last_cache_seen_by_index) {
       base::Time latest_dir_mtime;
       simple_util::GetMTime(cache_directory, &latest_dir_mtime);
-      if (LegacyIsIndexFileStale(latest_dir_mtime, index_file_path)) {
+      if (LegacyIsIndexFileStale(latest_dir_mtime, loaded_file_path)) {
         UmaRecordIndexFileState(INDEX_STATE_FRESH_CONCURRENT_UPDATES,
                                 cache_type);
       } else {
         UmaRecordIndexFileState(INDEX_STATE_FRESH, cache_type);
       }
       UmaRecordIndexInitMethod(INITIALIZE_METHOD_LOADED, cache_type);
+      // Replace a legacy index file with a table right away.
+      if (!out_result->loaded_from_table)
+        out_result->flush_required = true;
       return;
     }
     UmaRecordIndexFileState(INDEX_STATE_STALE, cache_type);
@@ -327,7 +426,8 @@ void SimpleIndexFile::SyncLoadIndexEntries(
 
   // Reconstruct the index by scanning the disk for entries.
   const base::TimeTicks start = base::TimeTicks::Now();
-  SyncRestoreFromDisk(cache_directory, index_file_path, out_result);
+  SyncRestoreFromDisk(cache_directory, index_file_path, index_table_path,
+                      out_result);
   SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type,
                    base::TimeTicks::Now() - start);
   SIMPLE_CACHE_UMA(COUNTS, "IndexEntriesRestored", cache_type,
@@ -342,6 +442,27 @@ void SimpleIndexFile::SyncLoadIndexEntries(
   }
 }
 
+// static
+bool SimpleIndexFile::SyncLoadFromTable(
+    const base::FilePath& index_table_path,
+    base::Time* out_last_cache_seen_by_index,
+    SimpleIndexLoadResult* out_result) {
+  out_result->Reset();
+
+  SimpleIndexTable table;
+  if (!table.Open(index_table_path))
+    return false;
+  if (!table.ReadAllEntries(&out_result->entries)) {
+    simple_util::SimpleCacheDeleteFile(index_table_path);
+    return false;
+  }
+
+  *out_last_cache_seen_by_index = table.GetCacheLastModified();
+  out_result->did_load = true;
+  out_result->loaded_from_table = true;
+  return true;
+}
+
 // static
 void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
                                        base::Time* out_last_cache_seen_by_index,
@@ -453,9 +574,11 @@ void SimpleIndexFile::Deserialize(const char* data, int data_len,
 void SimpleIndexFile::SyncRestoreFromDisk(
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+    const base::FilePath& index_table_path,
     SimpleIndexLoadResult* out_result) {
   VLOG(1) << "Simple Cache Index is being restored from disk.";
   simple_util::SimpleCacheDeleteFile(index_file_path);
+  simple_util::SimpleCacheDeleteFile(index_table_path);
   out_result->Reset();
   SimpleIndex::EntrySet* entries = &out_result->entries;
 
@@ -27,6 +27,8 @@ class TaskRunner;
 
 namespace disk_cache {
 
+class SimpleIndexTable;
+
 const uint64 kSimpleIndexMagicNumber = UINT64_C(0x656e74657220796f);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
@@ -37,14 +39,24 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   bool did_load;
   SimpleIndex::EntrySet entries;
   bool flush_required;
+
+  // True if |entries| come from an up to date index table, which can then be
+  // updated incrementally.
+  bool loaded_from_table;
 };
 
-// Simple Index File format is a pickle serialized data of IndexMetadata and
-// EntryMetadata objects. The file format is as follows: one instance of
-// serialized |IndexMetadata| followed serialized |EntryMetadata| entries
-// repeated |number_of_entries| amount of times. To know more about the format,
-// see SimpleIndexFile::Serialize() and SeeSimpleIndexFile::LoadFromDisk()
-// methods.
+// The index is stored on disk as a SimpleIndexTable, see
+// simple_index_table.h. It is written as a whole by WriteToDisk() and then
+// kept up to date by UpdateOnDisk(), which only rewrites the pages holding
+// entries that changed.
+//
+// The legacy Simple Index File format is a pickle serialized data of
+// IndexMetadata and EntryMetadata objects. The file format is as follows: one
+// instance of serialized |IndexMetadata| followed serialized |EntryMetadata|
+// entries repeated |number_of_entries| amount of times. To know more about the
+// format, see SimpleIndexFile::Serialize() and
+// SeeSimpleIndexFile::LoadFromDisk() methods. It is only read when no index
+// table exists yet, and is deleted once the table has been written.
 //
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
@@ -81,6 +93,18 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_directory);
   virtual ~SimpleIndexFile();
 
+  typedef base::Callback<void(scoped_ptr<SimpleIndexTable>)>
+      IndexTableCallback;
+
+  // Maps the index table, so that the index can answer lookups while its
+  // entries are still being loaded. The pages of the table are read and
+  // checked on the worker pool before |callback| runs; that only takes a
+  // scan of the file, while loading the entries also builds the EntrySet.
+  // Runs |callback| with NULL if there is no index table, or if it is older
+  // than |cache_last_modified|.
+  virtual void MapIndexTable(base::Time cache_last_modified,
+                             const IndexTableCallback& callback);
+
   // Get index entries based on current disk context.
   virtual void LoadIndexEntries(base::Time cache_last_modified,
                                 const base::Closure& callback,
@@ -93,6 +117,16 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                            bool app_on_background,
                            const base::Closure& callback);
 
+  // Apply |updated_entries| and |removed_hashes| to the index on disk, in
+  // place. Runs |callback| with false if the index could not be updated, in
+  // which case it must be written anew with WriteToDisk().
+  virtual void UpdateOnDisk(const SimpleIndex::EntrySet& updated_entries,
+                            const std::vector<uint64>& removed_hashes,
+                            uint64 cache_size,
+                            const base::TimeTicks& start,
+                            bool app_on_background,
+                            const base::Callback<void(bool)>& callback);
+
  private:
   friend class WrappedSimpleIndexFile;
 
@@ -103,13 +137,25 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // prevent reallocation on the IO thread when merging in new live entries.
   static const int kExtraSizeForMerge = 512;
 
+  // Synchronous (IO performing) implementation of MapIndexTable.
+  static scoped_ptr<SimpleIndexTable> SyncMapIndexTable(
+      base::Time cache_last_modified,
+      const base::FilePath& index_table_path);
+
   // Synchronous (IO performing) implementation of LoadIndexEntries.
   static void SyncLoadIndexEntries(net::CacheType cache_type,
                                    base::Time cache_last_modified,
                                    const base::FilePath& cache_directory,
                                    const base::FilePath& index_file_path,
+                                   const base::FilePath& index_table_path,
                                    SimpleIndexLoadResult* out_result);
 
+  // Load the index table from disk, returning false if there is none or it
+  // is corrupt.
+  static bool SyncLoadFromTable(const base::FilePath& index_table_path,
+                                base::Time* out_last_cache_seen_by_index,
+                                SimpleIndexLoadResult* out_result);
+
   // Load the index file from disk returning an EntrySet.
   static void SyncLoadFromDisk(const base::FilePath& index_filename,
                                base::Time* out_last_cache_seen_by_index,
@@ -146,19 +192,32 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_path,
       const EntryFileCallback& entry_file_callback);
 
-  // Writes the index file to disk atomically.
+  // Writes the index table to disk atomically, and removes the legacy index
+  // file it replaces.
   static void SyncWriteToDisk(net::CacheType cache_type,
                               const base::FilePath& cache_directory,
                               const base::FilePath& index_filename,
-                              const base::FilePath& temp_index_filename,
-                              scoped_ptr<base::Pickle> pickle,
+                              const base::FilePath& index_table_filename,
+                              scoped_ptr<SimpleIndex::EntrySet> entries,
+                              uint64 cache_size,
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Synchronous (IO performing) implementation of UpdateOnDisk.
+  static bool SyncUpdateOnDisk(net::CacheType cache_type,
+                               const base::FilePath& cache_directory,
+                               const base::FilePath& index_table_filename,
+                               scoped_ptr<SimpleIndex::EntrySet> updated_entries,
+                               scoped_ptr<std::vector<uint64> > removed_hashes,
+                               uint64 cache_size,
+                               const base::TimeTicks& start_time,
+                               bool app_on_background);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
                                   const base::FilePath& index_file_path,
+                                  const base::FilePath& index_table_path,
                                   SimpleIndexLoadResult* out_result);
 
   // Determines if an index file is stale relative to the time of last
@@ -177,10 +236,12 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   const net::CacheType cache_type_;
   const base::FilePath cache_directory_;
   const base::FilePath index_file_;
-  const base::FilePath temp_index_file_;
+  const base::FilePath index_table_file_;
 
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
+  static const char kIndexTableFileName[];
+  // The temporary file legacy index files were written through.
   static const char kTempIndexFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
@@ -0,0 +1,452 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <stddef.h>
+
+#include <map>
+#include <set>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/numerics/safe_conversions.h"
+#include "net/disk_cache/simple/simple_backend_version.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "third_party/zlib/zlib.h"
+
+using base::File;
+
+namespace disk_cache {
+
+struct SimpleIndexTable::Header {
+  uint64 magic_number;
+  uint32 version;
+  uint32 page_count;  // Number of record pages, not counting the header.
+  uint64 entry_count;
+  uint64 removed_count;  // Number of tombstones.
+  uint64 cache_size;
+  int64 cache_last_modified;
+  uint32 crc;  // Covers all the fields above.
+  uint32 padding;
+};
+
+struct SimpleIndexTable::Record {
+  uint64 hash;
+  EntryMetadata metadata;
+};
+
+namespace {
+
+// Hash values that mark free slots. An entry whose hash collides with one of
+// them is not stored in the table, and is treated as a cache miss.
+const uint64 kEmptyHash = 0;
+const uint64 kRemovedHash = 1;
+
+const size_t kRecordSize = 16;
+
+struct PageTrailer {
+  uint32 crc;  // Covers the records of the page.
+  uint32 padding;
+};
+
+const size_t kRecordsPerPage =
+    (SimpleIndexTable::kPageSize - sizeof(PageTrailer)) / kRecordSize;
+const size_t kRecordsSize = kRecordsPerPage * kRecordSize;
+
+// Keep the table at most half full when it is written anew, and give up on
+// incremental updates once live entries and tombstones fill three quarters of
+// it.
+const uint64 kInitialLoadFactorPercent = 50;
+const uint64 kMaxLoadFactorPercent = 75;
+
+const uint32 kMaxPageCount = 1 << 20;
+
+uint32 CalculateCRC(const void* data, size_t length) {
+  return crc32(crc32(0, Z_NULL, 0), static_cast<const Bytef*>(data),
+               base::checked_cast<uInt>(length));
+}
+
+bool IsPageValid(const char* page) {
+  const PageTrailer* trailer =
+      reinterpret_cast<const PageTrailer*>(page + kRecordsSize);
+  return trailer->crc == CalculateCRC(page, kRecordsSize);
+}
+
+void SealPage(char* page) {
+  PageTrailer* trailer = reinterpret_cast<PageTrailer*>(page + kRecordsSize);
+  trailer->crc = CalculateCRC(page, kRecordsSize);
+}
+
+int64 GetPageOffset(uint64 page) {
+  // The header takes the first page of the file.
+  return static_cast<int64>(page + 1) * SimpleIndexTable::kPageSize;
+}
+
+bool IsStorableHash(uint64 entry_hash) {
+  return entry_hash != kEmptyHash && entry_hash != kRemovedHash;
+}
+
+}  // namespace
+
+// The pages of a table being updated. Pages are read and checked on first
+// access, and written back by Flush() if they were modified.
+class SimpleIndexTable::PageSet {
+ public:
+  PageSet(File* file, uint32 page_count)
+      : file_(file), page_count_(page_count) {}
+
+  ~PageSet() {
+    for (PageMap::iterator it = pages_.begin(); it != pages_.end(); ++it)
+      delete[] it->second;
+  }
+
+  // Returns the records of |page|, or NULL if it can't be read or is corrupt.
+  Record* GetPageRecords(uint32 page) {
+    DCHECK_LT(page, page_count_);
+    PageMap::const_iterator it = pages_.find(page);
+    if (it != pages_.end())
+      return reinterpret_cast<Record*>(it->second);
+
+    scoped_ptr<char[]> data(new char[kPageSize]);
+    int bytes_read = file_->Read(GetPageOffset(page), data.get(), kPageSize);
+    if (bytes_read != static_cast<int>(kPageSize) || !IsPageValid(data.get()))
+      return NULL;
+
+    char* page_data = data.release();
+    pages_[page] = page_data;
+    return reinterpret_cast<Record*>(page_data);
+  }
+
+  Record* GetRecord(uint64 slot) {
+    return GetPageRecords(static_cast<uint32>(slot / kRecordsPerPage)) +
+           slot % kRecordsPerPage;
+  }
+
+  void MarkDirty(uint64 slot) {
+    dirty_pages_.insert(static_cast<uint32>(slot / kRecordsPerPage));
+  }
+
+  bool Flush() {
+    for (std::set<uint32>::const_iterator it = dirty_pages_.begin();
+         it != dirty_pages_.end(); ++it) {
+      char* page_data = pages_[*it];
+      SealPage(page_data);
+      int bytes_written =
+          file_->Write(GetPageOffset(*it), page_data, kPageSize);
+      if (bytes_written != static_cast<int>(kPageSize))
+        return false;
+    }
+    return true;
+  }
+
+ private:
+  typedef std::map<uint32, char*> PageMap;
+
+  File* const file_;
+  const uint32 page_count_;
+  PageMap pages_;
+  std::set<uint32> dirty_pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(PageSet);
+};
+
+// static
+template <typename RecordType, typename PageSource>
+SimpleIndexTable::ProbeResult SimpleIndexTable::Probe(PageSource* source,
+                                                      uint32 page_count,
+                                                      uint64 entry_hash,
+                                                      uint64* out_slot) {
+  const uint64 capacity = static_cast<uint64>(page_count) * kRecordsPerPage;
+  uint64 slot = entry_hash % capacity;
+  bool have_free_slot = false;
+  for (uint64 i = 0; i < capacity; ++i, slot = (slot + 1) % capacity) {
+    RecordType* records =
+        source->GetPageRecords(static_cast<uint32>(slot / kRecordsPerPage));
+    if (!records)
+      return PROBE_CORRUPT;
+    const uint64 hash = records[slot % kRecordsPerPage].hash;
+    if (hash == entry_hash) {
+      *out_slot = slot;
+      return PROBE_FOUND;
+    }
+    if (hash == kEmptyHash) {
+      if (!have_free_slot)
+        *out_slot = slot;
+      return PROBE_NOT_FOUND;
+    }
+    // Reuse the first tombstone on the way, but keep looking in case the
+    // entry is further down the sequence.
+    if (hash == kRemovedHash && !have_free_slot) {
+      have_free_slot = true;
+      *out_slot = slot;
+    }
+  }
+  return have_free_slot ? PROBE_NOT_FOUND : PROBE_FULL;
+}
+
+SimpleIndexTable::SimpleIndexTable() : page_count_(0) {
+  static_assert(sizeof(Record) == kRecordSize, "unexpected record size");
+  static_assert(sizeof(Header) <= kPageSize, "header does not fit a page");
+}
+
+SimpleIndexTable::~SimpleIndexTable() {}
+
+bool SimpleIndexTable::Open(const base::FilePath& file_name) {
+  DCHECK(!file_map_.IsValid());
+  File file(file_name,
+            File::FLAG_OPEN | File::FLAG_READ | File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return false;
+
+  if (!file_map_.Initialize(file.Pass()) || file_map_.length() < kPageSize)
+    return false;
+
+  const Header* table_header = header();
+  if (table_header->magic_number != kSimpleIndexTableMagicNumber ||
+      table_header->version != kSimpleVersion ||
+      table_header->crc != CalculateCRC(table_header, offsetof(Header, crc)) ||
+      table_header->page_count == 0 ||
+      table_header->page_count > kMaxPageCount ||
+      file_map_.length() <
+          static_cast<size_t>(GetPageOffset(table_header->page_count))) {
+    LOG(WARNING) << "Invalid Simple Index Table header.";
+    return false;
+  }
+
+  page_count_ = table_header->page_count;
+  page_states_.assign(page_count_, PAGE_UNCHECKED);
+  return true;
+}
+
+void SimpleIndexTable::CheckAllPages() {
+  DCHECK(file_map_.IsValid());
+  for (uint32 page = 0; page < page_count_; ++page)
+    GetPageRecords(page);
+}
+
+SimpleIndexTable::LookupResult SimpleIndexTable::Find(
+    uint64 entry_hash,
+    EntryMetadata* out_metadata) const {
+  DCHECK(file_map_.IsValid());
+  if (!IsStorableHash(entry_hash))
+    return LOOKUP_UNKNOWN;
+
+  uint64 slot = 0;
+  switch (Probe<const Record>(this, page_count_, entry_hash, &slot)) {
+    case PROBE_FOUND:
+      *out_metadata = GetPageRecords(static_cast<uint32>(
+          slot / kRecordsPerPage))[slot % kRecordsPerPage].metadata;
+      return LOOKUP_FOUND;
+    case PROBE_NOT_FOUND:
+    case PROBE_FULL:
+      return LOOKUP_NOT_FOUND;
+    case PROBE_CORRUPT:
+      return LOOKUP_UNKNOWN;
+  }
+  NOTREACHED();
+  return LOOKUP_UNKNOWN;
+}
+
+bool SimpleIndexTable::ReadAllEntries(
+    SimpleIndex::EntrySet* out_entries) const {
+  DCHECK(file_map_.IsValid());
+  out_entries->clear();
+  for (uint32 page = 0; page < page_count_; ++page) {
+    const Record* records = GetPageRecords(page);
+    if (!records) {
+      LOG(WARNING) << "Corrupt page in Simple Index Table.";
+      out_entries->clear();
+      return false;
+    }
+    for (size_t i = 0; i < kRecordsPerPage; ++i) {
+      if (IsStorableHash(records[i].hash)) {
+        SimpleIndex::InsertInEntrySet(records[i].hash, records[i].metadata,
+                                      out_entries);
+      }
+    }
+  }
+  return true;
+}
+
+uint64 SimpleIndexTable::GetEntryCount() const {
+  return header()->entry_count;
+}
+
+uint64 SimpleIndexTable::GetCacheSize() const {
+  return header()->cache_size;
+}
+
+base::Time SimpleIndexTable::GetCacheLastModified() const {
+  return base::Time::FromInternalValue(header()->cache_last_modified);
+}
+
+// static
+bool SimpleIndexTable::SyncWrite(const base::FilePath& file_name,
+                                 const SimpleIndex::EntrySet& entries,
+                                 uint64 cache_size,
+                                 base::Time cache_last_modified) {
+  const uint64 wanted_capacity =
+      entries.size() * 100 / kInitialLoadFactorPercent + 1;
+  const uint64 page_count =
+      (wanted_capacity + kRecordsPerPage - 1) / kRecordsPerPage;
+  if (page_count > kMaxPageCount)
+    return false;
+
+  const size_t file_size = static_cast<size_t>(GetPageOffset(page_count));
+  std::vector<char> buffer(file_size, 0);
+
+  uint64 entry_count = 0;
+  const uint64 capacity = page_count * kRecordsPerPage;
+  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    if (!IsStorableHash(it->first))
+      continue;
+    for (uint64 slot = it->first % capacity;; slot = (slot + 1) % capacity) {
+      Record* record = reinterpret_cast<Record*>(
+          &buffer[GetPageOffset(slot / kRecordsPerPage)]) +
+          slot % kRecordsPerPage;
+      if (record->hash == kEmptyHash) {
+        record->hash = it->first;
+        record->metadata = it->second;
+        break;
+      }
+    }
+    ++entry_count;
+  }
+
+  for (uint64 page = 0; page < page_count; ++page)
+    SealPage(&buffer[GetPageOffset(page)]);
+
+  Header* table_header = reinterpret_cast<Header*>(&buffer[0]);
+  table_header->magic_number = kSimpleIndexTableMagicNumber;
+  table_header->version = kSimpleVersion;
+  table_header->page_count = static_cast<uint32>(page_count);
+  table_header->entry_count = entry_count;
+  table_header->removed_count = 0;
+  table_header->cache_size = cache_size;
+  table_header->cache_last_modified = cache_last_modified.ToInternalValue();
+  table_header->crc = CalculateCRC(table_header, offsetof(Header, crc));
+
+  // Write to a temporary file first so that a crash never leaves a half
+  // written table behind.
+  const base::FilePath temp_file_name =
+      file_name.AddExtension(FILE_PATH_LITERAL("tmp"));
+  File file(temp_file_name, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE |
+                                File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return false;
+  int bytes_written = file.Write(0, &buffer[0], file_size);
+  file.Close();
+  if (bytes_written != base::checked_cast<int>(file_size)) {
+    simple_util::SimpleCacheDeleteFile(temp_file_name);
+    return false;
+  }
+  if (!base::ReplaceFile(temp_file_name, file_name, NULL)) {
+    simple_util::SimpleCacheDeleteFile(temp_file_name);
+    return false;
+  }
+  return true;
+}
+
+// static
+bool SimpleIndexTable::SyncUpdate(const base::FilePath& file_name,
+                                  const SimpleIndex::EntrySet& updated_entries,
+                                  const std::vector<uint64>& removed_hashes,
+                                  uint64 cache_size,
+                                  base::Time cache_last_modified) {
+  File file(file_name, File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE |
+                           File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return false;
+
+  Header table_header;
+  if (file.Read(0, reinterpret_cast<char*>(&table_header),
+                sizeof(table_header)) != sizeof(table_header) ||
+      table_header.magic_number != kSimpleIndexTableMagicNumber ||
+      table_header.version != kSimpleVersion ||
+      table_header.crc != CalculateCRC(&table_header, offsetof(Header, crc)) ||
+      table_header.page_count == 0 ||
+      table_header.page_count > kMaxPageCount) {
+    return false;
+  }
+
+  const uint64 capacity =
+      static_cast<uint64>(table_header.page_count) * kRecordsPerPage;
+  PageSet pages(&file, table_header.page_count);
+
+  for (std::vector<uint64>::const_iterator it = removed_hashes.begin();
+       it != removed_hashes.end(); ++it) {
+    if (!IsStorableHash(*it))
+      continue;
+    uint64 slot = 0;
+    ProbeResult result =
+        Probe<Record>(&pages, table_header.page_count, *it, &slot);
+    if (result == PROBE_CORRUPT)
+      return false;
+    if (result != PROBE_FOUND)
+      continue;
+    pages.GetRecord(slot)->hash = kRemovedHash;
+    pages.MarkDirty(slot);
+    --table_header.entry_count;
+    ++table_header.removed_count;
+  }
+
+  for (SimpleIndex::EntrySet::const_iterator it = updated_entries.begin();
+       it != updated_entries.end(); ++it) {
+    if (!IsStorableHash(it->first))
+      continue;
+    uint64 slot = 0;
+    ProbeResult result =
+        Probe<Record>(&pages, table_header.page_count, it->first, &slot);
+    if (result == PROBE_CORRUPT || result == PROBE_FULL)
+      return false;
+    Record* record = pages.GetRecord(slot);
+    if (result == PROBE_NOT_FOUND) {
+      if (record->hash == kRemovedHash)
+        --table_header.removed_count;
+      ++table_header.entry_count;
+      if ((table_header.entry_count + table_header.removed_count) * 100 >
+          capacity * kMaxLoadFactorPercent) {
+        return false;
+      }
+      record->hash = it->first;
+    }
+    record->metadata = it->second;
+    pages.MarkDirty(slot);
+  }
+
+  // Nothing has been written so far. From now on a failure, or a crash, may
+  // leave some pages updated and the header not. A torn page fails its
+  // checksum, which makes the loader discard the table; otherwise the caller
+  // rewrites the table with SyncWrite().
+  if (!pages.Flush())
+    return false;
+  table_header.cache_size = cache_size;
+  table_header.cache_last_modified = cache_last_modified.ToInternalValue();
+  table_header.crc = CalculateCRC(&table_header, offsetof(Header, crc));
+  return file.Write(0, reinterpret_cast<const char*>(&table_header),
+                    sizeof(table_header)) == sizeof(table_header);
+}
+
+const SimpleIndexTable::Header* SimpleIndexTable::header() const {
+  return reinterpret_cast<const Header*>(file_map_.data());
+}
+
+const SimpleIndexTable::Record* SimpleIndexTable::GetPageRecords(
+    uint32 page) const {
+  DCHECK_LT(page, page_count_);
+  const char* page_data =
+      reinterpret_cast<const char*>(file_map_.data()) + GetPageOffset(page);
+  if (page_states_[page] == PAGE_UNCHECKED)
+    page_states_[page] = IsPageValid(page_data) ? PAGE_VALID : PAGE_CORRUPT;
+  if (page_states_[page] == PAGE_CORRUPT)
+    return NULL;
+  return reinterpret_cast<const Record*>(page_data);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,140 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace disk_cache {
+
+const uint64 kSimpleIndexTableMagicNumber = UINT64_C(0x6e647874626c6573);
+
+// The Simple Index Table is an on-disk open addressing hash table of
+// EntryMetadata, designed to be memory mapped and queried in place, and to be
+// updated one page at a time instead of being rewritten as a whole.
+//
+// The file is made of fixed size pages. The first page holds a Header, and
+// every following page holds kRecordsPerPage fixed size records and a
+// PageTrailer with the CRC of the records. An entry lives in the first free
+// slot found by linear probing from |entry_hash| % capacity, possibly spanning
+// several pages. Removed entries leave a tombstone behind so that probe
+// sequences of other entries are not broken.
+//
+// A table is only ever read on one thread at a time, and readers never take
+// locks: the mapped view is immutable for as long as it is in use. Writes
+// happen through SyncUpdate() and SyncWrite(), on the cache thread, after the
+// in-memory index has taken over from the mapped view.
+class NET_EXPORT_PRIVATE SimpleIndexTable {
+ public:
+  enum LookupResult {
+    LOOKUP_FOUND,
+    LOOKUP_NOT_FOUND,
+    // The page holding the answer failed its checksum.
+    LOOKUP_UNKNOWN,
+  };
+
+  static const size_t kPageSize = 4096;
+
+  SimpleIndexTable();
+  ~SimpleIndexTable();
+
+  // Maps the table stored in |file_name| and checks its header. Pages are
+  // checked lazily, the first time they are looked at, and a corrupt page
+  // only makes its lookups return LOOKUP_UNKNOWN. Returns false if the file
+  // does not exist or is not a valid table.
+  bool Open(const base::FilePath& file_name);
+
+  // Reads and checks every page, so that lookups find them resident and never
+  // have to check them. This blocks on disk IO, so it has to happen on the
+  // worker pool before the table is handed to the IO thread.
+  void CheckAllPages();
+
+  // Looks up |entry_hash|, filling |out_metadata| if it is found.
+  LookupResult Find(uint64 entry_hash, EntryMetadata* out_metadata) const;
+
+  // Fills |out_entries| with every entry in the table. Returns false, leaving
+  // |out_entries| empty, if any page is corrupt.
+  bool ReadAllEntries(SimpleIndex::EntrySet* out_entries) const;
+
+  uint64 GetEntryCount() const;
+  uint64 GetCacheSize() const;
+  base::Time GetCacheLastModified() const;
+
+  // Writes a new table holding |entries| to |file_name|, sized so that it can
+  // absorb a fair amount of incremental updates. Returns false on IO error.
+  static bool SyncWrite(const base::FilePath& file_name,
+                        const SimpleIndex::EntrySet& entries,
+                        uint64 cache_size,
+                        base::Time cache_last_modified);
+
+  // Applies |updated_entries| and |removed_hashes| to the table stored in
+  // |file_name|, rewriting only the pages they touch and the header. Returns
+  // false if the table is missing, corrupt or too full to take the update,
+  // in which case the file is left unchanged, or if writing it fails, in
+  // which case some pages may have been updated and the header not. Either
+  // way the caller should then write the table anew with SyncWrite().
+  static bool SyncUpdate(const base::FilePath& file_name,
+                         const SimpleIndex::EntrySet& updated_entries,
+                         const std::vector<uint64>& removed_hashes,
+                         uint64 cache_size,
+                         base::Time cache_last_modified);
+
+ private:
+  struct Header;
+  struct Record;
+  class PageSet;
+
+  enum ProbeResult {
+    PROBE_FOUND,
+    PROBE_NOT_FOUND,
+    PROBE_CORRUPT,
+    PROBE_FULL,
+  };
+
+  enum PageState {
+    PAGE_UNCHECKED,
+    PAGE_VALID,
+    PAGE_CORRUPT,
+  };
+
+  // Walks the probe sequence of |entry_hash| over the pages of |source|. On
+  // return, |*out_slot| is the slot holding |entry_hash| if it was found, or
+  // else the slot where it should be inserted.
+  template <typename RecordType, typename PageSource>
+  static ProbeResult Probe(PageSource* source,
+                           uint32 page_count,
+                           uint64 entry_hash,
+                           uint64* out_slot);
+
+  const Header* header() const;
+
+  // Returns the records of |page|, or NULL if the page is corrupt.
+  const Record* GetPageRecords(uint32 page) const;
+
+  base::MemoryMappedFile file_map_;
+  uint32 page_count_;
+
+  // Pages are validated on first use, or all at once by CheckAllPages(). This
+  // is the only state that lookups modify.
+  mutable std::vector<uint8> page_states_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleIndexTable);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
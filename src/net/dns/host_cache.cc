@@ -8,6 +8,8 @@
 #include "base/metrics/field_trial.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+#include "net/base/ip_address_number.h"
 #include "net/base/net_errors.h"
 
 namespace net {
@@ -18,14 +20,16 @@ HostCache::Entry::Entry(int error, const AddressList& addrlist,
                         base::TimeDelta ttl)
     : error(error),
       addrlist(addrlist),
-      ttl(ttl) {
+      ttl(ttl),
+      hit_count(0) {
   DCHECK(ttl >= base::TimeDelta());
 }
 
 HostCache::Entry::Entry(int error, const AddressList& addrlist)
     : error(error),
       addrlist(addrlist),
-      ttl(base::TimeDelta::FromSeconds(-1)) {
+      ttl(base::TimeDelta::FromSeconds(-1)),
+      hit_count(0) {
 }
 
 HostCache::Entry::~Entry() {
@@ -49,6 +53,32 @@ const HostCache::Entry* HostCache::Lookup(const Key& key,
   return entries_.Get(key, now);
 }
 
+const HostCache::Entry* HostCache::LookupStale(const Key& key,
+                                               base::TimeTicks now,
+                                               base::TimeDelta max_stale,
+                                               EntryStaleness* staleness) {
+  DCHECK(CalledOnValidThread());
+  DCHECK(staleness);
+  if (caching_is_disabled())
+    return NULL;
+
+  base::TimeTicks expiration;
+  Entry* entry = entries_.GetIgnoringExpiration(key, &expiration);
+  if (!entry)
+    return NULL;
+
+  if (now >= expiration && now - expiration >= max_stale) {
+    // Let Get() remove the entry, and record it.
+    entries_.Get(key, now);
+    return NULL;
+  }
+
+  ++entry->hit_count;
+  staleness->expired_by = now - expiration;
+  staleness->hit_count = entry->hit_count;
+  return entry;
+}
+
 void HostCache::Set(const Key& key,
                     const Entry& entry,
                     base::TimeTicks now,
@@ -57,7 +87,16 @@ void HostCache::Set(const Key& key,
   if (caching_is_disabled())
     return;
 
-  entries_.Put(key, entry, now, now + ttl);
+  // Keep counting the hits of the key across updates, so that a refreshed
+  // entry is still known to be used often.
+  Entry new_entry(entry);
+  base::TimeTicks old_expiration;
+  const Entry* old_entry =
+      entries_.GetIgnoringExpiration(key, &old_expiration);
+  if (old_entry)
+    new_entry.hit_count = old_entry->hit_count;
+
+  entries_.Put(key, new_entry, now, now + ttl);
 }
 
 void HostCache::clear() {
@@ -70,6 +109,98 @@ size_t HostCache::size() const {
   return entries_.size();
 }
 
+void HostCache::GetAsListValue(base::ListValue* entry_list) const {
+  DCHECK(CalledOnValidThread());
+  DCHECK(entry_list);
+
+  // Expiration times are saved as wall clock times, since TimeTicks do not
+  // carry over to the next run.
+  base::TimeTicks now_ticks = base::TimeTicks::Now();
+  base::Time now = base::Time::Now();
+
+  for (EntryMap::Iterator it(entries_); it.HasNext(); it.Advance()) {
+    const Key& key = it.key();
+    const Entry& entry = it.value();
+    if (entry.error != OK || entry.addrlist.empty())
+      continue;
+
+    scoped_ptr<base::DictionaryValue> entry_dict(new base::DictionaryValue());
+    entry_dict->SetString("hostname", key.hostname);
+    entry_dict->SetInteger("address_family",
+                           static_cast<int>(key.address_family));
+    entry_dict->SetInteger("flags", key.host_resolver_flags);
+    base::Time expiration = now + (it.expiration() - now_ticks);
+    entry_dict->SetString("expiration",
+                          base::Int64ToString(expiration.ToInternalValue()));
+
+    scoped_ptr<base::ListValue> address_list(new base::ListValue());
+    for (size_t i = 0; i < entry.addrlist.size(); ++i)
+      address_list->AppendString(entry.addrlist[i].ToStringWithoutPort());
+    entry_dict->Set("addresses", address_list.Pass());
+
+    entry_list->Append(entry_dict.Pass());
+  }
+}
+
+bool HostCache::RestoreFromListValue(const base::ListValue& entry_list) {
+  DCHECK(CalledOnValidThread());
+  if (caching_is_disabled())
+    return true;
+
+  base::TimeTicks now_ticks = base::TimeTicks::Now();
+  base::Time now = base::Time::Now();
+  bool success = true;
+
+  for (base::ListValue::const_iterator it = entry_list.begin();
+       it != entry_list.end(); ++it) {
+    const base::DictionaryValue* entry_dict;
+    std::string hostname;
+    int address_family;
+    int flags;
+    std::string expiration_string;
+    int64 expiration_value;
+    const base::ListValue* address_list;
+    if (!(*it)->GetAsDictionary(&entry_dict) ||
+        !entry_dict->GetString("hostname", &hostname) ||
+        !entry_dict->GetInteger("address_family", &address_family) ||
+        !entry_dict->GetInteger("flags", &flags) ||
+        !entry_dict->GetString("expiration", &expiration_string) ||
+        !base::StringToInt64(expiration_string, &expiration_value) ||
+        !entry_dict->GetList("addresses", &address_list) ||
+        address_family < ADDRESS_FAMILY_UNSPECIFIED ||
+        address_family > ADDRESS_FAMILY_LAST) {
+      success = false;
+      continue;
+    }
+
+    AddressList addrlist;
+    for (base::ListValue::const_iterator address_it = address_list->begin();
+         address_it != address_list->end(); ++address_it) {
+      std::string address_string;
+      IPAddressNumber address;
+      if (!(*address_it)->GetAsString(&address_string) ||
+          !ParseIPLiteralToNumber(address_string, &address)) {
+        success = false;
+        continue;
+      }
+      addrlist.push_back(IPEndPoint(address, 0));
+    }
+    if (addrlist.empty())
+      continue;
+
+    // Entries resolved during this run are more recent.
+    Key key(hostname, static_cast<AddressFamily>(address_family), flags);
+    base::TimeTicks old_expiration;
+    if (entries_.GetIgnoringExpiration(key, &old_expiration))
+      continue;
+
+    base::Time expiration = base::Time::FromInternalValue(expiration_value);
+    entries_.Put(key, Entry(OK, addrlist), now_ticks,
+                 now_ticks + (expiration - now));
+  }
+  return success;
+}
+
 size_t HostCache::max_entries() const {
   DCHECK(CalledOnValidThread());
   return entries_.max_entries();
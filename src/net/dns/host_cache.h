@@ -17,6 +17,10 @@
 #include "net/base/expiring_cache.h"
 #include "net/base/net_export.h"
 
+namespace base {
+class ListValue;
+}
+
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
@@ -36,6 +40,17 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
     AddressList addrlist;
     // TTL obtained from the nameserver. Negative if unknown.
     base::TimeDelta ttl;
+    // Number of lookups that returned this entry, or the entries it replaced
+    // for the same key.
+    int hit_count;
+  };
+
+  // Describes an entry returned by LookupStale().
+  struct EntryStaleness {
+    // Time since the entry expired. Negative if it has yet to expire.
+    base::TimeDelta expired_by;
+    // The hit count of the entry, including this lookup.
+    int hit_count;
   };
 
   struct Key {
@@ -82,6 +97,14 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // |now|. If there is no such entry, returns NULL.
   const Entry* Lookup(const Key& key, base::TimeTicks now);
 
+  // Like Lookup(), but also returns an entry that expired less than
+  // |max_stale| before |now|, and describes it in |*staleness|. Entries that
+  // expired longer ago are removed.
+  const Entry* LookupStale(const Key& key,
+                           base::TimeTicks now,
+                           base::TimeDelta max_stale,
+                           EntryStaleness* staleness);
+
   // Overwrites or creates an entry for |key|.
   // |entry| is the value to set, |now| is the current time
   // |ttl| is the "time to live".
@@ -96,6 +119,16 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // Returns the number of entries in the cache.
   size_t size() const;
 
+  // Appends the successful entries of the cache to |entry_list|, so that they
+  // can be saved and restored when the network stack is next started.
+  void GetAsListValue(base::ListValue* entry_list) const;
+
+  // Adds the entries of |entry_list|, as returned by GetAsListValue(), that
+  // are not already in the cache. They keep their expiration time, so entries
+  // that have expired since they were saved can only be returned by
+  // LookupStale(). Returns false if some of the entries could not be parsed.
+  bool RestoreFromListValue(const base::ListValue& entry_list);
+
   // Following are used by net_internals UI.
   size_t max_entries() const;
 
@@ -9,6 +9,7 @@
 
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
 #include "net/base/address_family.h"
 #include "net/base/completion_callback.h"
 #include "net/base/host_port_pair.h"
@@ -54,6 +55,12 @@ class NET_EXPORT HostResolver {
     size_t max_concurrent_resolves;
     size_t max_retry_attempts;
     bool enable_caching;
+    // If positive, cached results that expired less than this long ago are
+    // still returned, while the host is resolved again in the background.
+    base::TimeDelta max_stale_cache_age;
+    // If true, cached results that are used often are resolved again in the
+    // background shortly before they expire.
+    bool refresh_hot_cache_entries;
   };
 
   // The parameters for doing a Resolve(). A hostname and port are
@@ -74,6 +74,16 @@ const unsigned kNegativeCacheEntryTTLSeconds = 0;
 // Minimum TTL for successful resolutions with DnsTask.
 const unsigned kMinimumTTLSeconds = kCacheEntryTTLSeconds;
 
+// When |refresh_hot_cache_entries_| is set, cache entries that have been
+// returned at least kHotCacheEntryMinHits times are resolved again once they
+// are due to expire within kHotCacheEntryRefreshSeconds.
+const int kHotCacheEntryMinHits = 3;
+const int kHotCacheEntryRefreshSeconds = 10;
+
+// After a refresh of a cache entry fails, the entry is not refreshed again for
+// this long, so that every stale hit on it does not start another Job.
+const int kFailedRefreshBackoffSeconds = 30;
+
 // Time between IPv6 probes, i.e. for how long results of each IPv6 probe are
 // cached.
 const int kIPv6ProbePeriodMs = 1000;
@@ -1249,6 +1259,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
         key_(key),
         priority_tracker_(priority),
         had_non_speculative_request_(false),
+        is_cache_refresh_(false),
         had_dns_config_(false),
         num_occupied_job_slots_(0),
         dns_task_error_(OK),
@@ -1361,7 +1372,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
 
     if (num_active_requests() > 0) {
       UpdatePriority();
-    } else {
+    } else if (!is_cache_refresh_) {
       // If we were called from a Request's callback within CompleteRequests,
       // that Request could not have been cancelled, so num_active_requests()
       // could not be 0. Therefore, we are not in CompleteRequests().
@@ -1401,7 +1412,12 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
   // Attempts to serve the job from HOSTS. Returns true if succeeded and
   // this Job was destroyed.
   bool ServeFromHosts() {
-    DCHECK_GT(num_active_requests(), 0u);
+    // A cache refresh may have no request to take the port from; it keeps
+    // running instead.
+    if (num_active_requests() == 0) {
+      DCHECK(is_cache_refresh_);
+      return false;
+    }
     AddressList addr_list;
     if (resolver_->ServeFromHosts(key(),
                                   requests_.front()->info(),
@@ -1417,6 +1433,10 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
 
   const Key& key() const { return key_; }
 
+  // Marks this Job as resolving its key to refresh the cache, so that it
+  // runs to completion and caches its result even if no request is attached.
+  void set_is_cache_refresh() { is_cache_refresh_ = true; }
+
   bool is_queued() const {
     return !handle_.is_null();
   }
@@ -1705,6 +1725,18 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
       handle_.Reset();
     }
 
+    if (num_active_requests() == 0 && is_cache_refresh_) {
+      // Failures are not cached, leaving the entry that was being refreshed
+      // in place.
+      if (entry.error == OK)
+        resolver_->CacheResult(key_, entry, ttl);
+      else
+        resolver_->failed_refresh_times_[key_] = base::TimeTicks::Now();
+      net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
+                                        entry.error);
+      return;
+    }
+
     if (num_active_requests() == 0) {
       net_log_.AddEvent(NetLog::TYPE_CANCELLED);
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
@@ -1786,6 +1818,9 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job,
 
   bool had_non_speculative_request_;
 
+  // See set_is_cache_refresh().
+  bool is_cache_refresh_;
+
   // Distinguishes measurements taken while DnsClient was fully configured.
   bool had_dns_config_;
 
@@ -1833,6 +1868,8 @@ HostResolverImpl::ProcTaskParams::~ProcTaskParams() {}
 HostResolverImpl::HostResolverImpl(const Options& options, NetLog* net_log)
     : max_queued_jobs_(0),
       proc_params_(NULL, options.max_retry_attempts),
+      max_stale_cache_age_(options.max_stale_cache_age),
+      refresh_hot_cache_entries_(options.refresh_hot_cache_entries),
       net_log_(net_log),
       received_dns_config_(false),
       num_dns_failures_(0),
@@ -1977,8 +2014,11 @@ int HostResolverImpl::ResolveHelper(const Key& key,
   int net_error = ERR_UNEXPECTED;
   if (ResolveAsIP(key, info, ip_number, &net_error, addresses))
     return net_error;
-  if (ServeFromCache(key, info, &net_error, addresses)) {
+  bool needs_refresh = false;
+  if (ServeFromCache(key, info, &net_error, addresses, &needs_refresh)) {
     source_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT);
+    if (needs_refresh)
+      RefreshCacheEntry(key, source_net_log);
     return net_error;
   }
   // TODO(szym): Do not do this if nsswitch.conf instructs not to.
@@ -2085,17 +2125,35 @@ bool HostResolverImpl::ResolveAsIP(const Key& key,
 bool HostResolverImpl::ServeFromCache(const Key& key,
                                       const RequestInfo& info,
                                       int* net_error,
-                                      AddressList* addresses) {
+                                      AddressList* addresses,
+                                      bool* needs_refresh) {
   DCHECK(addresses);
   DCHECK(net_error);
+  DCHECK(needs_refresh);
   if (!info.allow_cached_response() || !cache_.get())
     return false;
 
-  const HostCache::Entry* cache_entry = cache_->Lookup(
-      key, base::TimeTicks::Now());
+  HostCache::EntryStaleness staleness;
+  const HostCache::Entry* cache_entry = cache_->LookupStale(
+      key, base::TimeTicks::Now(), max_stale_cache_age_, &staleness);
   if (!cache_entry)
     return false;
 
+  if (staleness.expired_by >= base::TimeDelta()) {
+    // Only addresses are worth serving stale; a failure is retried.
+    if (cache_entry->error != OK)
+      return false;
+    UMA_HISTOGRAM_CUSTOM_TIMES("DNS.CacheStaleHit", staleness.expired_by,
+                               base::TimeDelta::FromSeconds(1),
+                               base::TimeDelta::FromDays(1), 100);
+    *needs_refresh = true;
+  } else if (refresh_hot_cache_entries_ && cache_entry->error == OK &&
+             staleness.hit_count >= kHotCacheEntryMinHits &&
+             -staleness.expired_by <
+                 base::TimeDelta::FromSeconds(kHotCacheEntryRefreshSeconds)) {
+    *needs_refresh = true;
+  }
+
   *net_error = cache_entry->error;
   if (*net_error == OK) {
     if (cache_entry->has_ttl())
@@ -2187,6 +2245,29 @@ void HostResolverImpl::CacheResult(const Key& key,
                                    base::TimeDelta ttl) {
   if (cache_.get())
     cache_->Set(key, entry, base::TimeTicks::Now(), ttl);
+  failed_refresh_times_.erase(key);
+}
+
+void HostResolverImpl::RefreshCacheEntry(const Key& key,
+                                         const BoundNetLog& source_net_log) {
+  if (jobs_.find(key) != jobs_.end())
+    return;
+  FailedRefreshMap::iterator failed_it = failed_refresh_times_.find(key);
+  if (failed_it != failed_refresh_times_.end()) {
+    if (base::TimeTicks::Now() - failed_it->second <
+        base::TimeDelta::FromSeconds(kFailedRefreshBackoffSeconds)) {
+      return;
+    }
+    failed_refresh_times_.erase(failed_it);
+  }
+  // Refreshes are not worth evicting requests for.
+  if (dispatcher_->num_queued_jobs() >= max_queued_jobs_)
+    return;
+
+  Job* job = new Job(weak_ptr_factory_.GetWeakPtr(), key, IDLE, source_net_log);
+  job->set_is_cache_refresh();
+  job->Schedule(false);
+  jobs_.insert(std::make_pair(key, job));
 }
 
 void HostResolverImpl::RemoveJob(Job* job) {
@@ -2321,6 +2402,7 @@ void HostResolverImpl::OnIPAddressChanged() {
   probe_weak_ptr_factory_.InvalidateWeakPtrs();
   if (cache_.get())
     cache_->clear();
+  failed_refresh_times_.clear();
 #if defined(OS_POSIX) && !defined(OS_MACOSX) && !defined(OS_ANDROID)
   new LoopbackProbeJob(probe_weak_ptr_factory_.GetWeakPtr());
 #endif
@@ -2372,6 +2454,7 @@ void HostResolverImpl::UpdateDNSConfig(bool config_changed) {
     // resolv.conf changes so we don't need to do anything to clear that cache.
     if (cache_.get())
       cache_->clear();
+    failed_refresh_times_.clear();
 
     // Life check to bail once |this| is deleted.
     base::WeakPtr<HostResolverImpl> self = weak_ptr_factory_.GetWeakPtr();
@@ -151,6 +151,7 @@ class NET_EXPORT HostResolverImpl
   class Request;
   typedef HostCache::Key Key;
   typedef std::map<Key, Job*> JobMap;
+  typedef std::map<Key, base::TimeTicks> FailedRefreshMap;
   typedef ScopedVector<Request> RequestsList;
 
   // Number of consecutive failures of DnsTask (with successful fallback to
@@ -178,11 +179,18 @@ class NET_EXPORT HostResolverImpl
 
   // If |key| is not found in cache returns false, otherwise returns
   // true, sets |net_error| to the cached error code and fills |addresses|
-  // if it is a positive entry.
+  // if it is a positive entry. Sets |*needs_refresh| if the entry is stale,
+  // or about to expire and used often enough to be refreshed ahead of time.
   bool ServeFromCache(const Key& key,
                       const RequestInfo& info,
                       int* net_error,
-                      AddressList* addresses);
+                      AddressList* addresses,
+                      bool* needs_refresh);
+
+  // Starts a Job to resolve |key| again and update the cache, unless one is
+  // already running or a refresh of |key| failed a short while ago. The Job
+  // has no requests of its own.
+  void RefreshCacheEntry(const Key& key, const BoundNetLog& source_net_log);
 
   // If we have a DnsClient with a valid DnsConfig, and |key| is found in the
   // HOSTS file, returns true and fills |addresses|. Otherwise returns false.
@@ -258,9 +266,17 @@ class NET_EXPORT HostResolverImpl
   // Cache of host resolution results.
   scoped_ptr<HostCache> cache_;
 
+  // See HostResolver::Options.
+  base::TimeDelta max_stale_cache_age_;
+  bool refresh_hot_cache_entries_;
+
   // Map from HostCache::Key to a Job.
   JobMap jobs_;
 
+  // When the last refresh of a cache entry failed, for the entries whose
+  // refresh is backing off. See RefreshCacheEntry().
+  FailedRefreshMap failed_refresh_times_;
+
   // Starts Jobs according to their priority and the configured limits.
   scoped_ptr<PrioritizedDispatcher> dispatcher_;
 
@@ -209,6 +209,12 @@ class SQLitePersistentCookieStore::Backend
                       const CanonicalCookie& cc);
   // Commit our pending operations to the database.
   void Commit();
+
+  typedef std::list<PendingOperation*> PendingOperationsList;
+  // Collapses the operations in |ops| so that there is at most one per
+  // cookie, with the same result once committed.
+  static void CoalesceOperations(PendingOperationsList* ops);
+
   // Close() executed on the background runner.
   void InternalBackgroundClose(const base::Closure& callback);
 
@@ -233,7 +239,6 @@ class SQLitePersistentCookieStore::Backend
   scoped_ptr<sql::Connection> db_;
   sql::MetaTable meta_table_;
 
-  typedef std::list<PendingOperation*> PendingOperationsList;
   PendingOperationsList pending_;
   PendingOperationsList::size_type num_pending_;
   // Guard |cookies_|, |pending_|, |num_pending_|.
@@ -596,6 +601,9 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
 
   db_.reset(new sql::Connection);
   db_->set_histogram_tag("Cookie");
+  // Periodic commits append to the log instead of going through a rollback
+  // journal, and loads are not blocked by a commit in progress.
+  db_->set_wal_mode();
 
   // Unretained to avoid a ref loop with |db_|.
   db_->set_error_callback(
@@ -1061,9 +1069,16 @@ void SQLitePersistentCookieStore::Backend::Commit() {
   if (!db_.get() || ops.empty())
     return;
 
+  PendingOperationsList::size_type num_ops = ops.size();
+  CoalesceOperations(&ops);
+  UMA_HISTOGRAM_COUNTS("Cookie.CommitOperationsCoalesced",
+                       num_ops - ops.size());
+
+  // Adds replace any existing row, so that an add which absorbed a delete of
+  // the same cookie can be committed as a single statement.
   sql::Statement add_smt(db_->GetCachedStatement(
       SQL_FROM_HERE,
-      "INSERT INTO cookies (creation_utc, host_key, name, value, "
+      "INSERT OR REPLACE INTO cookies (creation_utc, host_key, name, value, "
       "encrypted_value, path, expires_utc, secure, httponly, firstpartyonly, "
       "last_access_utc, has_expires, persistent, priority) "
       "VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?)"));
@@ -1148,6 +1163,85 @@ void SQLitePersistentCookieStore::Backend::Commit() {
                             succeeded ? 0 : 1, 2);
 }
 
+// static
+void SQLitePersistentCookieStore::Backend::CoalesceOperations(
+    PendingOperationsList* ops) {
+  struct CookieOperation {
+    // The operation that leaves the row of the cookie as the whole sequence
+    // of operations on it would, or NULL if there is nothing to do.
+    PendingOperation* op;
+    // True if the row of the cookie did not exist before the first
+    // operation, so that a delete can cancel out what came before it.
+    bool row_is_new;
+  };
+  // Cookies are identified by their creation time, the primary key of the
+  // table. Committing them in that order also keeps the b-tree updates local.
+  std::map<int64, CookieOperation> cookie_ops;
+
+  for (PendingOperationsList::iterator it = ops->begin(); it != ops->end();
+       ++it) {
+    PendingOperation* po = *it;
+    const int64 creation_time = po->cc().CreationDate().ToInternalValue();
+    std::map<int64, CookieOperation>::iterator cookie_it =
+        cookie_ops.find(creation_time);
+    if (cookie_it == cookie_ops.end()) {
+      CookieOperation cookie_op = {po,
+                                   po->op() == PendingOperation::COOKIE_ADD};
+      cookie_ops[creation_time] = cookie_op;
+      continue;
+    }
+
+    CookieOperation& cookie_op = cookie_it->second;
+    PendingOperation* previous = cookie_op.op;
+    switch (po->op()) {
+      case PendingOperation::COOKIE_ADD:
+        cookie_op.op = po;
+        break;
+
+      case PendingOperation::COOKIE_UPDATEACCESS:
+        if (!previous) {
+          // The cookie was added and deleted again, there is no row to
+          // update.
+          delete po;
+          continue;
+        }
+        if (previous->op() == PendingOperation::COOKIE_DELETE) {
+          delete po;
+          continue;
+        }
+        if (previous->op() == PendingOperation::COOKIE_ADD) {
+          // Add the cookie with its latest access time instead.
+          cookie_op.op =
+              new PendingOperation(PendingOperation::COOKIE_ADD, po->cc());
+          delete po;
+        } else {
+          cookie_op.op = po;
+        }
+        break;
+
+      case PendingOperation::COOKIE_DELETE:
+        cookie_op.op = cookie_op.row_is_new ? NULL : po;
+        if (!cookie_op.op)
+          delete po;
+        break;
+
+      default:
+        NOTREACHED();
+        delete po;
+        continue;
+    }
+    delete previous;
+  }
+
+  ops->clear();
+  for (std::map<int64, CookieOperation>::const_iterator it =
+           cookie_ops.begin();
+       it != cookie_ops.end(); ++it) {
+    if (it->second.op)
+      ops->push_back(it->second.op);
+  }
+}
+
 void SQLitePersistentCookieStore::Backend::Flush(
     const base::Closure& callback) {
   DCHECK(!background_task_runner_->RunsTasksOnCurrentThread());
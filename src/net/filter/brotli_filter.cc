@@ -0,0 +1,76 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/filter/brotli_filter.h"
+
+#include "base/logging.h"
+#include "third_party/brotli/dec/decode.h"
+
+namespace net {
+
+BrotliFilter::BrotliFilter(FilterType type)
+    : Filter(type), decoding_status_(DECODING_UNINITIALIZED) {}
+
+BrotliFilter::~BrotliFilter() {
+  if (brotli_state_)
+    BrotliStateCleanup(brotli_state_.get());
+}
+
+bool BrotliFilter::InitDecoding() {
+  if (decoding_status_ != DECODING_UNINITIALIZED)
+    return false;
+
+  brotli_state_.reset(new BrotliState);
+  BrotliStateInit(brotli_state_.get());
+  decoding_status_ = DECODING_IN_PROGRESS;
+  return true;
+}
+
+Filter::FilterStatus BrotliFilter::ReadFilteredData(char* dest_buffer,
+                                                    int* dest_len) {
+  if (!dest_buffer || !dest_len || *dest_len <= 0)
+    return Filter::FILTER_ERROR;
+
+  if (decoding_status_ == DECODING_DONE) {
+    *dest_len = 0;
+    return Filter::FILTER_DONE;
+  }
+
+  if (decoding_status_ != DECODING_IN_PROGRESS)
+    return Filter::FILTER_ERROR;
+
+  // The pre-filter data is not checked for emptiness: the decoder may still
+  // hold output from earlier input.
+  size_t available_in = stream_data_len_;
+  const uint8_t* next_in = reinterpret_cast<const uint8_t*>(next_stream_data_);
+  size_t available_out = *dest_len;
+  uint8_t* next_out = reinterpret_cast<uint8_t*>(dest_buffer);
+  size_t total_out = 0;
+  BrotliResult result =
+      BrotliDecompressStream(&available_in, &next_in, &available_out,
+                             &next_out, &total_out, brotli_state_.get());
+
+  *dest_len -= static_cast<int>(available_out);
+  stream_data_len_ = static_cast<int>(available_in);
+  next_stream_data_ = available_in ? reinterpret_cast<char*>(
+                                         const_cast<uint8_t*>(next_in))
+                                   : NULL;
+
+  switch (result) {
+    case BROTLI_RESULT_NEEDS_MORE_OUTPUT:
+      return Filter::FILTER_OK;
+    case BROTLI_RESULT_NEEDS_MORE_INPUT:
+      DCHECK_EQ(0, stream_data_len_);
+      return Filter::FILTER_NEED_MORE_DATA;
+    case BROTLI_RESULT_SUCCESS:
+      decoding_status_ = DECODING_DONE;
+      return Filter::FILTER_DONE;
+    case BROTLI_RESULT_ERROR:
+      break;
+  }
+  decoding_status_ = DECODING_ERROR;
+  return Filter::FILTER_ERROR;
+}
+
+}  // namespace net
@@ -0,0 +1,63 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// BrotliFilter applies brotli content decoding to a data stream, for
+// "Content-Encoding: br". The decoder is incremental, so the compressed data
+// may be handed over in chunks of any size.
+//
+// BrotliFilter is a subclass of Filter. See the latter's header file filter.h
+// for sample usage.
+
+#ifndef NET_FILTER_BROTLI_FILTER_H_
+#define NET_FILTER_BROTLI_FILTER_H_
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/filter/filter.h"
+
+typedef struct BrotliStateStruct BrotliState;
+
+namespace net {
+
+class BrotliFilter : public Filter {
+ public:
+  ~BrotliFilter() override;
+
+  // Initializes the brotli decoder. Returns false if the filter was already
+  // initialized.
+  bool InitDecoding();
+
+  // Decodes the pre-filter data and writes the output into |dest_buffer|.
+  // Upon entry, *dest_len is the size of |dest_buffer|. Upon exit, *dest_len
+  // is the number of chars written into it.
+  //
+  // Returns FILTER_OK when the decoder has more output to give, even if all
+  // the pre-filter data has been consumed.
+  FilterStatus ReadFilteredData(char* dest_buffer, int* dest_len) override;
+
+ private:
+  enum DecodingStatus {
+    DECODING_UNINITIALIZED,
+    DECODING_IN_PROGRESS,
+    DECODING_DONE,
+    DECODING_ERROR
+  };
+
+  // Only to be instantiated by Filter::Factory.
+  explicit BrotliFilter(FilterType type);
+  friend class Filter;
+
+  // Tracks the status of decoding. Set by InitDecoding, and then updated only
+  // by ReadFilteredData.
+  DecodingStatus decoding_status_;
+
+  // The state of the brotli decoder, created by InitDecoding.
+  scoped_ptr<BrotliState> brotli_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(BrotliFilter);
+};
+
+}  // namespace net
+
+#endif  // NET_FILTER_BROTLI_FILTER_H_
@@ -54,6 +54,15 @@ bool UseCertCache() {
          "ExperimentGroup";
 }
 
+// Completes the creation of a backend that compresses the data it stores.
+void WrapCompressedBackend(scoped_ptr<disk_cache::Backend>* backend,
+                           const net::CompletionCallback& callback,
+                           int result) {
+  if (result == net::OK)
+    *backend = disk_cache::CreateCompressedBackend(backend->Pass());
+  callback.Run(result);
+}
+
 }  // namespace
 
 namespace net {
@@ -68,7 +77,8 @@ HttpCache::DefaultBackend::DefaultBackend(
       backend_type_(backend_type),
       path_(path),
       max_bytes_(max_bytes),
-      thread_(thread) {
+      thread_(thread),
+      compress_entries_(false) {
 }
 
 HttpCache::DefaultBackend::~DefaultBackend() {}
@@ -85,15 +95,24 @@ int HttpCache::DefaultBackend::CreateBackend(
     NetLog* net_log, scoped_ptr<disk_cache::Backend>* backend,
     const CompletionCallback& callback) {
   DCHECK_GE(max_bytes_, 0);
-  return disk_cache::CreateCacheBackend(type_,
-                                        backend_type_,
-                                        path_,
-                                        max_bytes_,
-                                        true,
-                                        thread_,
-                                        net_log,
-                                        backend,
-                                        callback);
+  if (!compress_entries_) {
+    return disk_cache::CreateCacheBackend(type_,
+                                          backend_type_,
+                                          path_,
+                                          max_bytes_,
+                                          true,
+                                          thread_,
+                                          net_log,
+                                          backend,
+                                          callback);
+  }
+
+  int rv = disk_cache::CreateCacheBackend(
+      type_, backend_type_, path_, max_bytes_, true, thread_, net_log, backend,
+      base::Bind(&WrapCompressedBackend, backend, callback));
+  if (rv == OK)
+    *backend = disk_cache::CreateCompressedBackend(backend->Pass());
+  return rv;
 }
 
 //-----------------------------------------------------------------------------
@@ -102,7 +121,9 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      shared_writing(false),
+      shared_writing_truncated(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -312,6 +333,7 @@ HttpCache::HttpCache(scoped_ptr<HttpTransactionFactory> network_layer,
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
       mode_(NORMAL),
+      shared_writing_(false),
       network_layer_(network_layer.Pass()),
       clock_(new base::DefaultClock()),
       weak_factory_(this) {
@@ -344,6 +366,8 @@ HttpCache::~HttpCache() {
     entry->will_process_pending_queue = false;
     entry->pending_queue.clear();
     entry->readers.clear();
+    entry->shared_readers.clear();
+    entry->waiting_shared_readers.clear();
     entry->writer = NULL;
     DeactivateEntry(entry);
   }
@@ -634,6 +658,7 @@ void HttpCache::FinalizeDoomedEntry(ActiveEntry* entry) {
   DCHECK(entry->doomed);
   DCHECK(!entry->writer);
   DCHECK(entry->readers.empty());
+  DCHECK(entry->shared_readers.empty());
   DCHECK(entry->pending_queue.empty());
 
   ActiveEntriesSet::iterator it = doomed_entries_.find(entry);
@@ -662,6 +687,7 @@ void HttpCache::DeactivateEntry(ActiveEntry* entry) {
   DCHECK(!entry->writer);
   DCHECK(entry->disk_entry);
   DCHECK(entry->readers.empty());
+  DCHECK(entry->shared_readers.empty());
   DCHECK(entry->pending_queue.empty());
 
   std::string key = entry->disk_entry->GetKey();
@@ -802,6 +828,16 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
+  //
+  // The exception is a writer that shares the entry: transactions that would
+  // just read the stored response can follow the writer as it stores the body.
+
+  if (entry->shared_writing && !entry->will_process_pending_queue &&
+      trans->CanJoinSharedWriter()) {
+    DCHECK(entry->writer);
+    entry->shared_readers.push_back(trans);
+    return OK;
+  }
 
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
@@ -832,10 +868,16 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
 
 void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
                               bool cancel) {
+  // A shared reader going away doesn't affect anybody else.
+  if (RemoveSharedReader(entry, trans))
+    return;
+
   // If we already posted a task to move on to the next transaction and this was
   // the writer, there is nothing to cancel.
-  if (entry->will_process_pending_queue && entry->readers.empty())
+  if (entry->will_process_pending_queue && !entry->writer &&
+      entry->readers.empty()) {
     return;
+  }
 
   if (entry->writer) {
     DCHECK(trans == entry->writer);
@@ -844,6 +886,9 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
     bool success = false;
     if (cancel) {
       DCHECK(entry->disk_entry);
+      // Whatever happens to the entry, readers following this writer will not
+      // get the rest of the body.
+      EndSharedWriting(entry, false);
       // This is a successful operation in the sense that we want to keep the
       // entry.
       success = trans->AddTruncatedFlag();
@@ -860,19 +905,30 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
   DCHECK(entry->readers.empty());
 
+  EndSharedWriting(entry, success);
   entry->writer = NULL;
 
+  // Readers that followed the writer now behave as regular readers, which
+  // keeps the entry from being replaced until they are done.
+  entry->readers.splice(entry->readers.end(), entry->shared_readers);
+
   if (success) {
     ProcessPendingQueue(entry);
   } else {
-    DCHECK(!entry->will_process_pending_queue);
-
     // We failed to create this entry.
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty() && !entry->will_process_pending_queue) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // Former shared readers still reference this entry, so keep it around
+      // until they are done, but don't hand it out anymore.
+      DoomEntry(entry->disk_entry->GetKey(), NULL);
+    } else {
+      entry->disk_entry->Doom();
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -885,6 +941,9 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
+  if (RemoveSharedReader(entry, trans))
+    return;
+
   DCHECK(!entry->writer);
 
   TransactionList::iterator it =
@@ -900,6 +959,8 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   DCHECK(entry->writer);
   DCHECK(entry->writer->mode() == Transaction::READ_WRITE);
   DCHECK(entry->readers.empty());
+  DCHECK(!entry->shared_writing);
+  DCHECK(entry->shared_readers.empty());
 
   Transaction* trans = entry->writer;
 
@@ -909,6 +970,68 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::BeginSharedWriting(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(entry->readers.empty());
+  DCHECK(!entry->shared_writing);
+
+  entry->shared_writing = true;
+  entry->shared_writing_truncated = false;
+  if (!entry->pending_queue.empty())
+    ProcessPendingQueue(entry);
+}
+
+void HttpCache::EndSharedWriting(ActiveEntry* entry, bool complete) {
+  if (!entry->shared_writing)
+    return;
+
+  entry->shared_writing = false;
+  entry->shared_writing_truncated = !complete;
+  NotifySharedReaders(entry, complete ? OK : ERR_CACHE_WRITE_FAILURE);
+}
+
+void HttpCache::OnSharedDataWritten(ActiveEntry* entry) {
+  if (entry->shared_writing)
+    NotifySharedReaders(entry, OK);
+}
+
+int HttpCache::WaitForSharedData(ActiveEntry* entry, Transaction* trans) {
+  if (entry->shared_writing) {
+    DCHECK(entry->writer);
+    DCHECK(std::find(entry->waiting_shared_readers.begin(),
+                     entry->waiting_shared_readers.end(),
+                     trans) == entry->waiting_shared_readers.end());
+    entry->waiting_shared_readers.push_back(trans);
+    return ERR_IO_PENDING;
+  }
+  return entry->shared_writing_truncated ? ERR_CACHE_WRITE_FAILURE : OK;
+}
+
+void HttpCache::NotifySharedReaders(ActiveEntry* entry, int result) {
+  TransactionList waiting_readers;
+  waiting_readers.swap(entry->waiting_shared_readers);
+
+  // The writer is in the middle of its own IO, so the readers are notified
+  // asynchronously. Their callbacks are bound to weak pointers, so there is
+  // nothing to cancel if a reader goes away in the meantime.
+  for (TransactionList::iterator it = waiting_readers.begin();
+       it != waiting_readers.end(); ++it) {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind((*it)->io_callback(), result));
+  }
+}
+
+bool HttpCache::RemoveSharedReader(ActiveEntry* entry, Transaction* trans) {
+  TransactionList::iterator it = std::find(entry->shared_readers.begin(),
+                                           entry->shared_readers.end(), trans);
+  if (it == entry->shared_readers.end())
+    return false;
+
+  entry->shared_readers.erase(it);
+  entry->waiting_shared_readers.remove(trans);
+  return true;
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -1002,7 +1125,27 @@ void HttpCache::ProcessPendingQueue(ActiveEntry* entry) {
 
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
-  DCHECK(!entry->writer);
+
+  if (entry->writer) {
+    // The writer is sharing the entry. The next transaction that can follow it
+    // starts reading now; the rest keeps waiting for the writer to finish.
+    if (!entry->shared_writing)
+      return;
+    TransactionList::iterator it = entry->pending_queue.begin();
+    while (it != entry->pending_queue.end() && !(*it)->CanJoinSharedWriter())
+      ++it;
+    if (it == entry->pending_queue.end())
+      return;
+
+    Transaction* next = *it;
+    entry->pending_queue.erase(it);
+    entry->shared_readers.push_back(next);
+
+    // Like regular readers, shared readers are let in one at a time.
+    ProcessPendingQueue(entry);
+    next->io_callback().Run(OK);
+    return;
+  }
 
   // If no one is interested in this entry, then we can deactivate it.
   if (entry->pending_queue.empty()) {
@@ -108,6 +108,12 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     // Returns a factory for an in-memory cache.
     static scoped_ptr<BackendFactory> InMemory(int max_bytes);
 
+    // When set, the backend compresses the response bodies it stores. See
+    // disk_cache::CreateCompressedBackend().
+    void set_compress_entries(bool compress_entries) {
+      compress_entries_ = compress_entries;
+    }
+
     // BackendFactory implementation.
     int CreateBackend(NetLog* net_log,
                       scoped_ptr<disk_cache::Backend>* backend,
@@ -119,6 +125,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     const base::FilePath path_;
     int max_bytes_;
     scoped_refptr<base::SingleThreadTaskRunner> thread_;
+    bool compress_entries_;
   };
 
   // The number of minutes after a resource is prefetched that it can be used
@@ -182,6 +189,16 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   void set_mode(Mode value) { mode_ = value; }
   Mode mode() { return mode_; }
 
+  // Get/Set whether transactions may read an entry while it is still being
+  // written. When enabled, once the writer has stored the response headers of
+  // a full 200 response, other transactions for the same entry that would
+  // just use it as-is start streaming the body from the cache as the writer
+  // appends it, instead of waiting for the whole response to be downloaded.
+  // Readers never slow down the writer; they are limited to the data that
+  // has already been stored, and fail if the writer does not finish.
+  void set_shared_writing(bool value) { shared_writing_ = value; }
+  bool shared_writing() const { return shared_writing_; }
+
   // Get/Set the cache's clock. These are public only for testing.
   void SetClockForTesting(scoped_ptr<base::Clock> clock) {
     clock_.reset(clock.release());
@@ -260,8 +277,18 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     Transaction*       writer;
     TransactionList    readers;
     TransactionList    pending_queue;
+    // Transactions reading the response body while |writer| is still
+    // appending to it, and the subset of them that caught up with the writer
+    // and are waiting for more data.
+    TransactionList    shared_readers;
+    TransactionList    waiting_shared_readers;
     bool               will_process_pending_queue;
     bool               doomed;
+    // True while |writer| lets other transactions read the body it writes.
+    bool               shared_writing;
+    // True if the writer stopped sharing before storing the whole body, so the
+    // end of the stored data is not the end of the response.
+    bool               shared_writing_truncated;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
@@ -364,6 +391,31 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once the response headers are stored and
+  // the body can be read while it is being written.
+  void BeginSharedWriting(ActiveEntry* entry);
+
+  // Stops sharing |entry| with new readers. |complete| tells the current shared
+  // readers whether the stored body is the whole response.
+  void EndSharedWriting(ActiveEntry* entry, bool complete);
+
+  // Called by the writer of |entry| after appending response data.
+  void OnSharedDataWritten(ActiveEntry* entry);
+
+  // Called by the shared reader |trans| when it has read all the data stored
+  // in |entry| so far. Returns ERR_IO_PENDING if the writer is still active,
+  // in which case |trans| will be notified via its IO callback when there is
+  // more data or the writer is done. Otherwise returns OK if the stored body is
+  // complete, or ERR_CACHE_WRITE_FAILURE if the writer gave up.
+  int WaitForSharedData(ActiveEntry* entry, Transaction* trans);
+
+  // Posts |result| to all the shared readers of |entry| waiting for data.
+  void NotifySharedReaders(ActiveEntry* entry, int result);
+
+  // Removes |trans| from the shared readers of |entry|. Returns false if it
+  // was not a shared reader.
+  bool RemoveSharedReader(ActiveEntry* entry, Transaction* trans);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -414,6 +466,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   bool fail_conditionalization_for_test_;
 
   Mode mode_;
+  bool shared_writing_;
 
   scoped_ptr<HttpTransactionFactory> network_layer_;
 
@@ -264,6 +264,7 @@ HttpCache::Transaction::Transaction(RequestPriority priority, HttpCache* cache)
       cache_pending_(false),
       done_reading_(false),
       vary_mismatch_(false),
+      shared_reader_(false),
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
@@ -343,6 +344,16 @@ bool HttpCache::Transaction::AddTruncatedFlag() {
   return true;
 }
 
+bool HttpCache::Transaction::CanJoinSharedWriter() const {
+  // Anything that may need to validate, update or partially use the entry has
+  // to wait for the writer to finish.
+  if (mode_ != READ && mode_ != READ_WRITE)
+    return false;
+  if (partial_ || range_requested_ || request_->method != "GET")
+    return false;
+  return !(effective_load_flags_ & (LOAD_VALIDATE_CACHE | LOAD_PREFETCH));
+}
+
 LoadState HttpCache::Transaction::GetWriterLoadState() const {
   if (network_trans_.get())
     return network_trans_->GetLoadState();
@@ -508,6 +519,8 @@ void HttpCache::Transaction::StopCaching() {
   //                Fix this.
   if (cache_.get() && entry_ && (mode_ & WRITE) && network_trans_.get() &&
       !is_sparse_ && !range_requested_) {
+    // Readers following this transaction will not get the rest of the body.
+    cache_->EndSharedWriting(entry_, false);
     mode_ = NONE;
   }
 }
@@ -935,6 +948,13 @@ int HttpCache::Transaction::DoLoop(int result) {
       case STATE_CACHE_READ_DATA_COMPLETE:
         rv = DoCacheReadDataComplete(rv);
         break;
+      case STATE_CACHE_WAIT_FOR_SHARED_DATA:
+        DCHECK_EQ(OK, rv);
+        rv = DoCacheWaitForSharedData();
+        break;
+      case STATE_CACHE_WAIT_FOR_SHARED_DATA_COMPLETE:
+        rv = DoCacheWaitForSharedDataComplete(rv);
+        break;
       case STATE_CACHE_WRITE_DATA:
         rv = DoCacheWriteData(rv);
         break;
@@ -1208,8 +1228,12 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   DCHECK(new_entry_);
   cache_pending_ = false;
 
-  if (result == OK)
+  if (result == OK) {
     entry_ = new_entry_;
+    // If the entry still has a writer, we were let in to read the body while
+    // it is being written.
+    shared_reader_ = entry_->writer && entry_->writer != this;
+  }
 
   // If there is a failure, the cache should have taken care of new_entry_.
   new_entry_ = NULL;
@@ -1276,10 +1300,13 @@ int HttpCache::Transaction::DoCacheReadResponseComplete(int result) {
   if (response_.headers->GetContentLength() == current_size)
     truncated_ = false;
 
-  if ((response_.unused_since_prefetch &&
-       !(request_->load_flags & LOAD_PREFETCH)) ||
-      (!response_.unused_since_prefetch &&
-       (request_->load_flags & LOAD_PREFETCH))) {
+  // A shared reader must not write to the entry, so it leaves the prefetch bit
+  // alone.
+  if (!shared_reader_ &&
+      ((response_.unused_since_prefetch &&
+        !(request_->load_flags & LOAD_PREFETCH)) ||
+       (!response_.unused_since_prefetch &&
+        (request_->load_flags & LOAD_PREFETCH)))) {
     // Either this is the first use of an entry since it was prefetched or
     // this is a prefetch. The value of response.unused_since_prefetch is valid
     // for this transaction but the bit needs to be flipped in storage.
@@ -1722,6 +1749,14 @@ int HttpCache::Transaction::DoTruncateCachedMetadataComplete(int result) {
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_WRITE_INFO,
                                         result);
     }
+
+    // The headers of a new, complete response are stored and the body is
+    // about to follow, so other readers of this entry can stop waiting.
+    if (cache_->shared_writing() && mode_ == WRITE && !partial_ &&
+        !truncated_ && request_->method == "GET" &&
+        response_.headers->response_code() == 200) {
+      cache_->BeginSharedWriting(entry_);
+    }
   }
 
   next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
@@ -1829,6 +1864,9 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
 
   if (result > 0) {
     read_offset_ += result;
+  } else if (result == 0 && shared_reader_) {
+    // This may just be the end of what the writer has stored so far.
+    next_state_ = STATE_CACHE_WAIT_FOR_SHARED_DATA;
   } else if (result == 0) {  // End of file.
     RecordHistograms();
     cache_->DoneReadingFromEntry(entry_, this);
@@ -1839,6 +1877,43 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
   return result;
 }
 
+int HttpCache::Transaction::DoCacheWaitForSharedData() {
+  DCHECK(shared_reader_);
+  next_state_ = STATE_CACHE_WAIT_FOR_SHARED_DATA_COMPLETE;
+
+  // The writer may have appended data while our last read was in progress.
+  if (read_offset_ < entry_->disk_entry->GetDataSize(kResponseContentIndex))
+    return OK;
+
+  return cache_->WaitForSharedData(entry_, this);
+}
+
+int HttpCache::Transaction::DoCacheWaitForSharedDataComplete(int result) {
+  if (!cache_.get())
+    return ERR_UNEXPECTED;
+
+  // The writer gave up before storing the whole body.
+  if (result != OK)
+    return result;
+
+  if (read_offset_ < entry_->disk_entry->GetDataSize(kResponseContentIndex)) {
+    next_state_ = STATE_CACHE_READ_DATA;
+    return OK;
+  }
+
+  if (entry_->shared_writing) {
+    next_state_ = STATE_CACHE_WAIT_FOR_SHARED_DATA;
+    return OK;
+  }
+
+  // The writer stored the whole body and we have read all of it.
+  shared_reader_ = false;
+  RecordHistograms();
+  cache_->DoneReadingFromEntry(entry_, this);
+  entry_ = NULL;
+  return 0;
+}
+
 int HttpCache::Transaction::DoCacheWriteData(int num_bytes) {
   next_state_ = STATE_CACHE_WRITE_DATA_COMPLETE;
   write_len_ = num_bytes;
@@ -1879,6 +1954,9 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
       done_reading_ = true;
   }
 
+  if (result > 0 && entry_)
+    cache_->OnSharedDataWritten(entry_);
+
   if (partial_) {
     // This may be the last request.
     if (result != 0 || truncated_ ||
@@ -2127,6 +2205,18 @@ int HttpCache::Transaction::BeginCacheValidation() {
     response_.async_revalidation_required = true;
   }
 
+  if (shared_reader_ && !skip_validation) {
+    // The entry is still being written by another transaction, so it can be
+    // neither validated nor replaced. Fetch this response on its own.
+    UpdateTransactionPattern(PATTERN_NOT_COVERED);
+    cache_->DoneWithEntry(entry_, this, false);
+    entry_ = NULL;
+    shared_reader_ = false;
+    mode_ = NONE;
+    next_state_ = STATE_SEND_REQUEST;
+    return OK;
+  }
+
   if (request_->method == "HEAD" &&
       (truncated_ || response_.headers->response_code() == 206)) {
     DCHECK(!partial_);
@@ -2601,7 +2691,9 @@ int HttpCache::Transaction::SetupEntryForRead() {
       partial_.reset();
     }
   }
-  cache_->ConvertWriterToReader(entry_);
+  // A shared reader was never the writer of the entry.
+  if (!shared_reader_)
+    cache_->ConvertWriterToReader(entry_);
   mode_ = READ;
 
   if (request_->method == "HEAD")
@@ -108,6 +108,11 @@ class HttpCache::Transaction : public HttpTransaction {
 
   HttpCache::ActiveEntry* entry() { return entry_; }
 
+  // Returns true if this transaction, waiting to be added to an entry, would
+  // only read the stored response and can therefore start reading it while
+  // the entry's writer is still storing the body.
+  bool CanJoinSharedWriter() const;
+
   // Returns the LoadState of the writer transaction of a given ActiveEntry. In
   // other words, returns the LoadState of this transaction without asking the
   // http cache, because this transaction should be the one currently writing
@@ -219,6 +224,8 @@ class HttpCache::Transaction : public HttpTransaction {
     STATE_NETWORK_READ_COMPLETE,
     STATE_CACHE_READ_DATA,
     STATE_CACHE_READ_DATA_COMPLETE,
+    STATE_CACHE_WAIT_FOR_SHARED_DATA,
+    STATE_CACHE_WAIT_FOR_SHARED_DATA_COMPLETE,
     STATE_CACHE_WRITE_DATA,
     STATE_CACHE_WRITE_DATA_COMPLETE,
     STATE_CACHE_WRITE_TRUNCATED_RESPONSE,
@@ -290,6 +297,8 @@ class HttpCache::Transaction : public HttpTransaction {
   int DoNetworkReadComplete(int result);
   int DoCacheReadData();
   int DoCacheReadDataComplete(int result);
+  int DoCacheWaitForSharedData();
+  int DoCacheWaitForSharedDataComplete(int result);
   int DoCacheWriteData(int num_bytes);
   int DoCacheWriteDataComplete(int result);
   int DoCacheWriteTruncatedResponse();
@@ -454,6 +463,7 @@ class HttpCache::Transaction : public HttpTransaction {
   bool cache_pending_;  // We are waiting for the HttpCache.
   bool done_reading_;  // All available data was read.
   bool vary_mismatch_;  // The request doesn't match the stored vary data.
+  bool shared_reader_;  // We read the body while another transaction writes.
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
   bool fail_conditionalization_for_test_;  // Fail ConditionalizeRequest.
@@ -16,6 +16,7 @@
 #include "net/http/http_auth_handler_factory.h"
 #include "net/http/http_response_body_drainer.h"
 #include "net/http/http_stream_factory_impl.h"
+#include "net/http/preconnect_predictor.h"
 #include "net/http/url_security_manager.h"
 #include "net/proxy/proxy_service.h"
 #include "net/quic/crypto/quic_random.h"
@@ -118,7 +119,8 @@ HttpNetworkSession::Params::Params()
       quic_threshold_public_resets_post_handshake(0),
       quic_threshold_timeouts_streams_open(0),
       quic_close_sessions_on_ip_change(false),
-      proxy_delegate(NULL) {
+      proxy_delegate(NULL),
+      enable_preconnect_prediction(false) {
   quic_supported_versions.push_back(QUIC_VERSION_25);
 }
 
@@ -223,6 +225,9 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
 
   http_server_properties_->SetAlternativeServiceProbabilityThreshold(
       params.alternative_service_probability_threshold);
+
+  if (params.enable_preconnect_prediction)
+    preconnect_predictor_.reset(new PreconnectPredictor(this));
 }
 
 HttpNetworkSession::~HttpNetworkSession() {
@@ -44,6 +44,7 @@ class HttpResponseBodyDrainer;
 class HttpServerProperties;
 class NetLog;
 class NetworkDelegate;
+class PreconnectPredictor;
 class ProxyDelegate;
 class ProxyService;
 class QuicClock;
@@ -178,6 +179,10 @@ class NET_EXPORT HttpNetworkSession
     std::unordered_set<std::string> quic_host_whitelist;
 
     ProxyDelegate* proxy_delegate;
+
+    // Learns the connections that pages open, and preconnects them when the
+    // pages are loaded again.
+    bool enable_preconnect_prediction;
   };
 
   enum SocketPoolType {
@@ -230,6 +235,10 @@ class NET_EXPORT HttpNetworkSession
   HttpStreamFactory* http_stream_factory_for_websocket() {
     return http_stream_factory_for_websocket_.get();
   }
+  // Returns NULL unless |enable_preconnect_prediction| is set.
+  PreconnectPredictor* preconnect_predictor() {
+    return preconnect_predictor_.get();
+  }
   NetLog* net_log() {
     return net_log_;
   }
@@ -285,6 +294,7 @@ class NET_EXPORT HttpNetworkSession
   SpdySessionPool spdy_session_pool_;
   scoped_ptr<HttpStreamFactory> http_stream_factory_;
   scoped_ptr<HttpStreamFactory> http_stream_factory_for_websocket_;
+  scoped_ptr<PreconnectPredictor> preconnect_predictor_;
   std::set<HttpResponseBodyDrainer*> response_drainers_;
 
   NextProtoVector next_protos_;
@@ -115,6 +115,100 @@ void CheckDoesNotHaveEmbededNulls(const std::string& str) {
   CHECK(str.find('\0') == std::string::npos);
 }
 
+// These response headers are looked up often enough that the position of
+// their first occurrence is recorded when parsing. The entries of
+// IndexedHeaderId are their positions in kIndexedHeaders.
+enum IndexedHeaderId {
+  kAge,
+  kCacheControl,
+  kConnection,
+  kContentEncoding,
+  kContentLength,
+  kContentType,
+  kDate,
+  kETag,
+  kExpires,
+  kKeepAlive,
+  kLastModified,
+  kLocation,
+  kPragma,
+  kSetCookie,
+  kTransferEncoding,
+  kVary,
+};
+
+const char* const kIndexedHeaders[] = {
+  "age",
+  "cache-control",
+  "connection",
+  "content-encoding",
+  "content-length",
+  "content-type",
+  "date",
+  "etag",
+  "expires",
+  "keep-alive",
+  "last-modified",
+  "location",
+  "pragma",
+  "set-cookie",
+  "transfer-encoding",
+  "vary",
+};
+
+// Returns the position of |name| in kIndexedHeaders, or -1. No two indexed
+// names have both the same length and the same first letter, so these pick
+// the only possible match, and at most one comparison is made.
+int GetIndexedHeaderId(const base::StringPiece& name) {
+  if (name.empty())
+    return -1;
+
+  char first = base::ToLowerASCII(name[0]);
+  IndexedHeaderId id;
+  switch (name.size()) {
+    case 3:
+      id = kAge;
+      break;
+    case 4:
+      id = first == 'd' ? kDate : (first == 'e' ? kETag : kVary);
+      break;
+    case 6:
+      id = kPragma;
+      break;
+    case 7:
+      id = kExpires;
+      break;
+    case 8:
+      id = kLocation;
+      break;
+    case 10:
+      id = first == 'c' ? kConnection
+                        : (first == 'k' ? kKeepAlive : kSetCookie);
+      break;
+    case 12:
+      id = kContentType;
+      break;
+    case 13:
+      id = first == 'c' ? kCacheControl : kLastModified;
+      break;
+    case 14:
+      id = kContentLength;
+      break;
+    case 16:
+      id = kContentEncoding;
+      break;
+    case 17:
+      id = kTransferEncoding;
+      break;
+    default:
+      return -1;
+  }
+
+  if (!base::EqualsCaseInsensitiveASCII(name, kIndexedHeaders[id]))
+    return -1;
+  return id;
+}
+
 }  // namespace
 
 const char HttpResponseHeaders::kContentRange[] = "Content-Range";
@@ -157,6 +251,8 @@ HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
 
 HttpResponseHeaders::HttpResponseHeaders(base::PickleIterator* iter)
     : response_code_(-1) {
+  std::fill(indexed_headers_, indexed_headers_ + kNumIndexedHeaders,
+            std::string::npos);
   std::string raw_input;
   if (iter->ReadString(&raw_input))
     Parse(raw_input);
@@ -388,6 +484,13 @@ void HttpResponseHeaders::UpdateWithNewRange(
 }
 
 void HttpResponseHeaders::Parse(const std::string& raw_input) {
+  static_assert(arraysize(kIndexedHeaders) == kNumIndexedHeaders,
+                "kIndexedHeaders does not match kNumIndexedHeaders");
+  static_assert(kVary == kNumIndexedHeaders - 1,
+                "IndexedHeaderId does not match kIndexedHeaders");
+  std::fill(indexed_headers_, indexed_headers_ + kNumIndexedHeaders,
+            std::string::npos);
+
   raw_headers_.reserve(raw_input.size());
 
   // ParseStatusLine adds a normalized status line to raw_headers_
@@ -605,6 +708,8 @@ bool HttpResponseHeaders::HasHeader(const base::StringPiece& name) const {
 }
 
 HttpResponseHeaders::HttpResponseHeaders() : response_code_(-1) {
+  std::fill(indexed_headers_, indexed_headers_ + kNumIndexedHeaders,
+            std::string::npos);
 }
 
 HttpResponseHeaders::~HttpResponseHeaders() {
@@ -733,6 +838,14 @@ void HttpResponseHeaders::ParseStatusLine(
 
 size_t HttpResponseHeaders::FindHeader(size_t from,
                                        const base::StringPiece& search) const {
+  int id = GetIndexedHeaderId(search);
+  if (id >= 0) {
+    // Only later occurrences need to be searched for.
+    size_t first = indexed_headers_[id];
+    if (first >= from)
+      return first;
+  }
+
   for (size_t i = from; i < parsed_.size(); ++i) {
     if (parsed_[i].is_continuation())
       continue;
@@ -791,6 +904,12 @@ void HttpResponseHeaders::AddToParsed(std::string::const_iterator name_begin,
                                       std::string::const_iterator name_end,
                                       std::string::const_iterator value_begin,
                                       std::string::const_iterator value_end) {
+  if (name_begin != name_end) {
+    int id = GetIndexedHeaderId(base::StringPiece(name_begin, name_end));
+    if (id >= 0 && indexed_headers_[id] == std::string::npos)
+      indexed_headers_[id] = parsed_.size();
+  }
+
   ParsedHeader header;
   header.name_begin = name_begin;
   header.name_end = name_end;
@@ -332,6 +332,9 @@ class NET_EXPORT HttpResponseHeaders
                        std::string::const_iterator line_end,
                        bool has_headers);
 
+  // Number of frequently used headers whose first occurrence is indexed.
+  enum { kNumIndexedHeaders = 16 };
+
   // Find the header in our list (case-insensitive) starting with parsed_ at
   // index |from|.  Returns string::npos if not found.
   size_t FindHeader(size_t from, const base::StringPiece& name) const;
@@ -387,6 +390,11 @@ class NET_EXPORT HttpResponseHeaders
   // header-value pairs within raw_headers_.
   HeaderList parsed_;
 
+  // For each of the headers in kIndexedHeaders, the index in parsed_ of its
+  // first occurrence, or string::npos if it is not present. This spares
+  // scanning all the headers to look up the most common ones.
+  size_t indexed_headers_[kNumIndexedHeaders];
+
   // The raw_headers_ consists of the normalized status line (terminated with a
   // null byte) and then followed by the raw null-terminated headers from the
   // input that was passed to our constructor.  We preserve the input [*] to
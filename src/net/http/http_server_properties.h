@@ -21,6 +21,7 @@
 #include "net/socket/next_proto.h"
 #include "net/spdy/spdy_framer.h"  // TODO(willchan): Reconsider this.
 #include "net/spdy/spdy_protocol.h"
+#include "url/gurl.h"
 
 namespace base {
 class Value;
@@ -208,6 +209,25 @@ struct NET_EXPORT ServerNetworkStats {
   QuicBandwidth bandwidth_estimate;
 };
 
+// An origin that a page has been seen to connect to, along with the number of
+// sockets it needed.
+struct NET_EXPORT PreconnectOrigin {
+  PreconnectOrigin() : num_sockets(0) {}
+  PreconnectOrigin(const GURL& origin, int num_sockets)
+      : origin(origin), num_sockets(num_sockets) {}
+
+  bool operator==(const PreconnectOrigin& other) const {
+    return origin == other.origin && num_sockets == other.num_sockets;
+  }
+
+  bool operator!=(const PreconnectOrigin& other) const {
+    return !this->operator==(other);
+  }
+
+  GURL origin;
+  int num_sockets;
+};
+
 typedef std::vector<AlternativeService> AlternativeServiceVector;
 typedef std::vector<AlternativeServiceInfo> AlternativeServiceInfoVector;
 typedef base::MRUCache<HostPortPair, AlternativeServiceInfoVector>
@@ -215,10 +235,16 @@ typedef base::MRUCache<HostPortPair, AlternativeServiceInfoVector>
 typedef base::MRUCache<HostPortPair, SettingsMap> SpdySettingsMap;
 typedef base::MRUCache<HostPortPair, ServerNetworkStats> ServerNetworkStatsMap;
 typedef base::MRUCache<QuicServerId, std::string> QuicServerInfoMap;
+typedef std::vector<PreconnectOrigin> PreconnectOriginVector;
+typedef base::MRUCache<GURL, PreconnectOriginVector> PreconnectMap;
 
 // Persist 5 QUIC Servers. This is mainly used by cronet.
 const int kMaxQuicServersToPersist = 5;
 
+// Persist the connections of the pages of the 100 most recently loaded page
+// origins.
+const int kMaxPreconnectPagesToPersist = 100;
+
 extern const char kAlternateProtocolHeader[];
 extern const char kAlternativeServiceHeader[];
 
@@ -228,6 +254,7 @@ extern const char kAlternativeServiceHeader[];
 // * alternative service support.
 // * SPDY Settings (like CWND ID field).
 // * QUIC data (like ServerNetworkStats and QuicServerInfo).
+// * the origins that pages connect to, used for preconnecting.
 //
 // Embedders must ensure that HttpServerProperites is completely initialized
 // before the first request is issued.
@@ -381,6 +408,19 @@ class NET_EXPORT HttpServerProperties {
   // Returns all persistent QuicServerInfo objects.
   virtual const QuicServerInfoMap& quic_server_info_map() const = 0;
 
+  // Saves the origins that the pages of |page_url|, an origin, connect to. Returns true if the value
+  // has changed otherwise it returns false.
+  virtual bool SetPreconnectOrigins(const GURL& page_url,
+                                    const PreconnectOriginVector& origins) = 0;
+
+  // Gets the origins that the pages of |page_url|, an origin, connect to, or
+  // NULL if unknown.
+  virtual const PreconnectOriginVector* GetPreconnectOrigins(
+      const GURL& page_url) = 0;
+
+  // Returns all persistent preconnect origins.
+  virtual const PreconnectMap& preconnect_map() const = 0;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(HttpServerProperties);
 };
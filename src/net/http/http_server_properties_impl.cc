@@ -32,6 +32,7 @@ HttpServerPropertiesImpl::HttpServerPropertiesImpl()
       server_network_stats_map_(ServerNetworkStatsMap::NO_AUTO_EVICT),
       alternative_service_probability_threshold_(1.0),
       quic_server_info_map_(kMaxQuicServersToPersist),
+      preconnect_map_(kMaxPreconnectPagesToPersist),
       weak_ptr_factory_(this) {
   canonical_suffixes_.push_back(".c.youtube.com");
   canonical_suffixes_.push_back(".googlevideo.com");
@@ -160,6 +161,14 @@ void HttpServerPropertiesImpl::InitializeQuicServerInfoMap(
   }
 }
 
+void HttpServerPropertiesImpl::InitializePreconnectMap(
+    PreconnectMap* preconnect_map) {
+  for (PreconnectMap::reverse_iterator it = preconnect_map->rbegin();
+       it != preconnect_map->rend(); ++it) {
+    preconnect_map_.Put(it->first, it->second);
+  }
+}
+
 void HttpServerPropertiesImpl::GetSpdyServerList(
     base::ListValue* spdy_server_list,
     size_t max_size) const {
@@ -191,6 +200,7 @@ void HttpServerPropertiesImpl::Clear() {
   last_quic_address_.clear();
   server_network_stats_map_.Clear();
   quic_server_info_map_.Clear();
+  preconnect_map_.Clear();
 }
 
 bool HttpServerPropertiesImpl::SupportsRequestPriority(
@@ -634,6 +644,29 @@ const QuicServerInfoMap& HttpServerPropertiesImpl::quic_server_info_map()
   return quic_server_info_map_;
 }
 
+bool HttpServerPropertiesImpl::SetPreconnectOrigins(
+    const GURL& page_url,
+    const PreconnectOriginVector& origins) {
+  DCHECK(CalledOnValidThread());
+  PreconnectMap::iterator it = preconnect_map_.Peek(page_url);
+  bool changed = (it == preconnect_map_.end() || it->second != origins);
+  preconnect_map_.Put(page_url, origins);
+  return changed;
+}
+
+const PreconnectOriginVector* HttpServerPropertiesImpl::GetPreconnectOrigins(
+    const GURL& page_url) {
+  DCHECK(CalledOnValidThread());
+  PreconnectMap::iterator it = preconnect_map_.Get(page_url);
+  if (it == preconnect_map_.end())
+    return nullptr;
+  return &it->second;
+}
+
+const PreconnectMap& HttpServerPropertiesImpl::preconnect_map() const {
+  return preconnect_map_;
+}
+
 void HttpServerPropertiesImpl::SetAlternativeServiceProbabilityThreshold(
     double threshold) {
   alternative_service_probability_threshold_ = threshold;
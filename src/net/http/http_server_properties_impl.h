@@ -62,6 +62,8 @@ class NET_EXPORT HttpServerPropertiesImpl
 
   void InitializeQuicServerInfoMap(QuicServerInfoMap* quic_server_info_map);
 
+  void InitializePreconnectMap(PreconnectMap* preconnect_map);
+
   // Get the list of servers (host/port) that support SPDY. The max_size is the
   // number of MRU servers that support SPDY that are to be returned.
   void GetSpdyServerList(base::ListValue* spdy_server_list,
@@ -131,6 +133,11 @@ class NET_EXPORT HttpServerPropertiesImpl
                          const std::string& server_info) override;
   const std::string* GetQuicServerInfo(const QuicServerId& server_id) override;
   const QuicServerInfoMap& quic_server_info_map() const override;
+  bool SetPreconnectOrigins(const GURL& page_url,
+                            const PreconnectOriginVector& origins) override;
+  const PreconnectOriginVector* GetPreconnectOrigins(
+      const GURL& page_url) override;
+  const PreconnectMap& preconnect_map() const override;
 
  private:
   friend class HttpServerPropertiesImplPeer;
@@ -185,6 +192,8 @@ class NET_EXPORT HttpServerPropertiesImpl
 
   QuicServerInfoMap quic_server_info_map_;
 
+  PreconnectMap preconnect_map_;
+
   base::WeakPtrFactory<HttpServerPropertiesImpl> weak_ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpServerPropertiesImpl);
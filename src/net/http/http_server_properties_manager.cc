@@ -69,6 +69,9 @@ const char kProbabilityKey[] = "probability";
 const char kExpirationKey[] = "expiration";
 const char kNetworkStatsKey[] = "network_stats";
 const char kSrttKey[] = "srtt";
+const char kPreconnectPagesKey[] = "preconnect_pages";
+const char kOriginKey[] = "origin";
+const char kSocketsKey[] = "sockets";
 
 }  // namespace
 
@@ -409,6 +412,28 @@ const QuicServerInfoMap& HttpServerPropertiesManager::quic_server_info_map()
   return http_server_properties_impl_->quic_server_info_map();
 }
 
+bool HttpServerPropertiesManager::SetPreconnectOrigins(
+    const GURL& page_url,
+    const PreconnectOriginVector& origins) {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  bool changed =
+      http_server_properties_impl_->SetPreconnectOrigins(page_url, origins);
+  if (changed)
+    ScheduleUpdatePrefsOnNetworkThread(SET_PRECONNECT_ORIGINS);
+  return changed;
+}
+
+const PreconnectOriginVector* HttpServerPropertiesManager::GetPreconnectOrigins(
+    const GURL& page_url) {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  return http_server_properties_impl_->GetPreconnectOrigins(page_url);
+}
+
+const PreconnectMap& HttpServerPropertiesManager::preconnect_map() const {
+  DCHECK(network_task_runner_->RunsTasksOnCurrentThread());
+  return http_server_properties_impl_->preconnect_map();
+}
+
 //
 // Update the HttpServerPropertiesImpl's cache with data from preferences.
 //
@@ -470,6 +495,8 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnPrefThread() {
       new ServerNetworkStatsMap(kMaxServerNetworkStatsHostsToPersist));
   scoped_ptr<QuicServerInfoMap> quic_server_info_map(
       new QuicServerInfoMap(kMaxQuicServersToPersist));
+  scoped_ptr<PreconnectMap> preconnect_map(
+      new PreconnectMap(kMaxPreconnectPagesToPersist));
 
   for (base::DictionaryValue::Iterator it(*servers_dict); !it.IsAtEnd();
        it.Advance()) {
@@ -506,7 +533,8 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnPrefThread() {
   }
 
   if (!AddToQuicServerInfoMap(http_server_properties_dict,
-                              quic_server_info_map.get())) {
+                              quic_server_info_map.get()) ||
+      !AddToPreconnectMap(http_server_properties_dict, preconnect_map.get())) {
     detected_corrupted_prefs = true;
   }
 
@@ -519,7 +547,7 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnPrefThread() {
           base::Owned(alternative_service_map.release()), base::Owned(addr),
           base::Owned(server_network_stats_map.release()),
           base::Owned(quic_server_info_map.release()),
-          detected_corrupted_prefs));
+          base::Owned(preconnect_map.release()), detected_corrupted_prefs));
 }
 
 void HttpServerPropertiesManager::AddToSpdySettingsMap(
@@ -790,6 +818,62 @@ bool HttpServerPropertiesManager::AddToQuicServerInfoMap(
   return !detected_corrupted_prefs;
 }
 
+bool HttpServerPropertiesManager::AddToPreconnectMap(
+    const base::DictionaryValue& http_server_properties_dict,
+    PreconnectMap* preconnect_map) {
+  const base::DictionaryValue* preconnect_pages_dict = NULL;
+  if (!http_server_properties_dict.GetDictionaryWithoutPathExpansion(
+          kPreconnectPagesKey, &preconnect_pages_dict)) {
+    return true;
+  }
+
+  bool detected_corrupted_prefs = false;
+  for (base::DictionaryValue::Iterator it(*preconnect_pages_dict);
+       !it.IsAtEnd(); it.Advance()) {
+    GURL page_url(it.key());
+    const base::ListValue* origin_list = NULL;
+    if (!page_url.is_valid() || !it.value().GetAsList(&origin_list)) {
+      DVLOG(1) << "Malformed http_server_properties for preconnect page: "
+               << it.key();
+      detected_corrupted_prefs = true;
+      continue;
+    }
+    // Pages are learned by origin. Older versions stored full page URLs,
+    // which are dropped, and the prefs rewritten without them.
+    if (page_url != page_url.GetOrigin()) {
+      detected_corrupted_prefs = true;
+      continue;
+    }
+
+    PreconnectOriginVector origins;
+    for (const base::Value* origin_value : *origin_list) {
+      const base::DictionaryValue* origin_dict = NULL;
+      std::string origin_str;
+      int num_sockets = 0;
+      if (!origin_value->GetAsDictionary(&origin_dict) ||
+          !origin_dict->GetStringWithoutPathExpansion(kOriginKey,
+                                                      &origin_str) ||
+          !origin_dict->GetIntegerWithoutPathExpansion(kSocketsKey,
+                                                       &num_sockets) ||
+          num_sockets <= 0) {
+        DVLOG(1) << "Malformed http_server_properties preconnect origin for: "
+                 << it.key();
+        detected_corrupted_prefs = true;
+        continue;
+      }
+      GURL origin(origin_str);
+      if (!origin.is_valid()) {
+        detected_corrupted_prefs = true;
+        continue;
+      }
+      origins.push_back(PreconnectOrigin(origin, num_sockets));
+    }
+    if (!origins.empty())
+      preconnect_map->Put(page_url, origins);
+  }
+  return !detected_corrupted_prefs;
+}
+
 void HttpServerPropertiesManager::UpdateCacheFromPrefsOnNetworkThread(
     StringVector* spdy_servers,
     SpdySettingsMap* spdy_settings_map,
@@ -797,6 +881,7 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnNetworkThread(
     IPAddressNumber* last_quic_address,
     ServerNetworkStatsMap* server_network_stats_map,
     QuicServerInfoMap* quic_server_info_map,
+    PreconnectMap* preconnect_map,
     bool detected_corrupted_prefs) {
   // Preferences have the master data because admins might have pushed new
   // preferences. Update the cached data with new data from preferences.
@@ -825,6 +910,8 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnNetworkThread(
   http_server_properties_impl_->InitializeQuicServerInfoMap(
       quic_server_info_map);
 
+  http_server_properties_impl_->InitializePreconnectMap(preconnect_map);
+
   // Update the prefs with what we have read (delete all corrupted prefs).
   if (detected_corrupted_prefs)
     ScheduleUpdatePrefsOnNetworkThread(DETECTED_CORRUPTED_PREFS);
@@ -943,6 +1030,18 @@ void HttpServerPropertiesManager::UpdatePrefsFromCacheOnNetworkThread(
     }
   }
 
+  PreconnectMap* preconnect_map = NULL;
+  const PreconnectMap& main_preconnect_map =
+      http_server_properties_impl_->preconnect_map();
+  if (main_preconnect_map.size() > 0) {
+    preconnect_map = new PreconnectMap(kMaxPreconnectPagesToPersist);
+    for (PreconnectMap::const_reverse_iterator it =
+             main_preconnect_map.rbegin();
+         it != main_preconnect_map.rend(); ++it) {
+      preconnect_map->Put(it->first, it->second);
+    }
+  }
+
   IPAddressNumber* last_quic_addr = new IPAddressNumber;
   http_server_properties_impl_->GetSupportsQuic(last_quic_addr);
   // Update the preferences on the pref thread.
@@ -953,7 +1052,8 @@ void HttpServerPropertiesManager::UpdatePrefsFromCacheOnNetworkThread(
           base::Owned(spdy_server_list), base::Owned(spdy_settings_map),
           base::Owned(alternative_service_map), base::Owned(last_quic_addr),
           base::Owned(server_network_stats_map),
-          base::Owned(quic_server_info_map), completion));
+          base::Owned(quic_server_info_map), base::Owned(preconnect_map),
+          completion));
 }
 
 // A local or temporary data structure to hold |supports_spdy|, SpdySettings,
@@ -991,6 +1091,7 @@ void HttpServerPropertiesManager::UpdatePrefsOnPrefThread(
     IPAddressNumber* last_quic_address,
     ServerNetworkStatsMap* server_network_stats_map,
     QuicServerInfoMap* quic_server_info_map,
+    PreconnectMap* preconnect_map,
     const base::Closure& completion) {
   typedef std::map<HostPortPair, ServerPref> ServerPrefMap;
   ServerPrefMap server_pref_map;
@@ -1063,6 +1164,8 @@ void HttpServerPropertiesManager::UpdatePrefsOnPrefThread(
   SaveQuicServerInfoMapToServerPrefs(quic_server_info_map,
                                      &http_server_properties_dict);
 
+  SavePreconnectMapToPrefs(preconnect_map, &http_server_properties_dict);
+
   setting_prefs_ = true;
   pref_service_->Set(path_, http_server_properties_dict);
   setting_prefs_ = false;
@@ -1177,6 +1280,31 @@ void HttpServerPropertiesManager::SaveQuicServerInfoMapToServerPrefs(
                                                        quic_servers_dict);
 }
 
+void HttpServerPropertiesManager::SavePreconnectMapToPrefs(
+    PreconnectMap* preconnect_map,
+    base::DictionaryValue* http_server_properties_dict) {
+  if (!preconnect_map)
+    return;
+
+  base::DictionaryValue* preconnect_pages_dict = new base::DictionaryValue;
+  for (const std::pair<GURL, PreconnectOriginVector>& entry :
+       *preconnect_map) {
+    base::ListValue* origin_list = new base::ListValue;
+    for (const PreconnectOrigin& origin : entry.second) {
+      base::DictionaryValue* origin_dict = new base::DictionaryValue;
+      origin_dict->SetStringWithoutPathExpansion(kOriginKey,
+                                                 origin.origin.spec());
+      origin_dict->SetIntegerWithoutPathExpansion(kSocketsKey,
+                                                  origin.num_sockets);
+      origin_list->Append(origin_dict);
+    }
+    preconnect_pages_dict->SetWithoutPathExpansion(entry.first.spec(),
+                                                   origin_list);
+  }
+  http_server_properties_dict->SetWithoutPathExpansion(kPreconnectPagesKey,
+                                                       preconnect_pages_dict);
+}
+
 void HttpServerPropertiesManager::OnHttpServerPropertiesChanged() {
   DCHECK(pref_task_runner_->RunsTasksOnCurrentThread());
   if (!setting_prefs_)
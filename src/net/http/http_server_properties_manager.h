@@ -132,6 +132,11 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
                          const std::string& server_info) override;
   const std::string* GetQuicServerInfo(const QuicServerId& server_id) override;
   const QuicServerInfoMap& quic_server_info_map() const override;
+  bool SetPreconnectOrigins(const GURL& page_url,
+                            const PreconnectOriginVector& origins) override;
+  const PreconnectOriginVector* GetPreconnectOrigins(
+      const GURL& page_url) override;
+  const PreconnectMap& preconnect_map() const override;
 
  protected:
   // The location where ScheduleUpdatePrefsOnNetworkThread was called.
@@ -150,7 +155,8 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
     SET_SERVER_NETWORK_STATS = 11,
     DETECTED_CORRUPTED_PREFS = 12,
     SET_QUIC_SERVER_INFO = 13,
-    NUM_LOCATIONS = 14,
+    SET_PRECONNECT_ORIGINS = 14,
+    NUM_LOCATIONS = 15,
   };
 
   // --------------------
@@ -180,6 +186,7 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
       IPAddressNumber* last_quic_address,
       ServerNetworkStatsMap* server_network_stats_map,
       QuicServerInfoMap* quic_server_info_map,
+      PreconnectMap* preconnect_map,
       bool detected_corrupted_prefs);
 
   // These are used to delay updating the preferences when cached data in
@@ -211,6 +218,7 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
                                IPAddressNumber* last_quic_address,
                                ServerNetworkStatsMap* server_network_stats_map,
                                QuicServerInfoMap* quic_server_info_map,
+                               PreconnectMap* preconnect_map,
                                const base::Closure& completion);
 
  private:
@@ -238,6 +246,8 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
                             ServerNetworkStatsMap* network_stats_map);
   bool AddToQuicServerInfoMap(const base::DictionaryValue& server_dict,
                               QuicServerInfoMap* quic_server_info_map);
+  bool AddToPreconnectMap(const base::DictionaryValue& server_dict,
+                          PreconnectMap* preconnect_map);
 
   void SaveSpdySettingsToServerPrefs(const SettingsMap* spdy_settings_map,
                                      base::DictionaryValue* server_pref_dict);
@@ -250,6 +260,9 @@ class NET_EXPORT HttpServerPropertiesManager : public HttpServerProperties {
   void SaveQuicServerInfoMapToServerPrefs(
       QuicServerInfoMap* quic_server_info_map,
       base::DictionaryValue* http_server_properties_dict);
+  void SavePreconnectMapToPrefs(
+      PreconnectMap* preconnect_map,
+      base::DictionaryValue* http_server_properties_dict);
   void SaveSupportsQuicToPrefs(
       const IPAddressNumber* last_quic_address,
       base::DictionaryValue* http_server_properties_dict);
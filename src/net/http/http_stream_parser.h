@@ -56,6 +56,17 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
 
   int ReadResponseHeaders(const CompletionCallback& callback);
 
+  // Reads the response body into |buf|. Body data is read from the socket
+  // directly into |buf|, so a caller that passes in memory it shares with its
+  // consumer usually gets the data there without an intermediate copy. The
+  // exceptions are:
+  //   - Body bytes that arrived along with the headers are copied into |buf|.
+  //     They are returned first, on their own.
+  //   - Chunked bodies are decoded in place, which moves the data within
+  //     |buf| to remove the chunk framing.
+  //   - Bytes read past the end of the body, such as the start of the next
+  //     response on a reused connection, are copied out of |buf| and kept
+  //     for the next read.
   int ReadResponseBody(IOBuffer* buf, int buf_len,
                        const CompletionCallback& callback);
 
@@ -198,7 +209,8 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
   // |request_headers_| if the body was merged with the headers.
   int request_headers_length_;
 
-  // Temporary buffer for reading.
+  // Temporary buffer for reading the headers. It is not used for the body,
+  // except for the data read along with the headers.
   scoped_refptr<GrowableIOBuffer> read_buf_;
 
   // Offset of the first unused byte in |read_buf_|.  May be nonzero due to
@@ -7,6 +7,8 @@
 
 #include "net/http/http_util.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "base/basictypes.h"
@@ -519,25 +521,28 @@ static int LocateEndOfHeadersHelper(const char* buf,
                                     int buf_len,
                                     int i,
                                     bool accept_empty_header_list) {
-  char last_c = '\0';
-  bool was_lf = false;
-  if (accept_empty_header_list) {
-    // Normally two line breaks signal the end of a header list. An empty header
-    // list ends with a single line break at the start of the buffer.
-    last_c = '\n';
-    was_lf = true;
-  }
-
-  for (; i < buf_len; ++i) {
-    char c = buf[i];
-    if (c == '\n') {
-      if (was_lf)
-        return i + 1;
-      was_lf = true;
-    } else if (c != '\r' || last_c != '\n') {
-      was_lf = false;
+  // The header list ends with a line break that immediately follows another
+  // one, or follows another one and a CR. Only the line breaks are looked for,
+  // with memchr(), which is much faster than testing each byte in turn.
+  //
+  // Normally two line breaks signal the end of a header list. An empty header
+  // list ends with a single line break at the start of the buffer.
+  bool was_lf = accept_empty_header_list;
+  int last_lf = i - 1;
+
+  while (i < buf_len) {
+    const char* lf =
+        static_cast<const char*>(memchr(buf + i, '\n', buf_len - i));
+    if (!lf)
+      return -1;
+    int lf_pos = static_cast<int>(lf - buf);
+    if (was_lf && (lf_pos == last_lf + 1 ||
+                   (lf_pos == last_lf + 2 && buf[lf_pos - 1] == '\r'))) {
+      return lf_pos + 1;
     }
-    last_c = c;
+    was_lf = true;
+    last_lf = lf_pos;
+    i = lf_pos + 1;
   }
   return -1;
 }
@@ -0,0 +1,133 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/preconnect_predictor.h"
+
+#include <algorithm>
+
+#include "base/metrics/histogram_macros.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_stream_factory.h"
+#include "net/ssl/ssl_config.h"
+#include "net/ssl/ssl_config_service.h"
+
+namespace net {
+
+namespace {
+
+// Number of page loads that can record their connections at the same time.
+const int kMaxPageLoadsInProgress = 16;
+
+bool MoreSocketsFirst(const PreconnectOrigin& a, const PreconnectOrigin& b) {
+  return a.num_sockets > b.num_sockets;
+}
+
+}  // namespace
+
+const int PreconnectPredictor::kMaxSocketsPerOrigin;
+const size_t PreconnectPredictor::kMaxOriginsPerPage;
+
+PreconnectPredictor::PageLoad::PageLoad() {}
+
+PreconnectPredictor::PageLoad::~PageLoad() {}
+
+PreconnectPredictor::PreconnectPredictor(HttpNetworkSession* session)
+    : session_(session), page_loads_(kMaxPageLoadsInProgress) {
+  DCHECK(session_);
+}
+
+PreconnectPredictor::~PreconnectPredictor() {}
+
+void PreconnectPredictor::OnMainFrameRequest(const GURL& page_url) {
+  DCHECK(CalledOnValidThread());
+  GURL page_key = GetPageKey(page_url);
+  if (page_key.is_empty())
+    return;
+
+  HttpServerProperties* http_server_properties =
+      session_->http_server_properties().get();
+  if (!http_server_properties)
+    return;
+
+  PageLoad page_load;
+  const PreconnectOriginVector* origins =
+      http_server_properties->GetPreconnectOrigins(page_key);
+  if (origins) {
+    Preconnect(*origins);
+    page_load.previous_origins = *origins;
+  }
+  page_loads_.Put(page_key, page_load);
+}
+
+void PreconnectPredictor::OnNewConnection(const GURL& first_party_url,
+                                          const GURL& url) {
+  DCHECK(CalledOnValidThread());
+  PageLoadMap::iterator it = page_loads_.Peek(GetPageKey(first_party_url));
+  if (it == page_loads_.end() || !url.SchemeIsHTTPOrHTTPS())
+    return;
+
+  HttpServerProperties* http_server_properties =
+      session_->http_server_properties().get();
+  if (!http_server_properties)
+    return;
+
+  PageLoad& page_load = it->second;
+  ++page_load.sockets_per_origin[url.GetOrigin()];
+
+  // Origins that have not been needed yet by this load are kept with half of
+  // their previous count, so that a page that stops using an origin forgets
+  // about it after a few loads.
+  std::map<GURL, int> sockets_per_origin = page_load.sockets_per_origin;
+  for (const PreconnectOrigin& origin : page_load.previous_origins) {
+    int& num_sockets = sockets_per_origin[origin.origin];
+    num_sockets = std::max(num_sockets, origin.num_sockets / 2);
+  }
+
+  PreconnectOriginVector origins;
+  for (const std::pair<GURL, int>& entry : sockets_per_origin) {
+    if (entry.second > 0) {
+      origins.push_back(PreconnectOrigin(
+          entry.first, std::min(entry.second, kMaxSocketsPerOrigin)));
+    }
+  }
+  std::stable_sort(origins.begin(), origins.end(), &MoreSocketsFirst);
+  if (origins.size() > kMaxOriginsPerPage)
+    origins.resize(kMaxOriginsPerPage);
+
+  http_server_properties->SetPreconnectOrigins(it->first, origins);
+}
+
+// static
+GURL PreconnectPredictor::GetPageKey(const GURL& page_url) {
+  if (!page_url.is_valid() || !page_url.SchemeIsHTTPOrHTTPS())
+    return GURL();
+  return page_url.GetOrigin();
+}
+
+void PreconnectPredictor::Preconnect(const PreconnectOriginVector& origins) {
+  SSLConfig ssl_config;
+  session_->ssl_config_service()->GetSSLConfig(&ssl_config);
+  session_->GetAlpnProtos(&ssl_config.alpn_protos);
+  session_->GetNpnProtos(&ssl_config.npn_protos);
+
+  int total_sockets = 0;
+  for (const PreconnectOrigin& origin : origins) {
+    int num_sockets = std::min(origin.num_sockets, kMaxSocketsPerOrigin);
+    if (num_sockets <= 0)
+      continue;
+
+    HttpRequestInfo request_info;
+    request_info.url = origin.origin;
+    request_info.method = "GET";
+    request_info.privacy_mode = PRIVACY_MODE_DISABLED;
+    session_->http_stream_factory()->PreconnectStreams(
+        num_sockets, request_info, ssl_config, ssl_config);
+    total_sockets += num_sockets;
+  }
+  UMA_HISTOGRAM_COUNTS_100("Net.PreconnectPredictor.SocketsRequested",
+                           total_sockets);
+}
+
+}  // namespace net
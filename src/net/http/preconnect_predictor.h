@@ -0,0 +1,81 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_PRECONNECT_PREDICTOR_H_
+#define NET_HTTP_PRECONNECT_PREDICTOR_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/containers/mru_cache.h"
+#include "base/threading/non_thread_safe.h"
+#include "net/base/net_export.h"
+#include "net/http/http_server_properties.h"
+#include "url/gurl.h"
+
+namespace net {
+
+class HttpNetworkSession;
+
+// PreconnectPredictor learns which origins a page connects to, and how many
+// sockets it opens to each of them, and warms up that many connections as
+// soon as a page is requested again. What it learns is kept in the session's
+// HttpServerProperties, so that it is persisted along with them.
+//
+// Pages are identified by their origin, so that what is persisted is origin
+// level data, like the rest of HttpServerProperties, rather than a history of
+// the pages visited. The pages of an origin share what is learned. Connections are attributed to a page
+// through the first party URL of the requests that opened them.
+class NET_EXPORT_PRIVATE PreconnectPredictor
+    : NON_EXPORTED_BASE(public base::NonThreadSafe) {
+ public:
+  // At most this many sockets are opened to a single origin, and this many
+  // origins remembered for a single page.
+  static const int kMaxSocketsPerOrigin = 6;
+  static const size_t kMaxOriginsPerPage = 16;
+
+  // |session| must outlive this object.
+  explicit PreconnectPredictor(HttpNetworkSession* session);
+  ~PreconnectPredictor();
+
+  // Called when a main frame request for |page_url| is started. Preconnects
+  // to the origins that the page connected to last time, and starts
+  // recording the connections of this load.
+  void OnMainFrameRequest(const GURL& page_url);
+
+  // Called when a request made on behalf of |first_party_url| had to open a
+  // new connection to |url|.
+  void OnNewConnection(const GURL& first_party_url, const GURL& url);
+
+ private:
+  // The connections opened so far by a page load, and what was learned about
+  // the page before it started.
+  struct PageLoad {
+    PageLoad();
+    ~PageLoad();
+
+    PreconnectOriginVector previous_origins;
+    std::map<GURL, int> sockets_per_origin;
+  };
+
+  typedef base::MRUCache<GURL, PageLoad> PageLoadMap;
+
+  // Returns the key that |page_url| is learned under, or an empty GURL if
+  // the page should not be learned.
+  static GURL GetPageKey(const GURL& page_url);
+
+  void Preconnect(const PreconnectOriginVector& origins);
+
+  HttpNetworkSession* const session_;
+
+  // Page loads that are still recording connections, by page key. Loads that
+  // fall out of it simply stop learning.
+  PageLoadMap page_loads_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreconnectPredictor);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_PRECONNECT_PREDICTOR_H_
@@ -26,6 +26,7 @@
 #include "base/metrics/sparse_histogram.h"
 #include "base/sha1.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
@@ -181,12 +182,40 @@ std::string HashesToBase64String(const HashValueVector& hashes) {
   return str;
 }
 
-std::string HashHost(const std::string& canonicalized_host) {
+std::string HashHost(const base::StringPiece& canonicalized_host) {
   char hashed[crypto::kSHA256Length];
   crypto::SHA256HashString(canonicalized_host, hashed, sizeof(hashed));
   return std::string(hashed, sizeof(hashed));
 }
 
+// An entry that is noted again is updated in memory, but is not persisted
+// again as long as its persisted expiry is within this fraction of its new
+// lifetime. Hosts send their headers with every response, and this keeps each
+// of them from rewriting the whole state.
+const int kRefreshLifetimeFraction = 16;
+
+// Returns true if |new_expiry| is far enough past |old_expiry| that the
+// persisted entry should be rewritten. An expiry that moves earlier, or into
+// the past, always needs a rewrite.
+bool IsRefreshNeeded(const base::Time& old_expiry,
+                     const base::Time& new_expiry) {
+  base::Time now = base::Time::Now();
+  if (new_expiry <= old_expiry || new_expiry <= now)
+    return true;
+  return (new_expiry - old_expiry) >=
+         (new_expiry - now) / kRefreshLifetimeFraction;
+}
+
+bool HashValueVectorsEqual(const HashValueVector& a, const HashValueVector& b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!a[i].Equals(b[i]))
+      return false;
+  }
+  return true;
+}
+
 // Returns true if the intersection of |a| and |b| is not empty. If either
 // |a| or |b| is empty, returns false.
 bool HashesIntersect(const HashValueVector& a,
@@ -741,7 +770,24 @@ void TransportSecurityState::EnableSTSHost(const std::string& host,
     // is the map key.)
     sts_state.domain.clear();
 
-    enabled_sts_hosts_[HashHost(canonicalized_host)] = sts_state;
+    const std::string hashed_host = HashHost(canonicalized_host);
+    STSState& stored_state = enabled_sts_hosts_[hashed_host];
+    ExpiryMap::const_iterator unpersisted =
+        unpersisted_sts_expiries_.find(hashed_host);
+    const base::Time persisted_expiry =
+        unpersisted == unpersisted_sts_expiries_.end() ? stored_state.expiry
+                                                       : unpersisted->second;
+    const bool needs_write =
+        stored_state.upgrade_mode != sts_state.upgrade_mode ||
+        stored_state.include_subdomains != sts_state.include_subdomains ||
+        IsRefreshNeeded(persisted_expiry, sts_state.expiry);
+    // The host's latest policy always applies, even when it is not worth
+    // persisting yet.
+    stored_state = sts_state;
+    if (!needs_write) {
+      unpersisted_sts_expiries_[hashed_host] = persisted_expiry;
+      return;
+    }
   } else {
     const std::string hashed_host = HashHost(canonicalized_host);
     enabled_sts_hosts_.erase(hashed_host);
@@ -766,7 +812,28 @@ void TransportSecurityState::EnablePKPHost(const std::string& host,
     // is the map key.)
     pkp_state.domain.clear();
 
-    enabled_pkp_hosts_[HashHost(canonicalized_host)] = pkp_state;
+    const std::string hashed_host = HashHost(canonicalized_host);
+    PKPState& stored_state = enabled_pkp_hosts_[hashed_host];
+    ExpiryMap::const_iterator unpersisted =
+        unpersisted_pkp_expiries_.find(hashed_host);
+    const base::Time persisted_expiry =
+        unpersisted == unpersisted_pkp_expiries_.end() ? stored_state.expiry
+                                                       : unpersisted->second;
+    const bool needs_write =
+        stored_state.include_subdomains != pkp_state.include_subdomains ||
+        stored_state.report_uri != pkp_state.report_uri ||
+        !HashValueVectorsEqual(stored_state.spki_hashes,
+                               pkp_state.spki_hashes) ||
+        !HashValueVectorsEqual(stored_state.bad_spki_hashes,
+                               pkp_state.bad_spki_hashes) ||
+        IsRefreshNeeded(persisted_expiry, pkp_state.expiry);
+    // The host's latest policy always applies, even when it is not worth
+    // persisting yet.
+    stored_state = pkp_state;
+    if (!needs_write) {
+      unpersisted_pkp_expiries_[hashed_host] = persisted_expiry;
+      return;
+    }
   } else {
     const std::string hashed_host = HashHost(canonicalized_host);
     enabled_pkp_hosts_.erase(hashed_host);
@@ -852,6 +919,8 @@ void TransportSecurityState::ClearDynamicData() {
   DCHECK(CalledOnValidThread());
   enabled_sts_hosts_.clear();
   enabled_pkp_hosts_.clear();
+  unpersisted_sts_expiries_.clear();
+  unpersisted_pkp_expiries_.clear();
 }
 
 void TransportSecurityState::DeleteAllDynamicDataSince(const base::Time& time) {
@@ -891,6 +960,11 @@ TransportSecurityState::~TransportSecurityState() {
 void TransportSecurityState::DirtyNotify() {
   DCHECK(CalledOnValidThread());
 
+  // The delegate persists the whole state, including the updates that did
+  // not notify it.
+  unpersisted_sts_expiries_.clear();
+  unpersisted_pkp_expiries_.clear();
+
   if (delegate_)
     delegate_->StateIsDirty(this);
 }
@@ -1125,6 +1199,11 @@ bool TransportSecurityState::GetDynamicSTSState(const std::string& host,
                                                 STSState* result) {
   DCHECK(CalledOnValidThread());
 
+  // Most profiles have few dynamic entries, if any, and this is called for
+  // every request. Don't bother hashing the host for nothing.
+  if (enabled_sts_hosts_.empty())
+    return false;
+
   const std::string canonicalized_host = CanonicalizeHost(host);
   if (canonicalized_host.empty())
     return false;
@@ -1132,8 +1211,8 @@ bool TransportSecurityState::GetDynamicSTSState(const std::string& host,
   base::Time current_time(base::Time::Now());
 
   for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    std::string host_sub_chunk(&canonicalized_host[i],
-                               canonicalized_host.size() - i);
+    base::StringPiece host_sub_chunk(&canonicalized_host[i],
+                                     canonicalized_host.size() - i);
     STSStateMap::iterator j = enabled_sts_hosts_.find(HashHost(host_sub_chunk));
     if (j == enabled_sts_hosts_.end())
       continue;
@@ -1166,6 +1245,11 @@ bool TransportSecurityState::GetDynamicPKPState(const std::string& host,
                                                 PKPState* result) {
   DCHECK(CalledOnValidThread());
 
+  // Most profiles have few dynamic entries, if any, and this is called for
+  // every request. Don't bother hashing the host for nothing.
+  if (enabled_pkp_hosts_.empty())
+    return false;
+
   const std::string canonicalized_host = CanonicalizeHost(host);
   if (canonicalized_host.empty())
     return false;
@@ -1173,8 +1257,8 @@ bool TransportSecurityState::GetDynamicPKPState(const std::string& host,
   base::Time current_time(base::Time::Now());
 
   for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    std::string host_sub_chunk(&canonicalized_host[i],
-                               canonicalized_host.size() - i);
+    base::StringPiece host_sub_chunk(&canonicalized_host[i],
+                                     canonicalized_host.size() - i);
     PKPStateMap::iterator j = enabled_pkp_hosts_.find(HashHost(host_sub_chunk));
     if (j == enabled_pkp_hosts_.end())
       continue;
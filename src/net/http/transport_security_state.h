@@ -7,11 +7,11 @@
 
 #include <stdint.h>
 
-#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/containers/hash_tables.h"
 #include "base/gtest_prod_util.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/time/time.h"
@@ -101,8 +101,8 @@ class NET_EXPORT TransportSecurityState
     const STSState& domain_state() const { return iterator_->second; }
 
    private:
-    std::map<std::string, STSState>::const_iterator iterator_;
-    std::map<std::string, STSState>::const_iterator end_;
+    base::hash_map<std::string, STSState>::const_iterator iterator_;
+    base::hash_map<std::string, STSState>::const_iterator end_;
   };
 
   // A PKPState describes the public key pinning state.
@@ -177,8 +177,8 @@ class NET_EXPORT TransportSecurityState
     const PKPState& domain_state() const { return iterator_->second; }
 
    private:
-    std::map<std::string, PKPState>::const_iterator iterator_;
-    std::map<std::string, PKPState>::const_iterator end_;
+    base::hash_map<std::string, PKPState>::const_iterator iterator_;
+    base::hash_map<std::string, PKPState>::const_iterator end_;
   };
 
   // An interface for asynchronously sending HPKP violation reports.
@@ -323,8 +323,10 @@ class NET_EXPORT TransportSecurityState
   FRIEND_TEST_ALL_PREFIXES(HttpSecurityHeadersTest, UpdateDynamicPKPMaxAge0);
   FRIEND_TEST_ALL_PREFIXES(HttpSecurityHeadersTest, NoClobberPins);
 
-  typedef std::map<std::string, STSState> STSStateMap;
-  typedef std::map<std::string, PKPState> PKPStateMap;
+  // Keyed by the SHA-256 hash of the canonicalized host name.
+  typedef base::hash_map<std::string, STSState> STSStateMap;
+  typedef base::hash_map<std::string, PKPState> PKPStateMap;
+  typedef base::hash_map<std::string, base::Time> ExpiryMap;
 
   // Send an UMA report on pin validation failure, if the host is in a
   // statically-defined list of domains.
@@ -399,6 +401,11 @@ class NET_EXPORT TransportSecurityState
   STSStateMap enabled_sts_hosts_;
   PKPStateMap enabled_pkp_hosts_;
 
+  // The expiry last handed to the delegate for the hosts whose expiry has
+  // been extended since without calling DirtyNotify(), which clears them.
+  ExpiryMap unpersisted_sts_expiries_;
+  ExpiryMap unpersisted_pkp_expiries_;
+
   Delegate* delegate_;
 
   ReportSender* report_sender_;
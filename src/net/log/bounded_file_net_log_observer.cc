@@ -0,0 +1,315 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/log/bounded_file_net_log_observer.h"
+
+#include <stdio.h>
+
+#include <set>
+#include <string>
+
+#include "base/bind.h"
+#include "base/callback.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/json/json_writer.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/memory/weak_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "net/log/net_log_util.h"
+#include "net/url_request/url_request_context.h"
+
+namespace net {
+
+namespace {
+
+// Number of queued events that gets them written out.
+const size_t kEventsPerWrite = 64;
+
+// Events that don't fill a batch are written out this long after the first of
+// them was queued, so that a quiet period, or a hang, doesn't keep them from
+// reaching the disk.
+const int kFlushDelaySeconds = 1;
+
+// Events are dropped rather than queued past this, until the queue has been
+// written out.
+const size_t kMaxQueuedEvents = 15000;
+
+}  // namespace
+
+// Events that have been logged, but not written yet. Filled on the threads
+// that log, and emptied on the file task runner.
+class BoundedFileNetLogObserver::WriteQueue
+    : public base::RefCountedThreadSafe<WriteQueue> {
+ public:
+  WriteQueue() {}
+
+  // Queues |value|, and returns the number of events that are now queued.
+  size_t AddEntry(scoped_ptr<base::Value> value) {
+    base::AutoLock lock(lock_);
+    if (queue_.size() < kMaxQueuedEvents)
+      queue_.push_back(value.Pass());
+    return queue_.size();
+  }
+
+  // Moves the queued events to |values|.
+  void SwapQueue(ScopedVector<base::Value>* values) {
+    DCHECK(values->empty());
+    base::AutoLock lock(lock_);
+    queue_.swap(*values);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<WriteQueue>;
+
+  ~WriteQueue() {}
+
+  base::Lock lock_;
+  ScopedVector<base::Value> queue_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteQueue);
+};
+
+// Writes events to the event files, and puts the final log together. All
+// methods are called on the file task runner.
+//
+// The event files are used in turn, each one until it has its share of the
+// total size. Every event is preceded by a separator, so that the files can
+// be concatenated from the oldest one on, whichever that is. Only the
+// separator before the first event is left out.
+class BoundedFileNetLogObserver::FileWriter {
+ public:
+  FileWriter(const base::FilePath& log_path,
+             size_t max_total_size,
+             size_t total_num_files)
+      : log_path_(log_path),
+        max_file_size_(max_total_size / total_num_files),
+        total_num_files_(total_num_files),
+        current_file_index_(0),
+        current_file_size_(0),
+        wrapped_(false),
+        weak_factory_(this) {}
+
+  ~FileWriter() {}
+
+  // Used by the delayed flushes, which may run after the writer is deleted.
+  // The pointer is only dereferenced on the file task runner.
+  base::WeakPtr<FileWriter> GetWeakPtr() { return weak_factory_.GetWeakPtr(); }
+
+  void Initialize(const std::string& constants_json) {
+    constants_json_ = constants_json;
+    OpenCurrentFile();
+  }
+
+  // Writes out the events in |write_queue|.
+  void Flush(scoped_refptr<WriteQueue> write_queue) {
+    ScopedVector<base::Value> values;
+    write_queue->SwapQueue(&values);
+
+    std::string json;
+    for (const base::Value* value : values) {
+      json.clear();
+      base::JSONWriter::Write(*value, &json);
+      WriteEvent(json);
+    }
+    if (current_file_)
+      fflush(current_file_.get());
+  }
+
+  // Writes out the rest of |write_queue|, and then the log, out of the
+  // constants, the events left in the event files and |tab_info_json|. The
+  // event files are deleted.
+  void Stop(scoped_refptr<WriteQueue> write_queue,
+            const std::string& tab_info_json) {
+    Flush(write_queue);
+    current_file_.reset();
+
+    base::ScopedFILE log_file(base::OpenFile(log_path_, "wb"));
+    if (log_file) {
+      fprintf(log_file.get(), "{\"constants\": %s,\n", constants_json_.c_str());
+      fprintf(log_file.get(), "\"events\": [\n");
+
+      size_t first_file_index =
+          wrapped_ ? (current_file_index_ + 1) % total_num_files_ : 0;
+      size_t num_files = wrapped_ ? total_num_files_ : current_file_index_ + 1;
+      bool wrote_events = false;
+      for (size_t i = 0; i < num_files; ++i) {
+        std::string events;
+        base::FilePath path =
+            GetEventFilePath((first_file_index + i) % total_num_files_);
+        if (!base::ReadFileToString(path, &events) || events.empty())
+          continue;
+        // The first event has no separator before it.
+        size_t offset = wrote_events ? 0 : kSeparatorLength;
+        DCHECK_LE(offset, events.size());
+        fwrite(events.data() + offset, 1, events.size() - offset,
+               log_file.get());
+        wrote_events = true;
+      }
+
+      fprintf(log_file.get(), "]");
+      if (!tab_info_json.empty())
+        fprintf(log_file.get(), ",\"tabInfo\": %s\n", tab_info_json.c_str());
+      fprintf(log_file.get(), "}");
+    }
+
+    for (size_t i = 0; i < total_num_files_; ++i)
+      base::DeleteFile(GetEventFilePath(i), false);
+  }
+
+ private:
+  // Written before every event. Newlines are needed so that partial logs can
+  // be loaded by ignoring their last line.
+  static const char kSeparator[];
+  static const size_t kSeparatorLength = 2;
+
+  base::FilePath GetEventFilePath(size_t index) const {
+    return log_path_.InsertBeforeExtensionASCII(".events" +
+                                                base::SizeTToString(index));
+  }
+
+  void OpenCurrentFile() {
+    current_file_.reset(
+        base::OpenFile(GetEventFilePath(current_file_index_), "wb"));
+    current_file_size_ = 0;
+  }
+
+  void WriteEvent(const std::string& json) {
+    if (current_file_size_ >= max_file_size_) {
+      current_file_index_ = (current_file_index_ + 1) % total_num_files_;
+      if (current_file_index_ == 0)
+        wrapped_ = true;
+      OpenCurrentFile();
+    }
+    if (!current_file_)
+      return;
+    fprintf(current_file_.get(), "%s%s", kSeparator, json.c_str());
+    current_file_size_ += kSeparatorLength + json.size();
+  }
+
+  const base::FilePath log_path_;
+  const size_t max_file_size_;
+  const size_t total_num_files_;
+
+  std::string constants_json_;
+
+  base::ScopedFILE current_file_;
+  size_t current_file_index_;
+  size_t current_file_size_;
+
+  // True once all the event files have been used, so that the one after the
+  // current one holds the oldest events.
+  bool wrapped_;
+
+  base::WeakPtrFactory<FileWriter> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileWriter);
+};
+
+const char BoundedFileNetLogObserver::FileWriter::kSeparator[] = ",\n";
+const size_t BoundedFileNetLogObserver::FileWriter::kSeparatorLength;
+
+BoundedFileNetLogObserver::BoundedFileNetLogObserver(
+    const scoped_refptr<base::SingleThreadTaskRunner>& task_runner)
+    : task_runner_(task_runner),
+      capture_mode_(NetLogCaptureMode::Default()),
+      file_writer_(NULL) {}
+
+BoundedFileNetLogObserver::~BoundedFileNetLogObserver() {
+  DCHECK(!net_log());
+  DCHECK(!file_writer_);
+}
+
+void BoundedFileNetLogObserver::set_capture_mode(
+    NetLogCaptureMode capture_mode) {
+  DCHECK(!net_log());
+  capture_mode_ = capture_mode;
+}
+
+void BoundedFileNetLogObserver::StartObserving(
+    NetLog* net_log,
+    const base::FilePath& log_path,
+    base::Value* constants,
+    URLRequestContext* url_request_context,
+    size_t max_total_size,
+    size_t total_num_files) {
+  DCHECK(!file_writer_);
+  // FileWriter divides the total size among the files.
+  CHECK_GT(total_num_files, 0u);
+
+  std::string constants_json;
+  if (constants)
+    base::JSONWriter::Write(*constants, &constants_json);
+  else
+    base::JSONWriter::Write(*GetNetConstants(), &constants_json);
+
+  write_queue_ = new WriteQueue();
+  file_writer_ = new FileWriter(log_path, max_total_size, total_num_files);
+  weak_file_writer_ = file_writer_->GetWeakPtr();
+  task_runner_->PostTask(
+      FROM_HERE, base::Bind(&FileWriter::Initialize,
+                            base::Unretained(file_writer_), constants_json));
+
+  // Add events for in progress requests if a context is given.
+  if (url_request_context) {
+    DCHECK(url_request_context->CalledOnValidThread());
+
+    std::set<URLRequestContext*> contexts;
+    contexts.insert(url_request_context);
+    CreateNetLogEntriesForActiveObjects(contexts, this);
+  }
+
+  net_log->DeprecatedAddObserver(this, capture_mode_);
+}
+
+void BoundedFileNetLogObserver::StopObserving(
+    URLRequestContext* url_request_context,
+    const base::Closure& callback) {
+  net_log()->DeprecatedRemoveObserver(this);
+
+  // Write state of the URLRequestContext when logging stopped.
+  std::string tab_info_json;
+  if (url_request_context) {
+    DCHECK(url_request_context->CalledOnValidThread());
+
+    base::JSONWriter::Write(
+        *GetNetInfo(url_request_context, NET_INFO_ALL_SOURCES),
+        &tab_info_json);
+  }
+
+  task_runner_->PostTaskAndReply(
+      FROM_HERE, base::Bind(&FileWriter::Stop, base::Unretained(file_writer_),
+                            write_queue_, tab_info_json),
+      callback);
+  task_runner_->DeleteSoon(FROM_HERE, file_writer_);
+  file_writer_ = NULL;
+  weak_file_writer_.reset();
+  write_queue_ = NULL;
+}
+
+void BoundedFileNetLogObserver::OnAddEntry(const NetLog::Entry& entry) {
+  scoped_ptr<base::Value> value(entry.ToValue());
+  // Only the event that fills a batch posts a write. Events logged before it
+  // runs are written along with the batch. The first event queued posts a
+  // delayed write, for the events that don't fill a batch in time.
+  const size_t num_queued = write_queue_->AddEntry(value.Pass());
+  if (num_queued == kEventsPerWrite) {
+    task_runner_->PostTask(
+        FROM_HERE, base::Bind(&FileWriter::Flush,
+                              base::Unretained(file_writer_), write_queue_));
+  } else if (num_queued == 1) {
+    task_runner_->PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&FileWriter::Flush, weak_file_writer_, write_queue_),
+        base::TimeDelta::FromSeconds(kFlushDelaySeconds));
+  }
+}
+
+}  // namespace net
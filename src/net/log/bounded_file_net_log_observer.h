@@ -0,0 +1,100 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_LOG_BOUNDED_FILE_NET_LOG_OBSERVER_H_
+#define NET_LOG_BOUNDED_FILE_NET_LOG_OBSERVER_H_
+
+#include <stddef.h>
+
+#include "base/callback_forward.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/log/net_log.h"
+
+namespace base {
+class SingleThreadTaskRunner;
+class Value;
+}
+
+namespace net {
+
+class URLRequestContext;
+
+// BoundedFileNetLogObserver is a cheaper alternative to
+// WriteToFileNetLogObserver for long captures on busy clients.
+//
+// Observers are called with the NetLog lock held, so everything they do
+// stalls every thread that logs. This observer only turns entries into
+// values there, and queues them. Serializing the values and writing them out
+// happens on |task_runner|.
+//
+// Events go to a set of files that together take at most a given size. Once
+// that is reached, the oldest events are dropped to make room for new ones.
+// When observing stops, the events that are left are put together into a
+// single log file, in the same format as WriteToFileNetLogObserver's.
+class NET_EXPORT BoundedFileNetLogObserver
+    : public NetLog::ThreadSafeObserver {
+ public:
+  // |task_runner| is used for all file operations. It must allow blocking,
+  // and it must outlive this object.
+  explicit BoundedFileNetLogObserver(
+      const scoped_refptr<base::SingleThreadTaskRunner>& task_runner);
+  ~BoundedFileNetLogObserver() override;
+
+  // Sets the capture mode to log at. Must be called before StartObserving.
+  void set_capture_mode(NetLogCaptureMode capture_mode);
+
+  // Starts observing |net_log|, and writing to |log_path|. Must not already
+  // be watching a NetLog.
+  //
+  // Events are kept in |total_num_files| files next to |log_path| while
+  // observing, using at most |max_total_size| bytes in total.
+  // |total_num_files| must be at least 1.
+  //
+  // |constants| and |url_request_context| are as in
+  // WriteToFileNetLogObserver::StartObserving().
+  void StartObserving(NetLog* net_log,
+                      const base::FilePath& log_path,
+                      base::Value* constants,
+                      URLRequestContext* url_request_context,
+                      size_t max_total_size,
+                      size_t total_num_files);
+
+  // Stops observing net_log(). Must already be watching. |callback| is run
+  // on the calling thread once |log_path| has been written.
+  //
+  // |url_request_context| is as in WriteToFileNetLogObserver::StopObserving().
+  void StopObserving(URLRequestContext* url_request_context,
+                     const base::Closure& callback);
+
+  // net::NetLog::ThreadSafeObserver implementation:
+  void OnAddEntry(const NetLog::Entry& entry) override;
+
+ private:
+  class WriteQueue;
+  class FileWriter;
+
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
+
+  // The capture mode to log at.
+  NetLogCaptureMode capture_mode_;
+
+  // Events waiting to be written. Shared with |file_writer_|.
+  scoped_refptr<WriteQueue> write_queue_;
+
+  // Lives on |task_runner_|, and is deleted there.
+  FileWriter* file_writer_;
+  // For the delayed writes, which may outlive |file_writer_|.
+  base::WeakPtr<FileWriter> weak_file_writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(BoundedFileNetLogObserver);
+};
+
+}  // namespace net
+
+#endif  // NET_LOG_BOUNDED_FILE_NET_LOG_OBSERVER_H_
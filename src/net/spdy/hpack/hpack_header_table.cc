@@ -14,29 +14,21 @@ namespace net {
 
 using base::StringPiece;
 
-bool HpackHeaderTable::EntryComparator::operator()(
-    const HpackEntry* lhs,
-    const HpackEntry* rhs) const {
-  int result = lhs->name().compare(rhs->name());
-  if (result != 0) {
-    return result < 0;
-  }
-  result = lhs->value().compare(rhs->value());
-  if (result != 0) {
-    return result < 0;
-  }
-  const size_t lhs_index = lhs->IsLookup() ? 0 : 1 + lhs->InsertionIndex();
-  const size_t rhs_index = rhs->IsLookup() ? 0 : 1 + rhs->InsertionIndex();
-  DCHECK(lhs == rhs || lhs_index != rhs_index)
-      << "lhs: (" << lhs->name() << ", " << rhs->value() << ") rhs: ("
-      << rhs->name() << ", " << rhs->value() << ")"
-      << " lhs index: " << lhs_index << " rhs index: " << rhs_index;
-  return lhs_index < rhs_index;
+size_t HpackHeaderTable::EntryHasher::operator()(
+    const HpackEntry* entry) const {
+  BASE_HASH_NAMESPACE::hash<StringPiece> hasher;
+  return hasher(entry->name()) * 31 + hasher(entry->value());
+}
+
+bool HpackHeaderTable::EntriesEq::operator()(const HpackEntry* lhs,
+                                             const HpackEntry* rhs) const {
+  return lhs->name() == rhs->name() && lhs->value() == rhs->value();
 }
 
 HpackHeaderTable::HpackHeaderTable()
     : static_entries_(ObtainHpackStaticTable().GetStaticEntries()),
       static_index_(ObtainHpackStaticTable().GetStaticIndex()),
+      static_name_index_(ObtainHpackStaticTable().GetStaticNameIndex()),
       settings_size_bound_(kDefaultHeaderTableSizeSetting),
       size_(0),
       max_size_(kDefaultHeaderTableSizeSetting),
@@ -60,17 +52,16 @@ const HpackEntry* HpackHeaderTable::GetByIndex(size_t index) {
 }
 
 const HpackEntry* HpackHeaderTable::GetByName(StringPiece name) {
-  HpackEntry query(name, "");
   {
-    OrderedEntrySet::const_iterator it = static_index_.lower_bound(&query);
-    if (it != static_index_.end() && (*it)->name() == name) {
-      return *it;
+    NameToEntryMap::const_iterator it = static_name_index_.find(name);
+    if (it != static_name_index_.end()) {
+      return it->second;
     }
   }
   {
-    OrderedEntrySet::const_iterator it = dynamic_index_.lower_bound(&query);
-    if (it != dynamic_index_.end() && (*it)->name() == name) {
-      return *it;
+    NameToEntryMap::const_iterator it = dynamic_name_index_.find(name);
+    if (it != dynamic_name_index_.end()) {
+      return it->second;
     }
   }
   return NULL;
@@ -80,16 +71,14 @@ const HpackEntry* HpackHeaderTable::GetByNameAndValue(StringPiece name,
                                                       StringPiece value) {
   HpackEntry query(name, value);
   {
-    OrderedEntrySet::const_iterator it = static_index_.lower_bound(&query);
-    if (it != static_index_.end() && (*it)->name() == name &&
-        (*it)->value() == value) {
+    UnorderedEntrySet::const_iterator it = static_index_.find(&query);
+    if (it != static_index_.end()) {
       return *it;
     }
   }
   {
-    OrderedEntrySet::const_iterator it = dynamic_index_.lower_bound(&query);
-    if (it != dynamic_index_.end() && (*it)->name() == name &&
-        (*it)->value() == value) {
+    UnorderedEntrySet::const_iterator it = dynamic_index_.find(&query);
+    if (it != dynamic_index_.end()) {
       return *it;
     }
   }
@@ -159,7 +148,18 @@ void HpackHeaderTable::Evict(size_t count) {
     HpackEntry* entry = &dynamic_entries_.back();
 
     size_ -= entry->Size();
-    CHECK_EQ(1u, dynamic_index_.erase(entry));
+    // A more recent entry with the same name and value may have taken the
+    // place of this one in the indices.
+    UnorderedEntrySet::iterator it = dynamic_index_.find(entry);
+    DCHECK(it != dynamic_index_.end());
+    if (*it == entry) {
+      dynamic_index_.erase(it);
+    }
+    NameToEntryMap::iterator name_it = dynamic_name_index_.find(entry->name());
+    DCHECK(name_it != dynamic_name_index_.end());
+    if (name_it->second == entry) {
+      dynamic_name_index_.erase(name_it);
+    }
     dynamic_entries_.pop_back();
   }
 }
@@ -178,7 +178,18 @@ const HpackEntry* HpackHeaderTable::TryAddEntry(StringPiece name,
   dynamic_entries_.push_front(HpackEntry(name, value,
                                          false,  // is_static
                                          total_insertions_));
-  CHECK(dynamic_index_.insert(&dynamic_entries_.front()).second);
+  HpackEntry* new_entry = &dynamic_entries_.front();
+  // The new entry has the lowest index of all the dynamic entries, so it
+  // replaces any older one with the same name, or name and value.
+  std::pair<UnorderedEntrySet::iterator, bool> index_result =
+      dynamic_index_.insert(new_entry);
+  if (!index_result.second) {
+    dynamic_index_.erase(index_result.first);
+    CHECK(dynamic_index_.insert(new_entry).second);
+  }
+  // The keys point into the entries, so the key is replaced too.
+  dynamic_name_index_.erase(new_entry->name());
+  dynamic_name_index_.insert(std::make_pair(new_entry->name(), new_entry));
 
   size_ += entry_size;
   ++total_insertions_;
@@ -193,12 +204,12 @@ void HpackHeaderTable::DebugLogTableState() const {
     DVLOG(2) << "  " << it->GetDebugString();
   }
   DVLOG(2) << "Full Static Index:";
-  for (OrderedEntrySet::const_iterator it = static_index_.begin();
+  for (UnorderedEntrySet::const_iterator it = static_index_.begin();
        it != static_index_.end(); ++it) {
     DVLOG(2) << "  " << (*it)->GetDebugString();
   }
   DVLOG(2) << "Full Dynamic Index:";
-  for (OrderedEntrySet::const_iterator it = dynamic_index_.begin();
+  for (UnorderedEntrySet::const_iterator it = dynamic_index_.begin();
        it != dynamic_index_.end(); ++it) {
     DVLOG(2) << "  " << (*it)->GetDebugString();
   }
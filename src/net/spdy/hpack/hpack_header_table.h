@@ -7,9 +7,9 @@
 
 #include <cstddef>
 #include <deque>
-#include <set>
 
 #include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
 #include "base/macros.h"
 #include "net/base/net_export.h"
 #include "net/spdy/hpack/hpack_entry.h"
@@ -36,15 +36,21 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   // extended to map to list iterators.
   typedef std::deque<HpackEntry> EntryTable;
 
-  // Implements a total ordering of HpackEntry on name(), value(), then index
-  // ascending. Note that index may change over the lifetime of an HpackEntry,
-  // but the relative index order of two entries will not. This comparator is
-  // composed with the 'lookup' HpackEntry constructor to allow for efficient
-  // lower-bounding of matching entries.
-  struct NET_EXPORT_PRIVATE EntryComparator {
+  // Hashes and compares HpackEntry on name() and value(), so that the indices
+  // below hold at most one entry for each distinct name and value: the one
+  // with the lowest index. The 'lookup' HpackEntry constructor makes the
+  // queries.
+  struct NET_EXPORT_PRIVATE EntryHasher {
+    size_t operator()(const HpackEntry* entry) const;
+  };
+  struct NET_EXPORT_PRIVATE EntriesEq {
     bool operator()(const HpackEntry* lhs, const HpackEntry* rhs) const;
   };
-  typedef std::set<HpackEntry*, EntryComparator> OrderedEntrySet;
+  typedef base::hash_set<HpackEntry*, EntryHasher, EntriesEq>
+      UnorderedEntrySet;
+  // Maps a name to the entry with the lowest index having that name. The keys
+  // point into the entries.
+  typedef base::hash_map<StringPiece, const HpackEntry*> NameToEntryMap;
 
   HpackHeaderTable();
 
@@ -61,7 +67,7 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   // Returns the entry matching the index, or NULL.
   const HpackEntry* GetByIndex(size_t index);
 
-  // Returns the lowest-value entry having |name|, or NULL.
+  // Returns the lowest-index entry having |name|, or NULL.
   const HpackEntry* GetByName(StringPiece name);
 
   // Returns the lowest-index matching entry, or NULL.
@@ -109,8 +115,10 @@ class NET_EXPORT_PRIVATE HpackHeaderTable {
   const EntryTable& static_entries_;
   EntryTable dynamic_entries_;
 
-  const OrderedEntrySet& static_index_;
-  OrderedEntrySet dynamic_index_;
+  const UnorderedEntrySet& static_index_;
+  const NameToEntryMap& static_name_index_;
+  UnorderedEntrySet dynamic_index_;
+  NameToEntryMap dynamic_name_index_;
 
   // Last acknowledged value for SETTINGS_HEADER_TABLE_SIZE.
   size_t settings_size_bound_;
@@ -33,6 +33,7 @@ URLRequestContext::URLRequestContext()
       backoff_manager_(nullptr),
       sdch_manager_(nullptr),
       network_quality_estimator_(nullptr),
+      enable_brotli_(false),
       url_requests_(new std::set<const URLRequest*>) {
 }
 
@@ -61,6 +62,7 @@ void URLRequestContext::CopyFrom(const URLRequestContext* other) {
   set_sdch_manager(other->sdch_manager_);
   set_http_user_agent_settings(other->http_user_agent_settings_);
   set_network_quality_estimator(other->network_quality_estimator_);
+  set_enable_brotli(other->enable_brotli_);
 }
 
 const HttpNetworkSession::Params* URLRequestContext::GetNetworkSessionParams(
@@ -218,6 +218,12 @@ class NET_EXPORT URLRequestContext
     network_quality_estimator_ = network_quality_estimator;
   }
 
+  // Whether "br" is advertised in Accept-Encoding. It is only ever advertised
+  // over cryptographic schemes, as some intermediaries mangle unknown
+  // encodings.
+  void set_enable_brotli(bool enable_brotli) { enable_brotli_ = enable_brotli; }
+  bool enable_brotli() const { return enable_brotli_; }
+
  private:
   // ---------------------------------------------------------------------------
   // Important: When adding any new members below, consider whether they need to
@@ -246,6 +252,9 @@ class NET_EXPORT URLRequestContext
   SdchManager* sdch_manager_;
   NetworkQualityEstimator* network_quality_estimator_;
 
+  // Enables Brotli Content-Encoding support.
+  bool enable_brotli_;
+
   // ---------------------------------------------------------------------------
   // Important: When adding any new members below, consider whether they need to
   // be added to CopyFrom.
@@ -207,6 +207,7 @@ URLRequestContextBuilder::URLRequestContextBuilder()
       throttling_enabled_(false),
       backoff_enabled_(false),
       sdch_enabled_(false),
+      brotli_enabled_(false),
       net_log_(nullptr) {
 }
 
@@ -342,6 +343,8 @@ scoped_ptr<URLRequestContext> URLRequestContextBuilder::Build() {
         scoped_ptr<net::SdchManager>(new SdchManager()).Pass());
   }
 
+  context->set_enable_brotli(brotli_enabled_);
+
   storage->set_transport_security_state(
       make_scoped_ptr(new TransportSecurityState()));
   if (!transport_security_persister_path_.empty()) {
@@ -22,6 +22,7 @@
 #include "base/values.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/load_flags.h"
+#include "net/base/load_timing_info.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
 #include "net/base/network_delegate.h"
@@ -39,6 +40,7 @@
 #include "net/http/http_transaction.h"
 #include "net/http/http_transaction_factory.h"
 #include "net/http/http_util.h"
+#include "net/http/preconnect_predictor.h"
 #include "net/proxy/proxy_info.h"
 #include "net/ssl/ssl_cert_request_info.h"
 #include "net/ssl/ssl_config_service.h"
@@ -273,6 +275,12 @@ void URLRequestHttpJob::Start() {
       http_user_agent_settings_ ?
           http_user_agent_settings_->GetUserAgent() : std::string());
 
+  if (request_info_.load_flags & LOAD_MAIN_FRAME) {
+    PreconnectPredictor* preconnect_predictor = GetPreconnectPredictor();
+    if (preconnect_predictor)
+      preconnect_predictor->OnMainFrameRequest(request_info_.url);
+  }
+
   AddExtraHeaders();
   AddCookieHeaderAndStart();
 }
@@ -601,25 +609,26 @@ void URLRequestHttpJob::AddExtraHeaders() {
     // easier to filter and analyze the streams to assure that a proxy has not
     // damaged these headers. Some proxies deliberately corrupt Accept-Encoding
     // headers.
-    if (!advertise_sdch) {
-      // Tell the server what compression formats we support (other than SDCH).
-      request_info_.extra_headers.SetHeader(
-          HttpRequestHeaders::kAcceptEncoding, "gzip, deflate");
-    } else {
-      // Include SDCH in acceptable list.
+    std::string advertised_encodings = "gzip, deflate";
+    if (advertise_sdch)
+      advertised_encodings += ", sdch";
+    if (request()->context()->enable_brotli() &&
+        request()->url().SchemeIsCryptographic()) {
+      advertised_encodings += ", br";
+    }
+    // Tell the server what compression formats we support.
+    request_info_.extra_headers.SetHeader(HttpRequestHeaders::kAcceptEncoding,
+                                          advertised_encodings);
+    if (advertise_sdch && dictionaries_advertised_) {
       request_info_.extra_headers.SetHeader(
-          HttpRequestHeaders::kAcceptEncoding, "gzip, deflate, sdch");
-      if (dictionaries_advertised_) {
-        request_info_.extra_headers.SetHeader(
-            kAvailDictionaryHeader,
-            dictionaries_advertised_->GetDictionaryClientHashList());
-        // Since we're tagging this transaction as advertising a dictionary,
-        // we'll definitely employ an SDCH filter (or tentative sdch filter)
-        // when we get a response. When done, we'll record histograms via
-        // SDCH_DECODE or SDCH_PASSTHROUGH. Hence we need to record packet
-        // arrival times.
-        packet_timing_enabled_ = true;
-      }
+          kAvailDictionaryHeader,
+          dictionaries_advertised_->GetDictionaryClientHashList());
+      // Since we're tagging this transaction as advertising a dictionary,
+      // we'll definitely employ an SDCH filter (or tentative sdch filter)
+      // when we get a response. When done, we'll record histograms via
+      // SDCH_DECODE or SDCH_PASSTHROUGH. Hence we need to record packet
+      // arrival times.
+      packet_timing_enabled_ = true;
     }
   }
 
@@ -927,6 +936,7 @@ void URLRequestHttpJob::OnStartCompleted(int result) {
   if (result == OK) {
     if (transaction_ && transaction_->GetResponseInfo()) {
       SetProxyServer(transaction_->GetResponseInfo()->proxy_server);
+      NotifyPreconnectPredictor();
     }
     scoped_refptr<HttpResponseHeaders> headers = GetResponseHeaders();
     if (network_delegate()) {
@@ -1574,6 +1584,38 @@ void URLRequestHttpJob::DoneWithRequest(CompletionCause reason) {
     request_->set_received_response_content_length(prefilter_bytes_read());
 }
 
+PreconnectPredictor* URLRequestHttpJob::GetPreconnectPredictor() const {
+  HttpTransactionFactory* factory =
+      request_->context()->http_transaction_factory();
+  if (!factory)
+    return NULL;
+  HttpNetworkSession* session = factory->GetSession();
+  if (!session)
+    return NULL;
+  return session->preconnect_predictor();
+}
+
+void URLRequestHttpJob::NotifyPreconnectPredictor() {
+  if (transaction_->GetResponseInfo()->was_cached)
+    return;
+
+  // Only requests that needed a new connection are reported, since those are
+  // the ones a preconnect would have sped up. A socket that the predictor
+  // preconnected is not counted as reused the first time it is used, so the
+  // hosts it got right are reported too, and keep being preconnected.
+  LoadTimingInfo load_timing_info;
+  if (!transaction_->GetLoadTimingInfo(&load_timing_info) ||
+      load_timing_info.socket_reused) {
+    return;
+  }
+
+  PreconnectPredictor* preconnect_predictor = GetPreconnectPredictor();
+  if (preconnect_predictor) {
+    preconnect_predictor->OnNewConnection(request_->first_party_for_cookies(),
+                                          request_->url());
+  }
+}
+
 HttpResponseHeaders* URLRequestHttpJob::GetResponseHeaders() const {
   DCHECK(transaction_.get());
   DCHECK(transaction_->GetResponseInfo());
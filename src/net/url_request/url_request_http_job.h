@@ -33,6 +33,7 @@ class HttpResponseHeaders;
 class HttpResponseInfo;
 class HttpTransaction;
 class HttpUserAgentSettings;
+class PreconnectPredictor;
 class ProxyInfo;
 class UploadDataStream;
 class URLRequestContext;
@@ -159,6 +160,13 @@ class NET_EXPORT_PRIVATE URLRequestHttpJob : public URLRequestJob {
   void RecordPerfHistograms(CompletionCause reason);
   void DoneWithRequest(CompletionCause reason);
 
+  // Returns the PreconnectPredictor of the network session, if there is one.
+  PreconnectPredictor* GetPreconnectPredictor() const;
+
+  // Tells the PreconnectPredictor if the transaction had to open a new
+  // connection.
+  void NotifyPreconnectPredictor();
+
   // Callback functions for Cookie Monster
   void DoLoadCookies();
   void CheckCookiePolicyAndLoad(const CookieList& cookie_list);
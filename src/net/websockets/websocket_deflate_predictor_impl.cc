@@ -4,20 +4,77 @@
 
 #include "net/websockets/websocket_deflate_predictor_impl.h"
 
+#include "net/websockets/websocket_frame.h"
+
 namespace net {
 
+namespace {
+
+// Messages are not deflated when deflating saves less than this.
+const double kMaxDeflatedRatio = 0.9;
+
+// Weight of the latest deflated message in the moving average.
+const double kDeflatedRatioWeight = 0.125;
+
+// While deflating does not pay off, one message out of this many is
+// deflated all the same.
+const int kSamplingInterval = 16;
+
+}  // namespace
+
 typedef WebSocketDeflatePredictor::Result Result;
 
+WebSocketDeflatePredictorImpl::WebSocketDeflatePredictorImpl()
+    : message_input_bytes_(0),
+      message_written_bytes_(0),
+      is_message_deflated_(false),
+      average_deflated_ratio_(-1),
+      messages_since_deflated_(0) {}
+
+WebSocketDeflatePredictorImpl::~WebSocketDeflatePredictorImpl() {}
+
 Result WebSocketDeflatePredictorImpl::Predict(
     const ScopedVector<WebSocketFrame>& frames,
     size_t frame_index) {
-  return DEFLATE;
+  if (average_deflated_ratio_ < kMaxDeflatedRatio ||
+      messages_since_deflated_ + 1 >= kSamplingInterval) {
+    return DEFLATE;
+  }
+  return DO_NOT_DEFLATE;
 }
 
 void WebSocketDeflatePredictorImpl::RecordInputDataFrame(
-    const WebSocketFrame* frame) {}
+    const WebSocketFrame* frame) {
+  message_input_bytes_ += frame->header.payload_length;
+}
 
 void WebSocketDeflatePredictorImpl::RecordWrittenDataFrame(
-    const WebSocketFrame* frame) {}
+    const WebSocketFrame* frame) {
+  if (frame->header.opcode != WebSocketFrameHeader::kOpCodeContinuation)
+    is_message_deflated_ = frame->header.reserved1;
+  message_written_bytes_ += frame->header.payload_length;
+  if (!frame->header.final)
+    return;
+
+  // All of the message has been written out, and so read in.
+  if (is_message_deflated_) {
+    messages_since_deflated_ = 0;
+    if (message_input_bytes_ > 0) {
+      double ratio = static_cast<double>(message_written_bytes_) /
+                     static_cast<double>(message_input_bytes_);
+      if (average_deflated_ratio_ < 0) {
+        average_deflated_ratio_ = ratio;
+      } else {
+        average_deflated_ratio_ += kDeflatedRatioWeight *
+                                   (ratio - average_deflated_ratio_);
+      }
+    }
+  } else {
+    ++messages_since_deflated_;
+  }
+  message_input_bytes_ = 0;
+  message_written_bytes_ = 0;
+  is_message_deflated_ = false;
+}
 
 }  // namespace net
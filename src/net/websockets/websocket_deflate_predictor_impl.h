@@ -6,7 +6,9 @@
 #define NET_WEBSOCKETS_WEBSOCKET_DEFLATE_PREDICTOR_IMPL_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include "base/macros.h"
 #include "base/memory/scoped_vector.h"
 #include "net/base/net_export.h"
 #include "net/websockets/websocket_deflate_predictor.h"
@@ -15,15 +17,37 @@ namespace net {
 
 struct WebSocketFrame;
 
+// WebSocketDeflatePredictorImpl deflates messages as long as deflating the
+// previous ones paid off. It keeps a moving average of the size of deflated
+// messages relative to their original size, and stops deflating when that
+// is close to 1. Once in a while it deflates a message anyway, to find out
+// whether the data has become compressible again.
 class NET_EXPORT_PRIVATE WebSocketDeflatePredictorImpl
     : public WebSocketDeflatePredictor {
  public:
-  ~WebSocketDeflatePredictorImpl() override {}
+  WebSocketDeflatePredictorImpl();
+  ~WebSocketDeflatePredictorImpl() override;
 
   Result Predict(const ScopedVector<WebSocketFrame>& frames,
                  size_t frame_index) override;
   void RecordInputDataFrame(const WebSocketFrame* frame) override;
   void RecordWrittenDataFrame(const WebSocketFrame* frame) override;
+
+ private:
+  // Payload bytes of the message being written, before and after
+  // compression, and whether it is being deflated.
+  uint64_t message_input_bytes_;
+  uint64_t message_written_bytes_;
+  bool is_message_deflated_;
+
+  // Moving average of the written size of deflated messages, as a fraction
+  // of their original size. Negative until a message has been deflated.
+  double average_deflated_ratio_;
+
+  // Number of messages written as-is since the last deflated one.
+  int messages_since_deflated_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketDeflatePredictorImpl);
 };
 
 }  // namespace net
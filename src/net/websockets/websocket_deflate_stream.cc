@@ -13,6 +13,7 @@
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram_macros.h"
 #include "net/base/completion_callback.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
@@ -33,6 +34,17 @@ namespace {
 const int kWindowBits = 15;
 const size_t kChunkSize = 4 * 1024;
 
+// The deflater hashes on fewer bits when its window is small, as a large
+// hash table then costs memory without finding more matches. This gives
+// zlib's default for the default window. Below kMinMemLevel, the literal
+// buffer gets so small that blocks are cut too often to compress well. At it,
+// the hash table and literal buffer take 8 KB instead of the default 128 KB.
+const int kMinMemLevel = 4;
+
+int GetMemLevelForWindowBits(int window_bits) {
+  return std::max(kMinMemLevel, window_bits - 7);
+}
+
 }  // namespace
 
 WebSocketDeflateStream::WebSocketDeflateStream(
@@ -46,7 +58,12 @@ WebSocketDeflateStream::WebSocketDeflateStream(
       writing_state_(NOT_WRITING),
       current_reading_opcode_(WebSocketFrameHeader::kOpCodeText),
       current_writing_opcode_(WebSocketFrameHeader::kOpCodeText),
-      predictor_(predictor.Pass()) {
+      predictor_(predictor.Pass()),
+      num_messages_deflated_(0),
+      num_messages_not_deflated_(0),
+      input_bytes_(0),
+      written_bytes_(0),
+      initialized_(false) {
   DCHECK(stream_);
   DCHECK(params.IsValidAsResponse());
   int client_max_window_bits = 15;
@@ -54,14 +71,41 @@ WebSocketDeflateStream::WebSocketDeflateStream(
     DCHECK(params.has_client_max_window_bits_value());
     client_max_window_bits = params.client_max_window_bits();
   }
-  deflater_.Initialize(client_max_window_bits);
-  inflater_.Initialize(kWindowBits);
+  // Always inflate with the full window: zlib before 1.2.9 silently widens
+  // an 8-bit deflate window to 9 bits, so servers announcing
+  // server_max_window_bits=8 may still refer back further than that.
+  initialized_ =
+      deflater_.Initialize(client_max_window_bits,
+                           GetMemLevelForWindowBits(client_max_window_bits)) &&
+      inflater_.Initialize(kWindowBits);
+  if (!initialized_)
+    DVLOG(1) << "Failed to initialize zlib for permessage-deflate.";
 }
 
-WebSocketDeflateStream::~WebSocketDeflateStream() {}
+WebSocketDeflateStream::~WebSocketDeflateStream() {
+  int num_messages = num_messages_deflated_ + num_messages_not_deflated_;
+  if (!num_messages)
+    return;
+  UMA_HISTOGRAM_PERCENTAGE("Net.WebSocket.Deflate.MessagesDeflated",
+                           num_messages_deflated_ * 100 / num_messages);
+  if (input_bytes_) {
+    UMA_HISTOGRAM_COUNTS_1000(
+        "Net.WebSocket.Deflate.WrittenBytesPercentage",
+        static_cast<int>(written_bytes_ * 100 / input_bytes_));
+  }
+  if (num_messages_deflated_) {
+    UMA_HISTOGRAM_CUSTOM_COUNTS(
+        "Net.WebSocket.Deflate.MicrosecondsPerMessage",
+        static_cast<int>(deflate_time_.InMicroseconds() /
+                         num_messages_deflated_),
+        1, 100000, 50);
+  }
+}
 
 int WebSocketDeflateStream::ReadFrames(ScopedVector<WebSocketFrame>* frames,
                                        const CompletionCallback& callback) {
+  if (!initialized_)
+    return ERR_WS_PROTOCOL_ERROR;
   int result = stream_->ReadFrames(
       frames,
       base::Bind(&WebSocketDeflateStream::OnReadComplete,
@@ -78,6 +122,8 @@ int WebSocketDeflateStream::ReadFrames(ScopedVector<WebSocketFrame>* frames,
 
 int WebSocketDeflateStream::WriteFrames(ScopedVector<WebSocketFrame>* frames,
                                         const CompletionCallback& callback) {
+  if (!initialized_)
+    return ERR_WS_PROTOCOL_ERROR;
   int result = Deflate(frames);
   if (result != OK)
     return result;
@@ -129,6 +175,7 @@ int WebSocketDeflateStream::Deflate(ScopedVector<WebSocketFrame>* frames) {
     scoped_ptr<WebSocketFrame> frame((*frames)[i]);
     (*frames)[i] = NULL;
     predictor_->RecordInputDataFrame(frame.get());
+    input_bytes_ += frame->header.payload_length;
 
     if (writing_state_ == WRITING_UNCOMPRESSED_MESSAGE) {
       if (frame->header.final)
@@ -137,6 +184,7 @@ int WebSocketDeflateStream::Deflate(ScopedVector<WebSocketFrame>* frames) {
       frames_to_write.push_back(frame.Pass());
       current_writing_opcode_ = WebSocketFrameHeader::kOpCodeContinuation;
     } else {
+      base::TimeTicks deflate_start = base::TimeTicks::Now();
       if (frame->data.get() &&
           !deflater_.AddBytes(
               frame->data->data(),
@@ -150,6 +198,7 @@ int WebSocketDeflateStream::Deflate(ScopedVector<WebSocketFrame>* frames) {
                  << "deflater_.Finish() returns an error.";
         return ERR_WS_PROTOCOL_ERROR;
       }
+      deflate_time_ += base::TimeTicks::Now() - deflate_start;
 
       if (writing_state_ == WRITING_COMPRESSED_MESSAGE) {
         if (deflater_.CurrentOutputSize() >= kChunkSize ||
@@ -176,6 +225,10 @@ int WebSocketDeflateStream::Deflate(ScopedVector<WebSocketFrame>* frames) {
     }
   }
   DCHECK_NE(WRITING_POSSIBLY_COMPRESSED_MESSAGE, writing_state_);
+  for (const WebSocketFrame* frame : frames_to_write) {
+    if (WebSocketFrameHeader::IsKnownDataOpCode(frame->header.opcode))
+      written_bytes_ += frame->header.payload_length;
+  }
   frames->swap(frames_to_write);
   return OK;
 }
@@ -189,6 +242,11 @@ void WebSocketDeflateStream::OnMessageStart(
   WebSocketDeflatePredictor::Result prediction =
       predictor_->Predict(frames, index);
 
+  if (prediction == WebSocketDeflatePredictor::DO_NOT_DEFLATE)
+    ++num_messages_not_deflated_;
+  else
+    ++num_messages_deflated_;
+
   switch (prediction) {
     case WebSocketDeflatePredictor::DEFLATE:
       writing_state_ = WRITING_COMPRESSED_MESSAGE;
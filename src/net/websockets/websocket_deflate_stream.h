@@ -6,11 +6,13 @@
 #define NET_WEBSOCKETS_WEBSOCKET_DEFLATE_STREAM_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string>
 
 #include "base/macros.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
+#include "base/time/time.h"
 #include "net/base/completion_callback.h"
 #include "net/base/net_export.h"
 #include "net/websockets/websocket_deflater.h"
@@ -98,6 +100,19 @@ class NET_EXPORT_PRIVATE WebSocketDeflateStream : public WebSocketStream {
   WebSocketFrameHeader::OpCode current_writing_opcode_;
   scoped_ptr<WebSocketDeflatePredictor> predictor_;
 
+  // Statistics about the messages written, reported to UMA when the stream
+  // goes away: how many were deflated or sent as-is, their payload bytes
+  // before and after compression, and the time spent deflating them.
+  int num_messages_deflated_;
+  int num_messages_not_deflated_;
+  uint64_t input_bytes_;
+  uint64_t written_bytes_;
+  base::TimeDelta deflate_time_;
+
+  // False if zlib could not be set up, in which case reads and writes fail
+  // the connection.
+  bool initialized_;
+
   DISALLOW_COPY_AND_ASSIGN(WebSocketDeflateStream);
 };
 
@@ -15,6 +15,13 @@
 
 namespace net {
 
+namespace {
+
+// zlib's default memory level.
+const int kDefaultMemLevel = 8;
+
+}  // namespace
+
 WebSocketDeflater::WebSocketDeflater(ContextTakeOverMode mode)
     : mode_(mode), are_bytes_added_(false) {}
 
@@ -26,17 +33,23 @@ WebSocketDeflater::~WebSocketDeflater() {
 }
 
 bool WebSocketDeflater::Initialize(int window_bits) {
+  return Initialize(window_bits, kDefaultMemLevel);
+}
+
+bool WebSocketDeflater::Initialize(int window_bits, int mem_level) {
   DCHECK(!stream_);
   stream_.reset(new z_stream);
 
   DCHECK_LE(8, window_bits);
   DCHECK_GE(15, window_bits);
+  DCHECK_LE(1, mem_level);
+  DCHECK_GE(9, mem_level);
   memset(stream_.get(), 0, sizeof(*stream_));
   int result = deflateInit2(stream_.get(),
                             Z_DEFAULT_COMPRESSION,
                             Z_DEFLATED,
                             -window_bits,  // Negative value for raw deflate
-                            8,  // default mem level
+                            mem_level,
                             Z_DEFAULT_STRATEGY);
   if (result != Z_OK) {
     deflateEnd(stream_.get());
@@ -36,7 +36,12 @@ class NET_EXPORT_PRIVATE WebSocketDeflater {
   // Returns true if there is no error and false otherwise.
   // This function must be called exactly once before calling any of
   // following methods.
-  // |window_bits| must be between 8 and 15 (both inclusive).
+  // |window_bits| must be between 8 and 15 (both inclusive), and
+  // |mem_level| between 1 and 9 (both inclusive). The compressor state takes
+  // about (1 << (window_bits + 2)) + (1 << (mem_level + 9)) bytes.
+  bool Initialize(int window_bits, int mem_level);
+
+  // Same as above, with zlib's default memory level.
   bool Initialize(int window_bits);
 
   // Adds bytes to |stream_|.
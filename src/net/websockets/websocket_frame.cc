@@ -231,16 +231,26 @@ void MaskWebSocketFramePayload(const WebSocketMaskingKey& masking_key,
            kMaskingKeyLength);
   }
 
-  // The main loop.
-  for (char* merged = aligned_begin; merged != aligned_end;
-       merged += kPackedMaskKeySize) {
-    // This is not quite standard-compliant C++. However, the standard-compliant
-    // equivalent (using memcpy()) compiles to slower code using g++. In
-    // practice, this will work for the compilers and architectures currently
-    // supported by Chromium, and the tests are extremely unlikely to pass if a
-    // future compiler/architecture breaks it.
-    *reinterpret_cast<PackedMaskType*>(merged) ^= packed_mask_key;
+  // The main loop. Large payloads are masked several words per iteration, so
+  // that the loads and stores of independent words can overlap.
+  //
+  // This is not quite standard-compliant C++. However, the standard-compliant
+  // equivalent (using memcpy()) compiles to slower code using g++. In
+  // practice, this will work for the compilers and architectures currently
+  // supported by Chromium, and the tests are extremely unlikely to pass if a
+  // future compiler/architecture breaks it.
+  static const size_t kUnrolledMaskSize = kPackedMaskKeySize * 4;
+  char* merged = aligned_begin;
+  for (; static_cast<size_t>(aligned_end - merged) >= kUnrolledMaskSize;
+       merged += kUnrolledMaskSize) {
+    PackedMaskType* const packed = reinterpret_cast<PackedMaskType*>(merged);
+    packed[0] ^= packed_mask_key;
+    packed[1] ^= packed_mask_key;
+    packed[2] ^= packed_mask_key;
+    packed[3] ^= packed_mask_key;
   }
+  for (; merged != aligned_end; merged += kPackedMaskKeySize)
+    *reinterpret_cast<PackedMaskType*>(merged) ^= packed_mask_key;
 
   MaskWebSocketFramePayloadByBytes(
       masking_key,
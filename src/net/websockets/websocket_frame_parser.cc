@@ -28,13 +28,37 @@ const uint64_t kMaxPayloadLengthWithoutExtendedLengthField = 125;
 const uint64_t kPayloadLengthWithTwoByteExtendedLengthField = 126;
 const uint64_t kPayloadLengthWithEightByteExtendedLengthField = 127;
 
+// Largest possible frame header. Only that much data is ever carried over
+// between two calls to Decode().
+const size_t kMaximumFrameHeaderSize =
+    net::WebSocketFrameHeader::kBaseHeaderSize +
+    net::WebSocketFrameHeader::kMaximumExtendedLengthSize +
+    net::WebSocketFrameHeader::kMaskingKeyLength;
+
+// The payload of one frame chunk, stored in the buffer shared by all the
+// chunks decoded from the same input. Keeps that buffer alive.
+class WebSocketPayloadBuffer : public net::IOBufferWithSize {
+ public:
+  WebSocketPayloadBuffer(net::IOBuffer* batch, size_t offset, size_t size)
+      : net::IOBufferWithSize(batch->data() + offset, size), batch_(batch) {}
+
+ private:
+  ~WebSocketPayloadBuffer() override {
+    // |data_| belongs to |batch_|.
+    data_ = NULL;
+  }
+
+  scoped_refptr<net::IOBuffer> batch_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketPayloadBuffer);
+};
+
 }  // namespace.
 
 namespace net {
 
 WebSocketFrameParser::WebSocketFrameParser()
-    : current_read_pos_(0),
-      frame_offset_(0),
+    : frame_offset_(0),
       websocket_error_(kWebSocketNormalClosure) {
   std::fill(masking_key_.key,
             masking_key_.key + WebSocketFrameHeader::kMaskingKeyLength,
@@ -52,61 +76,85 @@ bool WebSocketFrameParser::Decode(
   if (!length)
     return true;
 
-  // TODO(yutak): Remove copy.
-  buffer_.insert(buffer_.end(), data, data + length);
+  const char* current = data;
+  const char* const end = data + length;
+  bool first_chunk = false;
+
+  // Complete the frame header carried over from the previous round, copying
+  // no more of |data| than a header can need.
+  if (!buffer_.empty()) {
+    size_t carried_over = buffer_.size();
+    size_t appended = std::min(length, kMaximumFrameHeaderSize - carried_over);
+    buffer_.insert(buffer_.end(), data, data + appended);
+    size_t header_size =
+        DecodeFrameHeader(&buffer_.front(), &buffer_.front() + buffer_.size());
+    if (websocket_error_ != kWebSocketNormalClosure)
+      return false;
+    if (!current_frame_header_.get()) {
+      DCHECK_EQ(length, appended);
+      return true;
+    }
+    DCHECK_GT(header_size, carried_over);
+    current += header_size - carried_over;
+    buffer_.clear();
+    first_chunk = true;
+  }
+
+  // The payloads of all the chunks decoded from |data| are copied into a
+  // single buffer, which can't need more than what is left of |data|.
+  scoped_refptr<IOBuffer> payload_batch;
+  size_t payload_batch_used = 0;
 
-  while (current_read_pos_ < buffer_.size()) {
-    bool first_chunk = false;
+  while (true) {
     if (!current_frame_header_.get()) {
-      DecodeFrameHeader();
+      if (current == end)
+        break;
+      size_t header_size = DecodeFrameHeader(current, end);
       if (websocket_error_ != kWebSocketNormalClosure)
         return false;
       // If frame header is incomplete, then carry over the remaining
       // data to the next round of Decode().
-      if (!current_frame_header_.get())
+      if (!current_frame_header_.get()) {
+        buffer_.assign(current, end);
         break;
+      }
+      current += header_size;
       first_chunk = true;
     }
 
-    scoped_ptr<WebSocketFrameChunk> frame_chunk =
-        DecodeFramePayload(first_chunk);
+    if (current != end && !payload_batch.get())
+      payload_batch = new IOBuffer(static_cast<size_t>(end - current));
+    scoped_ptr<WebSocketFrameChunk> frame_chunk = DecodeFramePayload(
+        first_chunk, &current, end, payload_batch.get(), &payload_batch_used);
     DCHECK(frame_chunk.get());
     frame_chunks->push_back(frame_chunk.Pass());
+    first_chunk = false;
 
     if (current_frame_header_.get()) {
-      DCHECK(current_read_pos_ == buffer_.size());
+      DCHECK(current == end);
       break;
     }
   }
 
-  // Drain unnecessary data. TODO(yutak): Remove copy. (but how?)
-  buffer_.erase(buffer_.begin(), buffer_.begin() + current_read_pos_);
-  current_read_pos_ = 0;
-
   // Sanity check: the size of carried-over data should not exceed
   // the maximum possible length of a frame header.
-  static const size_t kMaximumFrameHeaderSize =
-      WebSocketFrameHeader::kBaseHeaderSize +
-      WebSocketFrameHeader::kMaximumExtendedLengthSize +
-      WebSocketFrameHeader::kMaskingKeyLength;
   DCHECK_LT(buffer_.size(), kMaximumFrameHeaderSize);
 
   return true;
 }
 
-void WebSocketFrameParser::DecodeFrameHeader() {
+size_t WebSocketFrameParser::DecodeFrameHeader(const char* data,
+                                               const char* end) {
   typedef WebSocketFrameHeader::OpCode OpCode;
   static const int kMaskingKeyLength = WebSocketFrameHeader::kMaskingKeyLength;
 
   DCHECK(!current_frame_header_.get());
 
-  const char* start = &buffer_.front() + current_read_pos_;
-  const char* current = start;
-  const char* end = &buffer_.front() + buffer_.size();
+  const char* current = data;
 
   // Header needs 2 bytes at minimum.
   if (end - current < 2)
-    return;
+    return 0;
 
   uint8_t first_byte = *current++;
   uint8_t second_byte = *current++;
@@ -121,7 +169,7 @@ void WebSocketFrameParser::DecodeFrameHeader() {
   uint64_t payload_length = second_byte & kPayloadLengthMask;
   if (payload_length == kPayloadLengthWithTwoByteExtendedLengthField) {
     if (end - current < 2)
-      return;
+      return 0;
     uint16_t payload_length_16;
     base::ReadBigEndian(current, &payload_length_16);
     current += 2;
@@ -130,7 +178,7 @@ void WebSocketFrameParser::DecodeFrameHeader() {
       websocket_error_ = kWebSocketErrorProtocolError;
   } else if (payload_length == kPayloadLengthWithEightByteExtendedLengthField) {
     if (end - current < 8)
-      return;
+      return 0;
     base::ReadBigEndian(current, &payload_length);
     current += 8;
     if (payload_length <= UINT16_MAX ||
@@ -142,15 +190,14 @@ void WebSocketFrameParser::DecodeFrameHeader() {
   }
   if (websocket_error_ != kWebSocketNormalClosure) {
     buffer_.clear();
-    current_read_pos_ = 0;
     current_frame_header_.reset();
     frame_offset_ = 0;
-    return;
+    return 0;
   }
 
   if (masked) {
     if (end - current < kMaskingKeyLength)
-      return;
+      return 0;
     std::copy(current, current + kMaskingKeyLength, masking_key_.key);
     current += kMaskingKeyLength;
   } else {
@@ -164,16 +211,20 @@ void WebSocketFrameParser::DecodeFrameHeader() {
   current_frame_header_->reserved3 = reserved3;
   current_frame_header_->masked = masked;
   current_frame_header_->payload_length = payload_length;
-  current_read_pos_ += current - start;
   DCHECK_EQ(0u, frame_offset_);
+  return current - data;
 }
 
 scoped_ptr<WebSocketFrameChunk> WebSocketFrameParser::DecodeFramePayload(
-    bool first_chunk) {
+    bool first_chunk,
+    const char** data,
+    const char* end,
+    IOBuffer* payload_batch,
+    size_t* payload_batch_used) {
   // The cast here is safe because |payload_length| is already checked to be
   // less than std::numeric_limits<int>::max() when the header is parsed.
   int next_size = static_cast<int>(
-      std::min(static_cast<uint64_t>(buffer_.size() - current_read_pos_),
+      std::min(static_cast<uint64_t>(end - *data),
                current_frame_header_->payload_length - frame_offset_));
 
   scoped_ptr<WebSocketFrameChunk> frame_chunk(new WebSocketFrameChunk);
@@ -182,9 +233,11 @@ scoped_ptr<WebSocketFrameChunk> WebSocketFrameParser::DecodeFramePayload(
   }
   frame_chunk->final_chunk = false;
   if (next_size) {
-    frame_chunk->data = new IOBufferWithSize(static_cast<int>(next_size));
+    DCHECK(payload_batch);
+    frame_chunk->data = new WebSocketPayloadBuffer(
+        payload_batch, *payload_batch_used, static_cast<size_t>(next_size));
     char* io_data = frame_chunk->data->data();
-    memcpy(io_data, &buffer_.front() + current_read_pos_, next_size);
+    memcpy(io_data, *data, next_size);
     if (current_frame_header_->masked) {
       // The masking function is its own inverse, so we use the same function to
       // unmask as to mask.
@@ -192,7 +245,8 @@ scoped_ptr<WebSocketFrameChunk> WebSocketFrameParser::DecodeFramePayload(
           masking_key_, frame_offset_, io_data, next_size);
     }
 
-    current_read_pos_ += next_size;
+    *data += next_size;
+    *payload_batch_used += next_size;
     frame_offset_ += next_size;
   }
 
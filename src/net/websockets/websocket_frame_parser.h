@@ -19,6 +19,8 @@
 
 namespace net {
 
+class IOBuffer;
+
 // Parses WebSocket frames from byte stream.
 //
 // Specification of WebSocket frame format is available at
@@ -37,7 +39,9 @@ class NET_EXPORT WebSocketFrameParser {
   // any more data and future invocations of Decode() will simply return false.
   //
   // Payload data of parsed WebSocket frames may be incomplete; see comments in
-  // websocket_frame.h for more details.
+  // websocket_frame.h for more details. The payloads of all the chunks
+  // returned by one call share a single buffer, and |data| itself is only
+  // copied from when a frame header is split across calls.
   bool Decode(const char* data,
               size_t length,
               ScopedVector<WebSocketFrameChunk>* frame_chunks);
@@ -49,28 +53,34 @@ class NET_EXPORT WebSocketFrameParser {
   WebSocketError websocket_error() const { return websocket_error_; }
 
  private:
-  // Tries to decode a frame header from |current_read_pos_|.
-  // If successful, this function updates |current_read_pos_|,
-  // |current_frame_header_|, and |masking_key_| (if available).
-  // This function may set |failed_| to true if it observes a corrupt frame.
-  // If there is not enough data in the remaining buffer to parse a frame
-  // header, this function returns without doing anything.
-  void DecodeFrameHeader();
-
-  // Decodes frame payload and creates a WebSocketFrameChunk object.
-  // This function updates |current_read_pos_| and |frame_offset_| after
-  // parsing. This function returns a frame object even if no payload data is
-  // available at this moment, so the receiver could make use of frame header
-  // information. If the end of frame is reached, this function clears
-  // |current_frame_header_|, |frame_offset_| and |masking_key_|.
-  scoped_ptr<WebSocketFrameChunk> DecodeFramePayload(bool first_chunk);
-
-  // Internal buffer to store the data to parse.
+  // Tries to decode a frame header from the data in [|data|, |end|). If
+  // successful, this function updates |current_frame_header_| and
+  // |masking_key_| (if available) and returns the size of the header.
+  // This function may set |websocket_error_| if it observes a corrupt frame.
+  // If there is not enough data to parse a frame header, this function
+  // returns 0 without doing anything.
+  size_t DecodeFrameHeader(const char* data, const char* end);
+
+  // Decodes frame payload from [|*data|, |end|) and creates a
+  // WebSocketFrameChunk object. The payload is copied into |payload_batch|
+  // from |*payload_batch_used| on, and shares that buffer with the other
+  // chunks decoded by the same Decode() call. This function advances |*data|,
+  // |*payload_batch_used| and |frame_offset_| after parsing. This function
+  // returns a frame object even if no payload data is available at this
+  // moment, so the receiver could make use of frame header information. If the
+  // end of frame is reached, this function clears |current_frame_header_|,
+  // |frame_offset_| and |masking_key_|.
+  scoped_ptr<WebSocketFrameChunk> DecodeFramePayload(
+      bool first_chunk,
+      const char** data,
+      const char* end,
+      IOBuffer* payload_batch,
+      size_t* payload_batch_used);
+
+  // The beginning of a frame header that was cut by the end of the data
+  // given to Decode(), to be completed by the next call.
   std::vector<char> buffer_;
 
-  // Position in |buffer_| where the next round of parsing starts.
-  size_t current_read_pos_;
-
   // Frame header and masking key of the current frame.
   // |masking_key_| is filled with zeros if the current frame is not masked.
   scoped_ptr<WebSocketFrameHeader> current_frame_header_;
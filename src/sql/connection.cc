@@ -369,6 +369,7 @@ Connection::Connection()
       page_size_(0),
       cache_size_(0),
       exclusive_locking_(false),
+      wal_mode_(false),
       restrict_to_user_(false),
       transaction_nesting_(0),
       needs_rollback_(false),
@@ -1793,7 +1794,16 @@ bool Connection::OpenInternal(const std::string& file_name,
   // TRUNCATE should be faster than DELETE because it won't need directory
   // changes for each transaction.  PERSIST may break the spirit of using
   // secure_delete.
-  ignore_result(Execute("PRAGMA journal_mode = TRUNCATE"));
+  // WAL - append changes to a -wal file, checkpointed into the database.
+  // Opted into with set_wal_mode(). NORMAL syncs only at checkpoints, which
+  // is still safe against corruption in WAL mode. Failing to switch leaves
+  // the database in its previous mode.
+  if (wal_mode_) {
+    ignore_result(Execute("PRAGMA journal_mode = WAL"));
+    ignore_result(Execute("PRAGMA synchronous = NORMAL"));
+  } else {
+    ignore_result(Execute("PRAGMA journal_mode = TRUNCATE"));
+  }
 
   const base::TimeDelta kBusyTimeout =
     base::TimeDelta::FromSeconds(kBusyTimeoutSeconds);
@@ -142,6 +142,16 @@ class SQL_EXPORT Connection : public base::trace_event::MemoryDumpProvider {
   // This must be called before Open() to have an effect.
   void set_exclusive_locking() { exclusive_locking_ = true; }
 
+  // Call to use a write-ahead log instead of the default rollback journal,
+  // with syncs at checkpoints only. A commit then appends the changed pages
+  // to the -wal file instead of writing them twice, and readers are not
+  // blocked by a commit in progress. The journal mode is stored in the
+  // database file, so every connection to the file should agree on it;
+  // opening it without this switches it back to the rollback journal.
+  //
+  // This must be called before Open() to have an effect.
+  void set_wal_mode() { wal_mode_ = true; }
+
   // Call to cause Open() to restrict access permissions of the
   // database file to only the owner.
   // TODO(shess): Currently only supported on OS_POSIX, is a noop on
@@ -725,6 +735,7 @@ class SQL_EXPORT Connection : public base::trace_event::MemoryDumpProvider {
   int page_size_;
   int cache_size_;
   bool exclusive_locking_;
+  bool wal_mode_;
   bool restrict_to_user_;
 
   // All cached statements. Keeping a reference to these statements means that